@@ -41,6 +41,7 @@
 #include <stdio.h>
 
 #include "antelope.h"
+#include "storage.h"
 
 static db_output_function_t output = printf;
 
@@ -158,3 +159,11 @@ db_processing(db_handle_t *handle)
 {
   return handle->flags & DB_HANDLE_FLAG_PROCESSING;
 }
+
+/* db_flush: Write buffered changes of relations and indexes
+   to the file system. */
+db_result_t
+db_flush(void)
+{
+  return storage_flush();
+}
@@ -49,5 +49,10 @@ const char *db_get_result_message(db_result_t code);
 db_result_t db_print_header(db_handle_t *handle);
 db_result_t db_print_tuple(db_handle_t *handle);
 int db_processing(db_handle_t *handle);
+/* Changes to a relation are written to the file system once no query
+   uses the relation any longer, which is normally when the query that
+   made them completes. db_flush() writes back all buffered changes, also
+   those of relations that are still in use. */
+db_result_t db_flush(void);
 
 #endif /* DB_H */
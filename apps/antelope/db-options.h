@@ -186,6 +186,12 @@
 #define DB_INDEX_COST			64
 #endif /* DB_INDEX_COST */
 
+/* The number of rows that the index loader inserts into an index
+   before it yields to other processes. */
+#ifndef DB_INDEX_LOAD_BATCH
+#define DB_INDEX_LOAD_BATCH		1
+#endif /* DB_INDEX_LOAD_BATCH */
+
 /* The maximum number of hash table indexes. */
 #ifndef DB_MEMHASH_INDEX_LIMIT
 #define DB_MEMHASH_INDEX_LIMIT  	1
@@ -206,6 +212,59 @@
 #define DB_HEAP_CACHE_LIMIT		1
 #endif /* DB_HEAP_CACHE_LIMIT */
 
+/* The maximum number of B+-tree indexes. */
+#ifndef DB_BTREE_INDEX_LIMIT
+#define DB_BTREE_INDEX_LIMIT		1
+#endif /* DB_BTREE_INDEX_LIMIT */
+
+/* The size of a B+-tree node in bytes. Each key takes 8 bytes. */
+#ifndef DB_BTREE_NODE_SIZE
+#define DB_BTREE_NODE_SIZE		128
+#endif /* DB_BTREE_NODE_SIZE */
+
+/* The number of B+-tree nodes cached in memory, shared by all B+-trees. */
+#ifndef DB_BTREE_CACHE_LIMIT
+#define DB_BTREE_CACHE_LIMIT		4
+#endif /* DB_BTREE_CACHE_LIMIT */
+
+/* The maximum height of a B+-tree. */
+#ifndef DB_BTREE_MAX_DEPTH
+#define DB_BTREE_MAX_DEPTH		8
+#endif /* DB_BTREE_MAX_DEPTH */
+
+/* The initial B+-tree file size to reserve when using Coffee. */
+#ifndef DB_BTREE_RESERVE_SIZE
+#define DB_BTREE_RESERVE_SIZE		DB_COFFEE_RESERVE_SIZE
+#endif /* DB_BTREE_RESERVE_SIZE */
+
+/*----------------------------------------------------------------------------*/
+
+/* Storage buffer options. The buffer pool uses DB_STORAGE_PAGE_SIZE *
+   DB_STORAGE_PAGE_LIMIT bytes of memory for page data. */
+
+/* The size of a buffered page of a relation or index file. */
+#ifndef DB_STORAGE_PAGE_SIZE
+#define DB_STORAGE_PAGE_SIZE		64
+#endif /* DB_STORAGE_PAGE_SIZE */
+
+/* The number of pages in the buffer pool. Set to 0 to access
+   files directly through CFS. */
+#ifndef DB_STORAGE_PAGE_LIMIT
+#define DB_STORAGE_PAGE_LIMIT		2
+#endif /* DB_STORAGE_PAGE_LIMIT */
+
+/* The maximum number of files that are accessed through the buffer pool.
+   Relation files are kept open between queries while there is room. */
+#ifndef DB_STORAGE_FILE_LIMIT
+#define DB_STORAGE_FILE_LIMIT		2
+#endif /* DB_STORAGE_FILE_LIMIT */
+
+/* The number of pages read in advance when a file is scanned
+   sequentially. */
+#ifndef DB_STORAGE_READ_AHEAD
+#define DB_STORAGE_READ_AHEAD		1
+#endif /* DB_STORAGE_READ_AHEAD */
+
 /*----------------------------------------------------------------------------*/
 
 /* LVM options. */
@@ -227,5 +286,21 @@
 #define LVM_USE_FLOATS			DB_FEATURE_FLOATS
 #endif /* LVM_USE_FLOATS */
 
+/* Compile the predicate of a selection into threaded code before
+   scanning the relation, instead of interpreting it for each row. */
+#ifndef LVM_COMPILE_PREDICATES
+#define LVM_COMPILE_PREDICATES		1
+#endif /* LVM_COMPILE_PREDICATES */
+
+/* The maximum number of instructions in a compiled predicate. */
+#ifndef LVM_PROGRAM_SIZE
+#define LVM_PROGRAM_SIZE		16
+#endif /* LVM_PROGRAM_SIZE */
+
+/* The stack depth available to a compiled predicate. */
+#ifndef LVM_STACK_SIZE
+#define LVM_STACK_SIZE			8
+#endif /* LVM_STACK_SIZE */
+
 
 #endif /* !DB_OPTIONS_H */
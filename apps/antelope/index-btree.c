@@ -0,0 +1,738 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *	A B+-tree index for flash memory.
+ *
+ *	The tree is stored in a single file of fixed-size nodes. The
+ *	first node-sized slot of the file holds the tree metadata, and
+ *	each following slot holds one node. Leaves contain (key, tuple ID)
+ *	pairs sorted by key, and each leaf links to its right sibling.
+ *	A range search therefore descends the tree once to find the
+ *	first matching key, and then it walks the chain of leaves.
+ *
+ *	All node accesses go through a small LRU cache, and nodes are
+ *	modified in the cache. A dirty node is written back when it is
+ *	evicted or when the index is released. The many small changes
+ *	that successive inserts make to a node thus reach the flash as
+ *	one write. When keys arrive in ascending order, as they do for
+ *	time stamps or when the index is built over a relation that is
+ *	sorted by the attribute, a full leaf on the right edge of the
+ *	tree is not split in half. The new key starts a new leaf
+ *	instead. The tree is then bulk loaded with full nodes, and each
+ *	of them is written only once.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "lib/memb.h"
+
+#include "db-options.h"
+#include "index.h"
+#include "result.h"
+#include "storage.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#if DB_BTREE_CACHE_LIMIT < 2
+#error "The B+-tree index needs at least two cached nodes."
+#endif
+
+#define BTREE_MAGIC	0xb7ee
+#define NO_NODE		0
+
+#define NODE_OFFSET(id)	((unsigned long)(id) * DB_BTREE_NODE_SIZE)
+
+typedef int32_t btree_key_t;
+typedef uint32_t btree_node_id_t;
+
+struct btree_entry {
+  btree_key_t key;
+  /* A tuple ID in a leaf, and a child node ID in an internal node. */
+  uint32_t ptr;
+};
+
+struct btree_node_header {
+  uint16_t count;
+  uint8_t leaf;
+  uint8_t unused;
+  /* The right sibling of a leaf. */
+  btree_node_id_t next;
+};
+
+#define NODE_CAPACITY						\
+  ((DB_BTREE_NODE_SIZE - sizeof(struct btree_node_header)) /	\
+   sizeof(struct btree_entry))
+
+/*
+ * In an internal node, entry i points to the subtree whose keys are
+ * not smaller than the key of entry i. The key of the first entry is
+ * never compared, so keys smaller than it go to the first subtree.
+ */
+struct btree_node {
+  struct btree_node_header header;
+  struct btree_entry entries[NODE_CAPACITY];
+};
+
+struct btree_meta {
+  uint16_t magic;
+  uint8_t height;
+  uint8_t unused;
+  btree_node_id_t root;
+  /* The number of node slots in the file, including the metadata slot. */
+  btree_node_id_t node_count;
+  uint32_t item_count;
+};
+
+struct btree {
+  db_storage_id_t storage;
+  struct btree_meta meta;
+  uint8_t meta_dirty;
+};
+typedef struct btree btree_t;
+
+/* The nodes visited on the way from the root to a leaf. */
+struct btree_path {
+  btree_node_id_t nodes[DB_BTREE_MAX_DEPTH];
+  /* The chosen child in internal nodes, and the key position in the leaf. */
+  uint16_t slots[DB_BTREE_MAX_DEPTH];
+  /* The number of levels, from the root, whose node lies on the
+     right edge of the tree. */
+  uint8_t edge;
+};
+
+struct node_cache {
+  btree_t *tree;
+  btree_node_id_t id;
+  uint32_t last_used;
+  uint8_t dirty;
+  struct btree_node node;
+};
+
+static struct node_cache node_cache[DB_BTREE_CACHE_LIMIT];
+static uint32_t cache_clock;
+MEMB(btrees, btree_t, DB_BTREE_INDEX_LIMIT);
+
+static db_result_t create(index_t *);
+static db_result_t destroy(index_t *);
+static db_result_t load(index_t *);
+static db_result_t release(index_t *);
+static db_result_t insert(index_t *, attribute_value_t *, tuple_id_t);
+static db_result_t delete(index_t *, attribute_value_t *);
+static tuple_id_t get_next(index_iterator_t *);
+
+index_api_t index_btree = {
+  INDEX_BTREE,
+  INDEX_API_EXTERNAL | INDEX_API_RANGE_QUERIES,
+  create,
+  destroy,
+  load,
+  release,
+  insert,
+  delete,
+  get_next
+};
+
+static int
+node_flush(struct node_cache *cache)
+{
+  if(cache->tree == NULL || !cache->dirty) {
+    return 1;
+  }
+
+  if(DB_ERROR(storage_write(cache->tree->storage, &cache->node,
+                            NODE_OFFSET(cache->id), sizeof(cache->node)))) {
+    PRINTF("DB: Failed to write B+-tree node %lu\n", (unsigned long)cache->id);
+    return 0;
+  }
+  cache->dirty = 0;
+
+  return 1;
+}
+
+static struct node_cache *
+get_cache_free(void)
+{
+  struct node_cache *victim;
+  int i;
+
+  victim = &node_cache[0];
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(node_cache[i].tree == NULL) {
+      return &node_cache[i];
+    }
+    if(node_cache[i].last_used < victim->last_used) {
+      victim = &node_cache[i];
+    }
+  }
+
+  if(node_flush(victim) == 0) {
+    return NULL;
+  }
+  victim->tree = NULL;
+
+  return victim;
+}
+
+static struct node_cache *
+node_get(btree_t *tree, btree_node_id_t id)
+{
+  struct node_cache *cache;
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(node_cache[i].tree == tree && node_cache[i].id == id) {
+      node_cache[i].last_used = ++cache_clock;
+      return &node_cache[i];
+    }
+  }
+
+  cache = get_cache_free();
+  if(cache == NULL) {
+    return NULL;
+  }
+
+  if(DB_ERROR(storage_read(tree->storage, &cache->node,
+                           NODE_OFFSET(id), sizeof(cache->node)))) {
+    PRINTF("DB: Failed to read B+-tree node %lu\n", (unsigned long)id);
+    return NULL;
+  }
+
+  cache->tree = tree;
+  cache->id = id;
+  cache->dirty = 0;
+  cache->last_used = ++cache_clock;
+
+  return cache;
+}
+
+static struct node_cache *
+node_new(btree_t *tree, int leaf)
+{
+  struct node_cache *cache;
+
+  cache = get_cache_free();
+  if(cache == NULL) {
+    return NULL;
+  }
+
+  memset(&cache->node, 0, sizeof(cache->node));
+  cache->node.header.leaf = leaf;
+  cache->tree = tree;
+  cache->id = tree->meta.node_count++;
+  cache->dirty = 1;
+  cache->last_used = ++cache_clock;
+  tree->meta_dirty = 1;
+
+  return cache;
+}
+
+static int
+tree_flush(btree_t *tree)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(node_cache[i].tree == tree && node_flush(&node_cache[i]) == 0) {
+      return 0;
+    }
+  }
+
+  if(tree->meta_dirty) {
+    if(DB_ERROR(storage_write(tree->storage, &tree->meta, 0,
+                              sizeof(tree->meta)))) {
+      return 0;
+    }
+    tree->meta_dirty = 0;
+  }
+
+  return 1;
+}
+
+static void
+tree_invalidate(btree_t *tree)
+{
+  int i;
+
+  for(i = 0; i < DB_BTREE_CACHE_LIMIT; i++) {
+    if(node_cache[i].tree == tree) {
+      node_cache[i].tree = NULL;
+    }
+  }
+}
+
+/*
+ * Return the position of the first entry whose key is not smaller
+ * than the given key, or, if upper is set, the position of the first
+ * entry whose key is greater than it.
+ */
+static int
+node_search(struct btree_node *node, long key, int upper)
+{
+  int low;
+  int high;
+  int middle;
+
+  low = 0;
+  high = node->header.count;
+  while(low < high) {
+    middle = low + (high - low) / 2;
+    if(node->entries[middle].key < key ||
+       (upper && node->entries[middle].key == key)) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static void
+node_insert_at(struct btree_node *node, int position,
+               struct btree_entry *entry)
+{
+  memmove(&node->entries[position + 1], &node->entries[position],
+          (node->header.count - position) * sizeof(node->entries[0]));
+  node->entries[position] = *entry;
+  node->header.count++;
+}
+
+/*
+ * Descend from the root to the leaf where the key belongs. When upper
+ * is set, the path leads past all entries with an equal key, which is
+ * where a new entry should be inserted. Otherwise, it leads to the
+ * first entry whose key is not smaller than the given key. Returns the
+ * level of the leaf, or -1 on failure.
+ */
+static int
+tree_descend(btree_t *tree, long key, int upper, struct btree_path *path)
+{
+  struct node_cache *cache;
+  struct btree_node *node;
+  btree_node_id_t id;
+  int level;
+  int position;
+
+  id = tree->meta.root;
+  path->edge = 1;
+
+  for(level = 0; level < DB_BTREE_MAX_DEPTH; level++) {
+    cache = node_get(tree, id);
+    if(cache == NULL) {
+      return -1;
+    }
+    node = &cache->node;
+
+    path->nodes[level] = id;
+    position = node_search(node, key, upper);
+    if(node->header.leaf) {
+      path->slots[level] = position;
+      return level;
+    }
+
+    position = position > 0 ? position - 1 : 0;
+    path->slots[level] = position;
+    if(path->edge == level + 1 && position == node->header.count - 1) {
+      path->edge++;
+    }
+    id = node->entries[position].ptr;
+  }
+
+  PRINTF("DB: The B+-tree is deeper than %d levels\n", DB_BTREE_MAX_DEPTH);
+  return -1;
+}
+
+static db_result_t
+tree_insert(btree_t *tree, btree_key_t key, tuple_id_t value)
+{
+  struct btree_path path;
+  struct btree_entry entry;
+  struct node_cache *cache;
+  struct node_cache *sibling;
+  struct node_cache *root;
+  struct btree_node *node;
+  btree_key_t first_key;
+  int level;
+  int position;
+  int split;
+
+  level = tree_descend(tree, key, 1, &path);
+  if(level < 0) {
+    return DB_INDEX_ERROR;
+  }
+  position = path.slots[level];
+
+  entry.key = key;
+  entry.ptr = value;
+
+  for(;;) {
+    cache = node_get(tree, path.nodes[level]);
+    if(cache == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    node = &cache->node;
+
+    if(node->header.count < NODE_CAPACITY) {
+      node_insert_at(node, position, &entry);
+      cache->dirty = 1;
+      break;
+    }
+
+    if(level == 0 && tree->meta.height >= DB_BTREE_MAX_DEPTH) {
+      PRINTF("DB: The B+-tree cannot grow higher\n");
+      return DB_LIMIT_ERROR;
+    }
+
+    /* The node is full. Keep it full if we are appending to the right
+       edge of the tree; otherwise split it in half. */
+    if(level < path.edge && position == node->header.count) {
+      split = node->header.count;
+    } else {
+      split = node->header.count / 2;
+    }
+
+    sibling = node_new(tree, node->header.leaf);
+    if(sibling == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+
+    memcpy(sibling->node.entries, &node->entries[split],
+           (node->header.count - split) * sizeof(node->entries[0]));
+    sibling->node.header.count = node->header.count - split;
+    node->header.count = split;
+    if(node->header.leaf) {
+      sibling->node.header.next = node->header.next;
+      node->header.next = sibling->id;
+    }
+    cache->dirty = 1;
+
+    if(position >= split) {
+      node_insert_at(&sibling->node, position - split, &entry);
+    } else {
+      node_insert_at(node, position, &entry);
+    }
+
+    PRINTF("DB: Split B+-tree node %lu at level %d into node %lu\n",
+           (unsigned long)cache->id, level, (unsigned long)sibling->id);
+
+    /* The parent gets an entry for the new sibling. */
+    entry.key = sibling->node.entries[0].key;
+    entry.ptr = sibling->id;
+    first_key = node->entries[0].key;
+
+    if(level == 0) {
+      root = node_new(tree, 0);
+      if(root == NULL) {
+        return DB_STORAGE_ERROR;
+      }
+      root->node.entries[0].key = first_key;
+      root->node.entries[0].ptr = path.nodes[0];
+      root->node.entries[1] = entry;
+      root->node.header.count = 2;
+      tree->meta.root = root->id;
+      tree->meta.height++;
+      break;
+    }
+
+    level--;
+    position = path.slots[level] + 1;
+  }
+
+  tree->meta.item_count++;
+  tree->meta_dirty = 1;
+
+  return DB_OK;
+}
+
+static db_result_t
+create(index_t *index)
+{
+  char *filename;
+  btree_t *tree;
+  struct node_cache *root;
+
+  filename = storage_generate_file("btree", DB_BTREE_RESERVE_SIZE);
+  if(filename == NULL) {
+    PRINTF("DB: Failed to generate a B+-tree file\n");
+    return DB_INDEX_ERROR;
+  }
+  memcpy(index->descriptor_file, filename, sizeof(index->descriptor_file));
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    cfs_remove(index->descriptor_file);
+    index->descriptor_file[0] = '\0';
+    return DB_ALLOCATION_ERROR;
+  }
+
+  /*
+   * Unlike storage_open(), we do not promise Coffee that the file is
+   * written only once, because nodes are rewritten when they change.
+   */
+  tree->storage = cfs_open(index->descriptor_file, CFS_READ | CFS_WRITE);
+  if(tree->storage < 0) {
+    goto error;
+  }
+
+  tree->meta.magic = BTREE_MAGIC;
+  tree->meta.height = 1;
+  tree->meta.unused = 0;
+  tree->meta.node_count = 1;
+  tree->meta.item_count = 0;
+
+  root = node_new(tree, 1);
+  if(root == NULL) {
+    goto error;
+  }
+  tree->meta.root = root->id;
+
+  if(tree_flush(tree) == 0) {
+    goto error;
+  }
+
+  PRINTF("DB: Created a B+-tree index in file %s with %u keys per node\n",
+         index->descriptor_file, (unsigned)NODE_CAPACITY);
+
+  return DB_OK;
+
+error:
+  tree_invalidate(tree);
+  if(tree->storage >= 0) {
+    cfs_close(tree->storage);
+  }
+  memb_free(&btrees, tree);
+  index->opaque_data = NULL;
+  cfs_remove(index->descriptor_file);
+  index->descriptor_file[0] = '\0';
+  return DB_STORAGE_ERROR;
+}
+
+static db_result_t
+destroy(index_t *index)
+{
+  if(index->opaque_data != NULL) {
+    release(index);
+  }
+  cfs_remove(index->descriptor_file);
+  return DB_OK;
+}
+
+static db_result_t
+load(index_t *index)
+{
+  btree_t *tree;
+
+  index->opaque_data = tree = memb_alloc(&btrees);
+  if(tree == NULL) {
+    PRINTF("DB: Failed to allocate a B+-tree\n");
+    return DB_ALLOCATION_ERROR;
+  }
+
+  tree->storage = cfs_open(index->descriptor_file, CFS_READ | CFS_WRITE);
+  if(tree->storage < 0 ||
+     DB_ERROR(storage_read(tree->storage, &tree->meta, 0,
+                           sizeof(tree->meta))) ||
+     tree->meta.magic != BTREE_MAGIC) {
+    PRINTF("DB: Failed to load a B+-tree from file %s\n",
+           index->descriptor_file);
+    if(tree->storage >= 0) {
+      cfs_close(tree->storage);
+    }
+    memb_free(&btrees, tree);
+    index->opaque_data = NULL;
+    return DB_STORAGE_ERROR;
+  }
+  tree->meta_dirty = 0;
+
+  PRINTF("DB: Loaded a B+-tree of height %u with %lu keys from file %s\n",
+         (unsigned)tree->meta.height, (unsigned long)tree->meta.item_count,
+         index->descriptor_file);
+
+  return DB_OK;
+}
+
+static db_result_t
+release(index_t *index)
+{
+  btree_t *tree;
+  db_result_t result;
+
+  tree = index->opaque_data;
+
+  result = tree_flush(tree) ? DB_OK : DB_STORAGE_ERROR;
+  tree_invalidate(tree);
+  cfs_close(tree->storage);
+  memb_free(&btrees, tree);
+  index->opaque_data = NULL;
+
+  return result;
+}
+
+static db_result_t
+insert(index_t *index, attribute_value_t *key, tuple_id_t value)
+{
+  btree_t *tree;
+  long long_key;
+
+  tree = (btree_t *)index->opaque_data;
+
+  long_key = db_value_to_long(key);
+
+  if(DB_ERROR(tree_insert(tree, (btree_key_t)long_key, value))) {
+    PRINTF("DB: Failed to insert key %ld into a B+-tree index\n", long_key);
+    return DB_INDEX_ERROR;
+  }
+
+  return DB_OK;
+}
+
+/*
+ * Remove all entries with the given key. Leaves that become empty are
+ * left in place, since merging nodes would cost more flash writes than
+ * the space it reclaims.
+ */
+static db_result_t
+delete(index_t *index, attribute_value_t *value)
+{
+  btree_t *tree;
+  struct btree_path path;
+  struct node_cache *cache;
+  struct btree_node *node;
+  btree_node_id_t id;
+  long key;
+  int level;
+  int start;
+  int end;
+  unsigned long removed;
+
+  tree = (btree_t *)index->opaque_data;
+  key = db_value_to_long(value);
+
+  level = tree_descend(tree, key, 0, &path);
+  if(level < 0) {
+    return DB_INDEX_ERROR;
+  }
+
+  removed = 0;
+  for(id = path.nodes[level], start = path.slots[level]; id != NO_NODE;) {
+    cache = node_get(tree, id);
+    if(cache == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    node = &cache->node;
+
+    for(end = start;
+        end < node->header.count && node->entries[end].key == key;
+        end++);
+
+    if(end > start) {
+      memmove(&node->entries[start], &node->entries[end],
+              (node->header.count - end) * sizeof(node->entries[0]));
+      node->header.count -= end - start;
+      cache->dirty = 1;
+      removed += end - start;
+    }
+
+    if(start < node->header.count) {
+      break;
+    }
+    id = node->header.next;
+    start = 0;
+  }
+
+  if(removed == 0) {
+    return DB_INDEX_ERROR;
+  }
+
+  tree->meta.item_count -= removed;
+  tree->meta_dirty = 1;
+
+  return DB_OK;
+}
+
+static tuple_id_t
+get_next(index_iterator_t *iterator)
+{
+  static struct {
+    index_iterator_t *index_iterator;
+    btree_node_id_t leaf;
+    uint16_t position;
+  } cursor;
+  struct btree_path path;
+  struct node_cache *cache;
+  struct btree_entry *entry;
+  btree_t *tree;
+  int level;
+
+  tree = (btree_t *)iterator->index->opaque_data;
+
+  if(cursor.index_iterator != iterator || iterator->next_item_no == 0) {
+    /* Find the first key of a new search. */
+    cursor.index_iterator = iterator;
+    level = tree_descend(tree, db_value_to_long(&iterator->min_value),
+                         0, &path);
+    if(level < 0) {
+      cursor.leaf = NO_NODE;
+      return INVALID_TUPLE;
+    }
+    cursor.leaf = path.nodes[level];
+    cursor.position = path.slots[level];
+  }
+
+  while(cursor.leaf != NO_NODE) {
+    cache = node_get(tree, cursor.leaf);
+    if(cache == NULL) {
+      break;
+    }
+
+    if(cursor.position < cache->node.header.count) {
+      entry = &cache->node.entries[cursor.position];
+      if(entry->key > db_value_to_long(&iterator->max_value)) {
+        break;
+      }
+      cursor.position++;
+      iterator->next_item_no++;
+      return (tuple_id_t)entry->ptr;
+    }
+
+    cursor.leaf = cache->node.header.next;
+    cursor.position = 0;
+  }
+
+  cursor.leaf = NO_NODE;
+  return INVALID_TUPLE;
+}
@@ -49,7 +49,7 @@
 #include "storage.h"
 
 static index_api_t *index_components[] = {&index_inline,
-	&index_maxheap};
+	&index_maxheap, &index_btree};
 
 LIST(indices);
 MEMB(index_memb, index_t, DB_INDEX_POOL_SIZE);
@@ -388,8 +388,10 @@ PROCESS_THREAD(db_indexer, ev, data)
       continue;
     }
 
-    for(;; row++) {
-      PROCESS_PAUSE();
+    for(row = 0;; row++) {
+      if(row % DB_INDEX_LOAD_BATCH == 0) {
+        PROCESS_PAUSE();
+      }
 
       result = db_process(&handle);
       if(DB_ERROR(result)) {
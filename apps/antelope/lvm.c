@@ -818,12 +818,380 @@ lvm_print_derivations(lvm_instance_t *p)
 #endif /* DEBUG */
 }
 
+/*
+ * Compiled predicates. The prefix code of a predicate is translated into
+ * postfix code for a stack machine, where each instruction points to
+ * the function that executes it. Variables are read directly from the
+ * row with the same encoding that the relation uses. Comparisons between
+ * a variable and a constant, which are the most common predicates, get
+ * instructions of their own. The second operand of AND and OR is skipped
+ * if the first one decides the result.
+ */
+struct lvm_machine {
+  const lvm_program_t *program;
+  const unsigned char *row;
+  int top;
+  long stack[LVM_STACK_SIZE];
+};
+
+static int compile_depth;
+
+static long
+load_variable(struct lvm_machine *m, variable_id_t id)
+{
+  const struct lvm_binding *binding;
+  const unsigned char *ptr;
+
+  binding = &m->program->bindings[id];
+  ptr = m->row + binding->offset;
+  if(binding->size == 2) {
+    return ptr[0] << 8 | ptr[1];
+  }
+  return (uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 |
+         (uint32_t)ptr[2] << 8 | ptr[3];
+}
+
+static const struct lvm_instruction *
+exec_end(const struct lvm_instruction *i, struct lvm_machine *m)
+{
+  return NULL;
+}
+
+static const struct lvm_instruction *
+exec_long(const struct lvm_instruction *i, struct lvm_machine *m)
+{
+  m->stack[++m->top] = i->value;
+  return i + 1;
+}
+
+static const struct lvm_instruction *
+exec_variable(const struct lvm_instruction *i, struct lvm_machine *m)
+{
+  m->stack[++m->top] = load_variable(m, i->variable);
+  return i + 1;
+}
+
+static const struct lvm_instruction *
+exec_not(const struct lvm_instruction *i, struct lvm_machine *m)
+{
+  m->stack[m->top] = !m->stack[m->top];
+  return i + 1;
+}
+
+/* Keep the result of the first operand of AND if it is false, and
+   skip the second one. */
+static const struct lvm_instruction *
+exec_and(const struct lvm_instruction *i, struct lvm_machine *m)
+{
+  if(!m->stack[m->top]) {
+    return &m->program->code[i->value];
+  }
+  m->top--;
+  return i + 1;
+}
+
+static const struct lvm_instruction *
+exec_or(const struct lvm_instruction *i, struct lvm_machine *m)
+{
+  if(m->stack[m->top]) {
+    return &m->program->code[i->value];
+  }
+  m->top--;
+  return i + 1;
+}
+
+/* Operators on the two topmost values of the stack. */
+#define EXEC_BINARY(name, op)						\
+static const struct lvm_instruction *					\
+exec_##name(const struct lvm_instruction *i, struct lvm_machine *m)	\
+{									\
+  m->top--;								\
+  m->stack[m->top] = m->stack[m->top] op m->stack[m->top + 1];		\
+  return i + 1;								\
+}
+
+/* Comparisons of a variable with a constant. */
+#define EXEC_COMPARE_LONG(name, op)					\
+static const struct lvm_instruction *					\
+exec_##name##_long(const struct lvm_instruction *i,			\
+                   struct lvm_machine *m)				\
+{									\
+  m->stack[++m->top] = load_variable(m, i->variable) op i->value;	\
+  return i + 1;								\
+}
+
+EXEC_BINARY(add, +)
+EXEC_BINARY(sub, -)
+EXEC_BINARY(mul, *)
+EXEC_BINARY(eq, ==)
+EXEC_BINARY(neq, !=)
+EXEC_BINARY(gt, >)
+EXEC_BINARY(geq, >=)
+EXEC_BINARY(lt, <)
+EXEC_BINARY(leq, <=)
+EXEC_COMPARE_LONG(eq, ==)
+EXEC_COMPARE_LONG(neq, !=)
+EXEC_COMPARE_LONG(gt, >)
+EXEC_COMPARE_LONG(geq, >=)
+EXEC_COMPARE_LONG(lt, <)
+EXEC_COMPARE_LONG(leq, <=)
+
+/* Indexed by the lower bits of the comparison operators. */
+static const lvm_handler_t compare_handlers[] = {
+  NULL, exec_eq, exec_neq, exec_gt, exec_geq, exec_lt, exec_leq
+};
+static const lvm_handler_t compare_long_handlers[] = {
+  NULL, exec_eq_long, exec_neq_long, exec_gt_long, exec_geq_long,
+  exec_lt_long, exec_leq_long
+};
+/* The comparison to use when the operands swap places. */
+static const operator_t mirrored_operators[] = {
+  0, LVM_EQ, LVM_NEQ, LVM_LE, LVM_LEQ, LVM_GE, LVM_GEQ
+};
+
+static lvm_status_t
+emit(lvm_program_t *program, lvm_handler_t handler, long value,
+     variable_id_t variable, int stack_effect)
+{
+  struct lvm_instruction *instruction;
+
+  if(program->length == LVM_PROGRAM_SIZE) {
+    return STACK_OVERFLOW;
+  }
+
+  compile_depth += stack_effect;
+  if(compile_depth > LVM_STACK_SIZE) {
+    return STACK_OVERFLOW;
+  }
+
+  instruction = &program->code[program->length++];
+  instruction->handler = handler;
+  instruction->value = value;
+  instruction->variable = variable;
+
+  return TRUE;
+}
+
+static lvm_status_t
+compile_operand(lvm_program_t *program, operand_t *operand)
+{
+  switch(operand->type) {
+  case LVM_LONG:
+    return emit(program, exec_long, operand->value.l, 0, 1);
+  case LVM_VARIABLE:
+    if(operand->value.id >= LVM_MAX_VARIABLE_ID ||
+       program->bindings[operand->value.id].size == 0) {
+      return INVALID_IDENTIFIER;
+    }
+    return emit(program, exec_variable, 0, operand->value.id, 1);
+  default:
+    return TYPE_ERROR;
+  }
+}
+
+static lvm_status_t
+compile_expr(lvm_instance_t *p, lvm_program_t *program)
+{
+  operator_t operator;
+  operand_t operand;
+  lvm_status_t r;
+  lvm_handler_t handler;
+  int i;
+
+  switch(get_type(p)) {
+  case LVM_OPERAND:
+    get_operand(p, &operand);
+    return compile_operand(program, &operand);
+  case LVM_ARITH_OP:
+    operator = *get_operator(p);
+    for(i = 0; i < 2; i++) {
+      r = compile_expr(p, program);
+      if(LVM_ERROR(r)) {
+        return r;
+      }
+    }
+    switch(operator) {
+    case LVM_ADD:
+      handler = exec_add;
+      break;
+    case LVM_SUB:
+      handler = exec_sub;
+      break;
+    case LVM_MUL:
+      handler = exec_mul;
+      break;
+    default:
+      /* Leave divisions to the interpreter, which reports division
+         by zero as an error. */
+      return MATH_ERROR;
+    }
+    return emit(program, handler, 0, 0, -1);
+  default:
+    return SEMANTIC_ERROR;
+  }
+}
+
+static int
+peek_operand(lvm_instance_t *p, operand_t *operand)
+{
+  if(get_type(p) != LVM_OPERAND) {
+    return 0;
+  }
+  get_operand(p, operand);
+  return 1;
+}
+
+static lvm_status_t
+compile_logic(lvm_instance_t *p, lvm_program_t *program)
+{
+  operator_t operator;
+  operand_t operand[2];
+  operand_t swap;
+  lvm_ip_t ip;
+  lvm_status_t r;
+  int jump;
+  int i;
+  int k;
+
+  if(get_type(p) != LVM_CMP_OP) {
+    return SEMANTIC_ERROR;
+  }
+  operator = *get_operator(p);
+
+  if(IS_CONNECTIVE(operator)) {
+    r = compile_logic(p, program);
+    if(LVM_ERROR(r)) {
+      return r;
+    }
+
+    if(operator == LVM_NOT) {
+      return emit(program, exec_not, 0, 0, 0);
+    }
+
+    jump = program->length;
+    r = emit(program, operator == LVM_AND ? exec_and : exec_or, 0, 0, -1);
+    if(LVM_ERROR(r)) {
+      return r;
+    }
+    r = compile_logic(p, program);
+    if(LVM_ERROR(r)) {
+      return r;
+    }
+    program->code[jump].value = program->length;
+    return TRUE;
+  }
+
+  i = operator & ~LVM_CMP_OP;
+  if(i < 1 || i > LVM_LEQ - LVM_CMP_OP) {
+    return EXECUTION_ERROR;
+  }
+
+  /* Try the fast path for comparing a variable with a constant. */
+  ip = p->ip;
+  if(peek_operand(p, &operand[0]) && peek_operand(p, &operand[1])) {
+    if(operand[0].type == LVM_LONG && operand[1].type == LVM_VARIABLE) {
+      swap = operand[0];
+      operand[0] = operand[1];
+      operand[1] = swap;
+      i = mirrored_operators[i] & ~LVM_CMP_OP;
+    }
+    if(operand[0].type == LVM_VARIABLE && operand[1].type == LVM_LONG &&
+       operand[0].value.id < LVM_MAX_VARIABLE_ID &&
+       program->bindings[operand[0].value.id].size != 0) {
+      return emit(program, compare_long_handlers[i], operand[1].value.l,
+                  operand[0].value.id, 1);
+    }
+  }
+  p->ip = ip;
+
+  for(k = 0; k < 2; k++) {
+    r = compile_expr(p, program);
+    if(LVM_ERROR(r)) {
+      return r;
+    }
+  }
+  return emit(program, compare_handlers[i], 0, 0, -1);
+}
+
+void
+lvm_program_init(lvm_program_t *program)
+{
+  memset(program, 0, sizeof(*program));
+}
+
+lvm_status_t
+lvm_bind_variable(lvm_program_t *program, char *name,
+                  unsigned offset, unsigned size)
+{
+  variable_id_t id;
+
+  if(size != 2 && size != 4) {
+    return TYPE_ERROR;
+  }
+
+  id = lookup(name);
+  if(id >= LVM_MAX_VARIABLE_ID || variables[id].name[0] == '\0') {
+    /* The predicate does not use this variable. */
+    return INVALID_IDENTIFIER;
+  }
+
+  program->bindings[id].offset = offset;
+  program->bindings[id].size = size;
+
+  return TRUE;
+}
+
+lvm_status_t
+lvm_compile(lvm_instance_t *p, lvm_program_t *program)
+{
+  lvm_status_t r;
+
+  p->ip = 0;
+  program->length = 0;
+  compile_depth = 0;
+
+  r = compile_logic(p, program);
+  if(!LVM_ERROR(r)) {
+    r = emit(program, exec_end, 0, 0, 0);
+  }
+  p->ip = 0;
+
+  if(LVM_ERROR(r)) {
+    PRINTF("The predicate cannot be compiled: %d\n", (int)r);
+    program->length = 0;
+    return r;
+  }
+
+  PRINTF("Compiled the predicate into %d instructions\n",
+         (int)program->length);
+  return TRUE;
+}
+
+lvm_status_t
+lvm_run(const lvm_program_t *program, const unsigned char *row)
+{
+  struct lvm_machine m;
+  const struct lvm_instruction *instruction;
+
+  m.program = program;
+  m.row = row;
+  m.top = -1;
+
+  for(instruction = program->code; instruction != NULL;) {
+    instruction = instruction->handler(instruction, &m);
+  }
+
+  return m.stack[0] ? TRUE : FALSE;
+}
+
 #ifdef TEST
 int
 main(void)
 {
   lvm_instance_t p;
   unsigned char code[256];
+  lvm_program_t program;
+  unsigned char row[] = {0, 0, 0, 109, 0, 15};
 
   lvm_reset(&p, code, sizeof(code));
 
@@ -852,6 +1220,14 @@ main(void)
 
   lvm_execute(&p);
 
+  /* The same predicate compiled, with y and z read from a row. */
+  lvm_program_init(&program);
+  lvm_bind_variable(&program, "y", 0, 4);
+  lvm_bind_variable(&program, "z", 4, 2);
+  if(!LVM_ERROR(lvm_compile(&p, &program))) {
+    printf("Compiled: %s\n", lvm_run(&program, row) == TRUE ? "true" : "false");
+  }
+
   /* Infix: !(9999 + 1 < -1 + 10001) => !(10000 < 10000) => true */
   lvm_reset(&p, code, sizeof(code));
   lvm_set_relation(&p, LVM_NOT);
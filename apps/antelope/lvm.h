@@ -120,6 +120,37 @@ struct operand {
 };
 typedef struct operand operand_t;
 
+/*
+ * A predicate compiled into threaded code. Each instruction holds a
+ * pointer to the function that executes it. Variables are bound to
+ * the offsets of attribute values in a row, so that the compiled
+ * predicate can evaluate a row without copying the values into the
+ * LVM variables first.
+ */
+struct lvm_machine;
+struct lvm_instruction;
+
+typedef const struct lvm_instruction *
+(*lvm_handler_t)(const struct lvm_instruction *, struct lvm_machine *);
+
+struct lvm_instruction {
+  lvm_handler_t handler;
+  long value;
+  variable_id_t variable;
+};
+
+struct lvm_binding {
+  uint16_t offset;
+  uint8_t size;
+};
+
+struct lvm_program {
+  struct lvm_instruction code[LVM_PROGRAM_SIZE];
+  struct lvm_binding bindings[LVM_MAX_VARIABLE_ID];
+  uint8_t length;
+};
+typedef struct lvm_program lvm_program_t;
+
 void lvm_reset(lvm_instance_t *p, unsigned char *code, lvm_ip_t size);
 void lvm_clone(lvm_instance_t *dst, lvm_instance_t *src);
 lvm_status_t lvm_derive(lvm_instance_t *p);
@@ -140,5 +171,10 @@ void lvm_set_relation(lvm_instance_t *p, operator_t op);
 void lvm_set_operand(lvm_instance_t *p, operand_t *op);
 void lvm_set_long(lvm_instance_t *p, long l);
 void lvm_set_variable(lvm_instance_t *p, char *name);
+void lvm_program_init(lvm_program_t *program);
+lvm_status_t lvm_bind_variable(lvm_program_t *program, char *name,
+                               unsigned offset, unsigned size);
+lvm_status_t lvm_compile(lvm_instance_t *p, lvm_program_t *program);
+lvm_status_t lvm_run(const lvm_program_t *program, const unsigned char *row);
 
 #endif /* LVM_H */
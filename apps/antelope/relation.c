@@ -68,6 +68,12 @@ struct source_dest_map {
 
 static struct source_dest_map attr_map[AQL_ATTRIBUTE_LIMIT];
 
+#if LVM_COMPILE_PREDICATES
+/* The predicate of the current selection, compiled for the attribute
+   offsets of the selected relation. */
+static lvm_program_t predicate;
+#endif /* LVM_COMPILE_PREDICATES */
+
 #if DB_FEATURE_JOIN
 /*
  * The source_map structure is used for mapping attributes to
@@ -671,6 +677,34 @@ select_index(db_handle_t *handle, lvm_instance_t *lvm_instance)
   }
 }
 
+#if LVM_COMPILE_PREDICATES
+static int
+compile_predicate(lvm_instance_t *lvm_instance, unsigned attribute_count)
+{
+  struct source_dest_map *attr_map_ptr;
+  attribute_t *result_attr;
+
+  lvm_program_init(&predicate);
+
+  /* Bind each variable to the attribute value in the source row. The
+     values are decoded as in relation_process_select(). */
+  for(attr_map_ptr = attr_map;
+      attr_map_ptr < attr_map + attribute_count;
+      attr_map_ptr++) {
+    result_attr = attr_map_ptr->to_attr;
+    if(result_attr->domain == DOMAIN_INT) {
+      lvm_bind_variable(&predicate, result_attr->name,
+                        attr_map_ptr->from_offset, 2);
+    } else if(result_attr->domain == DOMAIN_LONG) {
+      lvm_bind_variable(&predicate, result_attr->name,
+                        attr_map_ptr->from_offset, 4);
+    }
+  }
+
+  return !LVM_ERROR(lvm_compile(lvm_instance, &predicate));
+}
+#endif /* LVM_COMPILE_PREDICATES */
+
 static db_result_t
 generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
 {
@@ -701,6 +735,11 @@ generate_selection_result(db_handle_t *handle, relation_t *rel, aql_adt_t *adt)
     if(!LVM_ERROR(lvm_derive(adt->lvm_instance))) {
       select_index(handle, adt->lvm_instance);
     }
+#if LVM_COMPILE_PREDICATES
+    if(compile_predicate(adt->lvm_instance, attribute_count)) {
+      handle->flags |= DB_HANDLE_FLAG_COMPILED_PREDICATE;
+    }
+#endif /* LVM_COMPILE_PREDICATES */
   }
 
   handle->flags |= DB_HANDLE_FLAG_PROCESSING;
@@ -783,13 +822,30 @@ relation_process_select(void *handle_ptr)
     return DB_FINISHED;
   }
 
+  wanted_result = TRUE;
+  if(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC) {
+    wanted_result = FALSE;
+  }
+
+#if LVM_COMPILE_PREDICATES
+  if(handle->flags & DB_HANDLE_FLAG_COMPILED_PREDICATE) {
+    /* The compiled predicate reads the attribute values from the row
+       itself, so a tuple that does not match needs no more work. */
+    if(lvm_run(&predicate, row) != wanted_result) {
+      return DB_OK;
+    }
+  }
+#endif /* LVM_COMPILE_PREDICATES */
+
   /* Process the attributes in the result relation. */
   for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
     from_ptr = row + attr_map_ptr->from_offset;
     result_attr = attr_map_ptr->to_attr;
 
     /* Update the internal state of the PLE. */
-    if(result_attr->domain == DOMAIN_INT) {
+    if(handle->flags & DB_HANDLE_FLAG_COMPILED_PREDICATE) {
+      /* The values have been read already. */
+    } else if(result_attr->domain == DOMAIN_INT) {
       operand_value.l = from_ptr[0] << 8 | from_ptr[1];
       lvm_set_variable_value(result_attr->name, operand_value);
     } else if(result_attr->domain == DOMAIN_LONG) {
@@ -813,13 +869,9 @@ relation_process_select(void *handle_ptr)
     }
   }
 
-  wanted_result = TRUE;
-  if(AQL_GET_FLAGS(adt) & AQL_FLAG_INVERSE_LOGIC) {
-    wanted_result = FALSE;
-  }
-
   /* Check whether the given predicate is true for this tuple. */
   if(adt->lvm_instance == NULL ||
+     (handle->flags & DB_HANDLE_FLAG_COMPILED_PREDICATE) ||
      lvm_execute(adt->lvm_instance) == wanted_result) {
     if(AQL_GET_FLAGS(adt) & AQL_FLAG_AGGREGATE) {
       for(attr_map_ptr = attr_map; attr_map_ptr < attr_map_end; attr_map_ptr++) {
@@ -68,6 +68,50 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+#if DB_STORAGE_PAGE_LIMIT > 0
+/*
+ * The buffer pool. Relation files and index files opened through
+ * storage_open() are accessed in pages of DB_STORAGE_PAGE_SIZE bytes,
+ * which are replaced in LRU order. Writes modify the buffered page and
+ * reach CFS when the page is replaced, when the file is closed or its
+ * relation unloaded, or when storage_flush() is called. Rows written by a
+ * query thus reach CFS once no query uses the relation any longer.
+ * Relation files are kept open after their relation has been
+ * unloaded, so that the next query does not have to open them again.
+ */
+struct storage_file {
+  char name[DB_MAX_FILENAME_LENGTH];
+  db_storage_id_t fd;
+  uint8_t users;
+  unsigned long age;
+  unsigned long size;
+  unsigned long disk_size;
+  unsigned long next_page;
+};
+
+struct storage_page {
+  struct storage_file *file;
+  unsigned long number;
+  unsigned long age;
+  uint16_t dirty_start;
+  uint16_t dirty_end;
+  unsigned char data[DB_STORAGE_PAGE_SIZE];
+};
+
+/* Read-ahead must leave the page that was asked for in the pool. */
+#if DB_STORAGE_READ_AHEAD < DB_STORAGE_PAGE_LIMIT
+#define READ_AHEAD_LIMIT DB_STORAGE_READ_AHEAD
+#else
+#define READ_AHEAD_LIMIT (DB_STORAGE_PAGE_LIMIT - 1)
+#endif
+
+static struct storage_file files[DB_STORAGE_FILE_LIMIT];
+static struct storage_page pages[DB_STORAGE_PAGE_LIMIT];
+static struct storage_page *last_page;
+static unsigned long access_count;
+static struct storage_stats stats;
+#endif /* DB_STORAGE_PAGE_LIMIT > 0 */
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -75,6 +119,506 @@ merge_strings(char *dest, char *prefix, char *suffix)
   strcat(dest, suffix);
 }
 
+static db_result_t
+direct_read(db_storage_id_t fd,
+            void *buffer, unsigned long offset, unsigned length)
+{
+  char *ptr;
+  int r;
+
+  if(cfs_seek(fd, offset, CFS_SEEK_SET) == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+
+  ptr = buffer;
+  while(length > 0) {
+    r = cfs_read(fd, ptr, length);
+    if(r <= 0) {
+      return DB_STORAGE_ERROR;
+    }
+    ptr += r;
+    length -= r;
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+direct_write(db_storage_id_t fd,
+             const void *buffer, unsigned long offset, unsigned length)
+{
+  const char *ptr;
+  int r;
+
+  if(cfs_seek(fd, offset, CFS_SEEK_SET) == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+
+  ptr = buffer;
+  while(length > 0) {
+    r = cfs_write(fd, ptr, length);
+    if(r <= 0) {
+      return DB_STORAGE_ERROR;
+    }
+    ptr += r;
+    length -= r;
+  }
+
+  return DB_OK;
+}
+
+#if DB_STORAGE_PAGE_LIMIT > 0
+static struct storage_file *
+file_find(db_storage_id_t fd)
+{
+  int i;
+
+  for(i = 0; i < DB_STORAGE_FILE_LIMIT; i++) {
+    if(files[i].name[0] != '\0' && files[i].fd == fd) {
+      return &files[i];
+    }
+  }
+  return NULL;
+}
+
+static struct storage_file *
+file_lookup(const char *name)
+{
+  int i;
+
+  for(i = 0; i < DB_STORAGE_FILE_LIMIT; i++) {
+    if(files[i].name[0] != '\0' &&
+       strncmp(files[i].name, name, sizeof(files[i].name) - 1) == 0) {
+      return &files[i];
+    }
+  }
+  return NULL;
+}
+
+static db_result_t
+page_write_back(struct storage_page *page)
+{
+  unsigned long offset;
+  unsigned length;
+
+  offset = page->number * DB_STORAGE_PAGE_SIZE + page->dirty_start;
+  length = page->dirty_end - page->dirty_start;
+  if(DB_ERROR(direct_write(page->file->fd, page->data + page->dirty_start,
+                           offset, length))) {
+    PRINTF("DB: Failed to write back page %lu of %s\n",
+           page->number, page->file->name);
+    return DB_STORAGE_ERROR;
+  }
+
+  if(page->file->disk_size < offset + length) {
+    page->file->disk_size = offset + length;
+  }
+  page->dirty_start = page->dirty_end = 0;
+  stats.writes++;
+
+  return DB_OK;
+}
+
+/* Write back the dirty pages of a file. This is done in file order,
+   because relation files are opened in append mode. */
+static db_result_t
+file_flush(struct storage_file *file)
+{
+  struct storage_page *next;
+  int i;
+
+  for(;;) {
+    next = NULL;
+    for(i = 0; i < DB_STORAGE_PAGE_LIMIT; i++) {
+      if(pages[i].file == file && pages[i].dirty_end > 0 &&
+         (next == NULL || pages[i].number < next->number)) {
+        next = &pages[i];
+      }
+    }
+    if(next == NULL) {
+      return DB_OK;
+    }
+    if(DB_ERROR(page_write_back(next))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+}
+
+static void
+file_drop_pages(struct storage_file *file)
+{
+  int i;
+
+  for(i = 0; i < DB_STORAGE_PAGE_LIMIT; i++) {
+    if(pages[i].file == file) {
+      pages[i].file = NULL;
+      pages[i].dirty_start = pages[i].dirty_end = 0;
+    }
+  }
+  last_page = NULL;
+}
+
+static db_result_t
+file_release(struct storage_file *file)
+{
+  db_result_t result;
+
+  result = file_flush(file);
+  file_drop_pages(file);
+  cfs_close(file->fd);
+  file->name[0] = '\0';
+
+  return result;
+}
+
+/* Close the file that has been idle for the longest time. */
+static struct storage_file *
+file_reclaim(void)
+{
+  struct storage_file *idle;
+  int i;
+
+  idle = NULL;
+  for(i = 0; i < DB_STORAGE_FILE_LIMIT; i++) {
+    if(files[i].name[0] != '\0' && files[i].users == 0 &&
+       (idle == NULL || files[i].age < idle->age)) {
+      idle = &files[i];
+    }
+  }
+
+  if(idle != NULL) {
+    PRINTF("DB: Closing the idle file %s\n", idle->name);
+    file_release(idle);
+  }
+  return idle;
+}
+
+static db_storage_id_t
+file_open(const char *name, int flags)
+{
+  struct storage_file *file;
+  db_storage_id_t fd;
+  cfs_offset_t end;
+  int i;
+
+  file = file_lookup(name);
+  if(file != NULL) {
+    file->users++;
+    return file->fd;
+  }
+
+  fd = cfs_open(name, flags);
+  if(fd < 0 && file_reclaim() != NULL) {
+    fd = cfs_open(name, flags);
+  }
+  if(fd < 0) {
+    return -1;
+  }
+
+  for(i = 0; i < DB_STORAGE_FILE_LIMIT; i++) {
+    if(files[i].name[0] == '\0') {
+      file = &files[i];
+      break;
+    }
+  }
+  if(file == NULL) {
+    file = file_reclaim();
+  }
+
+  end = cfs_seek(fd, 0, CFS_SEEK_END);
+  if(file == NULL || end == (cfs_offset_t)-1) {
+    /* The file will be accessed without buffering. */
+    return fd;
+  }
+
+  strncpy(file->name, name, sizeof(file->name) - 1);
+  file->name[sizeof(file->name) - 1] = '\0';
+  file->fd = fd;
+  file->users = 1;
+  file->size = file->disk_size = end;
+  file->next_page = 0;
+
+  return fd;
+}
+
+static void
+file_close(db_storage_id_t fd, int keep_open)
+{
+  struct storage_file *file;
+
+  file = file_find(fd);
+  if(file == NULL) {
+    cfs_close(fd);
+    return;
+  }
+
+  if(file->users > 0) {
+    file->users--;
+  }
+  file->age = ++access_count;
+  if(file->users == 0) {
+    if(!keep_open) {
+      file_release(file);
+    } else if(DB_ERROR(file_flush(file))) {
+      PRINTF("DB: Failed to write back %s\n", file->name);
+    }
+  }
+}
+
+/* Forget a file that is about to be removed, without writing it back. */
+static void
+file_discard(const char *name)
+{
+  struct storage_file *file;
+
+  file = file_lookup(name);
+  if(file != NULL) {
+    file_drop_pages(file);
+    cfs_close(file->fd);
+    file->name[0] = '\0';
+  }
+}
+
+static db_result_t
+page_load(struct storage_page *page,
+          struct storage_file *file, unsigned long number)
+{
+  unsigned long offset;
+  unsigned length;
+
+  offset = number * DB_STORAGE_PAGE_SIZE;
+  length = 0;
+  if(offset < file->disk_size) {
+    length = file->disk_size - offset < DB_STORAGE_PAGE_SIZE ?
+             file->disk_size - offset : DB_STORAGE_PAGE_SIZE;
+    if(DB_ERROR(direct_read(file->fd, page->data, offset, length))) {
+      page->file = NULL;
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  /* Bytes that have not been written yet are read as zeroes. */
+  memset(page->data + length, 0, DB_STORAGE_PAGE_SIZE - length);
+
+  page->file = file;
+  page->number = number;
+  page->dirty_start = page->dirty_end = 0;
+  page->age = ++access_count;
+
+  return DB_OK;
+}
+
+static struct storage_page *
+page_find(struct storage_file *file, unsigned long number)
+{
+  int i;
+
+  if(last_page != NULL &&
+     last_page->file == file && last_page->number == number) {
+    return last_page;
+  }
+
+  for(i = 0; i < DB_STORAGE_PAGE_LIMIT; i++) {
+    if(pages[i].file == file && pages[i].number == number) {
+      return &pages[i];
+    }
+  }
+  return NULL;
+}
+
+static struct storage_page *
+page_allocate(void)
+{
+  struct storage_page *victim;
+  int i;
+
+  victim = &pages[0];
+  for(i = 0; i < DB_STORAGE_PAGE_LIMIT; i++) {
+    if(pages[i].file == NULL) {
+      return &pages[i];
+    }
+    if(pages[i].age < victim->age) {
+      victim = &pages[i];
+    }
+  }
+
+  if(victim->dirty_end > 0 && DB_ERROR(file_flush(victim->file))) {
+    return NULL;
+  }
+  if(victim == last_page) {
+    last_page = NULL;
+  }
+  victim->file = NULL;
+
+  return victim;
+}
+
+static struct storage_page *
+page_get(struct storage_file *file, unsigned long number)
+{
+  struct storage_page *page;
+  struct storage_page *ahead;
+  unsigned long next;
+
+  page = page_find(file, number);
+  if(page != NULL) {
+    stats.hits++;
+    page->age = ++access_count;
+    last_page = page;
+    return page;
+  }
+
+  stats.misses++;
+  page = page_allocate();
+  if(page == NULL || DB_ERROR(page_load(page, file, number))) {
+    return NULL;
+  }
+
+  /* A miss on the page that follows the previous miss is taken as
+     a sequential scan, and the next pages are read in advance. */
+  next = number + 1;
+  if(number == file->next_page) {
+    for(; next <= number + READ_AHEAD_LIMIT &&
+          next * DB_STORAGE_PAGE_SIZE < file->disk_size; next++) {
+      if(page_find(file, next) != NULL) {
+        continue;
+      }
+      ahead = page_allocate();
+      if(ahead == NULL || DB_ERROR(page_load(ahead, file, next))) {
+        break;
+      }
+      stats.read_ahead++;
+    }
+  }
+  file->next_page = next;
+
+  last_page = page;
+  return page;
+}
+
+static db_result_t
+buffered_read(struct storage_file *file,
+              void *buffer, unsigned long offset, unsigned length)
+{
+  struct storage_page *page;
+  unsigned char *ptr;
+  unsigned start;
+  unsigned n;
+
+  ptr = buffer;
+  while(length > 0) {
+    page = page_get(file, offset / DB_STORAGE_PAGE_SIZE);
+    if(page == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    start = offset % DB_STORAGE_PAGE_SIZE;
+    n = DB_STORAGE_PAGE_SIZE - start < length ?
+        DB_STORAGE_PAGE_SIZE - start : length;
+    memcpy(ptr, page->data + start, n);
+    ptr += n;
+    offset += n;
+    length -= n;
+  }
+
+  return DB_OK;
+}
+
+static db_result_t
+buffered_write(struct storage_file *file,
+               const void *buffer, unsigned long offset, unsigned length)
+{
+  struct storage_page *page;
+  const unsigned char *ptr;
+  unsigned start;
+  unsigned n;
+
+  ptr = buffer;
+  while(length > 0) {
+    page = page_get(file, offset / DB_STORAGE_PAGE_SIZE);
+    if(page == NULL) {
+      return DB_STORAGE_ERROR;
+    }
+    start = offset % DB_STORAGE_PAGE_SIZE;
+    n = DB_STORAGE_PAGE_SIZE - start < length ?
+        DB_STORAGE_PAGE_SIZE - start : length;
+    memcpy(page->data + start, ptr, n);
+
+    if(page->dirty_end == 0) {
+      page->dirty_start = start;
+      page->dirty_end = start + n;
+    } else {
+      if(start < page->dirty_start) {
+        page->dirty_start = start;
+      }
+      if(start + n > page->dirty_end) {
+        page->dirty_end = start + n;
+      }
+    }
+
+    ptr += n;
+    offset += n;
+    length -= n;
+    if(file->size < offset) {
+      file->size = offset;
+    }
+  }
+
+  return DB_OK;
+}
+#endif /* DB_STORAGE_PAGE_LIMIT > 0 */
+
+static db_result_t
+read_bytes(db_storage_id_t fd,
+           void *buffer, unsigned long offset, unsigned length)
+{
+#if DB_STORAGE_PAGE_LIMIT > 0
+  struct storage_file *file;
+
+  file = file_find(fd);
+  if(file != NULL) {
+    return buffered_read(file, buffer, offset, length);
+  }
+#endif
+  return direct_read(fd, buffer, offset, length);
+}
+
+static db_result_t
+write_bytes(db_storage_id_t fd,
+            const void *buffer, unsigned long offset, unsigned length)
+{
+#if DB_STORAGE_PAGE_LIMIT > 0
+  struct storage_file *file;
+
+  file = file_find(fd);
+  if(file != NULL) {
+    return buffered_write(file, buffer, offset, length);
+  }
+#endif
+  return direct_write(fd, buffer, offset, length);
+}
+
+static db_result_t
+file_size(db_storage_id_t fd, unsigned long *size)
+{
+  cfs_offset_t offset;
+#if DB_STORAGE_PAGE_LIMIT > 0
+  struct storage_file *file;
+
+  file = file_find(fd);
+  if(file != NULL) {
+    *size = file->size;
+    return DB_OK;
+  }
+#endif
+
+  offset = cfs_seek(fd, 0, CFS_SEEK_END);
+  if(offset == (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+  *size = offset;
+  return DB_OK;
+}
+
 char *
 storage_generate_file(char *prefix, unsigned long size)
 {
@@ -85,6 +629,9 @@ storage_generate_file(char *prefix, unsigned long size)
 
   snprintf(filename, sizeof(filename), "%s.%x", prefix,
            (unsigned)(random_rand() & 0xffff));
+#if DB_STORAGE_PAGE_LIMIT > 0
+  file_discard(filename);
+#endif
 
 #if DB_FEATURE_COFFEE
   PRINTF("DB: Reserving %lu bytes in %s\n", size, filename);
@@ -103,9 +650,18 @@ storage_generate_file(char *prefix, unsigned long size)
 db_result_t
 storage_load(relation_t *rel)
 {
+  if(RELATION_HAS_TUPLES(rel)) {
+    return DB_OK;
+  }
+
   PRINTF("DB: Opening the tuple file %s\n", rel->tuple_filename);
+#if DB_STORAGE_PAGE_LIMIT > 0
+  rel->tuple_storage = file_open(rel->tuple_filename,
+                                 CFS_READ | CFS_WRITE | CFS_APPEND);
+#else
   rel->tuple_storage = cfs_open(rel->tuple_filename,
                                 CFS_READ | CFS_WRITE | CFS_APPEND);
+#endif
   if(rel->tuple_storage < 0) {
     PRINTF("DB: Failed to open the tuple file\n");
     return DB_STORAGE_ERROR;
@@ -120,7 +676,11 @@ storage_unload(relation_t *rel)
   if(RELATION_HAS_TUPLES(rel)) {
     PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
 
+#if DB_STORAGE_PAGE_LIMIT > 0
+    file_close(rel->tuple_storage, 1);
+#else
     cfs_close(rel->tuple_storage);
+#endif
     rel->tuple_storage = -1;
   }
 }
@@ -280,6 +840,10 @@ db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
   if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
+#if DB_STORAGE_PAGE_LIMIT > 0
+    file_discard(rel->tuple_filename);
+    rel->tuple_storage = -1;
+#endif
     cfs_remove(rel->tuple_filename);
   }
   return cfs_remove(rel->name) < 0 ? DB_STORAGE_ERROR : DB_OK;
@@ -403,7 +967,6 @@ storage_put_index(index_t *index)
 db_result_t
 storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 {
-  int r;
   tuple_id_t nrows;
 
   if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
@@ -414,20 +977,11 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
     return DB_FINISHED;
   }
 
-  if(cfs_seek(rel->tuple_storage, *tuple_id * rel->row_length, CFS_SEEK_SET) ==
-              (cfs_offset_t)-1) {
-    return DB_STORAGE_ERROR;
-  }
-
-  r = cfs_read(rel->tuple_storage, row, rel->row_length);
-  if(r < 0) {
+  if(DB_ERROR(read_bytes(rel->tuple_storage, row,
+                         (unsigned long)*tuple_id * rel->row_length,
+                         rel->row_length))) {
     PRINTF("DB: Reading failed on fd %d\n", rel->tuple_storage);
     return DB_STORAGE_ERROR;
-  } else if(r == 0) {
-    return DB_FINISHED;
-  } else if(r < rel->row_length) {
-    PRINTF("DB: Incomplete record: %d < %d\n", r, rel->row_length);
-    return DB_STORAGE_ERROR;
   }
 
   row[rel->row_length - 1] ^= ROW_XOR;
@@ -440,28 +994,28 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 db_result_t
 storage_put_row(relation_t *rel, storage_row_t row)
 {
-  cfs_offset_t end;
-  unsigned remaining;
-  int r;
+  unsigned long end;
+  db_result_t result;
   unsigned char *last_byte;
 #if DB_FEATURE_INTEGRITY
   int missing_bytes;
   char buf[rel->row_length];
 #endif
 
-  end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
-  if(end == (cfs_offset_t)-1) {
+  if(DB_ERROR(file_size(rel->tuple_storage, &end))) {
     return DB_STORAGE_ERROR;
   }
 
 #if DB_FEATURE_INTEGRITY
   missing_bytes = end % rel->row_length;
   if(missing_bytes > 0) {
+    /* Pad the incomplete row at the end of the file. */
+    missing_bytes = rel->row_length - missing_bytes;
     memset(buf, 0xff, sizeof(buf));
-    r = cfs_write(rel->tuple_storage, buf, sizeof(buf));
-    if(r != missing_bytes) {
+    if(DB_ERROR(write_bytes(rel->tuple_storage, buf, end, missing_bytes))) {
       return DB_STORAGE_ERROR;
     }
+    end += missing_bytes;
   }
 #endif
 
@@ -470,39 +1024,33 @@ storage_put_row(relation_t *rel, storage_row_t row)
   last_byte = row + rel->row_length - 1;
   *last_byte ^= ROW_XOR;
 
-  remaining = rel->row_length;
-  do {
-    r = cfs_write(rel->tuple_storage, row, remaining);
-    if(r < 0) {
-      PRINTF("DB: Failed to store %u bytes\n", remaining);
-      *last_byte ^= ROW_XOR;
-      return DB_STORAGE_ERROR;
-    }
-    row += r;
-    remaining -= r;
-  } while(remaining > 0);
-
-  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+  result = write_bytes(rel->tuple_storage, row, end, rel->row_length);
 
   *last_byte ^= ROW_XOR;
 
+  if(DB_ERROR(result)) {
+    PRINTF("DB: Failed to store %u bytes\n", rel->row_length);
+    return DB_STORAGE_ERROR;
+  }
+
+  PRINTF("DB: Stored a of %d bytes\n", rel->row_length);
+
   return DB_OK;
 }
 
 db_result_t
 storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 {
-  cfs_offset_t offset;
+  unsigned long size;
 
   if(rel->row_length == 0) {
     *amount = 0;
   } else {
-    offset = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
-    if(offset == (cfs_offset_t)-1) {
+    if(DB_ERROR(file_size(rel->tuple_storage, &size))) {
       return DB_STORAGE_ERROR;
     }
 
-    *amount = (tuple_id_t)(offset / rel->row_length);
+    *amount = (tuple_id_t)(size / rel->row_length);
   }
 
   return DB_OK;
@@ -513,7 +1061,11 @@ storage_open(const char *filename)
 {
   int fd;
 
+#if DB_STORAGE_PAGE_LIMIT > 0
+  fd = file_open(filename, CFS_WRITE | CFS_READ);
+#else
   fd = cfs_open(filename, CFS_WRITE | CFS_READ);
+#endif
 #if DB_FEATURE_COFFEE
   if(fd >= 0) {
     cfs_coffee_set_io_semantics(fd, CFS_COFFEE_IO_FLASH_AWARE);
@@ -525,15 +1077,25 @@ storage_open(const char *filename)
 void
 storage_close(db_storage_id_t fd)
 {
+#if DB_STORAGE_PAGE_LIMIT > 0
+  file_close(fd, 0);
+#else
   cfs_close(fd);
+#endif
 }
 
 db_result_t
 storage_read(db_storage_id_t fd,
 	     void *buffer, unsigned long offset, unsigned length)
 {
-  char *ptr;
-  int r;
+#if DB_STORAGE_PAGE_LIMIT > 0
+  struct storage_file *file;
+
+  file = file_find(fd);
+  if(file != NULL) {
+    return buffered_read(file, buffer, offset, length);
+  }
+#endif
 
   /* Extend the file if necessary, so that previously unwritten bytes
      will be read in as zeroes. */
@@ -541,43 +1103,41 @@ storage_read(db_storage_id_t fd,
     return DB_STORAGE_ERROR;
   }
 
-  if(cfs_seek(fd, offset, CFS_SEEK_SET) == (cfs_offset_t)-1) {
-    return DB_STORAGE_ERROR;
-  }
-
-  ptr = buffer;
-  while(length > 0) {
-    r = cfs_read(fd, ptr, length);
-    if(r <= 0) {
-      return DB_STORAGE_ERROR;
-    }
-    ptr += r;
-    length -= r;
-  }
-
-  return DB_OK;
+  return direct_read(fd, buffer, offset, length);
 }
 
 db_result_t
 storage_write(db_storage_id_t fd,
 	      void *buffer, unsigned long offset, unsigned length)
 {
-  char *ptr;
-  int r;
+  return write_bytes(fd, buffer, offset, length);
+}
 
-  if(cfs_seek(fd, offset, CFS_SEEK_SET) == (cfs_offset_t)-1) {
-    return DB_STORAGE_ERROR;
-  }
+db_result_t
+storage_flush(void)
+{
+  db_result_t result;
+#if DB_STORAGE_PAGE_LIMIT > 0
+  int i;
+#endif
 
-  ptr = buffer;
-  while(length > 0) {
-    r = cfs_write(fd, ptr, length);
-    if(r <= 0) {
-      return DB_STORAGE_ERROR;
+  result = DB_OK;
+#if DB_STORAGE_PAGE_LIMIT > 0
+  for(i = 0; i < DB_STORAGE_FILE_LIMIT; i++) {
+    if(files[i].name[0] != '\0' && DB_ERROR(file_flush(&files[i]))) {
+      result = DB_STORAGE_ERROR;
     }
-    ptr += r;
-    length -= r;
   }
+#endif
+  return result;
+}
 
-  return DB_OK;
+void
+storage_get_stats(struct storage_stats *buffer_stats)
+{
+#if DB_STORAGE_PAGE_LIMIT > 0
+  memcpy(buffer_stats, &stats, sizeof(stats));
+#else
+  memset(buffer_stats, 0, sizeof(*buffer_stats));
+#endif
 }
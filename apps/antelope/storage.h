@@ -50,6 +50,13 @@
 
 typedef unsigned char * storage_row_t;
 
+struct storage_stats {
+  unsigned long hits;       /* Page accesses served by the buffer pool. */
+  unsigned long misses;     /* Page accesses that had to load a page. */
+  unsigned long read_ahead; /* Pages loaded ahead of a sequential scan. */
+  unsigned long writes;     /* Dirty pages written back to the file system. */
+};
+
 char *storage_generate_file(char *, unsigned long);
 
 db_result_t storage_load(relation_t *);
@@ -73,4 +80,7 @@ void storage_close(db_storage_id_t);
 db_result_t storage_read(db_storage_id_t, void *, unsigned long, unsigned);
 db_result_t storage_write(db_storage_id_t, void *, unsigned long, unsigned);
 
+db_result_t storage_flush(void);
+void storage_get_stats(struct storage_stats *);
+
 #endif /* STORAGE_H */
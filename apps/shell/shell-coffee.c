@@ -75,9 +75,36 @@ PROCESS_THREAD(shell_format_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+PROCESS(shell_gc_process, "gc");
+SHELL_COMMAND(gc_command,
+	      "gc",
+	      "gc: show Coffee garbage collection statistics",
+	      &shell_gc_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_gc_process, ev, data)
+{
+  struct cfs_coffee_gc_stats stats;
+  char buf[60];
+  PROCESS_BEGIN();
+
+  cfs_coffee_get_gc_stats(&stats);
+  snprintf(buf, sizeof(buf), "%lu pages free", stats.free_pages);
+  shell_output_str(&gc_command, "gc: ", buf);
+  snprintf(buf, sizeof(buf), "%lu sectors erased in the background",
+           stats.background_erases);
+  shell_output_str(&gc_command, "gc: ", buf);
+  snprintf(buf, sizeof(buf), "%lu sectors erased by %lu allocations, at most %u",
+           stats.foreground_erases, stats.foreground_runs,
+           stats.max_foreground_erases);
+  shell_output_str(&gc_command, "gc: ", buf);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
 void
 shell_coffee_init(void)
 {
   shell_register_command(&format_command);
+  shell_register_command(&gc_command);
 }
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         A log-structured store for time-series records on Coffee.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "tslog.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define FILENAME_LENGTH 32
+#define TSLOG_MAGIC     0xa5
+
+/*
+ * Coffee finds the end of a file that it has not cached by its last
+ * non-zero byte, so both headers end with a non-zero magic byte. A
+ * record whose data ends with zeroes may then be found to end early,
+ * which is why record data is read into a zeroed buffer.
+ */
+struct segment_header {
+  uint32_t sequence;
+  uint8_t reserved[3];
+  uint8_t magic;
+};
+
+struct record_header {
+  uint32_t timestamp;
+  uint16_t size;          /* The header and the data. */
+  uint8_t reserved;
+  uint8_t magic;
+};
+
+#define FIRST_RECORD  ((cfs_offset_t)sizeof(struct segment_header))
+/*---------------------------------------------------------------------------*/
+static void
+segment_name(char *filename, struct tslog *log, uint32_t sequence)
+{
+  snprintf(filename, FILENAME_LENGTH, "%s.%u", log->name,
+           (unsigned)((sequence - 1) % log->segment_count));
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+head_sequence(struct tslog *log)
+{
+  return log->tail_sequence - log->used_segments + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Records are read up to here. */
+static cfs_offset_t
+segment_limit(struct tslog *log, uint32_t sequence)
+{
+  return sequence == log->tail_sequence ? log->tail_offset : log->segment_size;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_header(int fd, cfs_offset_t offset, void *hdr, unsigned size)
+{
+  memset(hdr, 0, size);
+  /* Seeking first keeps Coffee from reading past its end of the file. */
+  if(cfs_seek(fd, offset, CFS_SEEK_SET) != offset ||
+     cfs_read(fd, hdr, size) <= 0 || ((uint8_t *)hdr)[size - 1] != TSLOG_MAGIC) {
+    return -1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+read_record_header(struct tslog *log, int fd, uint32_t sequence,
+                   cfs_offset_t offset, struct record_header *hdr)
+{
+  if(fd < 0 || read_header(fd, offset, hdr, sizeof(*hdr)) < 0 ||
+     hdr->size < sizeof(*hdr) ||
+     offset + hdr->size > segment_limit(log, sequence)) {
+    return -1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+open_segment(struct tslog *log, uint32_t sequence)
+{
+  char filename[FILENAME_LENGTH];
+
+  segment_name(filename, log, sequence);
+  return cfs_open(filename, CFS_READ);
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+find_sequence(struct tslog *log, uint8_t index)
+{
+  struct segment_header hdr;
+  int fd;
+
+  fd = open_segment(log, index + 1);
+  if(fd < 0) {
+    return 0;
+  }
+  if(read_header(fd, 0, &hdr, sizeof(hdr)) < 0 ||
+     hdr.sequence == 0 || (hdr.sequence - 1) % log->segment_count != index) {
+    hdr.sequence = 0;
+  }
+  cfs_close(fd);
+  return hdr.sequence;
+}
+/*---------------------------------------------------------------------------*/
+static cfs_offset_t
+find_tail_offset(struct tslog *log)
+{
+  struct record_header hdr;
+  cfs_offset_t offset;
+  int fd;
+
+  /* Nothing limits the scan before the tail offset is known. */
+  log->tail_offset = log->segment_size;
+
+  offset = FIRST_RECORD;
+  fd = open_segment(log, log->tail_sequence);
+  while(read_record_header(log, fd, log->tail_sequence, offset, &hdr) == 0) {
+    offset += hdr.size;
+  }
+  cfs_close(fd);
+  return offset;
+}
+/*---------------------------------------------------------------------------*/
+static int
+new_segment(struct tslog *log)
+{
+  char filename[FILENAME_LENGTH];
+  struct segment_header hdr;
+  uint32_t sequence;
+
+  if(log->fd >= 0) {
+    cfs_close(log->fd);
+    log->fd = -1;
+  }
+
+  sequence = log->tail_sequence + 1;
+  segment_name(filename, log, sequence);
+  if(cfs_remove(filename) == 0 && log->used_segments == log->segment_count) {
+    /* The oldest segment has been overwritten. */
+    log->used_segments--;
+  }
+  if(cfs_coffee_reserve(filename, log->segment_size) < 0) {
+    PRINTF("tslog: failed to reserve %s\n", filename);
+    return -1;
+  }
+
+  log->fd = cfs_open(filename, CFS_WRITE | CFS_APPEND);
+  if(log->fd < 0) {
+    return -1;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.sequence = sequence;
+  hdr.magic = TSLOG_MAGIC;
+  if(cfs_write(log->fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+    cfs_close(log->fd);
+    log->fd = -1;
+    cfs_remove(filename);
+    return -1;
+  }
+
+  log->tail_sequence = sequence;
+  log->tail_offset = FIRST_RECORD;
+  log->used_segments++;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tslog_open(struct tslog *log, const char *name,
+           uint8_t segment_count, cfs_offset_t segment_size)
+{
+  uint32_t sequence, min_sequence;
+  uint8_t i;
+
+  if(segment_count < 2 || segment_count > TSLOG_MAX_SEGMENTS ||
+     segment_size < FIRST_RECORD + (cfs_offset_t)sizeof(struct record_header)) {
+    return -1;
+  }
+
+  log->name = name;
+  log->segment_count = segment_count;
+  log->segment_size = segment_size;
+  log->fd = -1;
+  log->tail_sequence = 0;
+  log->used_segments = 0;
+
+  min_sequence = 0;
+  for(i = 0; i < segment_count; i++) {
+    sequence = find_sequence(log, i);
+    if(sequence == 0) {
+      continue;
+    }
+    if(sequence > log->tail_sequence) {
+      log->tail_sequence = sequence;
+    }
+    if(min_sequence == 0 || sequence < min_sequence) {
+      min_sequence = sequence;
+    }
+  }
+
+  if(log->tail_sequence > 0) {
+    log->used_segments = log->tail_sequence - min_sequence < segment_count ?
+      log->tail_sequence - min_sequence + 1 : segment_count;
+    log->tail_offset = find_tail_offset(log);
+  }
+  PRINTF("tslog: opened %s with %u segments, the newest %lu\n", name,
+         log->used_segments, (unsigned long)log->tail_sequence);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tslog_close(struct tslog *log)
+{
+  if(log->fd >= 0) {
+    cfs_close(log->fd);
+    log->fd = -1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+tslog_erase(struct tslog *log)
+{
+  char filename[FILENAME_LENGTH];
+  uint8_t i;
+
+  tslog_close(log);
+  for(i = 0; i < log->segment_count; i++) {
+    segment_name(filename, log, i + 1);
+    cfs_remove(filename);
+  }
+  log->tail_sequence = 0;
+  log->used_segments = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+tslog_append(struct tslog *log, uint32_t timestamp,
+             const void *data, uint16_t length)
+{
+  struct record_header hdr;
+  cfs_offset_t size;
+  char filename[FILENAME_LENGTH];
+
+  size = sizeof(hdr) + (cfs_offset_t)length;
+  if(size > log->segment_size - FIRST_RECORD || size > 0xffff) {
+    return -1;
+  }
+
+  if(log->tail_sequence == 0 ||
+     log->tail_offset + size > log->segment_size) {
+    if(new_segment(log) < 0) {
+      return -1;
+    }
+  } else if(log->fd < 0) {
+    segment_name(filename, log, log->tail_sequence);
+    log->fd = cfs_open(filename, CFS_WRITE | CFS_APPEND);
+    if(log->fd < 0 ||
+       cfs_seek(log->fd, log->tail_offset, CFS_SEEK_SET) != log->tail_offset) {
+      tslog_close(log);
+      return -1;
+    }
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.timestamp = timestamp;
+  hdr.size = size;
+  hdr.magic = TSLOG_MAGIC;
+  if(cfs_write(log->fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+     cfs_write(log->fd, data, length) != length) {
+    /* Do not write into the failed record again. */
+    log->tail_offset = log->segment_size;
+    tslog_close(log);
+    return -1;
+  }
+
+  log->tail_offset += size;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tslog_rewind(struct tslog *log, struct tslog_cursor *cursor)
+{
+  cursor->sequence = head_sequence(log);
+  cursor->offset = FIRST_RECORD;
+}
+/*---------------------------------------------------------------------------*/
+int
+tslog_seek(struct tslog *log, struct tslog_cursor *cursor,
+           uint32_t timestamp)
+{
+  struct record_header hdr;
+  uint32_t low, high, middle;
+  int fd, found;
+
+  /* Find the newest segment that starts before the timestamp. */
+  low = head_sequence(log);
+  high = log->tail_sequence;
+  while(low < high) {
+    middle = low + (high - low + 1) / 2;
+    fd = open_segment(log, middle);
+    found = read_record_header(log, fd, middle, FIRST_RECORD, &hdr) == 0 &&
+      hdr.timestamp < timestamp;
+    cfs_close(fd);
+    if(found) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  /* Scan from its start to the first record that is not older. */
+  cursor->sequence = low;
+  cursor->offset = FIRST_RECORD;
+  while(cursor->sequence <= log->tail_sequence) {
+    fd = open_segment(log, cursor->sequence);
+    while(read_record_header(log, fd, cursor->sequence,
+                             cursor->offset, &hdr) == 0) {
+      if(hdr.timestamp >= timestamp) {
+        cfs_close(fd);
+        return 0;
+      }
+      cursor->offset += hdr.size;
+    }
+    cfs_close(fd);
+    if(cursor->sequence == log->tail_sequence) {
+      break;
+    }
+    cursor->sequence++;
+    cursor->offset = FIRST_RECORD;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+tslog_read(struct tslog *log, struct tslog_cursor *cursor,
+           uint32_t *timestamp, void *buf, uint16_t size)
+{
+  struct record_header hdr;
+  uint16_t length;
+  int fd;
+
+  if(cursor->sequence < head_sequence(log)) {
+    tslog_rewind(log, cursor);
+  }
+
+  while(cursor->sequence <= log->tail_sequence) {
+    fd = open_segment(log, cursor->sequence);
+    if(read_record_header(log, fd, cursor->sequence,
+                          cursor->offset, &hdr) == 0) {
+      length = hdr.size - sizeof(hdr);
+      if(size > length) {
+        size = length;
+      }
+      memset(buf, 0, size);
+      cfs_read(fd, buf, size);
+      cfs_close(fd);
+
+      cursor->offset += hdr.size;
+      if(timestamp != NULL) {
+        *timestamp = hdr.timestamp;
+      }
+      return length;
+    }
+    cfs_close(fd);
+
+    if(cursor->sequence == log->tail_sequence) {
+      break;
+    }
+    cursor->sequence++;
+    cursor->offset = FIRST_RECORD;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         A log-structured store for time-series records on Coffee.
+ *
+ *         A log is a ring of equally sized segments, each a Coffee
+ *         file that is reserved once and then only appended to. When
+ *         the newest segment is full, the oldest one is removed and
+ *         reserved again as the newest, so appending never copies data
+ *         or extends files. Records carry a timestamp and are expected
+ *         to be appended in timestamp order, which lets tslog_seek()
+ *         find a record by binary search over the segments.
+ */
+
+#ifndef TSLOG_H_
+#define TSLOG_H_
+
+#include "contiki-conf.h"
+#include "cfs/cfs.h"
+
+/*
+ * The segments of a log named "name" are the files "name.0" to
+ * "name.N-1", so the name must leave room for the suffix within the
+ * file name length of Coffee.
+ */
+#define TSLOG_MAX_SEGMENTS  100
+
+struct tslog {
+  const char *name;
+  cfs_offset_t segment_size;
+  /* Sequence number of the newest segment; 0 if there is none. */
+  uint32_t tail_sequence;
+  /* Where the next record is written in the newest segment. */
+  cfs_offset_t tail_offset;
+  int fd;
+  uint8_t segment_count;
+  uint8_t used_segments;
+};
+
+/* A read position that stays valid while the log is appended to. */
+struct tslog_cursor {
+  uint32_t sequence;
+  cfs_offset_t offset;
+};
+
+/**
+ * \brief      Open a log, creating it if it does not exist.
+ * \param log  The log.
+ * \param name The base name of the segment files.
+ * \param segment_count Number of segments, at least 2.
+ * \param segment_size Size of each segment in bytes.
+ * \return     0 on success, -1 on failure.
+ *
+ *             An existing log must be opened with the same segment
+ *             count and size that it was created with.
+ */
+int tslog_open(struct tslog *log, const char *name,
+               uint8_t segment_count, cfs_offset_t segment_size);
+
+/**
+ * \brief      Close a log.
+ */
+void tslog_close(struct tslog *log);
+
+/**
+ * \brief      Remove all segments of a log, leaving it open and empty.
+ */
+void tslog_erase(struct tslog *log);
+
+/**
+ * \brief      Append a record to a log.
+ * \param log  The log.
+ * \param timestamp The time of the record, in any unit.
+ * \param data The record data.
+ * \param length The length of the record data.
+ * \return     0 on success, -1 on failure.
+ *
+ *             Timestamps must not decrease from one record to the next.
+ *             If the log is full, the oldest segment is overwritten.
+ */
+int tslog_append(struct tslog *log, uint32_t timestamp,
+                 const void *data, uint16_t length);
+
+/**
+ * \brief      Point a cursor at the oldest record of a log.
+ */
+void tslog_rewind(struct tslog *log, struct tslog_cursor *cursor);
+
+/**
+ * \brief      Point a cursor at the oldest record not older than a time.
+ * \return     0 if there is such a record, -1 if the cursor was left at
+ *             the end of the log.
+ */
+int tslog_seek(struct tslog *log, struct tslog_cursor *cursor,
+               uint32_t timestamp);
+
+/**
+ * \brief      Read the record at a cursor and advance the cursor.
+ * \param log  The log.
+ * \param cursor The cursor.
+ * \param timestamp Set to the time of the record, unless NULL.
+ * \param buf  Buffer for the record data.
+ * \param size Size of the buffer; longer records are truncated.
+ * \return     The length of the record data, or -1 at the end of the log.
+ *
+ *             A cursor at the end of the log reads records that are
+ *             appended later. A cursor whose record has been overwritten
+ *             moves on to the oldest record.
+ */
+int tslog_read(struct tslog *log, struct tslog_cursor *cursor,
+               uint32_t *timestamp, void *buf, uint16_t size);
+
+#endif /* TSLOG_H_ */
@@ -54,7 +54,7 @@
 #define PRINTF(...)
 #endif
 
-#include "contiki-conf.h"
+#include "contiki.h"
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
@@ -90,6 +90,66 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING  1
 #endif
 
+/*
+ * Files that are not in the file cache are looked up in a RAM index
+ * from hashed file names to the pages of their headers, instead of by
+ * scanning the storage. The index is rebuilt by a single scan when
+ * first needed. It holds COFFEE_NAME_INDEX_SIZE files, which must be a
+ * power of two; 0 disables it. If there are more files, lookups of
+ * files that are not in the index fall back to scanning.
+ */
+#ifndef COFFEE_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE  0
+#endif
+
+#if COFFEE_NAME_INDEX_SIZE & (COFFEE_NAME_INDEX_SIZE - 1)
+#error COFFEE_NAME_INDEX_SIZE must be a power of two.
+#endif
+
+/*
+ * Background garbage collection: whenever fewer than COFFEE_GC_WATERMARK
+ * pages are free, a process erases obsolete sectors one at a time,
+ * yielding between erasures. Reservations that still run out of space
+ * erase sectors one at a time until the reservation fits, but stop
+ * after COFFEE_GC_FOREGROUND_ERASES sectors and fail, leaving the rest
+ * to the background collector. The default of 2 bounds the time a
+ * cfs_write() or cfs_coffee_reserve() spends collecting garbage to two
+ * sector erasures and the header scans that find them, rather than one
+ * erasure per sector of the file system. Only an obsolete extent that
+ * covers whole sectors past the bound makes it erase more, as these
+ * sectors have to be erased together.
+ */
+#ifndef COFFEE_BACKGROUND_GC
+#define COFFEE_BACKGROUND_GC  0
+#endif
+
+#ifndef COFFEE_GC_WATERMARK
+#define COFFEE_GC_WATERMARK  (COFFEE_SIZE / COFFEE_PAGE_SIZE / 4)
+#endif
+
+#ifndef COFFEE_GC_FOREGROUND_ERASES
+#define COFFEE_GC_FOREGROUND_ERASES  2
+#endif
+
+/*
+ * Modified files find the latest log record of each log region in a
+ * RAM index of COFFEE_LOG_INDEX_SIZE regions per open file, rather than
+ * by scanning the log index table on storage. The index is built by a
+ * single scan when first needed. Regions beyond it are looked up by
+ * scanning; 0 disables the index.
+ */
+#ifndef COFFEE_LOG_INDEX_SIZE
+#define COFFEE_LOG_INDEX_SIZE  0
+#endif
+
+/*
+ * Pages read through cfs_read() are cached in COFFEE_READ_CACHE_SIZE
+ * pages of RAM, replaced in round-robin order; 0 disables the cache.
+ */
+#ifndef COFFEE_READ_CACHE_SIZE
+#define COFFEE_READ_CACHE_SIZE  0
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -100,6 +160,9 @@
 #define COFFEE_FD_APPEND  0x4
 
 #define COFFEE_FILE_MODIFIED  0x1
+#define COFFEE_FILE_LOG_INDEXED 0x2
+
+#define LOG_INDEX (COFFEE_MICRO_LOGS && COFFEE_LOG_INDEX_SIZE > 0)
 
 #define INVALID_PAGE    ((coffee_page_t)-1)
 #define UNKNOWN_OFFSET    ((cfs_offset_t)-1)
@@ -108,10 +171,18 @@
 #define CLOSE_FDS   1
 #define ALLOW_GC    1
 
+/* Name index states. */
+#define NAME_INDEX_UNBUILT    0
+#define NAME_INDEX_COMPLETE   1
+/* Some files did not fit in the index. */
+#define NAME_INDEX_INCOMPLETE 2
+
 /* "Greedy" garbage collection erases as many sectors as possible. */
 #define GC_GREEDY   0
 /* "Reluctant" garbage collection stops after erasing one sector. */
 #define GC_RELUCTANT    1
+/* "Incremental" garbage collection erases the first obsolete sector. */
+#define GC_INCREMENTAL  2
 
 /* File descriptor macros. */
 #define FD_VALID(fd) \
@@ -159,6 +230,8 @@ struct sector_status {
   coffee_page_t active;
   coffee_page_t obsolete;
   coffee_page_t free;
+  /* Obsolete pages of an extent that starts in a previous sector. */
+  coffee_page_t continued;
 };
 
 /* The structure of cached file objects. */
@@ -169,6 +242,10 @@ struct file {
   int16_t record_count;
   uint8_t references;
   uint8_t flags;
+#if LOG_INDEX
+  /* The latest log record of each region plus one, or 0 if none. */
+  uint16_t log_index[COFFEE_LOG_INDEX_SIZE];
+#endif
 };
 
 /* The file descriptor structure. */
@@ -193,6 +270,14 @@ struct file_header {
   char name[COFFEE_NAME_LENGTH];
 };
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+/* Name index entries; free entries have the page INVALID_PAGE. */
+struct name_index_entry {
+  uint16_t hash;
+  coffee_page_t page;
+};
+#endif
+
 /* This is needed because of a buggy compiler. */
 struct log_param {
   cfs_offset_t offset;
@@ -211,18 +296,122 @@ static struct protected_mem_t {
   struct file_desc coffee_fd_set[COFFEE_FD_SET_SIZE];
   coffee_page_t next_free;
   char gc_wait;
+#if COFFEE_NAME_INDEX_SIZE > 0
+  struct name_index_entry name_index[COFFEE_NAME_INDEX_SIZE];
+  unsigned name_index_count;
+  uint8_t name_index_state;
+#endif
 } protected_mem;
+static struct cfs_coffee_gc_stats gc_stats;
+/* Pages freed by the last run of the garbage collector. */
+static coffee_page_t gc_freed;
 static struct file *const coffee_files = protected_mem.coffee_files;
 static struct file_desc *const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t *const next_free = &protected_mem.next_free;
 static char *const gc_wait = &protected_mem.gc_wait;
+#if COFFEE_NAME_INDEX_SIZE > 0
+static struct name_index_entry *const name_index = protected_mem.name_index;
+#endif
 
+#if COFFEE_READ_CACHE_SIZE > 0
+/* Read cache entries; free entries have the page 0. */
+struct read_cache_entry {
+  coffee_page_t page;   /* The cached page plus one. */
+  unsigned char data[COFFEE_PAGE_SIZE];
+};
+static struct read_cache_entry read_cache[COFFEE_READ_CACHE_SIZE];
+static uint8_t read_cache_next;
+#endif
+
+#if COFFEE_BACKGROUND_GC
+PROCESS(coffee_gc_process, "Coffee GC");
+#endif
+
+/*---------------------------------------------------------------------------*/
+#if COFFEE_READ_CACHE_SIZE > 0
+static void
+invalidate_read_cache(coffee_page_t first, coffee_page_t last)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_READ_CACHE_SIZE; i++) {
+    if(read_cache[i].page > first && read_cache[i].page <= last + 1) {
+      read_cache[i].page = 0;
+    }
+  }
+}
+#endif /* COFFEE_READ_CACHE_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+static void
+read_storage(void *buf, cfs_offset_t size, cfs_offset_t offset)
+{
+#if COFFEE_READ_CACHE_SIZE > 0
+  coffee_page_t page;
+  cfs_offset_t page_offset, n;
+  int i;
+
+  while(size > 0) {
+    page = offset / COFFEE_PAGE_SIZE;
+    page_offset = offset % COFFEE_PAGE_SIZE;
+    n = COFFEE_PAGE_SIZE - page_offset;
+    if(n > size) {
+      n = size;
+    }
+
+    for(i = 0; i < COFFEE_READ_CACHE_SIZE; i++) {
+      if(read_cache[i].page == page + 1) {
+        break;
+      }
+    }
+    if(i == COFFEE_READ_CACHE_SIZE && n == COFFEE_PAGE_SIZE) {
+      /* Whole pages that are not cached are read without caching them. */
+      COFFEE_READ(buf, n, offset);
+    } else {
+      if(i == COFFEE_READ_CACHE_SIZE) {
+        i = read_cache_next;
+        read_cache_next = (i + 1) % COFFEE_READ_CACHE_SIZE;
+        COFFEE_READ(read_cache[i].data, COFFEE_PAGE_SIZE,
+                    page * COFFEE_PAGE_SIZE);
+        read_cache[i].page = page + 1;
+      }
+      memcpy(buf, &read_cache[i].data[page_offset], n);
+    }
+    buf = (char *)buf + n;
+    offset += n;
+    size -= n;
+  }
+#else
+  COFFEE_READ(buf, size, offset);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+static void
+write_storage(const void *buf, cfs_offset_t size, cfs_offset_t offset)
+{
+#if COFFEE_READ_CACHE_SIZE > 0
+  if(size > 0) {
+    invalidate_read_cache(offset / COFFEE_PAGE_SIZE,
+                          (offset + size - 1) / COFFEE_PAGE_SIZE);
+  }
+#endif
+  COFFEE_WRITE(buf, size, offset);
+}
+/*---------------------------------------------------------------------------*/
+static void
+erase_storage(coffee_page_t sector)
+{
+#if COFFEE_READ_CACHE_SIZE > 0
+  invalidate_read_cache(sector * COFFEE_PAGES_PER_SECTOR,
+                        (sector + 1) * COFFEE_PAGES_PER_SECTOR - 1);
+#endif
+  COFFEE_ERASE(sector);
+}
 /*---------------------------------------------------------------------------*/
 static void
 write_header(struct file_header *hdr, coffee_page_t page)
 {
   hdr->flags |= HDR_FLAG_VALID;
-  COFFEE_WRITE(hdr, sizeof(*hdr), page * COFFEE_PAGE_SIZE);
+  write_storage(hdr, sizeof(*hdr), page * COFFEE_PAGE_SIZE);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -283,10 +472,12 @@ get_sector_status(uint16_t sector, struct sector_status *stats)
   } else {
     if(skip_pages >= COFFEE_PAGES_PER_SECTOR) {
       stats->obsolete = COFFEE_PAGES_PER_SECTOR;
+      stats->continued = COFFEE_PAGES_PER_SECTOR;
       skip_pages -= COFFEE_PAGES_PER_SECTOR;
       return skip_pages >= COFFEE_PAGES_PER_SECTOR ? 0 : skip_pages;
     }
     obsolete = skip_pages;
+    stats->continued = skip_pages;
   }
 
   /* Determine the amount of pages of each type that have not been
@@ -362,48 +553,179 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 }
 /*---------------------------------------------------------------------------*/
 static void
+erase_sector(uint16_t sector, coffee_page_t continued,
+             coffee_page_t isolation_count)
+{
+  coffee_page_t first_page;
+
+  first_page = sector * COFFEE_PAGES_PER_SECTOR;
+  if(first_page + continued < *next_free) {
+    *next_free = first_page + continued;
+  }
+
+  if(isolation_count > 0) {
+    isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+  }
+
+  erase_storage(sector);
+  PRINTF("Coffee: Erased sector %d!\n", sector);
+
+  /*
+   * The header of the extent that the sector starts with remains in the
+   * previous sector. Keep the pages of the extent allocated, lest files
+   * be allocated there and then skipped over as part of the extent.
+   */
+  if(continued > 0) {
+    isolate_pages(first_page, continued);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
 collect_garbage(int mode)
 {
-  uint16_t sector;
+  uint16_t sector, partial_sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t isolation_count, last_isolation_count;
+  coffee_page_t partial_continued, partial_obsolete;
+  int erased, last_erased;
 
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
-         mode == GC_RELUCTANT ? "reluctant" : "greedy");
+         mode == GC_RELUCTANT ? "reluctant" :
+         mode == GC_INCREMENTAL ? "incremental" : "greedy");
   /*
    * The garbage collector erases as many sectors as possible. A sector is
-   * erasable if there are only free or obsolete pages in it.
+   * erasable if there are only free or obsolete pages in it, unless all
+   * of them belong to an extent whose header remains in a previous sector.
+   *
+   * Incremental collection erases the first erasable sector without free
+   * pages, or else the first erasable sector. If the obsolete extent that
+   * ends the erased sector covers the whole next sector, then the next
+   * sector must be erased as well.
    */
+  erased = last_erased = 0;
+  gc_freed = 0;
+  partial_sector = COFFEE_SECTOR_COUNT;
+  partial_continued = partial_obsolete = last_isolation_count = 0;
   for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
     isolation_count = get_sector_status(sector, &stats);
     PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
            sector, (unsigned)stats.active,
            (unsigned)stats.obsolete, (unsigned)stats.free);
 
-    if(stats.active > 0) {
+    if(mode == GC_INCREMENTAL && erased > 0) {
+      if(last_isolation_count > 0 ||
+         stats.obsolete < COFFEE_PAGES_PER_SECTOR) {
+        break;
+      }
+      erase_sector(sector, 0, isolation_count);
+      erased++;
+      gc_freed += stats.obsolete;
+      last_isolation_count = isolation_count;
+      continue;
+    }
+
+    if(last_erased) {
+      /* The extent has been erased, or isolated, already. */
+      stats.continued = 0;
+    }
+    last_erased = 0;
+    if(stats.active > 0 || stats.continued == COFFEE_PAGES_PER_SECTOR) {
       continue;
     }
 
-    if((mode == GC_RELUCTANT && stats.free == 0) ||
-       (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < *next_free) {
-        *next_free = first_page;
+    if(mode == GC_INCREMENTAL && stats.free > 0) {
+      if(stats.obsolete > stats.continued &&
+         partial_sector == COFFEE_SECTOR_COUNT) {
+        partial_sector = sector;
+        partial_continued = stats.continued;
+        partial_obsolete = stats.obsolete;
       }
+    } else if((mode == GC_RELUCTANT && stats.free == 0) ||
+              (mode != GC_RELUCTANT && stats.obsolete > stats.continued)) {
+      erase_sector(sector, stats.continued, isolation_count);
+      erased++;
+      gc_freed += stats.obsolete - stats.continued;
+      last_erased = 1;
+      last_isolation_count = isolation_count;
 
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+      if(mode == GC_RELUCTANT && isolation_count > 0) {
+        break;
       }
+    }
+  }
 
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
+  if(mode == GC_INCREMENTAL && erased == 0 &&
+     partial_sector < COFFEE_SECTOR_COUNT) {
+    /* No obsolete extent can run past free pages. */
+    erase_sector(partial_sector, partial_continued, 0);
+    erased++;
+    gc_freed += partial_obsolete - partial_continued;
+  }
 
-      if(mode == GC_RELUCTANT && isolation_count > 0) {
+  return erased;
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+count_free_pages(void)
+{
+  uint16_t sector;
+  struct sector_status stats;
+  coffee_page_t free;
+
+  free = 0;
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    get_sector_status(sector, &stats);
+    free += stats.free;
+  }
+  return free;
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_BACKGROUND_GC
+/* Set when files changed since the GC process last counted free pages. */
+static char gc_recount;
+
+static void
+poll_gc(void)
+{
+  gc_recount = 1;
+  if(!process_is_running(&coffee_gc_process)) {
+    process_start(&coffee_gc_process, NULL);
+  }
+  process_poll(&coffee_gc_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  static coffee_page_t free_pages;
+  int erased;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    /* Scan the headers only when files changed, and otherwise count
+       what each erasure frees. */
+    while(1) {
+      if(gc_recount) {
+        gc_recount = 0;
+        free_pages = count_free_pages();
+      }
+      if(free_pages >= COFFEE_GC_WATERMARK) {
+        break;
+      }
+      erased = collect_garbage(GC_INCREMENTAL);
+      if(erased == 0) {
         break;
       }
+      gc_stats.background_erases += erased;
+      free_pages += gc_freed;
+      PROCESS_PAUSE();
     }
   }
+
+  PROCESS_END();
 }
+#endif /* COFFEE_BACKGROUND_GC */
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
 next_file(coffee_page_t page, struct file_header *hdr)
@@ -426,6 +748,110 @@ next_file(coffee_page_t page, struct file_header *hdr)
   return page + hdr->max_pages;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_NAME_INDEX_SIZE > 0
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash;
+  int i;
+
+  /* Only the part of the name that fits in a file header counts. */
+  hash = 5381;
+  for(i = 0; i < COFFEE_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+    hash = (hash << 5) + hash + (unsigned char)name[i];
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_add(const char *name, coffee_page_t page)
+{
+  unsigned i;
+
+  if(protected_mem.name_index_state != NAME_INDEX_COMPLETE) {
+    return;
+  }
+
+  /* Leave free entries so that probing always terminates quickly. */
+  if(protected_mem.name_index_count >= COFFEE_NAME_INDEX_SIZE * 3 / 4) {
+    protected_mem.name_index_state = NAME_INDEX_INCOMPLETE;
+    return;
+  }
+
+  i = name_hash(name) & (COFFEE_NAME_INDEX_SIZE - 1);
+  while(name_index[i].page != INVALID_PAGE) {
+    i = (i + 1) & (COFFEE_NAME_INDEX_SIZE - 1);
+  }
+  name_index[i].hash = name_hash(name);
+  name_index[i].page = page;
+  protected_mem.name_index_count++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(const char *name, coffee_page_t page)
+{
+  unsigned i, j, home;
+
+  if(protected_mem.name_index_state == NAME_INDEX_INCOMPLETE) {
+    /* There may be room for the files that are missing now. */
+    protected_mem.name_index_state = NAME_INDEX_UNBUILT;
+  }
+  if(protected_mem.name_index_state != NAME_INDEX_COMPLETE) {
+    return;
+  }
+
+  for(i = name_hash(name) & (COFFEE_NAME_INDEX_SIZE - 1);
+      name_index[i].page != page;
+      i = (i + 1) & (COFFEE_NAME_INDEX_SIZE - 1)) {
+    if(name_index[i].page == INVALID_PAGE) {
+      return;
+    }
+  }
+
+  /*
+   * Move later entries of the probe sequence into the gap, so that
+   * lookups can stop at the first free entry.
+   */
+  for(j = (i + 1) & (COFFEE_NAME_INDEX_SIZE - 1);
+      name_index[j].page != INVALID_PAGE;
+      j = (j + 1) & (COFFEE_NAME_INDEX_SIZE - 1)) {
+    home = name_index[j].hash & (COFFEE_NAME_INDEX_SIZE - 1);
+    if(((j - home) & (COFFEE_NAME_INDEX_SIZE - 1)) >=
+       ((j - i) & (COFFEE_NAME_INDEX_SIZE - 1))) {
+      name_index[i] = name_index[j];
+      i = j;
+    }
+  }
+  name_index[i].page = INVALID_PAGE;
+  protected_mem.name_index_count--;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_index(void)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+  unsigned i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    name_index[i].page = INVALID_PAGE;
+  }
+  protected_mem.name_index_count = 0;
+  protected_mem.name_index_state = NAME_INDEX_COMPLETE;
+
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
+      index_add(hdr.name, page);
+      if(protected_mem.name_index_state != NAME_INDEX_COMPLETE) {
+        break;
+      }
+    }
+  }
+  PRINTF("Coffee: Indexed %u files\n", protected_mem.name_index_count);
+}
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 static struct file *
 load_file(coffee_page_t start, struct file_header *hdr)
 {
@@ -474,6 +900,37 @@ find_file(const char *name)
   int i;
   struct file_header hdr;
   coffee_page_t page;
+#if COFFEE_NAME_INDEX_SIZE > 0
+  unsigned j;
+  uint16_t hash;
+
+  if(protected_mem.name_index_state == NAME_INDEX_UNBUILT) {
+    build_index();
+  }
+
+  hash = name_hash(name);
+  for(j = hash & (COFFEE_NAME_INDEX_SIZE - 1);
+      name_index[j].page != INVALID_PAGE;
+      j = (j + 1) & (COFFEE_NAME_INDEX_SIZE - 1)) {
+    if(name_index[j].hash != hash) {
+      continue;
+    }
+    page = name_index[j].page;
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+      for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
+        if(!FILE_FREE(&coffee_files[i]) && coffee_files[i].page == page) {
+          return &coffee_files[i];
+        }
+      }
+      return load_file(page, &hdr);
+    }
+  }
+
+  if(protected_mem.name_index_state == NAME_INDEX_COMPLETE) {
+    return NULL;
+  }
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
 
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
@@ -590,6 +1047,15 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   write_header(&hdr, page);
 
   *gc_wait = 0;
+#if COFFEE_BACKGROUND_GC
+  poll_gc();
+#endif
+
+#if COFFEE_NAME_INDEX_SIZE > 0
+  if(!HDR_LOG(hdr)) {
+    index_remove(hdr.name, page);
+  }
+#endif
 
   /* Close all file descriptors that reference the removed file. */
   if(close_fds) {
@@ -631,6 +1097,10 @@ reserve(const char *name, coffee_page_t pages,
   struct file_header hdr;
   coffee_page_t page;
   struct file *file;
+  int erased;
+#if COFFEE_BACKGROUND_GC
+  int i;
+#endif
 
   if(!allow_duplicates && find_file(name) != NULL) {
     return NULL;
@@ -641,9 +1111,34 @@ reserve(const char *name, coffee_page_t pages,
     if(*gc_wait) {
       return NULL;
     }
-    collect_garbage(GC_GREEDY);
+    gc_stats.foreground_runs++;
+#if COFFEE_BACKGROUND_GC
+    /* Erase only as many sectors as needed to bound the latency. */
+    erased = 0;
+    while(erased < COFFEE_GC_FOREGROUND_ERASES &&
+          (i = collect_garbage(GC_INCREMENTAL)) > 0) {
+      erased += i;
+      page = find_contiguous_pages(pages);
+      if(page != INVALID_PAGE) {
+        break;
+      }
+    }
+#else
+    erased = collect_garbage(GC_GREEDY);
     page = find_contiguous_pages(pages);
+#endif
+    gc_stats.foreground_erases += erased;
+    if((unsigned)erased > gc_stats.max_foreground_erases) {
+      gc_stats.max_foreground_erases = erased;
+    }
     if(page == INVALID_PAGE) {
+#if COFFEE_BACKGROUND_GC
+      if(erased >= COFFEE_GC_FOREGROUND_ERASES) {
+        /* Garbage remains; let the background collector take it. */
+        poll_gc();
+        return NULL;
+      }
+#endif
       *gc_wait = 1;
       return NULL;
     }
@@ -655,6 +1150,12 @@ reserve(const char *name, coffee_page_t pages,
   hdr.flags = HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+  if(!HDR_LOG(hdr)) {
+    index_add(hdr.name, page);
+  }
+#endif
+
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
          pages, page, name);
 
@@ -663,6 +1164,10 @@ reserve(const char *name, coffee_page_t pages,
     file->end = 0;
   }
 
+#if COFFEE_BACKGROUND_GC
+  poll_gc();
+#endif
+
   return file;
 }
 /*---------------------------------------------------------------------------*/
@@ -721,7 +1226,7 @@ get_record_index(coffee_page_t log_page, uint16_t search_records,
       }
 
       base -= batch_size * sizeof(indices[0]);
-      COFFEE_READ(&indices, sizeof(indices[0]) * batch_size, base);
+      read_storage(&indices, sizeof(indices[0]) * batch_size, base);
 
       for(i = batch_size - 1; i >= 0; i--) {
         if(indices[i] - 1 == region) {
@@ -738,10 +1243,74 @@ get_record_index(coffee_page_t log_page, uint16_t search_records,
 }
 #endif /* COFFEE_MICRO_LOGS */
 /*---------------------------------------------------------------------------*/
+#if LOG_INDEX
+static void
+build_log_index(struct file *file, coffee_page_t log_page,
+                uint16_t log_records)
+{
+  uint16_t processed;
+  uint16_t batch_size;
+  uint16_t i;
+
+  memset(file->log_index, 0, sizeof(file->log_index));
+
+  batch_size = log_records > COFFEE_LOG_TABLE_LIMIT ?
+    COFFEE_LOG_TABLE_LIMIT : log_records;
+  {
+    uint16_t indices[batch_size];
+
+    for(processed = 0; processed < log_records; processed += batch_size) {
+      if(batch_size > log_records - processed) {
+        batch_size = log_records - processed;
+      }
+
+      read_storage(&indices, batch_size * sizeof(indices[0]),
+                   absolute_offset(log_page, processed * sizeof(indices[0])));
+      for(i = 0; i < batch_size; i++) {
+        if(indices[i] == 0) {
+          break;
+        }
+        if(indices[i] <= COFFEE_LOG_INDEX_SIZE) {
+          file->log_index[indices[i] - 1] = processed + i + 1;
+        }
+      }
+      if(i < batch_size) {
+        processed += i;
+        break;
+      }
+    }
+  }
+
+  /* The scan found the next free log record as well. */
+  file->record_count = processed;
+  file->flags |= COFFEE_FILE_LOG_INDEXED;
+}
+#endif /* LOG_INDEX */
+/*---------------------------------------------------------------------------*/
+#if COFFEE_MICRO_LOGS
+static int
+find_record(struct file *file, coffee_page_t log_page, uint16_t log_records,
+            uint16_t search_records, uint16_t region)
+{
+#if LOG_INDEX
+  if(region < COFFEE_LOG_INDEX_SIZE) {
+    if(!(file->flags & COFFEE_FILE_LOG_INDEXED)) {
+      build_log_index(file, log_page, log_records);
+    }
+    /* Records written after the searched ones do not count. */
+    if(file->log_index[region] <= search_records) {
+      return (int)file->log_index[region] - 1;
+    }
+  }
+#endif /* LOG_INDEX */
+  return get_record_index(log_page, search_records, region);
+}
+#endif /* COFFEE_MICRO_LOGS */
+/*---------------------------------------------------------------------------*/
 #if COFFEE_MICRO_LOGS
 static int
-read_log_page(struct file_header *hdr, int16_t record_count,
-              struct log_param *lp)
+read_log_page(struct file *file, struct file_header *hdr,
+              int16_t record_count, struct log_param *lp)
 {
   uint16_t region;
   int16_t match_index;
@@ -754,7 +1323,8 @@ read_log_page(struct file_header *hdr, int16_t record_count,
   region = modify_log_buffer(log_record_size, &lp->offset, &lp->size);
 
   search_records = record_count < 0 ? log_records : record_count;
-  match_index = get_record_index(hdr->log_page, search_records, region);
+  match_index = find_record(file, hdr->log_page, log_records,
+                            search_records, region);
   if(match_index < 0) {
     return -1;
   }
@@ -762,7 +1332,7 @@ read_log_page(struct file_header *hdr, int16_t record_count,
   base = absolute_offset(hdr->log_page, log_records * sizeof(region));
   base += (cfs_offset_t)match_index * log_record_size;
   base += lp->offset;
-  COFFEE_READ(lp->buf, lp->size, base);
+  read_storage((char *)lp->buf, lp->size, base);
 
   return lp->size;
 }
@@ -791,6 +1361,11 @@ create_log(struct file *file, struct file_header *hdr)
   write_header(hdr, file->page);
 
   file->flags |= COFFEE_FILE_MODIFIED;
+#if LOG_INDEX
+  /* The new log is empty. */
+  memset(file->log_index, 0, sizeof(file->log_index));
+  file->flags |= COFFEE_FILE_LOG_INDEXED;
+#endif
   return log_file->page;
 }
 #endif /* COFFEE_MICRO_LOGS */
@@ -832,7 +1407,7 @@ merge_log(coffee_page_t file_page, int extend)
       cfs_close(fd);
       return -1;
     } else if(n > 0) {
-      COFFEE_WRITE(buf, n, absolute_offset(new_file->page, offset));
+      write_storage(buf, n, absolute_offset(new_file->page, offset));
       offset += n;
     }
   } while(n != 0);
@@ -952,7 +1527,7 @@ write_log_page(struct file *file, struct log_param *lp)
     lp_out.size = log_record_size;
 
     if((lp->offset > 0 || lp->size != log_record_size) &&
-       read_log_page(&hdr, log_record, &lp_out) < 0) {
+       read_log_page(file, &hdr, log_record, &lp_out) < 0) {
       COFFEE_READ(copy_buf, sizeof(copy_buf),
                   absolute_offset(file->page, offset));
     }
@@ -965,13 +1540,19 @@ write_log_page(struct file *file, struct log_param *lp)
      */
     offset = absolute_offset(log_page, 0);
     ++region;
-    COFFEE_WRITE(&region, sizeof(region),
+    write_storage(&region, sizeof(region),
                  offset + log_record * sizeof(region));
 
     offset += log_records * sizeof(region);
-    COFFEE_WRITE(copy_buf, sizeof(copy_buf),
+    write_storage(copy_buf, sizeof(copy_buf),
                  offset + log_record * log_record_size);
     file->record_count = log_record + 1;
+#if LOG_INDEX
+    if((file->flags & COFFEE_FILE_LOG_INDEXED) &&
+       region <= COFFEE_LOG_INDEX_SIZE) {
+      file->log_index[region - 1] = log_record + 1;
+    }
+#endif
   }
 
   return lp->size;
@@ -1112,13 +1693,13 @@ cfs_read(int fd, void *buf, unsigned size)
 
   /* If the file is allocated, read directly in the file. */
   if(!FILE_MODIFIED(file)) {
-    COFFEE_READ(buf, size, absolute_offset(file->page, fdp->offset));
+    read_storage(buf, size, absolute_offset(file->page, fdp->offset));
     fdp->offset += size;
     return size;
   }
 
 #if COFFEE_MICRO_LOGS
-  read_header(&hdr, file->page);
+  read_storage(&hdr, sizeof(hdr), file->page * COFFEE_PAGE_SIZE);
 
   /*
    * Fill the buffer by copying from the log in first hand, or the
@@ -1128,11 +1709,11 @@ cfs_read(int fd, void *buf, unsigned size)
     lp.offset = fdp->offset;
     lp.buf = buf;
     lp.size = bytes_left;
-    r = read_log_page(&hdr, file->record_count, &lp);
+    r = read_log_page(file, &hdr, file->record_count, &lp);
 
     /* Read from the original file if we cannot find the data in the log. */
     if(r < 0) {
-      COFFEE_READ(buf, lp.size, absolute_offset(file->page, fdp->offset));
+      read_storage(buf, lp.size, absolute_offset(file->page, fdp->offset));
       r = lp.size;
     }
     fdp->offset += r;
@@ -1223,7 +1804,7 @@ cfs_write(int fd, const void *buf, unsigned size)
        * corresponding end offset in the original extent to ensure that
        * the correct file size is calculated when opening the file again.
        */
-      COFFEE_WRITE(dummy, 1, absolute_offset(file->page, fdp->offset - 1));
+      write_storage(dummy, 1, absolute_offset(file->page, fdp->offset - 1));
     }
   } else {
 #endif /* COFFEE_MICRO_LOGS */
@@ -1233,7 +1814,7 @@ cfs_write(int fd, const void *buf, unsigned size)
   }
 #endif /* COFFEE_APPEND_ONLY */
 
-  COFFEE_WRITE(buf, size, absolute_offset(file->page, fdp->offset));
+  write_storage(buf, size, absolute_offset(file->page, fdp->offset));
   fdp->offset += size;
 #if COFFEE_MICRO_LOGS
 }
@@ -1269,8 +1850,13 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
     read_header(&hdr, page);
     if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
       coffee_page_t next_page;
-      memcpy(record->name, hdr.name, sizeof(record->name));
-      record->name[sizeof(record->name) - 1] = '\0';
+      size_t len;
+
+      /* The header name may be shorter than the dirent name. */
+      for(len = 0; len < sizeof(hdr.name) && len < sizeof(record->name) - 1 &&
+          hdr.name[len] != '\0'; len++);
+      memcpy(record->name, hdr.name, len);
+      record->name[len] = '\0';
       record->size = file_end(page);
 
       next_page = next_file(page, &hdr);
@@ -1349,18 +1935,26 @@ cfs_coffee_format(void)
   *next_free = 0;
 
   for(i = 0; i < COFFEE_SECTOR_COUNT; i++) {
-    COFFEE_ERASE(i);
+    erase_storage(i);
     PRINTF(".");
   }
 
   /* Formatting invalidates the file information. */
   memset(&protected_mem, 0, sizeof(protected_mem));
+  memset(&gc_stats, 0, sizeof(gc_stats));
 
   PRINTF(" done!\n");
 
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats)
+{
+  *stats = gc_stats;
+  stats->free_pages = count_free_pages();
+}
+/*---------------------------------------------------------------------------*/
 void *
 cfs_coffee_get_protected_mem(unsigned *size)
 {
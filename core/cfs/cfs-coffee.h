@@ -126,6 +126,32 @@ int cfs_coffee_set_io_semantics(int fd, unsigned flags);
  */
 int cfs_coffee_format(void);
 
+/**
+ * \brief Garbage collection statistics, from cfs_coffee_get_gc_stats().
+ */
+struct cfs_coffee_gc_stats {
+  /** Number of reservations that had to collect garbage first. */
+  unsigned long foreground_runs;
+  /** Number of sectors erased by these reservations. */
+  unsigned long foreground_erases;
+  /** Number of sectors erased by the background garbage collector. */
+  unsigned long background_erases;
+  /** Largest number of sectors erased by a single reservation. */
+  unsigned max_foreground_erases;
+  /** Number of free pages. */
+  unsigned long free_pages;
+};
+
+/**
+ * \brief Get garbage collection statistics.
+ * \param stats Filled in with the statistics.
+ *
+ * The statistics count from boot or from cfs_coffee_format(). Counting
+ * the free pages requires scanning the file headers of the whole file
+ * system.
+ */
+void cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats);
+
 /**
  * \brief Points out a memory region that may not be altered during
  * checkpointing operations that use the file system.
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *	A CFS backend for POSIX hosts that maps files into memory.
+ *
+ *	Every open file is mapped once, however many descriptors refer to
+ *	it, and reads and writes copy to and from the mapping. Files that
+ *	are written to grow in steps that double their size, and get their
+ *	proper size back when the last descriptor is closed, when
+ *	cfs_mmap_sync() is called, or when the process exits or is
+ *	terminated by a signal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "contiki-conf.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-mmap.h"
+
+#ifdef CFS_MMAP_CONF_MAX_OPEN_FILES
+#define CFS_MMAP_MAX_OPEN_FILES CFS_MMAP_CONF_MAX_OPEN_FILES
+#else
+#define CFS_MMAP_MAX_OPEN_FILES 16
+#endif
+
+#ifdef CFS_MMAP_CONF_FD_SET_SIZE
+#define CFS_MMAP_FD_SET_SIZE CFS_MMAP_CONF_FD_SET_SIZE
+#else
+#define CFS_MMAP_FD_SET_SIZE 32
+#endif
+
+/*
+ * Written data is left for the kernel to write back, except that once
+ * CFS_MMAP_FLUSH_BYTES have been written to a file since its last
+ * flush, the written range is written back before cfs_write() returns.
+ * 0 leaves it all to the kernel.
+ */
+#ifdef CFS_MMAP_CONF_FLUSH_BYTES
+#define CFS_MMAP_FLUSH_BYTES CFS_MMAP_CONF_FLUSH_BYTES
+#else
+#define CFS_MMAP_FLUSH_BYTES 0
+#endif
+
+/* Whether closing the last descriptor of a file waits for its data to
+   reach the host storage, as cfs_mmap_sync() does. */
+#ifdef CFS_MMAP_CONF_SYNC_ON_CLOSE
+#define CFS_MMAP_SYNC_ON_CLOSE CFS_MMAP_CONF_SYNC_ON_CLOSE
+#else
+#define CFS_MMAP_SYNC_ON_CLOSE 0
+#endif
+
+/* The smallest size that a file grows to when written to. */
+#define MIN_CAPACITY (64 * 1024L)
+
+struct mmap_file {
+  dev_t dev;
+  ino_t ino;
+  int host_fd;
+  unsigned char *map;
+  size_t mapped;
+  /* The size of the file and the size of the host file, which is
+     larger while the file is being written to. */
+  cfs_offset_t size;
+  cfs_offset_t capacity;
+  /* Written range that has not been flushed. */
+  cfs_offset_t dirty_start;
+  cfs_offset_t dirty_end;
+  uint8_t references;
+  uint8_t writable;
+};
+
+struct mmap_fd {
+  struct mmap_file *file;
+  cfs_offset_t offset;
+  uint8_t flags;
+};
+
+static struct mmap_file files[CFS_MMAP_MAX_OPEN_FILES];
+static struct mmap_fd fds[CFS_MMAP_FD_SET_SIZE];
+
+/* Signals that terminate the process, after which files that are being
+   written to must not keep their larger host size. */
+static const int exit_signals[] = { SIGHUP, SIGINT, SIGQUIT, SIGABRT, SIGTERM };
+#define EXIT_SIGNAL_COUNT (sizeof(exit_signals) / sizeof(exit_signals[0]))
+static void (*saved_handlers[EXIT_SIGNAL_COUNT])(int);
+static uint8_t exit_hooks_installed;
+
+#define FD_VALID(fd) \
+  ((fd) >= 0 && (fd) < CFS_MMAP_FD_SET_SIZE && fds[(fd)].flags != 0)
+/*---------------------------------------------------------------------------*/
+static int
+map_file(struct mmap_file *file, size_t length)
+{
+  if(file->map != NULL) {
+    munmap(file->map, file->mapped);
+    file->map = NULL;
+    file->mapped = 0;
+  }
+  if(length == 0) {
+    return 0;
+  }
+
+  file->map = mmap(NULL, length,
+                   file->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, file->host_fd, 0);
+  if(file->map == MAP_FAILED) {
+    file->map = NULL;
+    return -1;
+  }
+  file->mapped = length;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+flush(struct mmap_file *file, int flags)
+{
+  cfs_offset_t start;
+  int r;
+
+  r = 0;
+  if(file->dirty_end > file->dirty_start) {
+    start = file->dirty_start & ~(sysconf(_SC_PAGESIZE) - 1);
+    r = msync(file->map + start, file->dirty_end - start, flags);
+  }
+  file->dirty_start = file->dirty_end = 0;
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+mark_dirty(struct mmap_file *file, cfs_offset_t start, cfs_offset_t end)
+{
+  if(file->dirty_end == file->dirty_start) {
+    file->dirty_start = start;
+    file->dirty_end = end;
+  } else {
+    if(start < file->dirty_start) {
+      file->dirty_start = start;
+    }
+    if(end > file->dirty_end) {
+      file->dirty_end = end;
+    }
+  }
+
+  if(CFS_MMAP_FLUSH_BYTES > 0 &&
+     file->dirty_end - file->dirty_start >= CFS_MMAP_FLUSH_BYTES) {
+    flush(file, MS_SYNC);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Makes the file at least end bytes large by growing the host file. */
+static int
+reserve_space(struct mmap_file *file, cfs_offset_t end)
+{
+  cfs_offset_t capacity;
+
+  if(end <= file->capacity) {
+    return 0;
+  }
+
+  capacity = file->capacity < MIN_CAPACITY ? MIN_CAPACITY : file->capacity;
+  while(capacity < end) {
+    if(capacity * 2 < capacity) {
+      return -1;
+    }
+    capacity *= 2;
+  }
+
+  if(ftruncate(file->host_fd, capacity) < 0) {
+    return -1;
+  }
+  file->capacity = capacity;
+
+  if((size_t)capacity > file->mapped) {
+    return map_file(file, capacity);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+truncate_file(struct mmap_file *file)
+{
+  map_file(file, 0);
+  if(ftruncate(file->host_fd, 0) == 0) {
+    file->size = file->capacity = 0;
+  }
+  file->dirty_start = file->dirty_end = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release_file(struct mmap_file *file)
+{
+  if(file->writable) {
+    if(CFS_MMAP_SYNC_ON_CLOSE) {
+      flush(file, MS_SYNC);
+    }
+    if(file->capacity != file->size) {
+      map_file(file, 0);
+      ftruncate(file->host_fd, file->size);
+    }
+    if(CFS_MMAP_SYNC_ON_CLOSE) {
+      fsync(file->host_fd);
+    }
+  }
+  map_file(file, 0);
+  close(file->host_fd);
+}
+/*---------------------------------------------------------------------------*/
+/* Gives the host files of the files that are being written to their
+   proper size. Only uses async-signal-safe calls. */
+static void
+trim_files(void)
+{
+  int i;
+
+  for(i = 0; i < CFS_MMAP_MAX_OPEN_FILES; i++) {
+    if(files[i].references > 0 && files[i].writable &&
+       files[i].capacity != files[i].size &&
+       ftruncate(files[i].host_fd, files[i].size) == 0) {
+      files[i].capacity = files[i].size;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+exit_signal(int sig)
+{
+  unsigned i;
+
+  trim_files();
+  for(i = 0; i < EXIT_SIGNAL_COUNT; i++) {
+    if(exit_signals[i] == sig) {
+      /* Let the previous handler, or the default action, take over. */
+      signal(sig, saved_handlers[i] == SIG_ERR ? SIG_DFL : saved_handlers[i]);
+      raise(sig);
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+install_exit_hooks(void)
+{
+  unsigned i;
+
+  if(exit_hooks_installed) {
+    return;
+  }
+  exit_hooks_installed = 1;
+
+  atexit(trim_files);
+  for(i = 0; i < EXIT_SIGNAL_COUNT; i++) {
+    saved_handlers[i] = signal(exit_signals[i], exit_signal);
+    if(saved_handlers[i] == SIG_IGN) {
+      signal(exit_signals[i], SIG_IGN);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct mmap_file *
+get_file(int host_fd, int writable)
+{
+  struct stat st;
+  struct mmap_file *file;
+  size_t length;
+  int old_fd;
+  int i;
+
+  if(fstat(host_fd, &st) < 0) {
+    return NULL;
+  }
+
+  file = NULL;
+  for(i = 0; i < CFS_MMAP_MAX_OPEN_FILES; i++) {
+    if(files[i].references > 0 &&
+       files[i].dev == st.st_dev && files[i].ino == st.st_ino) {
+      if(writable && !files[i].writable) {
+        /* Map the file for writing from now on. */
+        old_fd = files[i].host_fd;
+        length = files[i].mapped;
+        files[i].host_fd = host_fd;
+        files[i].writable = 1;
+        if(map_file(&files[i], length) < 0) {
+          /* Keep the file read-only for the descriptors that use it. */
+          files[i].host_fd = old_fd;
+          files[i].writable = 0;
+          map_file(&files[i], length);
+          return NULL;
+        }
+        close(old_fd);
+      } else {
+        close(host_fd);
+      }
+      return &files[i];
+    } else if(files[i].references == 0 && file == NULL) {
+      file = &files[i];
+    }
+  }
+
+  if(file == NULL) {
+    return NULL;
+  }
+
+  memset(file, 0, sizeof(*file));
+  file->dev = st.st_dev;
+  file->ino = st.st_ino;
+  file->host_fd = host_fd;
+  file->writable = writable;
+  file->size = file->capacity = st.st_size;
+  if(map_file(file, file->size) < 0) {
+    return NULL;
+  }
+  return file;
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_open(const char *name, int flags)
+{
+  int fd, host_fd;
+  struct mmap_fd *fdp;
+
+  if(!(flags & (CFS_READ | CFS_WRITE))) {
+    return -1;
+  }
+
+  for(fd = 0; fd < CFS_MMAP_FD_SET_SIZE; fd++) {
+    if(fds[fd].flags == 0) {
+      break;
+    }
+  }
+  if(fd == CFS_MMAP_FD_SET_SIZE) {
+    return -1;
+  }
+  fdp = &fds[fd];
+
+  if(flags & CFS_WRITE) {
+    install_exit_hooks();
+    host_fd = open(name, O_RDWR | O_CREAT, 0600);
+  } else {
+    host_fd = open(name, O_RDONLY);
+  }
+  if(host_fd < 0) {
+    return -1;
+  }
+
+  fdp->file = get_file(host_fd, flags & CFS_WRITE);
+  if(fdp->file == NULL) {
+    close(host_fd);
+    return -1;
+  }
+
+  /* Opening a file for writing truncates it, as with cfs-posix. */
+  if((flags & CFS_WRITE) && !(flags & CFS_APPEND)) {
+    truncate_file(fdp->file);
+  }
+
+  fdp->file->references++;
+  fdp->offset = 0;
+  fdp->flags = flags;
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
+void
+cfs_close(int fd)
+{
+  struct mmap_file *file;
+
+  if(!FD_VALID(fd)) {
+    return;
+  }
+
+  file = fds[fd].file;
+  fds[fd].flags = 0;
+  fds[fd].file = NULL;
+  if(--file->references == 0) {
+    release_file(file);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_read(int fd, void *buf, unsigned size)
+{
+  struct mmap_fd *fdp;
+
+  if(!FD_VALID(fd) || !(fds[fd].flags & CFS_READ)) {
+    return -1;
+  }
+  fdp = &fds[fd];
+
+  if(fdp->offset >= fdp->file->size) {
+    return 0;
+  }
+  if(size > fdp->file->size - fdp->offset) {
+    size = fdp->file->size - fdp->offset;
+  }
+
+  memcpy(buf, fdp->file->map + fdp->offset, size);
+  fdp->offset += size;
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_write(int fd, const void *buf, unsigned size)
+{
+  struct mmap_fd *fdp;
+  struct mmap_file *file;
+  cfs_offset_t end;
+
+  if(!FD_VALID(fd) || !(fds[fd].flags & CFS_WRITE)) {
+    return -1;
+  }
+  fdp = &fds[fd];
+  file = fdp->file;
+  if(size == 0) {
+    return 0;
+  }
+
+  if(fdp->flags & CFS_APPEND) {
+    fdp->offset = file->size;
+  }
+
+  end = fdp->offset + size;
+  if(end < fdp->offset || reserve_space(file, end) < 0) {
+    return -1;
+  }
+
+  memcpy(file->map + fdp->offset, buf, size);
+  if(end > file->size) {
+    file->size = end;
+  }
+  mark_dirty(file, fdp->offset, end);
+  fdp->offset = end;
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+cfs_offset_t
+cfs_seek(int fd, cfs_offset_t offset, int whence)
+{
+  struct mmap_fd *fdp;
+
+  if(!FD_VALID(fd)) {
+    return -1;
+  }
+  fdp = &fds[fd];
+
+  if(whence == CFS_SEEK_CUR) {
+    offset += fdp->offset;
+  } else if(whence == CFS_SEEK_END) {
+    offset += fdp->file->size;
+  } else if(whence != CFS_SEEK_SET) {
+    return (cfs_offset_t)-1;
+  }
+
+  if(offset < 0) {
+    return (cfs_offset_t)-1;
+  }
+  return fdp->offset = offset;
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_remove(const char *name)
+{
+  return remove(name);
+}
+/*---------------------------------------------------------------------------*/
+int
+cfs_mmap_sync(int fd)
+{
+  struct mmap_file *file;
+
+  if(!FD_VALID(fd)) {
+    return -1;
+  }
+  file = fds[fd].file;
+  if(!file->writable) {
+    return 0;
+  }
+
+  if(file->size > 0 && msync(file->map, file->size, MS_SYNC) < 0) {
+    return -1;
+  }
+  file->dirty_start = file->dirty_end = 0;
+
+  /* The mapping stays, but the host file gets its proper size. */
+  if(file->capacity != file->size) {
+    if(ftruncate(file->host_fd, file->size) < 0) {
+      return -1;
+    }
+    file->capacity = file->size;
+  }
+  return fsync(file->host_fd);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup cfs
+ * @{
+ */
+
+/**
+ * \file
+ *	Extensions of the CFS backend that maps files into memory on
+ *	POSIX hosts.
+ *
+ *	Reads and writes are served from a shared mapping of each file,
+ *	so they cost no system calls. Written data reaches the host file
+ *	when the kernel writes the mapping back, when
+ *	CFS_MMAP_CONF_FLUSH_BYTES have been written since the last flush,
+ *	or when cfs_mmap_sync() is called.
+ *
+ *	While a file is open for writing, its host file is larger than
+ *	the file and padded with zeroes. It gets its proper size back
+ *	when the file is closed or synced, when the process exits, and
+ *	when the process is terminated by SIGHUP, SIGINT, SIGQUIT,
+ *	SIGABRT or SIGTERM. If the process is killed otherwise, e.g., by
+ *	SIGKILL or a crash, or if the host goes down, the padding remains
+ *	and is read back as part of the file. Call cfs_mmap_sync() after
+ *	writes that must survive such a failure with the file intact.
+ */
+
+#ifndef CFS_MMAP_H
+#define CFS_MMAP_H
+
+#include "cfs.h"
+
+/**
+ * \brief Write a file to the host storage.
+ * \param fd The file descriptor of the file.
+ * \return 0 on success, -1 on failure.
+ *
+ * Returns when everything written to the file so far has been written
+ * to the host storage, and the host file has its proper size.
+ */
+int cfs_mmap_sync(int fd);
+
+#endif /* !CFS_MMAP_H */
+
+/** @} */
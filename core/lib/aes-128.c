@@ -64,7 +64,15 @@ static const uint8_t sbox[256] =   {
 0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
 0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 };
 
-static uint8_t round_keys[11][AES_128_KEY_LENGTH];
+struct key_schedule {
+  uint8_t key[AES_128_KEY_LENGTH];
+  uint8_t round_keys[AES_128_ROUNDS + 1][AES_128_BLOCK_SIZE];
+};
+
+static struct key_schedule key_cache[AES_128_KEY_CACHE_SIZE];
+static uint8_t key_cache_used;
+static uint8_t key_cache_next;
+static const uint8_t (*round_keys)[AES_128_BLOCK_SIZE];
 
 /*---------------------------------------------------------------------------*/
 /* multiplies by 2 in GF(2) */
@@ -76,26 +84,55 @@ galois_mul2(uint8_t value)
 }
 /*---------------------------------------------------------------------------*/
 static void
-set_key(const uint8_t *key)
+expand(struct key_schedule *ks)
 {
   uint8_t i;
   uint8_t j;
   uint8_t rcon;
   
   rcon = 0x01;
-  memcpy(round_keys[0], key, AES_128_KEY_LENGTH);
-  for(i = 1; i <= 10; i++) {
-    round_keys[i][0] = sbox[round_keys[i - 1][13]] ^ round_keys[i - 1][0] ^ rcon;
-    round_keys[i][1] = sbox[round_keys[i - 1][14]] ^ round_keys[i - 1][1];
-    round_keys[i][2] = sbox[round_keys[i - 1][15]] ^ round_keys[i - 1][2];
-    round_keys[i][3] = sbox[round_keys[i - 1][12]] ^ round_keys[i - 1][3];
+  memcpy(ks->round_keys[0], ks->key, AES_128_KEY_LENGTH);
+  for(i = 1; i <= AES_128_ROUNDS; i++) {
+    ks->round_keys[i][0] = sbox[ks->round_keys[i - 1][13]] ^ ks->round_keys[i - 1][0] ^ rcon;
+    ks->round_keys[i][1] = sbox[ks->round_keys[i - 1][14]] ^ ks->round_keys[i - 1][1];
+    ks->round_keys[i][2] = sbox[ks->round_keys[i - 1][15]] ^ ks->round_keys[i - 1][2];
+    ks->round_keys[i][3] = sbox[ks->round_keys[i - 1][12]] ^ ks->round_keys[i - 1][3];
     for(j = 4; j < AES_128_BLOCK_SIZE; j++) {
-      round_keys[i][j] = round_keys[i - 1][j] ^ round_keys[i][j - 4];
+      ks->round_keys[i][j] = ks->round_keys[i - 1][j] ^ ks->round_keys[i][j - 4];
     }
     rcon = galois_mul2(rcon);
   }
 }
 /*---------------------------------------------------------------------------*/
+const uint8_t *
+aes_128_expand_key(const uint8_t *key)
+{
+  struct key_schedule *ks;
+  uint8_t i;
+
+  for(i = 0; i < key_cache_used; i++) {
+    if(memcmp(key_cache[i].key, key, AES_128_KEY_LENGTH) == 0) {
+      return key_cache[i].round_keys[0];
+    }
+  }
+
+  /* Not cached; replace entries in a round-robin fashion */
+  ks = &key_cache[key_cache_next];
+  key_cache_next = (key_cache_next + 1) % AES_128_KEY_CACHE_SIZE;
+  if(key_cache_used < AES_128_KEY_CACHE_SIZE) {
+    key_cache_used++;
+  }
+  memcpy(ks->key, key, AES_128_KEY_LENGTH);
+  expand(ks);
+  return ks->round_keys[0];
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+  round_keys = (const uint8_t (*)[AES_128_BLOCK_SIZE])aes_128_expand_key(key);
+}
+/*---------------------------------------------------------------------------*/
 static void
 encrypt(uint8_t *state)
 {
@@ -107,7 +144,7 @@ encrypt(uint8_t *state)
     state[i] = state[i] ^ round_keys[0][i];
   }
   
-  for(round = 1; round <= 10; round++) {
+  for(round = 1; round <= AES_128_ROUNDS; round++) {
     /* ByteSub */
     for(i = 0; i < AES_128_BLOCK_SIZE; i++) {
       state[i] = sbox[state[i]];
@@ -134,7 +171,7 @@ encrypt(uint8_t *state)
     state[3] = buf1;
 
     /* last round skips MixColumn */
-    if(round < 10) {
+    if(round < AES_128_ROUNDS) {
       /* MixColumn */
       for(i = 0; i < 4; i++) {
         buf4 = (i << 2);
@@ -178,6 +215,7 @@ aes_128_set_padded_key(uint8_t *key, uint8_t key_len)
 /*---------------------------------------------------------------------------*/
 const struct aes_128_driver aes_128_driver = {
   set_key,
-  encrypt
+  encrypt,
+  NULL
 };
 /*---------------------------------------------------------------------------*/
@@ -44,6 +44,18 @@
 
 #define AES_128_BLOCK_SIZE 16
 #define AES_128_KEY_LENGTH 16
+#define AES_128_ROUNDS     10
+
+/**
+ * Number of expanded keys kept around. Setting a key that is still in
+ * this cache skips the key expansion, which pays off when frames from
+ * several neighbors with distinct keys are processed in turn.
+ */
+#ifdef AES_128_CONF_KEY_CACHE_SIZE
+#define AES_128_KEY_CACHE_SIZE AES_128_CONF_KEY_CACHE_SIZE
+#else /* AES_128_CONF_KEY_CACHE_SIZE */
+#define AES_128_KEY_CACHE_SIZE 1
+#endif /* AES_128_CONF_KEY_CACHE_SIZE */
 
 #ifdef AES_128_CONF
 #define AES_128            AES_128_CONF
@@ -65,6 +77,14 @@ struct aes_128_driver {
    * \brief Encrypts.
    */
   void (* encrypt)(uint8_t *plaintext_and_result);
+  
+  /**
+   * \brief Encrypts two independent blocks under the current key.
+   *
+   * Optional; NULL if the driver cannot do better than two calls to
+   * encrypt. Pipelined implementations can overlap both encryptions.
+   */
+  void (* encrypt_pair)(uint8_t *block1, uint8_t *block2);
 };
 
 /**
@@ -72,6 +92,16 @@ struct aes_128_driver {
  */
 void aes_128_set_padded_key(uint8_t *key, uint8_t key_len);
 
+/**
+ * \brief Returns the round keys of a key, expanding it unless it is cached
+ * \return (AES_128_ROUNDS + 1) round keys of AES_128_BLOCK_SIZE bytes each.
+ *         They remain valid until AES_128_KEY_CACHE_SIZE other keys have
+ *         been expanded.
+ */
+const uint8_t *aes_128_expand_key(const uint8_t *key);
+
 extern const struct aes_128_driver AES_128;
+extern const struct aes_128_driver aes_128_driver;
+extern const struct aes_128_driver aes_128_ttable_driver;
 
 #endif /* AES_128_H_ */
@@ -59,86 +59,18 @@ set_iv(uint8_t *iv,
   iv[15] = counter;
 }
 /*---------------------------------------------------------------------------*/
-/* XORs the block m[pos] ... m[pos + 15] with K_{counter} */
+/* Encrypts the CBC-MAC state and the next key stream block together */
 static void
-ctr_step(const uint8_t *nonce,
-    uint8_t pos,
-    uint8_t *m_and_result,
-    uint8_t m_len,
-    uint8_t counter)
-{
-  uint8_t a[AES_128_BLOCK_SIZE];
-  uint8_t i;
-  
-  set_iv(a, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter);
-  AES_128.encrypt(a);
-  
-  for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-    m_and_result[pos + i] ^= a[i];
-  }
-}
-/*---------------------------------------------------------------------------*/
-static void
-mic(const uint8_t *nonce,
-    const uint8_t *m, uint8_t m_len,
-    const uint8_t *a, uint8_t a_len,
-    uint8_t *result,
-    uint8_t mic_len)
+encrypt_pair(uint8_t *x, uint8_t *s)
 {
-  uint8_t x[AES_128_BLOCK_SIZE];
-  uint8_t pos;
-  uint8_t i;
-  
-  set_iv(x, CCM_STAR_AUTH_FLAGS(a_len, mic_len), nonce, m_len);
-  AES_128.encrypt(x);
-  
-  if(a_len) {
-    x[1] = x[1] ^ a_len;
-    for(i = 2; (i - 2 < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-      x[i] ^= a[i - 2];
-    }
-    
+  if(AES_128.encrypt_pair) {
+    AES_128.encrypt_pair(x, s);
+  } else {
     AES_128.encrypt(x);
-    
-    pos = 14;
-    while(pos < a_len) {
-      for(i = 0; (pos + i < a_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= a[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
+    AES_128.encrypt(s);
   }
-  
-  if(m_len) {
-    pos = 0;
-    while(pos < m_len) {
-      for(i = 0; (pos + i < m_len) && (i < AES_128_BLOCK_SIZE); i++) {
-        x[i] ^= m[pos + i];
-      }
-      pos += AES_128_BLOCK_SIZE;
-      AES_128.encrypt(x);
-    }
-  }
-  
-  ctr_step(nonce, 0, x, AES_128_BLOCK_SIZE, 0);
-  
-  memcpy(result, x, mic_len);
 }
 /*---------------------------------------------------------------------------*/
-static void
-ctr(const uint8_t *nonce, uint8_t *m, uint8_t m_len)
-{
-  uint8_t pos;
-  uint8_t counter;
-  
-  pos = 0;
-  counter = 1;
-  while(pos < m_len) {
-    ctr_step(nonce, pos, m, m_len, counter++);
-    pos += AES_128_BLOCK_SIZE;
-  }
-}
 /*---------------------------------------------------------------------------*/
 static void
 set_key(const uint8_t *key)
@@ -146,6 +78,12 @@ set_key(const uint8_t *key)
   AES_128.set_key(key);
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Computes the MIC and en/decrypts m in a single pass. The CBC-MAC state x
+ * always holds data that still has to be encrypted, so that this encryption
+ * can be done along with that of the key stream block for the next part of
+ * m, regardless of whether the MIC is computed over the input or the output.
+ */
 static void
 aead(const uint8_t* nonce,
     uint8_t* m, uint8_t m_len,
@@ -153,20 +91,57 @@ aead(const uint8_t* nonce,
     uint8_t *result, uint8_t mic_len,
     int forward)
 {
-  if(!forward) {
-    /* decrypt */
-    ctr(nonce, m, m_len);
+  uint8_t x[AES_128_BLOCK_SIZE];
+  uint8_t s[AES_128_BLOCK_SIZE];
+  uint8_t counter;
+  uint8_t len;
+  uint8_t i;
+  
+  set_iv(x, CCM_STAR_AUTH_FLAGS(a_len, mic_len), nonce, m_len);
+  
+  if(a_len) {
+    AES_128.encrypt(x);
+    x[1] ^= a_len;
+    len = MIN(a_len, AES_128_BLOCK_SIZE - 2);
+    for(i = 0; i < len; i++) {
+      x[2 + i] ^= a[i];
+    }
+    a += len;
+    a_len -= len;
+    
+    while(a_len) {
+      AES_128.encrypt(x);
+      len = MIN(a_len, AES_128_BLOCK_SIZE);
+      for(i = 0; i < len; i++) {
+        x[i] ^= a[i];
+      }
+      a += len;
+      a_len -= len;
+    }
   }
   
-  mic(nonce,
-    m, m_len,
-    a, a_len,
-    result,
-    mic_len);
+  counter = 1;
+  while(m_len) {
+    set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, counter++);
+    encrypt_pair(x, s);
+    len = MIN(m_len, AES_128_BLOCK_SIZE);
+    for(i = 0; i < len; i++) {
+      if(forward) {
+        x[i] ^= m[i];
+        m[i] ^= s[i];
+      } else {
+        m[i] ^= s[i];
+        x[i] ^= m[i];
+      }
+    }
+    m += len;
+    m_len -= len;
+  }
   
-  if(forward) {
-    /* encrypt */
-    ctr(nonce, m, m_len);
+  set_iv(s, CCM_STAR_ENCRYPTION_FLAGS, nonce, 0);
+  encrypt_pair(x, s);
+  for(i = 0; i < mic_len; i++) {
+    result[i] = x[i] ^ s[i];
   }
 }
 /*---------------------------------------------------------------------------*/
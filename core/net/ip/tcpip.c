@@ -526,6 +526,9 @@ tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
   uip_ipaddr_t *nexthop;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+  uip_ipaddr_t srh_nexthop;
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
 
   if(uip_len == 0) {
     return;
@@ -547,20 +550,47 @@ tcpip_ipv6_output(void)
     /* Next hop determination */
     nbr = NULL;
 
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+    /* In non-storing mode, the root source routes the packets to the
+       nodes of its DODAG */
+    if(!rpl_srh_insert()) {
+      uip_clear_buf();
+      return;
+    }
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
+
     /* We first check if the destination address is on our immediate
        link. If so, we simply use the destination address as our
        nexthop address. */
     if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)){
       nexthop = &UIP_IP_BUF->destipaddr;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+    } else if(rpl_srh_get_next_hop(&srh_nexthop)) {
+      /* Source routed packet: the destination is the next hop */
+      nexthop = &srh_nexthop;
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
     } else {
       uip_ds6_route_t *route;
+#if UIP_CONF_IPV6_RPL
+      /* Packets carrying an RPL option are routed within their own
+         RPL instance. */
+      rpl_instance_t *instance;
+
+      instance = rpl_get_packet_instance();
+      route = rpl_route_lookup(instance, &UIP_IP_BUF->destipaddr);
+#else /* UIP_CONF_IPV6_RPL */
       /* Check if we have a route to the destination address. */
       route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+#endif /* UIP_CONF_IPV6_RPL */
 
       /* No route was found - we send to the default route instead. */
       if(route == NULL) {
         PRINTF("tcpip_ipv6_output: no route found, using default route\n");
+#if UIP_CONF_IPV6_RPL
+        nexthop = rpl_get_default_nexthop(instance);
+#else /* UIP_CONF_IPV6_RPL */
         nexthop = uip_ds6_defrt_choose();
+#endif /* UIP_CONF_IPV6_RPL */
         if(nexthop == NULL) {
 #ifdef UIP_FALLBACK_INTERFACE
 	  PRINTF("FALLBACK: removing ext hdrs & setting proto %d %d\n", 
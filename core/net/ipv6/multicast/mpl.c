@@ -0,0 +1,1066 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup mpl-multicast
+ * @{
+ */
+/**
+ * \file
+ *    This file implements IPv6 MPL multicast forwarding (RFC 7731)
+ */
+
+#include "contiki.h"
+#include "contiki-lib.h"
+#include "contiki-net.h"
+#include "lib/trickle-timer.h"
+#include "net/ipv6/uip-icmp6.h"
+#include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/ipv6/multicast/mpl.h"
+#include "dev/watchdog.h"
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+/*---------------------------------------------------------------------------*/
+/* Data Representation */
+/*---------------------------------------------------------------------------*/
+/*
+ * Seed IDs are stored in the form they are received in. A Seed ID elided
+ * from the MPL option (S=0) is the datagram's IPv6 source address, which the
+ * RFC treats as the same seed as a 128-bit Seed ID with that value. We
+ * therefore store those with s = MPL_SEED_ID_TYPE_128.
+ */
+typedef struct seed_id_s {
+  uint8_t id[16];
+  uint8_t s;
+} seed_id_t;
+
+/* Length of a Seed ID with S field s, as stored */
+#define SEED_ID_LEN(s) ((s) == MPL_SEED_ID_TYPE_16 ? 2 : \
+                        ((s) == MPL_SEED_ID_TYPE_64 ? 8 : 16))
+
+/* Length of a Seed ID with S field s, as carried in an option or message */
+#define SEED_ID_WIRE_LEN(s) ((s) == MPL_SEED_ID_TYPE_SRC ? 0 : SEED_ID_LEN(s))
+
+#define seed_id_cmp(a, b) \
+  ((a)->s == (b)->s && memcmp((a)->id, (b)->id, SEED_ID_LEN((a)->s)) == 0)
+
+#if DEBUG
+static void
+print_seed(const seed_id_t *s)
+{
+  uint8_t i;
+
+  if(s->s == MPL_SEED_ID_TYPE_128) {
+    PRINT6ADDR((const uip_ipaddr_t *)s->id);
+  } else {
+    PRINTF("0x");
+    for(i = 0; i < SEED_ID_LEN(s->s); i++) {
+      PRINTF("%02x", s->id[i]);
+    }
+  }
+}
+#define PRINT_SEED(s) print_seed(s)
+#else
+#define PRINT_SEED(s)
+#endif
+/*---------------------------------------------------------------------------*/
+/* Sequence Values and Serial Number Arithmetic
+ *
+ * Sequence Number Comparisons as per RFC1982 "Serial Number Arithmetic"
+ * MPL sequence values are 8 bits long, so our 'SERIAL_BITS' value is 8 here
+ */
+#define SEQ_VAL_IS_EQ(i1, i2) ((i1) == (i2))
+
+#define SEQ_VAL_IS_LT(i1, i2) \
+  ( \
+    ((i1) != (i2)) && \
+    ((((i1) < (i2)) && ((i2) - (i1)) < 0x80) || \
+     (((i1) > (i2)) && ((i1) - (i2)) > 0x80)) \
+  )
+
+#define SEQ_VAL_IS_GT(i1, i2) SEQ_VAL_IS_LT(i2, i1)
+/*---------------------------------------------------------------------------*/
+/* Buffered MPL Data Messages */
+struct mpl_msg {
+  struct mpl_msg *next;         /* Next message for the same seed */
+  struct mpl_seed *seed;        /* The seed set entry this message belongs to */
+  uint16_t size;
+  uint16_t opt_offset;          /* Offset of the MPL option within buff */
+  uint8_t seq;
+  uint8_t e;                    /* Trickle expirations since last reset */
+  uint8_t buff[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+/**
+ * \brief Is message m still being retransmitted under its seed's trickle
+ * timer?
+ */
+#define MSG_IS_ACTIVE(m) ((m)->e < MPL_DATA_MESSAGE_TIMER_EXPIRATIONS)
+
+/**
+ * \brief Get the TTL of a buffered message
+ */
+#define MSG_TTL(m) (((struct uip_ip_hdr *)(m)->buff)->ttl)
+
+/**
+ * \brief Get the MPL option of a buffered message
+ */
+#define MSG_OPT(m) ((struct hbho_mpl *)&(m)->buff[(m)->opt_offset])
+/*---------------------------------------------------------------------------*/
+/* Seed Set */
+struct mpl_seed {
+  struct mpl_seed *next;        /* Next entry in the same hash bucket */
+  seed_id_t seed_id;
+  LIST_STRUCT(msgs);            /* Buffered messages, oldest first */
+  struct trickle_timer tt;
+  unsigned long expires;        /* clock_seconds() */
+  uint8_t min_seqno;            /* Lowest sequence value we still accept */
+  uint8_t count;                /* Number of buffered messages */
+  uint8_t flags;
+};
+
+#define SEED_L_BIT 0x80         /* Listed in the current control message */
+/*---------------------------------------------------------------------------*/
+/* MPL HBH Option */
+struct hbho_mpl {
+  uint8_t type;
+  uint8_t len;
+  uint8_t flags;                /* S, M, V */
+  uint8_t seq;
+  /* Followed by the Seed ID, if S != 0 */
+};
+
+/* Option and Hop-by-Hop header as we send them. Both Seed ID types we can
+ * originate (elided and 16-bit) fit in 8 bytes with PadN */
+#define HBHO_LEN_SEED_ID_SRC     2
+#define HBHO_LEN_SEED_ID_16      4
+#define HBHO_TOTAL_LEN           8
+
+#define HBH_GET_S(h) ((h)->flags >> 6)
+#define HBH_M_BIT 0x20
+#define HBH_V_BIT 0x10
+#define HBH_SEED_ID(h) ((uint8_t *)(h) + sizeof(struct hbho_mpl))
+/*---------------------------------------------------------------------------*/
+/* MPL Seed Info in Control Messages */
+#define SEED_INFO_HDR_LEN        2
+#define SEED_INFO_BM_LEN_MAX    63
+#define SEED_INFO_GET_BM_LEN(p) ((p)[1] >> 2)
+#define SEED_INFO_GET_S(p) ((p)[1] & 0x03)
+/*---------------------------------------------------------------------------*/
+/* Destination for our control messages: ALL_MPL_FORWARDERS, link-local */
+#define mpl_create_dest(a) uip_ip6addr(a, 0xff02, 0, 0, 0, 0, 0, 0, 0x00fc)
+/*---------------------------------------------------------------------------*/
+/* Maintain Stats */
+#if UIP_MCAST6_STATS
+static struct mpl_stats stats;
+
+#define MPL_STATS_ADD(x) stats.x++
+#define MPL_STATS_INIT() do { memset(&stats, 0, sizeof(stats)); } while(0)
+#else /* UIP_MCAST6_STATS */
+#define MPL_STATS_ADD(x)
+#define MPL_STATS_INIT()
+#endif
+/*---------------------------------------------------------------------------*/
+/* Internal Data Structures */
+/*---------------------------------------------------------------------------*/
+MEMB(seed_memb, struct mpl_seed, MPL_SEED_SET_SIZE);
+MEMB(msg_memb, struct mpl_msg, MPL_BUFF_NUM);
+static struct mpl_seed *seed_table[MPL_SEED_SET_HASH_SIZE];
+static struct trickle_timer control_tt;
+static uint8_t control_e;
+static uint8_t last_seq;
+/*---------------------------------------------------------------------------*/
+/* uIPv6 Pointers */
+/*---------------------------------------------------------------------------*/
+#define UIP_EXT_BUF       ((struct uip_ext_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define UIP_EXT_BUF_NEXT  ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + HBHO_TOTAL_LEN])
+#define UIP_EXT_OPT_FIRST ((struct hbho_mpl *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + 2])
+#define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_ICMP_BUF      ((struct uip_icmp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
+#define UIP_ICMP_PAYLOAD  ((unsigned char *)&uip_buf[uip_l2_l3_icmp_hdr_len])
+extern uint16_t uip_slen;
+/*---------------------------------------------------------------------------*/
+/* Local function prototypes */
+/*---------------------------------------------------------------------------*/
+static void icmp_input(void);
+static void data_timer_expired(void *ptr, uint8_t suppress);
+/*---------------------------------------------------------------------------*/
+/* MPL Control Message ICMPv6 handler declaration */
+UIP_ICMP6_HANDLER(mpl_icmp_handler, ICMP6_MPL,
+                  UIP_ICMP6_HANDLER_CODE_ANY, icmp_input);
+/*---------------------------------------------------------------------------*/
+/* Seed Set Management */
+/*---------------------------------------------------------------------------*/
+static uint8_t
+seed_hash(const seed_id_t *s)
+{
+  uint8_t h;
+  uint8_t i;
+
+  h = s->s;
+  for(i = 0; i < SEED_ID_LEN(s->s); i++) {
+    h ^= s->id[i];
+  }
+  return h & (MPL_SEED_SET_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static int
+seed_is_expired(struct mpl_seed *s)
+{
+  return s->count == 0 && (long)(clock_seconds() - s->expires) >= 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+msg_free(struct mpl_msg *m)
+{
+  struct mpl_seed *s = m->seed;
+
+  /* Messages only ever leave from the head of a seed's list, so everything
+   * before the next one is now old */
+  s->min_seqno = m->seq + 1;
+  list_remove(s->msgs, m);
+  s->count--;
+  memb_free(&msg_memb, m);
+}
+/*---------------------------------------------------------------------------*/
+static void
+seed_free(struct mpl_seed *s)
+{
+  struct mpl_seed **prev;
+
+  PRINTF("MPL: Free seed ");
+  PRINT_SEED(&s->seed_id);
+  PRINTF("\n");
+
+  for(prev = &seed_table[seed_hash(&s->seed_id)]; *prev != NULL;
+      prev = &(*prev)->next) {
+    if(*prev == s) {
+      *prev = s->next;
+      break;
+    }
+  }
+
+  trickle_timer_stop(&s->tt);
+  while(list_head(s->msgs) != NULL) {
+    msg_free(list_head(s->msgs));
+  }
+  memb_free(&seed_memb, s);
+  MPL_STATS_ADD(seed_expired);
+}
+/*---------------------------------------------------------------------------*/
+static struct mpl_seed *
+seed_lookup(const seed_id_t *id)
+{
+  struct mpl_seed *s;
+  struct mpl_seed *next;
+
+  for(s = seed_table[seed_hash(id)]; s != NULL; s = next) {
+    next = s->next;
+    if(seed_id_cmp(&s->seed_id, id)) {
+      if(seed_is_expired(s)) {
+        /* The seed may have rebooted since: forget its sequence values */
+        seed_free(s);
+        return NULL;
+      }
+      return s;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct mpl_seed *
+seed_allocate(const seed_id_t *id)
+{
+  struct mpl_seed *s;
+  uint8_t i;
+
+  s = memb_alloc(&seed_memb);
+  if(s == NULL) {
+    /* Full. Reuse the first expired entry, if any */
+    for(i = 0; i < MPL_SEED_SET_HASH_SIZE && s == NULL; i++) {
+      for(s = seed_table[i]; s != NULL; s = s->next) {
+        if(seed_is_expired(s)) {
+          seed_free(s);
+          break;
+        }
+      }
+    }
+    s = memb_alloc(&seed_memb);
+    if(s == NULL) {
+      return NULL;
+    }
+  }
+
+  memset(s, 0, sizeof(struct mpl_seed));
+  memcpy(&s->seed_id, id, sizeof(seed_id_t));
+  LIST_STRUCT_INIT(s, msgs);
+
+  trickle_timer_config(&s->tt, MPL_DATA_MESSAGE_IMIN, MPL_DATA_MESSAGE_IMAX,
+                       MPL_DATA_MESSAGE_K);
+  trickle_timer_set(&s->tt, data_timer_expired, s);
+
+  i = seed_hash(id);
+  s->next = seed_table[i];
+  seed_table[i] = s;
+
+  PRINTF("MPL: New seed ");
+  PRINT_SEED(&s->seed_id);
+  PRINTF(" in bucket %u\n", i);
+
+  return s;
+}
+/*---------------------------------------------------------------------------*/
+/* Free the messages at the head of the seed's list that are no longer
+ * retransmitted */
+static void
+seed_purge(struct mpl_seed *s)
+{
+  struct mpl_msg *m;
+
+  while((m = list_head(s->msgs)) != NULL && !MSG_IS_ACTIVE(m)) {
+    PRINTF("MPL: Free message %u\n", m->seq);
+    msg_free(m);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct mpl_msg *
+msg_lookup(struct mpl_seed *s, uint8_t seq)
+{
+  struct mpl_msg *m;
+
+  for(m = list_head(s->msgs); m != NULL; m = list_item_next(m)) {
+    if(SEQ_VAL_IS_EQ(m->seq, seq)) {
+      return m;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static struct mpl_msg *
+buffer_reclaim(void)
+{
+  struct mpl_seed *largest = NULL;
+  struct mpl_seed *s;
+  uint8_t i;
+
+  for(i = 0; i < MPL_SEED_SET_HASH_SIZE; i++) {
+    for(s = seed_table[i]; s != NULL; s = s->next) {
+      if(largest == NULL || s->count > largest->count) {
+        largest = s;
+      }
+    }
+  }
+
+  if(largest == NULL || largest->count == 0) {
+    /* oops */
+    return NULL;
+  }
+
+  PRINTF("MPL: Reclaim message %u from seed ",
+         ((struct mpl_msg *)list_head(largest->msgs))->seq);
+  PRINT_SEED(&largest->seed_id);
+  PRINTF(", count was %u\n", largest->count);
+
+  msg_free(list_head(largest->msgs));
+  MPL_STATS_ADD(buff_reclaim);
+
+  return memb_alloc(&msg_memb);
+}
+/*---------------------------------------------------------------------------*/
+/* Start retransmitting all of a seed's messages */
+static void
+seed_reactivate(struct mpl_seed *s)
+{
+  struct mpl_msg *m;
+
+  for(m = list_head(s->msgs); m != NULL; m = list_item_next(m)) {
+    m->e = 0;
+  }
+  trickle_timer_reset_event(&s->tt);
+}
+/*---------------------------------------------------------------------------*/
+static void
+control_reset(void)
+{
+#if MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS
+  control_e = 0;
+  trickle_timer_reset_event(&control_tt);
+#endif
+}
+/*---------------------------------------------------------------------------*/
+/* Trickle Timer Callbacks */
+/*---------------------------------------------------------------------------*/
+static void
+data_timer_expired(void *ptr, uint8_t suppress)
+{
+  struct mpl_seed *s = (struct mpl_seed *)ptr;
+  struct mpl_msg *m;
+  uint8_t active = 0;
+
+  /* Bail out pronto if our uIPv6 stack is not ready to send messages */
+  if(uip_ds6_get_link_local(ADDR_PREFERRED) == NULL) {
+    return;
+  }
+
+  for(m = list_head(s->msgs); m != NULL; m = list_item_next(m)) {
+    if(!MSG_IS_ACTIVE(m)) {
+      continue;
+    }
+
+    if(suppress == TRICKLE_TIMER_TX_OK && MSG_TTL(m) > 0) {
+      PRINTF("MPL: Periodic - Sending message from seed ");
+      PRINT_SEED(&s->seed_id);
+      PRINTF(" seq %u\n", m->seq);
+
+      /* Flag the most recent message we know of for this seed */
+      if(list_item_next(m) == NULL) {
+        MSG_OPT(m)->flags |= HBH_M_BIT;
+      } else {
+        MSG_OPT(m)->flags &= ~HBH_M_BIT;
+      }
+
+      uip_len = m->size;
+      memcpy(UIP_IP_BUF, m->buff, uip_len);
+
+      UIP_MCAST6_STATS_ADD(mcast_fwd);
+      UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, fwd);
+      tcpip_output(NULL);
+      watchdog_periodic();
+    }
+
+    m->e++;
+    if(MSG_IS_ACTIVE(m)) {
+      active = 1;
+    }
+  }
+
+  if(!trickle_timer_is_running(&control_tt)) {
+    /* Nobody will ask for these through control messages */
+    seed_purge(s);
+  }
+
+  if(!active) {
+    trickle_timer_stop(&s->tt);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+icmp_output(void)
+{
+  struct mpl_seed *s;
+  struct mpl_msg *m;
+  uint8_t *info;
+  uint8_t *bitmap;
+  uint8_t bm_len;
+  uint8_t id_len;
+  uint8_t bit;
+  uint8_t i;
+  uint16_t payload_len;
+
+  PRINTF("MPL: ICMPv6 Out\n");
+
+  uip_ext_len = 0;
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = MPL_IP_HOP_LIMIT;
+
+  info = UIP_ICMP_PAYLOAD;
+  payload_len = 0;
+
+  for(i = 0; i < MPL_SEED_SET_HASH_SIZE; i++) {
+    for(s = seed_table[i]; s != NULL; s = s->next) {
+      m = list_tail(s->msgs);
+      if(m == NULL) {
+        continue;
+      }
+
+      bm_len = ((uint8_t)(m->seq - s->min_seqno) >> 3) + 1;
+      if(bm_len > SEED_INFO_BM_LEN_MAX) {
+        bm_len = SEED_INFO_BM_LEN_MAX;
+      }
+      id_len = SEED_ID_LEN(s->seed_id.s);
+
+      if(UIP_IPH_LEN + UIP_ICMPH_LEN + payload_len + SEED_INFO_HDR_LEN +
+         id_len + bm_len > UIP_BUFSIZE - UIP_LLH_LEN) {
+        PRINTF("MPL: ICMPv6 Out - no room for more seeds\n");
+        break;
+      }
+
+      info[0] = s->min_seqno;
+      info[1] = (bm_len << 2) | s->seed_id.s;
+      memcpy(&info[SEED_INFO_HDR_LEN], s->seed_id.id, id_len);
+
+      bitmap = &info[SEED_INFO_HDR_LEN + id_len];
+      memset(bitmap, 0, bm_len);
+      for(m = list_head(s->msgs); m != NULL; m = list_item_next(m)) {
+        bit = m->seq - s->min_seqno;
+        if(bit < (bm_len << 3)) {
+          bitmap[bit >> 3] |= 0x80 >> (bit & 0x07);
+        }
+      }
+
+      PRINTF("MPL: ICMPv6 Out - Seed ");
+      PRINT_SEED(&s->seed_id);
+      PRINTF(" min %u, %u messages\n", s->min_seqno, s->count);
+
+      payload_len += SEED_INFO_HDR_LEN + id_len + bm_len;
+      info = bitmap + bm_len;
+    }
+  }
+
+  if(payload_len == 0) {
+    PRINTF("MPL: ICMPv6 Out - nothing to send\n");
+    return;
+  }
+
+  mpl_create_dest(&UIP_IP_BUF->destipaddr);
+  uip_ds6_select_src(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
+
+  UIP_IP_BUF->len[0] = (UIP_ICMPH_LEN + payload_len) >> 8;
+  UIP_IP_BUF->len[1] = (UIP_ICMPH_LEN + payload_len) & 0xff;
+
+  UIP_ICMP_BUF->type = ICMP6_MPL;
+  UIP_ICMP_BUF->icode = MPL_ICMP_CODE;
+
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  uip_len = UIP_IPH_LEN + UIP_ICMPH_LEN + payload_len;
+
+  tcpip_ipv6_output();
+  MPL_STATS_ADD(icmp_out);
+}
+/*---------------------------------------------------------------------------*/
+static void
+control_timer_expired(void *ptr, uint8_t suppress)
+{
+  struct mpl_seed *s;
+  uint8_t i;
+
+  if(uip_ds6_get_link_local(ADDR_PREFERRED) == NULL) {
+    return;
+  }
+
+  if(suppress == TRICKLE_TIMER_TX_OK) {
+    icmp_output();
+  }
+
+  control_e++;
+  if(control_e >= MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS) {
+    PRINTF("MPL: Control timer done\n");
+    trickle_timer_stop(&control_tt);
+    for(i = 0; i < MPL_SEED_SET_HASH_SIZE; i++) {
+      for(s = seed_table[i]; s != NULL; s = s->next) {
+        seed_purge(s);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Locate the MPL option in the datagram's Hop-by-Hop header */
+static struct hbho_mpl *
+option_lookup(void)
+{
+  uint8_t *opt;
+  uint16_t offset;
+  uint16_t end;
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_HBHO) {
+    return NULL;
+  }
+
+  end = (UIP_EXT_BUF->len << 3) + 8;
+  if(UIP_IPH_LEN + end > uip_len) {
+    return NULL;
+  }
+
+  for(offset = 2; offset < end;) {
+    opt = (uint8_t *)UIP_EXT_BUF + offset;
+    if(opt[0] == UIP_EXT_HDR_OPT_PAD1) {
+      offset++;
+    } else if(opt[0] == UIP_EXT_HDR_OPT_MPL) {
+      return (struct hbho_mpl *)opt;
+    } else {
+      offset += opt[1] + 2;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Processes an incoming or outgoing multicast message and determines
+ * whether it should be dropped or accepted
+ *
+ * \param in 1: Incoming packet, 0: Outgoing (we are the seed)
+ *
+ * \return 0: Drop, 1: Accept
+ */
+static uint8_t
+accept(uint8_t in)
+{
+  struct hbho_mpl *opt;
+  struct mpl_seed *s;
+  struct mpl_msg *m;
+  struct mpl_msg *prev;
+  struct mpl_msg *iter;
+  seed_id_t seed_id;
+
+  PRINTF("MPL: Multicast I/O\n");
+
+#if UIP_CONF_IPV6_CHECKS
+  if(uip_is_addr_mcast_non_routable(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("MPL: Mcast I/O, bad destination\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+  /*
+   * Abort transmission if the v6 src is unspecified. This may happen if the
+   * seed tries to TX while it's still performing DAD or waiting for a prefix
+   */
+  if(uip_is_addr_unspecified(&UIP_IP_BUF->srcipaddr)) {
+    PRINTF("MPL: Mcast I/O, bad source\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+#endif
+
+  opt = option_lookup();
+  if(opt == NULL) {
+    PRINTF("MPL: Mcast I/O, no MPL option\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+
+  /* Only version 0 of the option exists */
+  if((opt->flags & HBH_V_BIT) ||
+     opt->len != 2 + SEED_ID_WIRE_LEN(HBH_GET_S(opt))) {
+    PRINTF("MPL: Mcast I/O, bad option\n");
+    UIP_MCAST6_STATS_ADD(mcast_bad);
+    return UIP_MCAST6_DROP;
+  }
+
+  /* A datagram that arrives with a hop limit of 0 must not be buffered */
+  if(in == MPL_DGRAM_IN && UIP_IP_BUF->ttl == 0) {
+    PRINTF("MPL: Mcast I/O, hop limit 0\n");
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+  memset(&seed_id, 0, sizeof(seed_id));
+  if(HBH_GET_S(opt) == MPL_SEED_ID_TYPE_SRC) {
+    seed_id.s = MPL_SEED_ID_TYPE_128;
+    memcpy(seed_id.id, &UIP_IP_BUF->srcipaddr, sizeof(uip_ipaddr_t));
+  } else {
+    seed_id.s = HBH_GET_S(opt);
+    memcpy(seed_id.id, HBH_SEED_ID(opt), SEED_ID_LEN(seed_id.s));
+  }
+
+  PRINTF("MPL: Option S=%u, M=%u, seq %u, seed ", HBH_GET_S(opt),
+         (opt->flags & HBH_M_BIT) != 0, opt->seq);
+  PRINT_SEED(&seed_id);
+  PRINTF("\n");
+
+#if UIP_MCAST6_STATS
+  if(in == MPL_DGRAM_IN) {
+    UIP_MCAST6_STATS_ADD(mcast_in_all);
+  }
+#endif
+
+  s = seed_lookup(&seed_id);
+  if(s != NULL) {
+    if(SEQ_VAL_IS_LT(opt->seq, s->min_seqno)) {
+      PRINTF("MPL: Too old\n");
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
+    }
+    if(msg_lookup(s, opt->seq) != NULL) {
+      PRINTF("MPL: Seen before\n");
+      trickle_timer_consistency(&s->tt);
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
+    }
+  } else {
+    s = seed_allocate(&seed_id);
+    if(s == NULL) {
+      PRINTF("MPL: Failed to allocate seed\n");
+      UIP_MCAST6_STATS_ADD(mcast_dropped);
+      return UIP_MCAST6_DROP;
+    }
+    s->min_seqno = opt->seq;
+  }
+
+  PRINTF("MPL: New message\n");
+
+  m = memb_alloc(&msg_memb);
+  if(m == NULL) {
+    PRINTF("MPL: Buffer allocation failed, reclaiming\n");
+    m = buffer_reclaim();
+  }
+  if(m == NULL || SEQ_VAL_IS_LT(opt->seq, s->min_seqno)) {
+    /* No buffer, or the reclaim moved this seed's window past us */
+    PRINTF("MPL: Buffer reclaim failed\n");
+    if(m != NULL) {
+      memb_free(&msg_memb, m);
+    }
+    UIP_MCAST6_STATS_ADD(mcast_dropped);
+    return UIP_MCAST6_DROP;
+  }
+
+#if UIP_MCAST6_STATS
+  if(in == MPL_DGRAM_IN) {
+    UIP_MCAST6_STATS_ADD(mcast_in_unique);
+    UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, in);
+  }
+#endif
+
+  memset(m, 0, sizeof(struct mpl_msg) - sizeof(m->buff));
+  memcpy(m->buff, UIP_IP_BUF, uip_len);
+  m->size = uip_len;
+  m->opt_offset = (uint8_t *)opt - (uint8_t *)UIP_IP_BUF;
+  m->seq = opt->seq;
+  m->seed = s;
+
+  /* Keep the list sorted by sequence value */
+  prev = NULL;
+  for(iter = list_head(s->msgs); iter != NULL && SEQ_VAL_IS_LT(iter->seq, m->seq);
+      iter = list_item_next(iter)) {
+    prev = iter;
+  }
+  list_insert(s->msgs, prev, m);
+  s->count++;
+  s->expires = clock_seconds() + MPL_SEED_SET_ENTRY_LIFETIME;
+
+  PRINTF("MPL: Seed ");
+  PRINT_SEED(&s->seed_id);
+  PRINTF(" now has %u messages from %u\n", s->count, s->min_seqno);
+
+  /*
+   * If this is an incoming message, we need to decrement its TTL before we
+   * start forwarding it. Without proactive forwarding, it only gets sent when
+   * a control message tells us that a neighbour is missing it.
+   *
+   * If on the other hand we are the seed, the caller sends the message
+   * straight away and the trickle timer handles retransmissions
+   */
+  if(in == MPL_DGRAM_IN) {
+    MSG_TTL(m)--;
+#if !MPL_PROACTIVE_FORWARDING
+    m->e = MPL_DATA_MESSAGE_TIMER_EXPIRATIONS;
+#endif
+  }
+  if(MSG_IS_ACTIVE(m)) {
+    trickle_timer_reset_event(&s->tt);
+  }
+  control_reset();
+
+  return UIP_MCAST6_ACCEPT;
+}
+/*---------------------------------------------------------------------------*/
+/* MPL Control Message Input Handler */
+static void
+icmp_input(void)
+{
+  struct mpl_seed *s;
+  struct mpl_msg *m;
+  seed_id_t seed_id;
+  uint8_t *info;
+  uint8_t *end;
+  uint8_t *bitmap;
+  uint8_t min_seqno;
+  uint8_t bm_len;
+  uint8_t id_len;
+  uint8_t inconsistency;
+  uint8_t bit;
+  uint16_t i;
+
+#if UIP_CONF_IPV6_CHECKS
+  if(!uip_is_addr_linklocal(&UIP_IP_BUF->srcipaddr)) {
+    PRINTF("MPL: ICMPv6 In, bad source ");
+    PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
+    PRINTF(" to ");
+    PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+    PRINTF("\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+
+  if(UIP_ICMP_BUF->icode != MPL_ICMP_CODE) {
+    PRINTF("MPL: ICMPv6 In, bad ICMP code\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+
+  if(UIP_IP_BUF->ttl != MPL_IP_HOP_LIMIT) {
+    PRINTF("MPL: ICMPv6 In, bad TTL\n");
+    MPL_STATS_ADD(icmp_bad);
+    goto discard;
+  }
+#endif
+
+  PRINTF("MPL: ICMPv6 In from ");
+  PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
+  PRINTF(" len %u, ext %u\n", uip_len, uip_ext_len);
+
+  MPL_STATS_ADD(icmp_in);
+
+  inconsistency = 0;
+
+  for(i = 0; i < MPL_SEED_SET_HASH_SIZE; i++) {
+    for(s = seed_table[i]; s != NULL; s = s->next) {
+      s->flags &= ~SEED_L_BIT;
+    }
+  }
+
+  info = UIP_ICMP_PAYLOAD;
+  end = (uint8_t *)UIP_ICMP_PAYLOAD + uip_len - uip_l2_l3_icmp_hdr_len;
+  while(info + SEED_INFO_HDR_LEN <= end) {
+    min_seqno = info[0];
+    bm_len = SEED_INFO_GET_BM_LEN(info);
+    id_len = SEED_ID_WIRE_LEN(SEED_INFO_GET_S(info));
+
+    if(info + SEED_INFO_HDR_LEN + id_len + bm_len > end) {
+      PRINTF("MPL: ICMPv6 In, truncated seed info\n");
+      MPL_STATS_ADD(icmp_bad);
+      goto discard;
+    }
+
+    memset(&seed_id, 0, sizeof(seed_id));
+    if(SEED_INFO_GET_S(info) == MPL_SEED_ID_TYPE_SRC) {
+      seed_id.s = MPL_SEED_ID_TYPE_128;
+      memcpy(seed_id.id, &UIP_IP_BUF->srcipaddr, sizeof(uip_ipaddr_t));
+    } else {
+      seed_id.s = SEED_INFO_GET_S(info);
+      memcpy(seed_id.id, &info[SEED_INFO_HDR_LEN], id_len);
+    }
+    bitmap = &info[SEED_INFO_HDR_LEN + id_len];
+
+    PRINTF("MPL: ICMPv6 In, seed ");
+    PRINT_SEED(&seed_id);
+    PRINTF(" min %u, bm_len %u\n", min_seqno, bm_len);
+
+    s = seed_lookup(&seed_id);
+    if(s == NULL) {
+      /* They have messages we don't know of */
+      for(i = 0; i < bm_len; i++) {
+        if(bitmap[i]) {
+          PRINTF("MPL: Inconsistency - Seed unknown to us\n");
+          inconsistency = 1;
+          break;
+        }
+      }
+    } else {
+      s->flags |= SEED_L_BIT;
+
+      /* We have new: a message they are missing */
+      for(m = list_head(s->msgs); m != NULL; m = list_item_next(m)) {
+        if(SEQ_VAL_IS_LT(m->seq, min_seqno)) {
+          continue;
+        }
+        bit = m->seq - min_seqno;
+        if(bit >= (bm_len << 3) ||
+           (bitmap[bit >> 3] & (0x80 >> (bit & 0x07))) == 0) {
+          PRINTF("MPL: Inconsistency - They miss %u\n", m->seq);
+          m->e = 0;
+          trickle_timer_reset_event(&s->tt);
+          inconsistency = 1;
+        }
+      }
+
+      /* They have new: a message we are missing */
+      for(i = 0; i < (bm_len << 3); i++) {
+        if(bitmap[i >> 3] & (0x80 >> (i & 0x07))) {
+          bit = min_seqno + i;
+          if(!SEQ_VAL_IS_LT(bit, s->min_seqno) && msg_lookup(s, bit) == NULL) {
+            PRINTF("MPL: Inconsistency - We miss %u\n", bit);
+            inconsistency = 1;
+            break;
+          }
+        }
+      }
+    }
+
+    info = bitmap + bm_len;
+  }
+
+  /* Seeds they did not list at all: all our messages are new to them */
+  for(i = 0; i < MPL_SEED_SET_HASH_SIZE; i++) {
+    for(s = seed_table[i]; s != NULL; s = s->next) {
+      if(s->count > 0 && !(s->flags & SEED_L_BIT)) {
+        PRINTF("MPL: Inconsistency - Seed ");
+        PRINT_SEED(&s->seed_id);
+        PRINTF(" not listed\n");
+        seed_reactivate(s);
+        inconsistency = 1;
+      }
+    }
+  }
+
+  if(inconsistency) {
+    control_reset();
+  } else {
+    trickle_timer_consistency(&control_tt);
+  }
+
+discard:
+
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+static void
+out(void)
+{
+  struct hbho_mpl *opt;
+
+  if(uip_len + HBHO_TOTAL_LEN > UIP_BUFSIZE - UIP_LLH_LEN) {
+    PRINTF("MPL: Multicast Out can not add HBHO. Packet too long\n");
+    goto drop;
+  }
+
+  /* Slide 'right' by HBHO_TOTAL_LEN bytes */
+  memmove(UIP_EXT_BUF_NEXT, UIP_EXT_BUF, uip_len - UIP_IPH_LEN);
+  memset(UIP_EXT_BUF, 0, HBHO_TOTAL_LEN);
+
+  UIP_EXT_BUF->next = UIP_IP_BUF->proto;
+  UIP_EXT_BUF->len = 0;
+
+  opt = UIP_EXT_OPT_FIRST;
+  opt->type = UIP_EXT_HDR_OPT_MPL;
+
+  /* We are the seed: every message we send is the most recent one */
+  last_seq++;
+  opt->seq = last_seq;
+  opt->flags = (MPL_SEED_ID_TYPE << 6) | HBH_M_BIT;
+#if MPL_SEED_ID_TYPE == MPL_SEED_ID_TYPE_16
+  memcpy(HBH_SEED_ID(opt), &uip_lladdr.addr[UIP_LLADDR_LEN - 2], 2);
+  opt->len = HBHO_LEN_SEED_ID_16;
+#else
+  opt->len = HBHO_LEN_SEED_ID_SRC;
+  /* PadN */
+  HBH_SEED_ID(opt)[0] = UIP_EXT_HDR_OPT_PADN;
+  HBH_SEED_ID(opt)[1] = 0;
+#endif
+
+  uip_ext_len += HBHO_TOTAL_LEN;
+  uip_len += HBHO_TOTAL_LEN;
+
+  /* Update the proto and length field in the v6 header */
+  UIP_IP_BUF->proto = UIP_PROTO_HBHO;
+  UIP_IP_BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
+  UIP_IP_BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
+
+  PRINTF("MPL: Multicast Out, seq %u\n", opt->seq);
+
+  /*
+   * Buffer the message so that we advertise it in our control messages and
+   * retransmit it under the seed's trickle timer, then send it immediately.
+   * We then set uip_len = 0 to stop the core from re-sending it.
+   */
+  if(accept(MPL_DGRAM_OUT)) {
+    tcpip_output(NULL);
+    UIP_MCAST6_STATS_ADD(mcast_out);
+    UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, out);
+  }
+
+drop:
+  uip_slen = 0;
+  uip_clear_buf();
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+in(void)
+{
+  /*
+   * We call accept() which will sort out caching and forwarding. Depending
+   * on accept()'s return value, we then need to signal the core
+   * whether to deliver this to higher layers
+   */
+  if(accept(MPL_DGRAM_IN) == UIP_MCAST6_DROP) {
+    return UIP_MCAST6_DROP;
+  }
+
+  if(!uip_ds6_is_my_maddr(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("MPL: Not a group member. No further processing\n");
+    return UIP_MCAST6_DROP;
+  } else {
+    PRINTF("MPL: Ours. Deliver to upper layers\n");
+    UIP_MCAST6_STATS_ADD(mcast_in_ours);
+    return UIP_MCAST6_ACCEPT;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  uip_ipaddr_t all_mpl_forwarders;
+
+  PRINTF("MPL: RFC 7731, %u seeds, %u buffers\n",
+         MPL_SEED_SET_SIZE, MPL_BUFF_NUM);
+
+  memb_init(&seed_memb);
+  memb_init(&msg_memb);
+  memset(seed_table, 0, sizeof(seed_table));
+
+  /* Don't restart from the same sequence values after a reboot */
+  last_seq = random_rand();
+
+  MPL_STATS_INIT();
+  UIP_MCAST6_STATS_INIT(&stats);
+
+  /* Register the ICMPv6 input handler and join ALL_MPL_FORWARDERS */
+  uip_icmp6_register_input_handler(&mpl_icmp_handler);
+  mpl_create_dest(&all_mpl_forwarders);
+  if(uip_ds6_maddr_add(&all_mpl_forwarders) == NULL) {
+    PRINTF("MPL: Failed to join ALL_MPL_FORWARDERS\n");
+  }
+
+  /* The control timer only runs while there is something to advertise */
+  trickle_timer_config(&control_tt, MPL_CONTROL_MESSAGE_IMIN,
+                       MPL_CONTROL_MESSAGE_IMAX, MPL_CONTROL_MESSAGE_K);
+  trickle_timer_set(&control_tt, control_timer_expired, NULL);
+  trickle_timer_stop(&control_tt);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief The MPL engine driver
+ */
+const struct uip_mcast6_driver mpl_driver = {
+  "MPL",
+  init,
+  out,
+  in,
+};
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \addtogroup uip6-multicast
+ * @{
+ */
+/**
+ * \defgroup mpl-multicast Multicast Protocol for Low-Power and Lossy Networks
+ *
+ * IPv6 multicast according to RFC 7731, "Multicast Protocol for Low-Power
+ * and Lossy Networks (MPL)".
+ *
+ * Every node keeps a seed set: one entry per MPL seed it has heard from,
+ * holding the lowest sequence value it still accepts and the messages it
+ * has buffered for that seed. Seed entries are kept in a small hash table
+ * so that the duplicate check on each received datagram does not have to
+ * walk every entry. Buffered messages come from a shared pool and are
+ * retransmitted under a trickle timer kept per seed. A separate trickle
+ * timer drives MPL control messages, which advertise the contents of our
+ * buffer to neighbours so that they can recover messages they have missed.
+ *
+ * Unlike the RFC, datagrams are not tunneled: the MPL option is inserted
+ * into the seed's own datagram, as ROLL TM does with its trickle option.
+ * @{
+ */
+/**
+ * \file
+ *    Header file for the implementation of the MPL multicast engine
+ */
+
+#ifndef MPL_H_
+#define MPL_H_
+
+#include "contiki-conf.h"
+#include "net/ipv6/multicast/uip-mcast6-stats.h"
+
+#include <stdint.h>
+/*---------------------------------------------------------------------------*/
+/* Protocol Constants */
+/*---------------------------------------------------------------------------*/
+#define MPL_ICMP_CODE                  0   /**< MPL Control ICMPv6 code */
+#define MPL_IP_HOP_LIMIT            0xFF   /**< Hop limit for ICMP messages */
+#define MPL_DGRAM_OUT                  0
+#define MPL_DGRAM_IN                   1
+
+/* Seed ID lengths, as encoded in the S field */
+#define MPL_SEED_ID_TYPE_SRC           0   /**< Seed ID is the IPv6 source */
+#define MPL_SEED_ID_TYPE_16            1   /**< 16-bit Seed ID */
+#define MPL_SEED_ID_TYPE_64            2   /**< 64-bit Seed ID */
+#define MPL_SEED_ID_TYPE_128           3   /**< 128-bit Seed ID */
+/*---------------------------------------------------------------------------*/
+/* Trickle Parameters (RFC 7731, sec. 5.4) */
+/*---------------------------------------------------------------------------*/
+/*
+ * The RFC derives the default Imin from the expected link-layer latency.
+ * Imin values are in clock ticks, Imax values in number of doublings of Imin.
+ * As with ROLL TM, 500ms works well over ContikiMAC. Drop this to 125ms over
+ * NullRDC.
+ */
+#ifdef MPL_CONF_DATA_MESSAGE_IMIN
+#define MPL_DATA_MESSAGE_IMIN MPL_CONF_DATA_MESSAGE_IMIN
+#else
+#define MPL_DATA_MESSAGE_IMIN (CLOCK_SECOND / 2)
+#endif
+
+#ifdef MPL_CONF_DATA_MESSAGE_IMAX
+#define MPL_DATA_MESSAGE_IMAX MPL_CONF_DATA_MESSAGE_IMAX
+#else
+#define MPL_DATA_MESSAGE_IMAX 0 /* Imax = Imin */
+#endif
+
+#ifdef MPL_CONF_DATA_MESSAGE_K
+#define MPL_DATA_MESSAGE_K MPL_CONF_DATA_MESSAGE_K
+#else
+#define MPL_DATA_MESSAGE_K 1
+#endif
+
+/**
+ * Number of trickle intervals for which a buffered message is retransmitted
+ * after it was last found to be new to someone
+ */
+#ifdef MPL_CONF_DATA_MESSAGE_TIMER_EXPIRATIONS
+#define MPL_DATA_MESSAGE_TIMER_EXPIRATIONS MPL_CONF_DATA_MESSAGE_TIMER_EXPIRATIONS
+#else
+#define MPL_DATA_MESSAGE_TIMER_EXPIRATIONS 3
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_IMIN
+#define MPL_CONTROL_MESSAGE_IMIN MPL_CONF_CONTROL_MESSAGE_IMIN
+#else
+#define MPL_CONTROL_MESSAGE_IMIN (CLOCK_SECOND / 2)
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_IMAX
+#define MPL_CONTROL_MESSAGE_IMAX MPL_CONF_CONTROL_MESSAGE_IMAX
+#else
+#define MPL_CONTROL_MESSAGE_IMAX 9 /* Imax = 256 secs */
+#endif
+
+#ifdef MPL_CONF_CONTROL_MESSAGE_K
+#define MPL_CONTROL_MESSAGE_K MPL_CONF_CONTROL_MESSAGE_K
+#else
+#define MPL_CONTROL_MESSAGE_K 1
+#endif
+
+/**
+ * Number of trickle intervals for which control messages are sent after the
+ * last inconsistency. Messages that are no longer retransmitted stay in our
+ * buffer until then. Set to 0 to disable control messages altogether
+ * (proactive forwarding only)
+ */
+#ifdef MPL_CONF_CONTROL_MESSAGE_TIMER_EXPIRATIONS
+#define MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS MPL_CONF_CONTROL_MESSAGE_TIMER_EXPIRATIONS
+#else
+#define MPL_CONTROL_MESSAGE_TIMER_EXPIRATIONS 10
+#endif
+/*---------------------------------------------------------------------------*/
+/* Configuration */
+/*---------------------------------------------------------------------------*/
+/**
+ * Size of the seed set: how many seeds we can track at the same time. A seed
+ * that has no buffered messages left keeps its entry for
+ * MPL_SEED_SET_ENTRY_LIFETIME, after which the entry can be reused
+ */
+#ifdef MPL_CONF_SEED_SET_SIZE
+#define MPL_SEED_SET_SIZE MPL_CONF_SEED_SET_SIZE
+#else
+#define MPL_SEED_SET_SIZE 2
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Number of buckets in the seed set hash table. Must be a power of two
+ */
+#ifdef MPL_CONF_SEED_SET_HASH_SIZE
+#define MPL_SEED_SET_HASH_SIZE MPL_CONF_SEED_SET_HASH_SIZE
+#else
+#define MPL_SEED_SET_HASH_SIZE 4
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Seed set entry lifetime, in seconds
+ */
+#ifdef MPL_CONF_SEED_SET_ENTRY_LIFETIME
+#define MPL_SEED_SET_ENTRY_LIFETIME MPL_CONF_SEED_SET_ENTRY_LIFETIME
+#else
+#define MPL_SEED_SET_ENTRY_LIFETIME (30 * 60)
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Maximum Number of Buffered Multicast Messages
+ * This buffer is shared across all seeds. When it runs out, the oldest
+ * message of the seed holding the most buffers is reclaimed
+ */
+#ifdef MPL_CONF_BUFF_NUM
+#define MPL_BUFF_NUM MPL_CONF_BUFF_NUM
+#else
+#define MPL_BUFF_NUM 6
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Forward new messages straight away (1) or only when a control message
+ * tells us a neighbour is missing them (0)
+ */
+#ifdef MPL_CONF_PROACTIVE_FORWARDING
+#define MPL_PROACTIVE_FORWARDING MPL_CONF_PROACTIVE_FORWARDING
+#else
+#define MPL_PROACTIVE_FORWARDING 1
+#endif
+/*---------------------------------------------------------------------------*/
+/**
+ * Seed ID carried in the MPL option of datagrams we originate:
+ * MPL_SEED_ID_TYPE_SRC (default) elides it and uses the IPv6 source address,
+ * MPL_SEED_ID_TYPE_16 uses the last two bytes of our link-layer address.
+ * Incoming datagrams are accepted with any Seed ID length
+ */
+#ifdef MPL_CONF_SEED_ID_TYPE
+#define MPL_SEED_ID_TYPE MPL_CONF_SEED_ID_TYPE
+#else
+#define MPL_SEED_ID_TYPE MPL_SEED_ID_TYPE_SRC
+#endif
+/*---------------------------------------------------------------------------*/
+/* Stats datatype */
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Multicast stats extension for the MPL engine
+ */
+struct mpl_stats {
+  /** Number of received control messages */
+  UIP_MCAST6_STATS_DATATYPE icmp_in;
+
+  /** Number of control messages sent */
+  UIP_MCAST6_STATS_DATATYPE icmp_out;
+
+  /** Number of malformed control messages seen by us */
+  UIP_MCAST6_STATS_DATATYPE icmp_bad;
+
+  /** Number of buffered messages reclaimed before they expired */
+  UIP_MCAST6_STATS_DATATYPE buff_reclaim;
+
+  /** Number of seed set entries reclaimed or expired */
+  UIP_MCAST6_STATS_DATATYPE seed_expired;
+};
+/*---------------------------------------------------------------------------*/
+#endif /* MPL_H_ */
+/*---------------------------------------------------------------------------*/
+/** @} */
+/** @} */
@@ -627,6 +627,7 @@ handle_timer(void *ptr)
           memcpy(UIP_IP_BUF, &locmpptr->buff, uip_len);
 
           UIP_MCAST6_STATS_ADD(mcast_fwd);
+          UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, fwd);
           tcpip_output(NULL);
           MCAST_PACKET_SEND_CLR(locmpptr);
           watchdog_periodic();
@@ -1027,6 +1028,7 @@ accept(uint8_t in)
 #if UIP_MCAST6_STATS
   if(in == ROLL_TM_DGRAM_IN) {
     UIP_MCAST6_STATS_ADD(mcast_in_unique);
+    UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, in);
   }
 #endif
 
@@ -1379,6 +1381,7 @@ out()
   if(accept(ROLL_TM_DGRAM_OUT)) {
     tcpip_output(NULL);
     UIP_MCAST6_STATS_ADD(mcast_out);
+    UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, out);
   }
 
 drop:
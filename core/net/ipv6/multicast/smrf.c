@@ -132,12 +132,14 @@ in()
 
   UIP_MCAST6_STATS_ADD(mcast_in_all);
   UIP_MCAST6_STATS_ADD(mcast_in_unique);
+  UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, in);
 
   /* If we have an entry in the mcast routing table, something with
    * a higher RPL rank (somewhere down the tree) is a group member */
   if(uip_mcast6_route_lookup(&UIP_IP_BUF->destipaddr)) {
     /* If we enter here, we will definitely forward */
     UIP_MCAST6_STATS_ADD(mcast_fwd);
+    UIP_MCAST6_STATS_GROUP_ADD(&UIP_IP_BUF->destipaddr, fwd);
 
     /*
      * Add a delay (D) of at least SMRF_FWD_DELAY() to compensate for how
@@ -44,6 +44,7 @@
 #include "lib/list.h"
 #include "lib/memb.h"
 #include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6-route.h"
 
 #include <stdint.h>
@@ -56,19 +57,29 @@
 #else
 #define UIP_MCAST6_ROUTE_ROUTES 1
 #endif /* UIP_CONF_DS6_MCAST_ROUTES */
+
+/* Number of hash buckets for route lookups, must be a power of two */
+#ifdef UIP_MCAST6_ROUTE_CONF_HASH_NB
+#define UIP_MCAST6_ROUTE_HASH_NB UIP_MCAST6_ROUTE_CONF_HASH_NB
+#else
+#define UIP_MCAST6_ROUTE_HASH_NB 4
+#endif /* UIP_MCAST6_ROUTE_CONF_HASH_NB */
+
+#define route_bucket(g) \
+  (&route_hash[uip_ds6_mcast_hash((g), UIP_MCAST6_ROUTE_HASH_NB)])
 /*---------------------------------------------------------------------------*/
 LIST(mcast_route_list);
 MEMB(mcast_route_memb, uip_mcast6_route_t, UIP_MCAST6_ROUTE_ROUTES);
 
+static uip_mcast6_route_t *route_hash[UIP_MCAST6_ROUTE_HASH_NB];
 static uip_mcast6_route_t *locmcastrt;
 /*---------------------------------------------------------------------------*/
 uip_mcast6_route_t *
 uip_mcast6_route_lookup(uip_ipaddr_t *group)
 {
-  locmcastrt = NULL;
-  for(locmcastrt = list_head(mcast_route_list);
+  for(locmcastrt = *route_bucket(group);
       locmcastrt != NULL;
-      locmcastrt = list_item_next(locmcastrt)) {
+      locmcastrt = locmcastrt->hash_next) {
     if(uip_ipaddr_cmp(&locmcastrt->group, group)) {
       return locmcastrt;
     }
@@ -89,23 +100,28 @@ uip_mcast6_route_add(uip_ipaddr_t *group)
       return NULL;
     }
     list_add(mcast_route_list, locmcastrt);
+
+    uip_ipaddr_copy(&(locmcastrt->group), group);
+    locmcastrt->hash_next = *route_bucket(group);
+    *route_bucket(group) = locmcastrt;
   }
 
   /* Reaching here means we either found the prefix or allocated a new one */
 
-  uip_ipaddr_copy(&(locmcastrt->group), group);
-
   return locmcastrt;
 }
 /*---------------------------------------------------------------------------*/
 void
 uip_mcast6_route_rm(uip_mcast6_route_t *route)
 {
-  /* Make sure it's actually in the list */
-  for(locmcastrt = list_head(mcast_route_list);
-      locmcastrt != NULL;
-      locmcastrt = list_item_next(locmcastrt)) {
-    if(locmcastrt == route) {
+  uip_mcast6_route_t **prev;
+
+  /* Make sure it's actually in the table */
+  for(prev = route_bucket(&route->group);
+      *prev != NULL;
+      prev = &(*prev)->hash_next) {
+    if(*prev == route) {
+      *prev = route->hash_next;
       list_remove(mcast_route_list, route);
       memb_free(&mcast_route_memb, route);
       return;
@@ -130,6 +146,7 @@ uip_mcast6_route_init()
 {
   memb_init(&mcast_route_memb);
   list_init(mcast_route_list);
+  memset(route_hash, 0, sizeof(route_hash));
 }
 /*---------------------------------------------------------------------------*/
 /** @} */
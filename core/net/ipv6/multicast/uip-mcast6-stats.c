@@ -38,16 +38,66 @@
  * \author
  *    George Oikonomou - <oikonomou@users.sourceforge.net>
  */
+#include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6-stats.h"
 
 #include <string.h>
 /*---------------------------------------------------------------------------*/
 uip_mcast6_stats_t uip_mcast6_stats;
+
+#if UIP_MCAST6_STATS
+/* Open addressing, linear probing. Entries are never removed */
+static uip_mcast6_group_stats_t group_stats[UIP_MCAST6_STATS_GROUPS];
+/*---------------------------------------------------------------------------*/
+static uip_mcast6_group_stats_t *
+group_find(const uip_ipaddr_t *group, uint8_t add)
+{
+  uint8_t i;
+  uint8_t slot;
+
+  slot = uip_ds6_mcast_hash(group, UIP_MCAST6_STATS_GROUPS);
+  for(i = 0; i < UIP_MCAST6_STATS_GROUPS; i++) {
+    if(uip_ipaddr_cmp(&group_stats[slot].group, group)) {
+      return &group_stats[slot];
+    }
+    if(uip_is_addr_unspecified(&group_stats[slot].group)) {
+      if(add) {
+        uip_ipaddr_copy(&group_stats[slot].group, group);
+        return &group_stats[slot];
+      }
+      return NULL;
+    }
+    slot = (slot + 1) & (UIP_MCAST6_STATS_GROUPS - 1);
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+uip_mcast6_group_stats_t *
+uip_mcast6_stats_group_lookup(const uip_ipaddr_t *group)
+{
+  return group_find(group, 0);
+}
+/*---------------------------------------------------------------------------*/
+uip_mcast6_group_stats_t *
+uip_mcast6_stats_group_add(const uip_ipaddr_t *group)
+{
+  return group_find(group, 1);
+}
+/*---------------------------------------------------------------------------*/
+uip_mcast6_group_stats_t *
+uip_mcast6_stats_groups(void)
+{
+  return group_stats;
+}
+#endif /* UIP_MCAST6_STATS */
 /*---------------------------------------------------------------------------*/
 void
 uip_mcast6_stats_init(void *stats)
 {
   memset(&uip_mcast6_stats, 0, sizeof(uip_mcast6_stats));
+#if UIP_MCAST6_STATS
+  memset(group_stats, 0, sizeof(group_stats));
+#endif
   uip_mcast6_stats.engine_stats = stats;
 }
 /*---------------------------------------------------------------------------*/
@@ -42,6 +42,7 @@
 #define UIP_MCAST6_STATS_H_
 /*---------------------------------------------------------------------------*/
 #include "contiki-conf.h"
+#include "net/ip/uip.h"
 
 #include <stdint.h>
 /*---------------------------------------------------------------------------*/
@@ -58,6 +59,17 @@
 #define UIP_MCAST6_STATS 0
 #endif
 /*---------------------------------------------------------------------------*/
+/**
+ * Number of multicast groups for which we keep separate counters. Must be a
+ * power of two. Groups seen once the table is full are only accounted for in
+ * the global counters
+ */
+#ifdef UIP_MCAST6_STATS_CONF_GROUPS
+#define UIP_MCAST6_STATS_GROUPS UIP_MCAST6_STATS_CONF_GROUPS
+#else
+#define UIP_MCAST6_STATS_GROUPS 4
+#endif
+/*---------------------------------------------------------------------------*/
 /* Stats datatype */
 /*---------------------------------------------------------------------------*/
 /**
@@ -90,6 +102,23 @@ typedef struct uip_mcast6_stats {
   /** Opaque pointer to an engine's additional stats */
   void *engine_stats;
 } uip_mcast6_stats_t;
+
+/**
+ * \brief Per-group multicast counters
+ */
+typedef struct uip_mcast6_group_stats {
+  /** The multicast group. Unspecified if the entry is not in use */
+  uip_ipaddr_t group;
+
+  /** Count of unique datagrams received for this group */
+  UIP_MCAST6_STATS_DATATYPE in;
+
+  /** Count of datagrams for this group forwarded by us */
+  UIP_MCAST6_STATS_DATATYPE fwd;
+
+  /** Count of datagrams for this group originated by us */
+  UIP_MCAST6_STATS_DATATYPE out;
+} uip_mcast6_group_stats_t;
 /*---------------------------------------------------------------------------*/
 /* Access macros */
 /*---------------------------------------------------------------------------*/
@@ -100,10 +129,17 @@ extern uip_mcast6_stats_t uip_mcast6_stats;
 #define UIP_MCAST6_STATS_ADD(x) uip_mcast6_stats.x++
 #define UIP_MCAST6_STATS_GET(x) uip_mcast6_stats.x
 #define UIP_MCAST6_STATS_INIT(s) uip_mcast6_stats_init(s)
+#define UIP_MCAST6_STATS_GROUP_ADD(g, x) do { \
+  uip_mcast6_group_stats_t *uip_mcast6_gs = uip_mcast6_stats_group_add(g); \
+  if(uip_mcast6_gs != NULL) { \
+    uip_mcast6_gs->x++; \
+  } \
+} while(0)
 #else /* UIP_MCAST6_STATS */
 #define UIP_MCAST6_STATS_ADD(x)
 #define UIP_MCAST6_STATS_GET(x) 0
 #define UIP_MCAST6_STATS_INIT(s)
+#define UIP_MCAST6_STATS_GROUP_ADD(g, x)
 #endif /* UIP_MCAST6_STATS */
 /*---------------------------------------------------------------------------*/
 /**
@@ -111,6 +147,31 @@ extern uip_mcast6_stats_t uip_mcast6_stats;
  * \param stats A pointer to a struct holding an engine's additional statistics
  */
 void uip_mcast6_stats_init(void *stats);
+
+/* Per-group counters, only available when UIP_MCAST6_STATS is enabled */
+/**
+ * \brief Retrieve the counters for a multicast group
+ * \param group The multicast group
+ * \return A pointer to the group's counters, or NULL if we keep none
+ */
+uip_mcast6_group_stats_t *uip_mcast6_stats_group_lookup(const uip_ipaddr_t *group);
+
+/**
+ * \brief Retrieve the counters for a multicast group, allocating them if
+ *        this is the first time we see the group
+ * \param group The multicast group
+ * \return A pointer to the group's counters, or NULL if the table is full
+ *
+ * Engines should not call this directly, use UIP_MCAST6_STATS_GROUP_ADD()
+ */
+uip_mcast6_group_stats_t *uip_mcast6_stats_group_add(const uip_ipaddr_t *group);
+
+/**
+ * \brief Retrieve the per-group counters table
+ * \return A pointer to an array of #UIP_MCAST6_STATS_GROUPS entries. Entries
+ *         not in use have an unspecified group address
+ */
+uip_mcast6_group_stats_t *uip_mcast6_stats_groups(void);
 /*---------------------------------------------------------------------------*/
 #endif /* UIP_MCAST6_STATS_H_ */
 /*---------------------------------------------------------------------------*/
@@ -212,8 +212,9 @@ uip_ds6_route_num_routes(void)
   return num_routes;
 }
 /*---------------------------------------------------------------------------*/
-uip_ds6_route_t *
-uip_ds6_route_lookup(uip_ipaddr_t *addr)
+/* Longest prefix match in the given table, or in all tables if table < 0 */
+static uip_ds6_route_t *
+route_lookup(int table, uip_ipaddr_t *addr)
 {
   uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
@@ -230,6 +231,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
       r != NULL;
       r = uip_ds6_route_next(r)) {
     if(r->length >= longestmatch &&
+       (table < 0 || r->table == table) &&
        uip_ipaddr_prefixcmp(addr, &r->ipaddr, r->length)) {
       longestmatch = r->length;
       found_route = r;
@@ -264,8 +266,28 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
 }
 /*---------------------------------------------------------------------------*/
 uip_ds6_route_t *
+uip_ds6_route_lookup(uip_ipaddr_t *addr)
+{
+  return route_lookup(-1, addr);
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_lookup_table(uint16_t table, uip_ipaddr_t *addr)
+{
+  return route_lookup(table, addr);
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
 uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 		  uip_ipaddr_t *nexthop)
+{
+  return uip_ds6_route_add_table(UIP_DS6_ROUTE_DEFAULT_TABLE,
+                                 ipaddr, length, nexthop);
+}
+/*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+uip_ds6_route_add_table(uint16_t table, uip_ipaddr_t *ipaddr, uint8_t length,
+                        uip_ipaddr_t *nexthop)
 {
   uip_ds6_route_t *r;
   struct uip_ds6_route_neighbor_route *nbrr;
@@ -286,7 +308,7 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
   /* First make sure that we don't add a route twice. If we find an
      existing route for our destination, we'll delete the old
      one first. */
-  r = uip_ds6_route_lookup(ipaddr);
+  r = route_lookup(table, ipaddr);
   if(r != NULL) {
     uip_ipaddr_t *current_nexthop;
     current_nexthop = uip_ds6_route_nexthop(r);
@@ -387,6 +409,7 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+  r->table = table;
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -92,6 +92,13 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB UIP_CONF_MAX_ROUTES
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/** \brief Routes are kept in separate tables, identified by a table
+ *  number. Routes added with uip_ds6_route_add() go to the default
+ *  table; ContikiRPL keeps one table per RPL instance, numbered by the
+ *  RPLInstanceID. uip_ds6_route_lookup() searches all tables. The
+ *  default table lies outside the range of RPLInstanceIDs. */
+#define UIP_DS6_ROUTE_DEFAULT_TABLE 0x100
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
@@ -125,6 +132,7 @@ typedef struct uip_ds6_route {
   UIP_DS6_ROUTE_STATE_TYPE state;
 #endif
   uint8_t length;
+  uint16_t table;
 } uip_ds6_route_t;
 
 /** \brief A neighbor route list entry, used on the
@@ -159,6 +167,11 @@ void uip_ds6_defrt_periodic(void);
 uip_ds6_route_t *uip_ds6_route_lookup(uip_ipaddr_t *destipaddr);
 uip_ds6_route_t *uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
                                    uip_ipaddr_t *next_hop);
+uip_ds6_route_t *uip_ds6_route_lookup_table(uint16_t table,
+                                           uip_ipaddr_t *destipaddr);
+uip_ds6_route_t *uip_ds6_route_add_table(uint16_t table, uip_ipaddr_t *ipaddr,
+                                        uint8_t length,
+                                        uip_ipaddr_t *next_hop);
 void uip_ds6_route_rm(uip_ds6_route_t *route);
 void uip_ds6_route_rm_by_nexthop(uip_ipaddr_t *nexthop);
 
@@ -70,6 +70,9 @@ static uint8_t rscount;                                         /**< number of r
 /** @{ */
 uip_ds6_netif_t uip_ds6_if;                                     /**< The single interface */
 uip_ds6_prefix_t uip_ds6_prefix_list[UIP_DS6_PREFIX_NB];        /**< Prefix list */
+#if UIP_DS6_MADDR_NB
+static uip_ds6_maddr_t *maddr_hash[UIP_DS6_MADDR_HASH_NB];      /**< Multicast address lookup */
+#endif /* UIP_DS6_MADDR_NB */
 
 /* Used by Cooja to enable extraction of addresses from memory.*/
 uint8_t uip_ds6_addr_size;
@@ -102,6 +105,9 @@ uip_ds6_init(void)
      UIP_DS6_ADDR_NB, UIP_DS6_MADDR_NB, UIP_DS6_AADDR_NB);
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
+#if UIP_DS6_MADDR_NB
+  memset(maddr_hash, 0, sizeof(maddr_hash));
+#endif /* UIP_DS6_MADDR_NB */
   uip_ds6_addr_size = sizeof(struct uip_ds6_addr);
   uip_ds6_netif_addr_list_offset = offsetof(struct uip_ds6_netif, addr_list);
 
@@ -421,13 +427,21 @@ uip_ds6_get_global(int8_t state)
 uip_ds6_maddr_t *
 uip_ds6_maddr_add(const uip_ipaddr_t *ipaddr)
 {
-  if(uip_ds6_list_loop
-     ((uip_ds6_element_t *)uip_ds6_if.maddr_list, UIP_DS6_MADDR_NB,
-      sizeof(uip_ds6_maddr_t), (void*)ipaddr, 128,
-      (uip_ds6_element_t **)&locmaddr) == FREESPACE) {
-    locmaddr->isused = 1;
-    uip_ipaddr_copy(&locmaddr->ipaddr, ipaddr);
-    return locmaddr;
+  uint8_t bucket;
+
+  if(uip_ds6_maddr_lookup(ipaddr) != NULL) {
+    return NULL;
+  }
+  for(locmaddr = uip_ds6_if.maddr_list;
+      locmaddr < uip_ds6_if.maddr_list + UIP_DS6_MADDR_NB; locmaddr++) {
+    if(!locmaddr->isused) {
+      locmaddr->isused = 1;
+      uip_ipaddr_copy(&locmaddr->ipaddr, ipaddr);
+      bucket = uip_ds6_mcast_hash(ipaddr, UIP_DS6_MADDR_HASH_NB);
+      locmaddr->next = maddr_hash[bucket];
+      maddr_hash[bucket] = locmaddr;
+      return locmaddr;
+    }
   }
   return NULL;
 }
@@ -436,7 +450,17 @@ uip_ds6_maddr_add(const uip_ipaddr_t *ipaddr)
 void
 uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 {
-  if(maddr != NULL) {
+  uip_ds6_maddr_t **prev;
+
+  if(maddr != NULL && maddr->isused) {
+    for(prev = &maddr_hash[uip_ds6_mcast_hash(&maddr->ipaddr,
+                                              UIP_DS6_MADDR_HASH_NB)];
+        *prev != NULL; prev = &(*prev)->next) {
+      if(*prev == maddr) {
+        *prev = maddr->next;
+        break;
+      }
+    }
     maddr->isused = 0;
   }
   return;
@@ -446,11 +470,11 @@ uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 uip_ds6_maddr_t *
 uip_ds6_maddr_lookup(const uip_ipaddr_t *ipaddr)
 {
-  if(uip_ds6_list_loop
-     ((uip_ds6_element_t *)uip_ds6_if.maddr_list, UIP_DS6_MADDR_NB,
-      sizeof(uip_ds6_maddr_t), (void*)ipaddr, 128,
-      (uip_ds6_element_t **)&locmaddr) == FOUND) {
-    return locmaddr;
+  for(locmaddr = maddr_hash[uip_ds6_mcast_hash(ipaddr, UIP_DS6_MADDR_HASH_NB)];
+      locmaddr != NULL; locmaddr = locmaddr->next) {
+    if(uip_ipaddr_cmp(&locmaddr->ipaddr, ipaddr)) {
+      return locmaddr;
+    }
   }
   return NULL;
 }
@@ -98,6 +98,13 @@
 #endif
 #define UIP_DS6_MADDR_NB UIP_DS6_MADDR_NBS + UIP_DS6_MADDR_NBU
 
+/* Multicast address lookup hash buckets, must be a power of two */
+#ifndef UIP_CONF_DS6_MADDR_HASH_NB
+#define UIP_DS6_MADDR_HASH_NB 4
+#else
+#define UIP_DS6_MADDR_HASH_NB UIP_CONF_DS6_MADDR_HASH_NB
+#endif
+
 /* Anycast address list */
 #if UIP_CONF_ROUTER
 #define UIP_DS6_AADDR_NBS UIP_DS6_PREFIX_NB - 1 /* One per non link local prefix (subnet prefix anycast address) */
@@ -192,8 +199,17 @@ typedef struct uip_ds6_aaddr {
 typedef struct uip_ds6_maddr {
   uint8_t isused;
   uip_ipaddr_t ipaddr;
+  struct uip_ds6_maddr *next; /**< Next address in the same hash bucket */
 } uip_ds6_maddr_t;
 
+/**
+ * \brief Hash bucket of multicast group a in a table of n buckets, n being a
+ * power of two. Groups mostly differ in the low-order bytes of their Group ID
+ * and in their scope
+ */
+#define uip_ds6_mcast_hash(a, n) \
+  (((a)->u8[1] ^ (a)->u8[13] ^ (a)->u8[14] ^ (a)->u8[15]) & ((n) - 1))
+
 /* only define the callback if RPL is active */
 #if UIP_CONF_IPV6_RPL
 #ifndef UIP_CONF_DS6_NEIGHBOR_STATE_CHANGED
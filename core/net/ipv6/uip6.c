@@ -898,6 +898,14 @@ ext_hdr_options_process(void)
 #endif /* UIP_CONF_IPV6_RPL */
         uip_ext_opt_offset += (UIP_EXT_HDR_OPT_BUF->len) + 2;
         return 0;
+#if UIP_CONF_IPV6_MPL
+      case UIP_EXT_HDR_OPT_MPL:
+        /* The multicast engine processes the option itself. Without it, the
+         * option type tells us to discard the packet (default case) */
+        PRINTF("Processing MPL option\n");
+        uip_ext_opt_offset += UIP_EXT_HDR_OPT_BUF->len + 2;
+        break;
+#endif /* UIP_CONF_IPV6_MPL */
       default:
         /*
          * check the two highest order bits of the option
@@ -1367,6 +1375,23 @@ uip_process(uint8_t flag)
 
         PRINTF("Processing Routing header\n");
         if(UIP_ROUTING_BUF->seg_left > 0) {
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+          if(rpl_process_srh_header()) {
+            /* The destination is now the next hop of the source route */
+            if(UIP_IP_BUF->ttl <= 1) {
+              uip_icmp6_error_output(ICMP6_TIME_EXCEEDED,
+                                     ICMP6_TIME_EXCEED_TRANSIT, 0);
+              UIP_STAT(++uip_stat.ip.drop);
+              goto send;
+            }
+            UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+            PRINTF("Forwarding source routed packet to ");
+            PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+            PRINTF("\n");
+            UIP_STAT(++uip_stat.ip.forwarded);
+            goto send;
+          }
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
           uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, UIP_IPH_LEN + uip_ext_len + 2);
           UIP_STAT(++uip_stat.ip.drop);
           UIP_LOG("ip6: unrecognized routing type");
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Per-neighbor link statistics (ETX, RSSI, freshness, counters),
+ *         fed by the MAC layer and shared by the upper layers.
+ */
+
+#include "contiki.h"
+#include "sys/ctimer.h"
+#include "net/mac/mac.h"
+#include "net/nbr-table.h"
+#include "net/packetbuf.h"
+#include "net/link-stats.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else /* DEBUG */
+#define PRINTF(...)
+#endif /* DEBUG */
+
+/* ETX of a frame that was never acknowledged */
+#ifdef LINK_STATS_CONF_ETX_NOACK_PENALTY
+#define ETX_NOACK_PENALTY LINK_STATS_CONF_ETX_NOACK_PENALTY
+#else /* LINK_STATS_CONF_ETX_NOACK_PENALTY */
+#define ETX_NOACK_PENALTY 10
+#endif /* LINK_STATS_CONF_ETX_NOACK_PENALTY */
+
+/* Weight of the history in the moving averages, in percent. A lower
+   weight is used until the statistics are fresh, so that a new link
+   converges quickly and a known link stays steady. */
+#define EWMA_SCALE           100
+#define EWMA_ALPHA           90
+#define EWMA_BOOTSTRAP_ALPHA 70
+
+/* Statistics are fresh after FRESHNESS_TARGET transmissions, as long as
+   the last one is more recent than FRESHNESS_EXPIRATION_TIME */
+#define FRESHNESS_TARGET          4
+#define FRESHNESS_MAX             16
+#define FRESHNESS_EXPIRATION_TIME (10 * 60 * (clock_time_t)CLOCK_SECOND)
+/* Freshness is halved every FRESHNESS_HALF_LIFE */
+#define FRESHNESS_HALF_LIFE       (20 * 60 * (clock_time_t)CLOCK_SECOND)
+
+NBR_TABLE(struct link_stats, link_stats);
+
+static struct ctimer periodic_timer;
+static uint8_t initialized;
+
+/*---------------------------------------------------------------------------*/
+static struct link_stats *
+get_or_add(const linkaddr_t *lladdr)
+{
+  struct link_stats *stats;
+
+  if(lladdr == NULL || linkaddr_cmp(lladdr, &linkaddr_null)) {
+    return NULL;
+  }
+  stats = nbr_table_get_from_lladdr(link_stats, lladdr);
+  if(stats == NULL) {
+    stats = nbr_table_add_lladdr(link_stats, lladdr);
+    if(stats != NULL) {
+      stats->last_tx_time = 0;
+      stats->etx = LINK_STATS_INIT_ETX * LINK_STATS_ETX_DIVISOR;
+      stats->rssi = 0;
+      stats->tx_count = 0;
+      stats->ack_count = 0;
+      stats->rx_count = 0;
+      stats->freshness = 0;
+    }
+  }
+  return stats;
+}
+/*---------------------------------------------------------------------------*/
+const struct link_stats *
+link_stats_from_lladdr(const linkaddr_t *lladdr)
+{
+  return nbr_table_get_from_lladdr(link_stats, lladdr);
+}
+/*---------------------------------------------------------------------------*/
+int
+link_stats_is_fresh(const struct link_stats *stats)
+{
+  return stats != NULL
+    && stats->freshness >= FRESHNESS_TARGET
+    && clock_time() - stats->last_tx_time < FRESHNESS_EXPIRATION_TIME;
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx)
+{
+  struct link_stats *stats;
+  uint16_t packet_etx;
+  uint8_t alpha;
+
+  if(status != MAC_TX_OK && status != MAC_TX_NOACK) {
+    /* Collisions and errors say nothing about the link */
+    return;
+  }
+
+  stats = get_or_add(lladdr);
+  if(stats == NULL) {
+    return;
+  }
+
+  packet_etx = (status == MAC_TX_NOACK ? ETX_NOACK_PENALTY : numtx)
+    * LINK_STATS_ETX_DIVISOR;
+  if(stats->tx_count == 0) {
+    /* First transmission: no history to average with */
+    stats->etx = packet_etx;
+  } else {
+    alpha = link_stats_is_fresh(stats) ? EWMA_ALPHA : EWMA_BOOTSTRAP_ALPHA;
+    stats->etx = ((uint32_t)stats->etx * alpha +
+                  (uint32_t)packet_etx * (EWMA_SCALE - alpha)) / EWMA_SCALE;
+  }
+
+  stats->last_tx_time = clock_time();
+  if(stats->freshness < FRESHNESS_MAX) {
+    stats->freshness++;
+  }
+  stats->tx_count++;
+  if(status == MAC_TX_OK) {
+    stats->ack_count++;
+  }
+
+  PRINTF("link-stats: %u sent, status %d numtx %d, etx %u.%02u\n",
+         lladdr->u8[LINKADDR_SIZE - 1], status, numtx,
+         stats->etx / LINK_STATS_ETX_DIVISOR,
+         (stats->etx % LINK_STATS_ETX_DIVISOR) * 100 / LINK_STATS_ETX_DIVISOR);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_input_callback(const linkaddr_t *lladdr)
+{
+  struct link_stats *stats;
+  int16_t packet_rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+
+  stats = get_or_add(lladdr);
+  if(stats == NULL) {
+    return;
+  }
+
+  if(stats->rx_count == 0) {
+    stats->rssi = packet_rssi;
+  } else {
+    stats->rssi = ((int32_t)stats->rssi * EWMA_ALPHA +
+                   (int32_t)packet_rssi * (EWMA_SCALE - EWMA_ALPHA)) / EWMA_SCALE;
+  }
+  stats->rx_count++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+periodic(void *ptr)
+{
+  struct link_stats *stats;
+
+  /* Age the freshness of all neighbors */
+  for(stats = nbr_table_head(link_stats); stats != NULL;
+      stats = nbr_table_next(link_stats, stats)) {
+    stats->freshness >>= 1;
+  }
+  ctimer_reset(&periodic_timer);
+}
+/*---------------------------------------------------------------------------*/
+void
+link_stats_init(void)
+{
+  /* Called by every MAC protocol at init time */
+  if(!initialized) {
+    initialized = 1;
+    nbr_table_register(link_stats, NULL);
+    ctimer_set(&periodic_timer, FRESHNESS_HALF_LIFE, periodic, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Per-neighbor link statistics (ETX, RSSI, freshness, counters),
+ *         fed by the MAC layer and shared by the upper layers.
+ */
+
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/* ETX fixed point divisor. 256 matches RPL_DAG_MC_ETX_DIVISOR, so that
+   RPL can use the ETX as link metric without conversion. */
+#define LINK_STATS_ETX_DIVISOR 256
+
+/* ETX of a neighbor we have not transmitted to yet */
+#ifdef LINK_STATS_CONF_INIT_ETX
+#define LINK_STATS_INIT_ETX LINK_STATS_CONF_INIT_ETX
+#else /* LINK_STATS_CONF_INIT_ETX */
+#define LINK_STATS_INIT_ETX 2
+#endif /* LINK_STATS_CONF_INIT_ETX */
+
+/* Statistics of one neighbor */
+struct link_stats {
+  clock_time_t last_tx_time;  /* Time of the last transmission */
+  uint16_t etx;               /* ETX, fixed point with LINK_STATS_ETX_DIVISOR */
+  int16_t rssi;               /* Average RSSI of the received frames */
+  uint16_t tx_count;          /* Transmissions that got a final status */
+  uint16_t ack_count;         /* Transmissions that were acknowledged */
+  uint16_t rx_count;          /* Received frames */
+  uint8_t freshness;          /* Recent transmissions, halved periodically */
+};
+
+/* Returns the statistics of a neighbor, or NULL if it has none */
+const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
+/* Are the statistics recent enough to be trusted? */
+int link_stats_is_fresh(const struct link_stats *stats);
+
+/* Called by the MAC layer with the final status of a unicast frame */
+void link_stats_packet_sent(const linkaddr_t *lladdr, int status, int numtx);
+/* Called by the MAC layer for every received frame, from packetbuf */
+void link_stats_input_callback(const linkaddr_t *lladdr);
+
+/* Initializes the module. Called by the MAC protocols, may be called
+   more than once. */
+void link_stats_init(void);
+
+#endif /* LINK_STATS_H_ */
@@ -41,6 +41,7 @@
 #include "llsec/ccm-star-packetbuf.h"
 #include "net/linkaddr.h"
 #include "net/packetbuf.h"
+#include "lib/aes-128.h"
 #include <string.h>
 
 /*---------------------------------------------------------------------------*/
@@ -76,3 +77,33 @@ ccm_star_packetbuf_set_nonce(uint8_t *nonce, int forward)
   nonce[12] = packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL);
 }
 /*---------------------------------------------------------------------------*/
+int
+ccm_star_packetbuf_aead(uint8_t hdrlen, int with_encryption,
+    uint8_t mic_len, int forward)
+{
+  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+  uint8_t generated_mic[AES_128_BLOCK_SIZE];
+  uint8_t *a;
+  uint8_t *mic;
+  uint8_t totlen;
+  uint8_t a_len;
+
+  ccm_star_packetbuf_set_nonce(nonce, forward);
+  totlen = packetbuf_totlen();
+  a = packetbuf_hdrptr();
+  a_len = with_encryption ? hdrlen : totlen;
+  mic = a + totlen;
+
+  CCM_STAR.aead(nonce,
+      a + a_len, totlen - a_len,
+      a, a_len,
+      forward ? mic : generated_mic, mic_len,
+      forward);
+
+  if(forward) {
+    packetbuf_set_datalen(packetbuf_datalen() + mic_len);
+    return 1;
+  }
+  return memcmp(generated_mic, mic, mic_len) == 0;
+}
+/*---------------------------------------------------------------------------*/
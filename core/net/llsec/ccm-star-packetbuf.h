@@ -45,4 +45,16 @@
 
 void ccm_star_packetbuf_set_nonce(uint8_t *nonce, int forward);
 
+/**
+ * \brief                 Runs CCM* in place over the frame in the packetbuf
+ * \param hdrlen          Length of the frame header, which is authenticated
+ * \param with_encryption Whether the frame payload is encrypted, too
+ * \param mic_len         Length of the MIC that follows the frame
+ * \param forward         != 0 to secure an outgoing frame, in which case the
+ *                        MIC gets appended to the packetbuf data
+ * \retval 0              The MIC of an incoming frame is not authentic
+ */
+int ccm_star_packetbuf_aead(uint8_t hdrlen, int with_encryption,
+    uint8_t mic_len, int forward);
+
 #endif /* CCM_STAR_PACKETBUF_H_ */
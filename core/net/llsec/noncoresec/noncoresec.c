@@ -80,49 +80,6 @@
 static uint8_t key[16] = NONCORESEC_KEY;
 NBR_TABLE(struct anti_replay_info, anti_replay_table);
 
-/*---------------------------------------------------------------------------*/
-static int
-aead(uint8_t hdrlen, int forward)
-{
-  uint8_t totlen;
-  uint8_t nonce[CCM_STAR_NONCE_LENGTH];
-  uint8_t *m;
-  uint8_t m_len;
-  uint8_t *a;
-  uint8_t a_len;
-  uint8_t *result;
-  uint8_t generated_mic[LLSEC802154_MIC_LENGTH];
-  uint8_t *mic;
-  
-  ccm_star_packetbuf_set_nonce(nonce, forward);
-  totlen = packetbuf_totlen();
-  a = packetbuf_hdrptr();
-#if WITH_ENCRYPTION
-  a_len = hdrlen;
-  m = a + a_len;
-  m_len = totlen - hdrlen;
-#else /* WITH_ENCRYPTION */
-  a_len = totlen;
-  m = NULL;
-  m_len = 0;
-#endif /* WITH_ENCRYPTION */
-  
-  mic = a + totlen;
-  result = forward ? mic : generated_mic;
-  
-  CCM_STAR.aead(nonce,
-      m, m_len,
-      a, a_len,
-      result, LLSEC802154_MIC_LENGTH,
-      forward);
-  
-  if(forward) {
-    packetbuf_set_datalen(packetbuf_datalen() + LLSEC802154_MIC_LENGTH);
-    return 1;
-  } else {
-    return (memcmp(generated_mic, mic, LLSEC802154_MIC_LENGTH) == 0);
-  }
-}
 /*---------------------------------------------------------------------------*/
 static void
 add_security_header(void)
@@ -151,7 +108,8 @@ create(void)
     return result;
   }
 
-  aead(result, 1);
+  ccm_star_packetbuf_aead(result, WITH_ENCRYPTION,
+      LLSEC802154_MIC_LENGTH, 1);
   
   return result;
 }
@@ -180,7 +138,8 @@ parse(void)
   
   packetbuf_set_datalen(packetbuf_datalen() - LLSEC802154_MIC_LENGTH);
   
-  if(!aead(result, 0)) {
+  if(!ccm_star_packetbuf_aead(result, WITH_ENCRYPTION,
+      LLSEC802154_MIC_LENGTH, 0)) {
     PRINTF("noncoresec: received unauthentic frame %"PRIu32"\n",
         anti_replay_get_counter());
     return FRAMER_FAILED;
@@ -0,0 +1,879 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         802.15.4 security implementation, which uses pairwise keys
+ */
+
+/**
+ * \addtogroup pairsec
+ * @{
+ */
+
+#include "net/llsec/pairsec/pairsec.h"
+#include "net/llsec/anti-replay.h"
+#include "net/llsec/llsec802154.h"
+#include "net/llsec/ccm-star-packetbuf.h"
+#include "net/mac/frame802154.h"
+#include "net/mac/framer-802154.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/nbr-table.h"
+#include "lib/aes-128.h"
+#include "lib/ccm-star.h"
+#include "lib/random.h"
+#include <string.h>
+
+#if !LLSEC802154_USES_EXPLICIT_KEYS
+#error "pairsec requires LLSEC802154_CONF_USES_EXPLICIT_KEYS"
+#endif /* !LLSEC802154_USES_EXPLICIT_KEYS */
+#if !LLSEC802154_SECURITY_LEVEL_MIC
+#error "pairsec requires a security level with a MIC"
+#endif /* !LLSEC802154_SECURITY_LEVEL_MIC */
+
+#define WITH_ENCRYPTION (LLSEC802154_SECURITY_LEVEL & (1 << 2))
+/* HELLOACKs and ACKs carry group keys and are therefore always encrypted */
+#define COMMAND_SECURITY_LEVEL (LLSEC802154_SECURITY_LEVEL | (1 << 2))
+
+#define CHALLENGE_LEN 8
+
+/* Command frame identifiers, following those of IEEE 802.15.4 */
+#define HELLO_IDENTIFIER    0x0A
+#define HELLOACK_IDENTIFIER 0x0B
+#define ACK_IDENTIFIER      0x0C
+
+/*
+ * Key indices: session keys are in slot 0, 1, or 2, so that the current,
+ * the previous, and the pending session key never share a slot
+ */
+#define KEY_SLOTS            3
+#define SLOT_KEY_INDEX(slot) ((slot) + 1)
+#define GROUP_KEY_INDEX      (KEY_SLOTS + 1)
+
+/* Neighbor flags */
+#define FLAG_KEY             0x01 /* Session key in tx_slot */
+#define FLAG_PREVIOUS_KEY    0x02 /* Previous session key in previous_slot */
+#define FLAG_GROUP_KEY       0x04
+
+/* Handshake states */
+#define HANDSHAKE_NONE              0
+#define HANDSHAKE_AWAITING_HELLOACK 1
+#define HANDSHAKE_AWAITING_ACK      2
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else /* DEBUG */
+#define PRINTF(...)
+#endif /* DEBUG */
+
+struct handshake {
+  union {
+    /* Our challenge while awaiting a HELLOACK */
+    uint8_t challenge[CHALLENGE_LEN];
+    /* Key that is being established while awaiting an ACK */
+    uint8_t key[AES_128_KEY_LENGTH];
+  } u;
+  unsigned long expiration;
+  /* Slot the key goes to once the ACK authenticates it */
+  uint8_t slot;
+  uint8_t state;
+};
+
+struct neighbor {
+  struct anti_replay_info anti_replay_info;
+  uint8_t keys[KEY_SLOTS][AES_128_KEY_LENGTH];
+  uint8_t group_key[AES_128_KEY_LENGTH];
+  struct handshake handshake;
+  unsigned long key_expiration;
+  uint8_t tx_slot;
+  uint8_t previous_slot;
+  uint8_t flags;
+};
+
+/*
+ * Handshake with a sender that we have no neighbor entry for. Anyone can
+ * start these, so they live apart from the neighbor table until they are
+ * authenticated.
+ */
+struct new_neighbor {
+  linkaddr_t addr;
+  struct handshake handshake;
+};
+
+static const uint8_t master_key[AES_128_KEY_LENGTH] = PAIRSEC_MASTER_KEY;
+static uint8_t group_key[AES_128_KEY_LENGTH];
+/* Challenge of our last broadcast HELLO */
+static uint8_t hello_challenge[CHALLENGE_LEN];
+static unsigned long hello_expiration;
+/* Key derived while parsing a HELLOACK, stored once it is authentic */
+static uint8_t helloack_key[AES_128_KEY_LENGTH];
+/* Sender of a frame that we had no key for */
+static linkaddr_t unknown_sender;
+static struct new_neighbor new_neighbors[PAIRSEC_MAX_NEW_NEIGHBORS];
+/* Token bucket pacing the handshakes that unknown senders start */
+static struct timer new_neighbor_timer;
+static uint8_t new_neighbor_tokens = PAIRSEC_MAX_NEW_NEIGHBORS;
+NBR_TABLE(struct neighbor, neighbors);
+
+PROCESS(pairsec_process, "pairsec");
+/*---------------------------------------------------------------------------*/
+static void
+random_bytes(uint8_t *p, uint8_t len)
+{
+  while(len--) {
+    *p++ = random_rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+pairsec_get_secret(const linkaddr_t *addr, uint8_t *secret)
+{
+  const linkaddr_t *first;
+  const linkaddr_t *second;
+
+  /* Encrypts the pair of addresses, which is the same on both sides */
+  if(memcmp(addr, &linkaddr_node_addr, LINKADDR_SIZE) < 0) {
+    first = addr;
+    second = &linkaddr_node_addr;
+  } else {
+    first = &linkaddr_node_addr;
+    second = addr;
+  }
+  memset(secret, 0, AES_128_KEY_LENGTH);
+  memcpy(secret, first, LINKADDR_SIZE);
+  memcpy(secret + AES_128_KEY_LENGTH / 2, second, LINKADDR_SIZE);
+  AES_128.set_key(master_key);
+  AES_128.encrypt(secret);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Session key = E_secret(initiator's challenge | responder's challenge) */
+static int
+derive_key(const linkaddr_t *addr,
+    const uint8_t *initiator_challenge, const uint8_t *responder_challenge,
+    uint8_t *key)
+{
+  uint8_t secret[AES_128_KEY_LENGTH];
+
+  if(!PAIRSEC_GET_SECRET(addr, secret)) {
+    PRINTF("pairsec: no secret shared with neighbor\n");
+    return 0;
+  }
+  memcpy(key, initiator_challenge, CHALLENGE_LEN);
+  memcpy(key + CHALLENGE_LEN, responder_challenge, CHALLENGE_LEN);
+  AES_128.set_key(secret);
+  AES_128.encrypt(key);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the ongoing handshake with addr, if any */
+static struct handshake *
+find_handshake(const linkaddr_t *addr)
+{
+  struct neighbor *n;
+  uint8_t i;
+
+  n = nbr_table_get_from_lladdr(neighbors, addr);
+  if(n) {
+    return &n->handshake;
+  }
+  for(i = 0; i < PAIRSEC_MAX_NEW_NEIGHBORS; i++) {
+    if((new_neighbors[i].handshake.state != HANDSHAKE_NONE)
+        && linkaddr_cmp(&new_neighbors[i].addr, addr)) {
+      return &new_neighbors[i].handshake;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+take_new_neighbor_token(void)
+{
+  /* Refill the token bucket */
+  while(new_neighbor_tokens < PAIRSEC_MAX_NEW_NEIGHBORS
+      && timer_expired(&new_neighbor_timer)) {
+    new_neighbor_tokens++;
+    timer_reset(&new_neighbor_timer);
+  }
+
+  if(new_neighbor_tokens == 0) {
+    return 0;
+  }
+  if(new_neighbor_tokens == PAIRSEC_MAX_NEW_NEIGHBORS) {
+    timer_set(&new_neighbor_timer, PAIRSEC_NEW_NEIGHBOR_INTERVAL);
+  }
+  new_neighbor_tokens--;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns the handshake with addr, which the caller may (re)start, or NULL.
+ * If paced, handshakes with senders that we have no neighbor entry for
+ * are subject to the token bucket.
+ */
+static struct handshake *
+start_handshake(const linkaddr_t *addr, int paced)
+{
+  struct handshake *h;
+  struct new_neighbor *entry;
+  uint8_t i;
+
+  h = find_handshake(addr);
+  if(h) {
+    return h;
+  }
+  entry = NULL;
+  for(i = 0; i < PAIRSEC_MAX_NEW_NEIGHBORS; i++) {
+    if(new_neighbors[i].handshake.state == HANDSHAKE_NONE) {
+      entry = &new_neighbors[i];
+      break;
+    }
+  }
+  if(!entry) {
+    PRINTF("pairsec: too many handshakes with new neighbors\n");
+    return NULL;
+  }
+  if(paced && !take_new_neighbor_token()) {
+    PRINTF("pairsec: pacing handshakes with new neighbors\n");
+    return NULL;
+  }
+  linkaddr_copy(&entry->addr, addr);
+  return &entry->handshake;
+}
+/*---------------------------------------------------------------------------*/
+int
+pairsec_has_key(const linkaddr_t *addr)
+{
+  struct neighbor *n;
+
+  n = nbr_table_get_from_lladdr(neighbors, addr);
+  return n && (n->flags & FLAG_KEY);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_command(const linkaddr_t *dest, uint8_t identifier,
+    const uint8_t *payload, uint8_t payload_len, uint8_t key_index)
+{
+  uint8_t *buf;
+
+  packetbuf_clear();
+  buf = packetbuf_dataptr();
+  buf[0] = identifier;
+  memcpy(buf + 1, payload, payload_len);
+  packetbuf_set_datalen(1 + payload_len);
+  packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_CMDFRAME);
+  if(dest) {
+    packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest);
+    packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+  }
+  if(key_index) {
+    packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, COMMAND_SECURITY_LEVEL);
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_ID_MODE, FRAME802154_1_BYTE_KEY_ID_MODE);
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_INDEX, key_index);
+    anti_replay_set_counter();
+  }
+  NETSTACK_MAC.send(NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+broadcast_hello(void)
+{
+  random_bytes(hello_challenge, CHALLENGE_LEN);
+  hello_expiration = clock_seconds() + PAIRSEC_HANDSHAKE_TIMEOUT;
+  send_command(NULL, HELLO_IDENTIFIER, hello_challenge, CHALLENGE_LEN, 0);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Starts establishing a new session key with addr. Of two neighbors, the
+ * one with the lower address initiates. The other one sends a HELLO, too,
+ * but only to ask for a handshake.
+ */
+static void
+initiate(const linkaddr_t *addr, int paced)
+{
+  struct handshake *h;
+
+  h = start_handshake(addr, paced);
+  if(!h || h->state == HANDSHAKE_AWAITING_HELLOACK) {
+    return;
+  }
+
+  PRINTF("pairsec: sending HELLO\n");
+  random_bytes(h->u.challenge, CHALLENGE_LEN);
+  h->state = HANDSHAKE_AWAITING_HELLOACK;
+  h->expiration = clock_seconds() + PAIRSEC_HANDSHAKE_TIMEOUT;
+  send_command(addr, HELLO_IDENTIFIER, h->u.challenge, CHALLENGE_LEN, 0);
+}
+/*---------------------------------------------------------------------------*/
+/* Makes the session key in slot the one we use from now on */
+static void
+activate_key(struct neighbor *n, uint8_t slot)
+{
+  if((n->flags & FLAG_KEY) && (slot != n->tx_slot)) {
+    n->previous_slot = n->tx_slot;
+    n->flags |= FLAG_PREVIOUS_KEY;
+  } else {
+    n->flags &= ~FLAG_PREVIOUS_KEY;
+  }
+  n->flags |= FLAG_KEY;
+  n->tx_slot = slot;
+  n->key_expiration = clock_seconds() + PAIRSEC_KEY_LIFETIME;
+  n->handshake.state = HANDSHAKE_NONE;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Stores an authenticated session key of addr in slot and makes it the one
+ * we use from now on. Only now does addr get a neighbor entry if it had
+ * none.
+ */
+static struct neighbor *
+establish(const linkaddr_t *addr, const uint8_t *key, uint8_t slot)
+{
+  struct neighbor *n;
+  uint8_t i;
+
+  n = nbr_table_get_from_lladdr(neighbors, addr);
+  if(!n) {
+    n = nbr_table_add_lladdr(neighbors, addr);
+    if(!n) {
+      PRINTF("pairsec: no room for neighbor\n");
+      return NULL;
+    }
+    anti_replay_init_info(&n->anti_replay_info);
+  }
+  memcpy(n->keys[slot], key, AES_128_KEY_LENGTH);
+  activate_key(n, slot);
+
+  for(i = 0; i < PAIRSEC_MAX_NEW_NEIGHBORS; i++) {
+    if(linkaddr_cmp(&new_neighbors[i].addr, addr)) {
+      new_neighbors[i].handshake.state = HANDSHAKE_NONE;
+    }
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+on_hello(const linkaddr_t *sender, const uint8_t *initiator_challenge)
+{
+  struct neighbor *n;
+  struct handshake *h;
+  uint8_t payload[2 * CHALLENGE_LEN + AES_128_KEY_LENGTH];
+  uint8_t slot;
+
+  if(memcmp(&linkaddr_node_addr, sender, LINKADDR_SIZE) < 0) {
+    /* The neighbor asks us to initiate */
+    initiate(sender, 1);
+    return;
+  }
+
+  h = start_handshake(sender, 1);
+  if(!h || (h->state == HANDSHAKE_AWAITING_ACK)) {
+    /* One handshake at a time */
+    return;
+  }
+
+  /*
+   * Keep the key in use until the initiator has the new one, too, and the
+   * previous one until the ACK authenticates the new one
+   */
+  n = nbr_table_get_from_lladdr(neighbors, sender);
+  slot = 0;
+  while(n && (((n->flags & FLAG_KEY) && (slot == n->tx_slot))
+      || ((n->flags & FLAG_PREVIOUS_KEY) && (slot == n->previous_slot)))) {
+    slot++;
+  }
+  memcpy(payload, initiator_challenge, CHALLENGE_LEN);
+  random_bytes(payload + CHALLENGE_LEN, CHALLENGE_LEN);
+  if(!derive_key(sender, payload, payload + CHALLENGE_LEN, h->u.key)) {
+    h->state = HANDSHAKE_NONE;
+    return;
+  }
+  h->slot = slot;
+  h->state = HANDSHAKE_AWAITING_ACK;
+  h->expiration = clock_seconds() + PAIRSEC_HANDSHAKE_TIMEOUT;
+
+  PRINTF("pairsec: sending HELLOACK\n");
+  memcpy(payload + 2 * CHALLENGE_LEN, group_key, AES_128_KEY_LENGTH);
+  send_command(sender, HELLOACK_IDENTIFIER,
+      payload, sizeof(payload), SLOT_KEY_INDEX(slot));
+}
+/*---------------------------------------------------------------------------*/
+static void
+on_helloack(const linkaddr_t *sender, const uint8_t *sender_group_key)
+{
+  struct neighbor *n;
+  uint8_t slot;
+
+  slot = packetbuf_attr(PACKETBUF_ATTR_KEY_INDEX) - 1;
+  n = establish(sender, helloack_key, slot);
+  if(!n) {
+    return;
+  }
+  memcpy(n->group_key, sender_group_key, AES_128_KEY_LENGTH);
+  n->flags |= FLAG_GROUP_KEY;
+  anti_replay_init_info(&n->anti_replay_info);
+
+  PRINTF("pairsec: sending ACK\n");
+  send_command(sender, ACK_IDENTIFIER,
+      group_key, AES_128_KEY_LENGTH, SLOT_KEY_INDEX(slot));
+}
+/*---------------------------------------------------------------------------*/
+static void
+on_ack(const linkaddr_t *sender, struct handshake *h,
+    const uint8_t *sender_group_key)
+{
+  struct neighbor *n;
+
+  n = establish(sender, h->u.key, h->slot);
+  if(!n) {
+    return;
+  }
+  memcpy(n->group_key, sender_group_key, AES_128_KEY_LENGTH);
+  n->flags |= FLAG_GROUP_KEY;
+  anti_replay_init_info(&n->anti_replay_info);
+  PRINTF("pairsec: session key established\n");
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_security_header(void)
+{
+  if(!packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)) {
+    packetbuf_set_attr(PACKETBUF_ATTR_FRAME_TYPE, FRAME802154_DATAFRAME);
+    packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, LLSEC802154_SECURITY_LEVEL);
+    packetbuf_set_attr(PACKETBUF_ATTR_KEY_ID_MODE, FRAME802154_1_BYTE_KEY_ID_MODE);
+    anti_replay_set_counter();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send(mac_callback_t sent, void *ptr)
+{
+  linkaddr_t receiver;
+
+  if(!packetbuf_holds_broadcast()
+      && !pairsec_has_key(packetbuf_addr(PACKETBUF_ADDR_RECEIVER))) {
+    PRINTF("pairsec: no session key yet\n");
+    linkaddr_copy(&receiver, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR_FATAL, 0);
+    initiate(&receiver, 0);
+    return;
+  }
+  NETSTACK_MAC.send(sent, ptr);
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the key to secure the outgoing frame with and sets its index */
+static const uint8_t *
+get_outgoing_key(void)
+{
+  struct neighbor *n;
+  struct handshake *h;
+  uint8_t key_index;
+
+  key_index = packetbuf_attr(PACKETBUF_ATTR_KEY_INDEX);
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_CMDFRAME) {
+    /* HELLOACKs and ACKs come with their key index */
+    if(((uint8_t *)packetbuf_dataptr())[0] == HELLOACK_IDENTIFIER) {
+      /* The key of a HELLOACK is not established yet */
+      h = find_handshake(packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+      if(!h || (h->state != HANDSHAKE_AWAITING_ACK)
+          || (key_index != SLOT_KEY_INDEX(h->slot))) {
+        return NULL;
+      }
+      return h->u.key;
+    }
+  } else if(packetbuf_holds_broadcast()) {
+    key_index = GROUP_KEY_INDEX;
+  } else {
+    n = nbr_table_get_from_lladdr(neighbors,
+        packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+    if(!n || !(n->flags & FLAG_KEY)) {
+      return NULL;
+    }
+    key_index = SLOT_KEY_INDEX(n->tx_slot);
+  }
+  packetbuf_set_attr(PACKETBUF_ATTR_KEY_INDEX, key_index);
+
+  if(key_index == GROUP_KEY_INDEX) {
+    return group_key;
+  }
+  n = nbr_table_get_from_lladdr(neighbors,
+      packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  return n ? n->keys[key_index - 1] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+create(void)
+{
+  const uint8_t *key;
+  uint8_t identifier;
+  uint8_t auth_len;
+  int with_encryption;
+  int result;
+
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_CMDFRAME) {
+    if(!packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)) {
+      /* HELLO */
+      return framer_802154.create();
+    }
+    /* Challenges go in the clear, group keys get encrypted */
+    identifier = ((uint8_t *)packetbuf_dataptr())[0];
+    auth_len = identifier == HELLOACK_IDENTIFIER ? 1 + 2 * CHALLENGE_LEN : 1;
+    with_encryption = 1;
+  } else {
+    add_security_header();
+    auth_len = 0;
+    with_encryption = WITH_ENCRYPTION;
+  }
+
+  key = get_outgoing_key();
+  if(!key) {
+    PRINTF("pairsec: no key to secure frame with\n");
+    return FRAMER_FAILED;
+  }
+
+  result = framer_802154.create();
+  if(result == FRAMER_FAILED) {
+    return result;
+  }
+
+  CCM_STAR.set_key(key);
+  ccm_star_packetbuf_aead(result + auth_len, with_encryption,
+      LLSEC802154_MIC_LENGTH, 1);
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Returns the key an incoming HELLOACK or ACK was secured with, or NULL
+ * if we did not expect it
+ */
+static const uint8_t *
+get_command_key(uint8_t identifier, const linkaddr_t *sender, uint8_t slot)
+{
+  struct handshake *h;
+  const uint8_t *challenge;
+
+  h = find_handshake(sender);
+  if(identifier == HELLOACK_IDENTIFIER) {
+    if(packetbuf_datalen() < 1 + 2 * CHALLENGE_LEN + AES_128_KEY_LENGTH
+        + LLSEC802154_MIC_LENGTH) {
+      return NULL;
+    }
+    /* HELLOACKs echo the challenge of the HELLO they reply to */
+    challenge = (uint8_t *)packetbuf_dataptr() + 1;
+    if(!(h && (h->state == HANDSHAKE_AWAITING_HELLOACK)
+        && !memcmp(h->u.challenge, challenge, CHALLENGE_LEN))
+        && !((clock_seconds() < hello_expiration)
+        && !memcmp(hello_challenge, challenge, CHALLENGE_LEN))) {
+      return NULL;
+    }
+    if(!derive_key(sender, challenge, challenge + CHALLENGE_LEN,
+        helloack_key)) {
+      return NULL;
+    }
+    return helloack_key;
+  }
+  if(identifier == ACK_IDENTIFIER) {
+    if(!h || (h->state != HANDSHAKE_AWAITING_ACK)
+        || (h->slot != slot)
+        || (packetbuf_datalen() < 1 + AES_128_KEY_LENGTH
+        + LLSEC802154_MIC_LENGTH)) {
+      return NULL;
+    }
+    return h->u.key;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the key an incoming data frame was secured with, if we know it */
+static const uint8_t *
+get_data_key(struct neighbor *n, struct handshake *h, uint8_t key_index)
+{
+  uint8_t slot;
+
+  if(key_index == GROUP_KEY_INDEX) {
+    return (n && (n->flags & FLAG_GROUP_KEY)) ? n->group_key : NULL;
+  }
+  slot = key_index - 1;
+  if(slot >= KEY_SLOTS) {
+    return NULL;
+  }
+  if(n && (n->flags & FLAG_KEY) && (slot == n->tx_slot)) {
+    return n->keys[slot];
+  }
+  if(n && (n->flags & FLAG_PREVIOUS_KEY) && (slot == n->previous_slot)) {
+    return n->keys[slot];
+  }
+  if(h && (h->state == HANDSHAKE_AWAITING_ACK) && (slot == h->slot)) {
+    return h->u.key;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+parse(void)
+{
+  int result;
+  const linkaddr_t *sender;
+  struct neighbor *n;
+  struct handshake *h;
+  const uint8_t *key;
+  uint8_t identifier;
+  uint8_t key_index;
+  uint8_t auth_len;
+  int with_encryption;
+
+  result = framer_802154.parse();
+  if(result == FRAMER_FAILED) {
+    return result;
+  }
+
+  sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+  if(linkaddr_cmp(sender, &linkaddr_node_addr)) {
+    PRINTF("pairsec: frame from ourselves\n");
+    return FRAMER_FAILED;
+  }
+  if(!packetbuf_holds_broadcast()
+      && !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+      &linkaddr_node_addr)) {
+    /* We share no key with the receiver */
+    return FRAMER_FAILED;
+  }
+  n = nbr_table_get_from_lladdr(neighbors, sender);
+  h = find_handshake(sender);
+  key_index = packetbuf_attr(PACKETBUF_ATTR_KEY_INDEX);
+
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_CMDFRAME) {
+    if(!packetbuf_datalen()) {
+      return FRAMER_FAILED;
+    }
+    identifier = ((uint8_t *)packetbuf_dataptr())[0];
+    if(identifier == HELLO_IDENTIFIER) {
+      if(packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)
+          || (packetbuf_datalen() != 1 + CHALLENGE_LEN)) {
+        return FRAMER_FAILED;
+      }
+      return result;
+    }
+    if((packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL) != COMMAND_SECURITY_LEVEL)
+        || (key_index < SLOT_KEY_INDEX(0))
+        || (key_index > SLOT_KEY_INDEX(KEY_SLOTS - 1))) {
+      return FRAMER_FAILED;
+    }
+    key = get_command_key(identifier, sender, key_index - 1);
+    auth_len = identifier == HELLOACK_IDENTIFIER ? 1 + 2 * CHALLENGE_LEN : 1;
+    with_encryption = 1;
+  } else {
+    if(packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL) != LLSEC802154_SECURITY_LEVEL) {
+      PRINTF("pairsec: received frame with wrong security level\n");
+      return FRAMER_FAILED;
+    }
+    key = get_data_key(n, h, key_index);
+    if(!key) {
+      /* Will establish a session key in the background */
+      linkaddr_copy(&unknown_sender, sender);
+      process_poll(&pairsec_process);
+    }
+    auth_len = 0;
+    with_encryption = WITH_ENCRYPTION;
+  }
+
+  if(!key) {
+    PRINTF("pairsec: no key for received frame\n");
+    return FRAMER_FAILED;
+  }
+
+  packetbuf_set_datalen(packetbuf_datalen() - LLSEC802154_MIC_LENGTH);
+
+  CCM_STAR.set_key(key);
+  if(!ccm_star_packetbuf_aead(result + auth_len, with_encryption,
+      LLSEC802154_MIC_LENGTH, 0)) {
+    PRINTF("pairsec: received unauthentic frame %"PRIu32"\n",
+        anti_replay_get_counter());
+    return FRAMER_FAILED;
+  }
+
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) == FRAME802154_CMDFRAME) {
+    /* Handshakes are fresh owing to the challenges */
+    return result;
+  }
+
+  if(!n) {
+    /*
+     * The frame is secured with the key of a handshake with a new neighbor,
+     * whose ACK got lost. It is the first frame we accept from it.
+     */
+    return establish(sender, key, h->slot) ? result : FRAMER_FAILED;
+  }
+
+  if(anti_replay_was_replayed(&n->anti_replay_info)) {
+    PRINTF("pairsec: received replayed frame %"PRIu32"\n",
+        anti_replay_get_counter());
+    return FRAMER_FAILED;
+  }
+
+  if(h && (key == h->u.key)) {
+    /* The initiator uses the new key, so our ACK got lost */
+    establish(sender, key, h->slot);
+  }
+
+  return result;
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
+{
+  linkaddr_t sender;
+  uint8_t payload[CHALLENGE_LEN + AES_128_KEY_LENGTH];
+  uint8_t *data;
+  struct handshake *h;
+
+  if(packetbuf_attr(PACKETBUF_ATTR_FRAME_TYPE) != FRAME802154_CMDFRAME) {
+    NETSTACK_NETWORK.input();
+    return;
+  }
+
+  /* Replies reuse the packetbuf */
+  linkaddr_copy(&sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  data = packetbuf_dataptr();
+  switch(data[0]) {
+  case HELLO_IDENTIFIER:
+    memcpy(payload, data + 1, CHALLENGE_LEN);
+    on_hello(&sender, payload);
+    break;
+  case HELLOACK_IDENTIFIER:
+    memcpy(payload, data + 1 + 2 * CHALLENGE_LEN, AES_128_KEY_LENGTH);
+    on_helloack(&sender, payload);
+    break;
+  case ACK_IDENTIFIER:
+    h = find_handshake(&sender);
+    if(h && (h->state == HANDSHAKE_AWAITING_ACK)) {
+      on_ack(&sender, h, data + 1);
+    }
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+length(void)
+{
+  add_security_header();
+  return framer_802154.length() + LLSEC802154_MIC_LENGTH;
+}
+/*---------------------------------------------------------------------------*/
+/* Renews expiring session keys and drops stale handshakes */
+static void
+maintain(void)
+{
+  struct neighbor *n;
+  struct handshake *h;
+  const linkaddr_t *addr;
+  unsigned long now;
+  unsigned long expiration;
+  uint8_t i;
+
+  now = clock_seconds();
+  for(i = 0; i < PAIRSEC_MAX_NEW_NEIGHBORS; i++) {
+    h = &new_neighbors[i].handshake;
+    if((h->state != HANDSHAKE_NONE) && (now >= h->expiration)) {
+      h->state = HANDSHAKE_NONE;
+    }
+  }
+
+  for(n = nbr_table_head(neighbors); n; n = nbr_table_next(neighbors, n)) {
+    addr = nbr_table_get_lladdr(neighbors, n);
+    if((n->handshake.state != HANDSHAKE_NONE)
+        && (now >= n->handshake.expiration)) {
+      n->handshake.state = HANDSHAKE_NONE;
+    }
+    if(n->handshake.state == HANDSHAKE_NONE) {
+      /* The neighbor with the lower address renews the key */
+      expiration = n->key_expiration;
+      if(memcmp(&linkaddr_node_addr, addr, LINKADDR_SIZE) > 0) {
+        expiration += PAIRSEC_HANDSHAKE_TIMEOUT;
+      }
+      if(now >= expiration) {
+        initiate(addr, 0);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(pairsec_process, ev, data)
+{
+  static struct etimer timer;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&timer, random_rand() % PAIRSEC_HELLO_DELAY + 1);
+  PROCESS_WAIT_UNTIL(etimer_expired(&timer));
+  broadcast_hello();
+
+  etimer_set(&timer, CLOCK_SECOND);
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == PROCESS_EVENT_POLL) {
+      initiate(&unknown_sender, 1);
+    } else if(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer)) {
+      maintain();
+      etimer_reset(&timer);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  random_bytes(group_key, AES_128_KEY_LENGTH);
+  nbr_table_register(neighbors, NULL);
+  process_start(&pairsec_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+const struct llsec_driver pairsec_driver = {
+  "pairsec",
+  init,
+  send,
+  input
+};
+/*---------------------------------------------------------------------------*/
+const struct framer pairsec_framer = {
+  length,
+  create,
+  parse
+};
+/*---------------------------------------------------------------------------*/
+
+/** @} */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         802.15.4 security implementation, which uses pairwise keys
+ */
+
+/**
+ * \addtogroup llsec
+ * @{
+ */
+
+/**
+ * \defgroup pairsec LLSEC driver using pairwise keys (PAIRSEC)
+ *
+ * Unicast frames are secured with a session key that is shared by the
+ * sender and the receiver only. Broadcast frames are secured with a group
+ * key of the sender, which it hands to each neighbor it shares a session
+ * key with.
+ *
+ * Session keys are established in-band by a three-way handshake:
+ * HELLO carries a challenge of the initiator, HELLOACK a challenge of the
+ * responder, and both sides derive the session key by encrypting the two
+ * challenges under a secret they already share. HELLOACK and ACK are
+ * secured with the new session key and carry the group keys.
+ *
+ * The session keys are only as strong as the secrets they derive from.
+ * The default PAIRSEC_GET_SECRET derives every pairwise secret from
+ * PAIRSEC_MASTER_KEY, which every node holds, and the challenges are sent
+ * in the clear. Extracting the master key from a single node therefore
+ * yields every session key and group key of the network. A compromise is
+ * confined to the keys of the compromised node only if PAIRSEC_CONF_GET_SECRET
+ * supplies per-pair secrets, e.g., from a key predistribution scheme.
+ *
+ * Session keys are renewed after PAIRSEC_KEY_LIFETIME. Each neighbor has
+ * three key slots, for the current, the previous, and the pending session
+ * key, and the key index in the auxiliary security header tells which one
+ * a frame was secured with. Frames secured with the old key are thus still
+ * accepted while the new one is being established.
+ *
+ * HELLOs are not authenticated. Senders only get a neighbor entry once a
+ * HELLOACK, ACK, or data frame from them is authentic, and handshakes that
+ * unknown senders start are paced.
+ *
+ * Requires LLSEC802154_CONF_USES_EXPLICIT_KEYS and a security level
+ * with a MIC.
+ *
+ * @{
+ */
+
+#ifndef PAIRSEC_H_
+#define PAIRSEC_H_
+
+#include "net/llsec/llsec.h"
+#include "net/linkaddr.h"
+
+/**
+ * Secret shared by this node and a neighbor, from which session keys are
+ * derived. By default, this is derived from PAIRSEC_MASTER_KEY, which
+ * every node holds, so it offers no protection against the compromise of
+ * a single node. Deployments that need it supply per-pair secrets instead.
+ */
+#ifdef PAIRSEC_CONF_GET_SECRET
+#define PAIRSEC_GET_SECRET PAIRSEC_CONF_GET_SECRET
+#else /* PAIRSEC_CONF_GET_SECRET */
+#define PAIRSEC_GET_SECRET pairsec_get_secret
+#endif /* PAIRSEC_CONF_GET_SECRET */
+
+#ifdef PAIRSEC_CONF_MASTER_KEY
+#define PAIRSEC_MASTER_KEY PAIRSEC_CONF_MASTER_KEY
+#else /* PAIRSEC_CONF_MASTER_KEY */
+#define PAIRSEC_MASTER_KEY { 0x00 , 0x01 , 0x02 , 0x03 , \
+                             0x04 , 0x05 , 0x06 , 0x07 , \
+                             0x08 , 0x09 , 0x0A , 0x0B , \
+                             0x0C , 0x0D , 0x0E , 0x0F }
+#endif /* PAIRSEC_CONF_MASTER_KEY */
+
+/** Seconds after which session keys are renewed */
+#ifdef PAIRSEC_CONF_KEY_LIFETIME
+#define PAIRSEC_KEY_LIFETIME PAIRSEC_CONF_KEY_LIFETIME
+#else /* PAIRSEC_CONF_KEY_LIFETIME */
+#define PAIRSEC_KEY_LIFETIME (60 * 60)
+#endif /* PAIRSEC_CONF_KEY_LIFETIME */
+
+/** Seconds we wait for a HELLOACK or an ACK before giving up */
+#ifdef PAIRSEC_CONF_HANDSHAKE_TIMEOUT
+#define PAIRSEC_HANDSHAKE_TIMEOUT PAIRSEC_CONF_HANDSHAKE_TIMEOUT
+#else /* PAIRSEC_CONF_HANDSHAKE_TIMEOUT */
+#define PAIRSEC_HANDSHAKE_TIMEOUT 8
+#endif /* PAIRSEC_CONF_HANDSHAKE_TIMEOUT */
+
+/** Handshakes with senders that have no neighbor entry yet, at a time */
+#ifdef PAIRSEC_CONF_MAX_NEW_NEIGHBORS
+#define PAIRSEC_MAX_NEW_NEIGHBORS PAIRSEC_CONF_MAX_NEW_NEIGHBORS
+#else /* PAIRSEC_CONF_MAX_NEW_NEIGHBORS */
+#define PAIRSEC_MAX_NEW_NEIGHBORS 4
+#endif /* PAIRSEC_CONF_MAX_NEW_NEIGHBORS */
+
+/**
+ * Frames of unknown senders start at most PAIRSEC_MAX_NEW_NEIGHBORS
+ * handshakes in a burst and one more every PAIRSEC_NEW_NEIGHBOR_INTERVAL
+ */
+#ifdef PAIRSEC_CONF_NEW_NEIGHBOR_INTERVAL
+#define PAIRSEC_NEW_NEIGHBOR_INTERVAL PAIRSEC_CONF_NEW_NEIGHBOR_INTERVAL
+#else /* PAIRSEC_CONF_NEW_NEIGHBOR_INTERVAL */
+#define PAIRSEC_NEW_NEIGHBOR_INTERVAL CLOCK_SECOND
+#endif /* PAIRSEC_CONF_NEW_NEIGHBOR_INTERVAL */
+
+/** Maximum random delay of the broadcast HELLO at startup */
+#ifdef PAIRSEC_CONF_HELLO_DELAY
+#define PAIRSEC_HELLO_DELAY PAIRSEC_CONF_HELLO_DELAY
+#else /* PAIRSEC_CONF_HELLO_DELAY */
+#define PAIRSEC_HELLO_DELAY (CLOCK_SECOND * 2)
+#endif /* PAIRSEC_CONF_HELLO_DELAY */
+
+/**
+ * \brief        Default PAIRSEC_GET_SECRET
+ * \param addr   Link-layer address of the neighbor
+ * \param secret Where to store the AES_128_KEY_LENGTH bytes of the secret
+ * \retval 0     No secret is shared with this neighbor
+ */
+int pairsec_get_secret(const linkaddr_t *addr, uint8_t *secret);
+
+/**
+ * \brief      Tells whether a session key is shared with a neighbor
+ * \retval 0   Unicast frames to addr cannot be secured yet
+ */
+int pairsec_has_key(const linkaddr_t *addr);
+
+extern const struct llsec_driver pairsec_driver;
+extern const struct framer pairsec_framer;
+
+#endif /* PAIRSEC_H_ */
+
+/** @} */
+/** @} */
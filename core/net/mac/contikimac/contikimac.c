@@ -47,8 +47,11 @@
 #include "net/mac/mac-sequence.h"
 #include "net/mac/contikimac/contikimac.h"
 #include "net/netstack.h"
+#include "net/queuebuf.h"
 #include "net/rime/rime.h"
 #include "sys/compower.h"
+#include "sys/ctimer.h"
+#include "sys/energest.h"
 #include "sys/pt.h"
 #include "sys/rtimer.h"
 
@@ -101,6 +104,45 @@
 #define SYNC_CYCLE_STARTS                    1
 #endif
 
+/* Adaptive channel check rate: under load, the channel is checked
+   2^shift times per CYCLE_TIME, with shift up to
+   CHECK_RATE_MAX_SHIFT. The extra checks are evenly spaced within the
+   base cycle, so that the base wake-ups senders are phase-locked on are
+   kept. Set to 0 for a fixed channel check rate. */
+#ifdef CONTIKIMAC_CONF_CHECK_RATE_MAX_SHIFT
+#define CHECK_RATE_MAX_SHIFT               CONTIKIMAC_CONF_CHECK_RATE_MAX_SHIFT
+#else
+#define CHECK_RATE_MAX_SHIFT               0
+#endif
+
+/* How often the channel check rate is adapted, in clock ticks */
+#ifdef CONTIKIMAC_CONF_CHECK_RATE_INTERVAL
+#define CHECK_RATE_INTERVAL                CONTIKIMAC_CONF_CHECK_RATE_INTERVAL
+#else
+#define CHECK_RATE_INTERVAL                (4 * CLOCK_SECOND)
+#endif
+
+/* Number of frames received within an interval above which the check
+   rate is raised, and below which it is lowered */
+#ifdef CONTIKIMAC_CONF_CHECK_RATE_HIGH_LOAD
+#define CHECK_RATE_HIGH_LOAD               CONTIKIMAC_CONF_CHECK_RATE_HIGH_LOAD
+#else
+#define CHECK_RATE_HIGH_LOAD               8
+#endif
+#ifdef CONTIKIMAC_CONF_CHECK_RATE_LOW_LOAD
+#define CHECK_RATE_LOW_LOAD                CONTIKIMAC_CONF_CHECK_RATE_LOW_LOAD
+#else
+#define CHECK_RATE_LOW_LOAD                2
+#endif
+
+/* The check rate is not raised while the radio duty cycle measured
+   by energest is above this value, in 1/1000. 0 disables the limit. */
+#ifdef CONTIKIMAC_CONF_CHECK_RATE_MAX_DUTY_CYCLE
+#define CHECK_RATE_MAX_DUTY_CYCLE          CONTIKIMAC_CONF_CHECK_RATE_MAX_DUTY_CYCLE
+#else
+#define CHECK_RATE_MAX_DUTY_CYCLE          0
+#endif
+
 /* Are we currently receiving a burst? */
 static int we_are_receiving_burst = 0;
 
@@ -200,6 +242,16 @@ static int we_are_receiving_burst = 0;
 #define GUARD_TIME                         10 * CHECK_TIME + CHECK_TIME_TX
 #endif
 
+/* MIN_GUARD_TIME is the smallest guard time used for a neighbor whose
+   wake-up jitter has been learned by the phase module: enough for our
+   CCAs before transmitting and for the channel check of the receiver.
+   The phase module adds a margin proportional to the jitter. */
+#ifdef CONTIKIMAC_CONF_MIN_GUARD_TIME
+#define MIN_GUARD_TIME                     CONTIKIMAC_CONF_MIN_GUARD_TIME
+#else
+#define MIN_GUARD_TIME                     (2 * CHECK_TIME + CHECK_TIME_TX)
+#endif
+
 /* INTER_PACKET_INTERVAL is the interval between two successive packet transmissions */
 #ifdef CONTIKIMAC_CONF_INTER_PACKET_INTERVAL
 #define INTER_PACKET_INTERVAL              CONTIKIMAC_CONF_INTER_PACKET_INTERVAL
@@ -242,6 +294,18 @@ static volatile uint8_t contikimac_keep_radio_on = 0;
 static volatile unsigned char we_are_sending = 0;
 static volatile unsigned char radio_is_on = 0;
 
+#if CHECK_RATE_MAX_SHIFT > 0
+static struct ctimer check_rate_timer;
+/* Current channel check rate shift, applied at the next base cycle */
+static volatile uint8_t check_rate_shift;
+/* Frames received during the current adaptation interval */
+static uint16_t check_rate_rx_count;
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
+
+static unsigned short radio_duty_cycle;
+static unsigned long last_radio_time;
+static clock_time_t last_duty_cycle_update;
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -372,6 +436,11 @@ powercycle(struct rtimer *t, void *ptr)
   static volatile rtimer_clock_t sync_cycle_start;
   static volatile uint8_t sync_cycle_phase;
 #endif
+  static rtimer_clock_t next_check;
+#if CHECK_RATE_MAX_SHIFT > 0
+  static uint8_t cycle_shift;
+  static uint8_t sub_check;
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
 
   PT_BEGIN(&pt);
 
@@ -385,6 +454,11 @@ powercycle(struct rtimer *t, void *ptr)
     static uint8_t packet_seen;
     static uint8_t count;
 
+#if CHECK_RATE_MAX_SHIFT > 0
+    /* Sub-cycle checks do not move the base cycle start */
+    if(sub_check == 0) {
+      cycle_shift = check_rate_shift;
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
 #if SYNC_CYCLE_STARTS
     /* Compute cycle start when RTIMER_ARCH_SECOND is not a multiple
        of CHANNEL_CHECK_RATE */
@@ -402,6 +476,9 @@ powercycle(struct rtimer *t, void *ptr)
 #else
     cycle_start += CYCLE_TIME;
 #endif
+#if CHECK_RATE_MAX_SHIFT > 0
+    }
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
 
     packet_seen = 0;
 
@@ -483,7 +560,19 @@ powercycle(struct rtimer *t, void *ptr)
       }
     }
 
-    if(RTIMER_CLOCK_LT(RTIMER_NOW() - cycle_start, CYCLE_TIME - CHECK_TIME * 4)) {
+    /* Offset of the next check from the start of the base cycle */
+#if CHECK_RATE_MAX_SHIFT > 0
+    if(++sub_check < (1 << cycle_shift)) {
+      next_check = sub_check * (CYCLE_TIME >> cycle_shift);
+    } else {
+      sub_check = 0;
+      next_check = CYCLE_TIME;
+    }
+#else /* CHECK_RATE_MAX_SHIFT > 0 */
+    next_check = CYCLE_TIME;
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
+
+    if(RTIMER_CLOCK_LT(RTIMER_NOW() - cycle_start, next_check - CHECK_TIME * 4)) {
       /* Schedule the next powercycle interrupt, or sleep the mcu
 	 until then.  Sleeping will not exit from this interrupt, so
 	 ensure an occasional wake cycle or foreground processing will
@@ -491,14 +580,14 @@ powercycle(struct rtimer *t, void *ptr)
 #if RDC_CONF_MCU_SLEEP
       static uint8_t sleepcycle;
       if((sleepcycle++ < 16) && !we_are_sending && !radio_is_on) {
-        rtimer_arch_sleep(CYCLE_TIME - (RTIMER_NOW() - cycle_start));
+        rtimer_arch_sleep(next_check - (RTIMER_NOW() - cycle_start));
       } else {
         sleepcycle = 0;
-        schedule_powercycle_fixed(t, CYCLE_TIME + cycle_start);
+        schedule_powercycle_fixed(t, next_check + cycle_start);
         PT_YIELD(&pt);
       }
 #else
-      schedule_powercycle_fixed(t, CYCLE_TIME + cycle_start);
+      schedule_powercycle_fixed(t, next_check + cycle_start);
       PT_YIELD(&pt);
 #endif
     }
@@ -604,7 +693,9 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   if(!is_broadcast && !is_receiver_awake) {
 #if WITH_PHASE_OPTIMIZATION
     ret = phase_wait(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
-                     CYCLE_TIME, GUARD_TIME,
+                     CYCLE_TIME,
+                     phase_guard_time(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                                      MIN_GUARD_TIME, GUARD_TIME),
                      mac_callback, mac_callback_ptr, buf_list);
     if(ret == PHASE_DEFERRED) {
       return MAC_TX_DEFERRED;
@@ -858,7 +949,10 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
     queuebuf_to_packetbuf(curr->buf);
     if(!packetbuf_attr(PACKETBUF_ATTR_IS_CREATED_AND_SECURED)) {
       /* create and secure this frame */
-      if(next != NULL) {
+      if(next != NULL && !packetbuf_holds_broadcast()) {
+        /* Unicast train: the receiver stays awake for the next frame.
+           Broadcast frames never set the pending bit, as it would keep
+           every neighbor's radio on. */
         packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
       }
       packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
@@ -949,6 +1043,10 @@ input_packet(void)
       /* This is a regular packet that is destined to us or to the
          broadcast address. */
 
+#if CHECK_RATE_MAX_SHIFT > 0
+      check_rate_rx_count++;
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
+
       /* If FRAME_PENDING is set, we are receiving a packets in a burst */
       we_are_receiving_burst = packetbuf_attr(PACKETBUF_ATTR_PENDING);
       if(we_are_receiving_burst) {
@@ -1020,6 +1118,60 @@ input_packet(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Computes the radio duty cycle since the last call from the listen
+   and transmit times accounted by energest */
+static void
+update_duty_cycle(void)
+{
+  unsigned long radio_time;
+  unsigned long elapsed;
+  clock_time_t now;
+
+  energest_flush();
+  radio_time = energest_type_time(ENERGEST_TYPE_LISTEN) +
+    energest_type_time(ENERGEST_TYPE_TRANSMIT);
+  now = clock_time();
+  elapsed = ((unsigned long)(now - last_duty_cycle_update) *
+             RTIMER_ARCH_SECOND) / CLOCK_SECOND;
+  if(elapsed > 0) {
+    radio_duty_cycle = (1000ul * (radio_time - last_radio_time)) / elapsed;
+  }
+  last_radio_time = radio_time;
+  last_duty_cycle_update = now;
+}
+/*---------------------------------------------------------------------------*/
+#if CHECK_RATE_MAX_SHIFT > 0
+/* Raises the channel check rate when the received traffic or our own
+   queue occupancy is high, and lowers it back when idle */
+static void
+check_rate_update(void *ptr)
+{
+  uint8_t queue_busy;
+
+  update_duty_cycle();
+  queue_busy = QUEUEBUF_NUM - queuebuf_numfree() >= QUEUEBUF_NUM / 2;
+
+  if((check_rate_rx_count >= CHECK_RATE_HIGH_LOAD || queue_busy) &&
+     check_rate_shift < CHECK_RATE_MAX_SHIFT &&
+     (CHECK_RATE_MAX_DUTY_CYCLE == 0 ||
+      radio_duty_cycle < CHECK_RATE_MAX_DUTY_CYCLE)) {
+    check_rate_shift++;
+    PRINTF("contikimac: check rate up to %u Hz (rx %u, duty cycle %u)\n",
+           NETSTACK_RDC_CHANNEL_CHECK_RATE << check_rate_shift,
+           check_rate_rx_count, radio_duty_cycle);
+  } else if(check_rate_rx_count <= CHECK_RATE_LOW_LOAD && !queue_busy &&
+            check_rate_shift > 0) {
+    check_rate_shift--;
+    PRINTF("contikimac: check rate down to %u Hz (rx %u, duty cycle %u)\n",
+           NETSTACK_RDC_CHANNEL_CHECK_RATE << check_rate_shift,
+           check_rate_rx_count, radio_duty_cycle);
+  }
+  check_rate_rx_count = 0;
+
+  ctimer_reset(&check_rate_timer);
+}
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
+/*---------------------------------------------------------------------------*/
 static void
 init(void)
 {
@@ -1034,6 +1186,13 @@ init(void)
   phase_init();
 #endif /* WITH_PHASE_OPTIMIZATION */
 
+  last_duty_cycle_update = clock_time();
+#if CHECK_RATE_MAX_SHIFT > 0
+  check_rate_shift = 0;
+  check_rate_rx_count = 0;
+  ctimer_set(&check_rate_timer, CHECK_RATE_INTERVAL, check_rate_update, NULL);
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
+
 }
 /*---------------------------------------------------------------------------*/
 static int
@@ -1078,6 +1237,25 @@ const struct rdc_driver contikimac_driver = {
   duty_cycle,
 };
 /*---------------------------------------------------------------------------*/
+unsigned short
+contikimac_channel_check_rate(void)
+{
+#if CHECK_RATE_MAX_SHIFT > 0
+  return NETSTACK_RDC_CHANNEL_CHECK_RATE << check_rate_shift;
+#else /* CHECK_RATE_MAX_SHIFT > 0 */
+  return NETSTACK_RDC_CHANNEL_CHECK_RATE;
+#endif /* CHECK_RATE_MAX_SHIFT > 0 */
+}
+/*---------------------------------------------------------------------------*/
+unsigned short
+contikimac_radio_duty_cycle(void)
+{
+#if CHECK_RATE_MAX_SHIFT == 0
+  update_duty_cycle();
+#endif /* CHECK_RATE_MAX_SHIFT == 0 */
+  return radio_duty_cycle;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 contikimac_debug_print(void)
 {
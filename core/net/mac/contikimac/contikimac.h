@@ -46,4 +46,15 @@
 
 extern const struct rdc_driver contikimac_driver;
 
+/* Returns the current channel check rate, in checks per second. It is
+   above NETSTACK_RDC_CHANNEL_CHECK_RATE when the adaptive check rate
+   (CONTIKIMAC_CONF_CHECK_RATE_MAX_SHIFT) has raised it under load. */
+unsigned short contikimac_channel_check_rate(void);
+
+/* Returns the radio duty cycle (listen + transmit time, as accounted
+   by energest) in 1/1000. With the adaptive check rate, this is the
+   duty cycle over the last adaptation interval, otherwise it is
+   measured since the previous call. Requires ENERGEST_CONF_ON. */
+unsigned short contikimac_radio_duty_cycle(void);
+
 #endif /* CONTIKIMAC_H */
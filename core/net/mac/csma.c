@@ -47,6 +47,8 @@
 #include "lib/random.h"
 
 #include "net/netstack.h"
+#include "net/nbr-table.h"
+#include "net/link-stats.h"
 
 #include "lib/list.h"
 #include "lib/memb.h"
@@ -84,6 +86,23 @@
 #error Change CSMA_CONF_MAX_MAC_TRANSMISSIONS in contiki-conf.h or in your Makefile.
 #endif /* CSMA_CONF_MAX_MAC_TRANSMISSIONS < 1 */
 
+/* Serve neighbor queues whose transmit timer has expired in deficit
+ * round-robin order, rather than in timer expiration order. Neighbors
+ * are charged for the bytes they put on the air, retransmissions included,
+ * so that a bad link does not get more than its share of the channel. */
+#ifdef CSMA_CONF_FAIR_SCHEDULER
+#define CSMA_FAIR_SCHEDULER CSMA_CONF_FAIR_SCHEDULER
+#else
+#define CSMA_FAIR_SCHEDULER 1
+#endif /* CSMA_CONF_FAIR_SCHEDULER */
+
+/* Bytes credited to a neighbor in each round of the scheduler */
+#ifdef CSMA_CONF_DRR_QUANTUM
+#define CSMA_DRR_QUANTUM CSMA_CONF_DRR_QUANTUM
+#else
+#define CSMA_DRR_QUANTUM 128
+#endif /* CSMA_CONF_DRR_QUANTUM */
+
 /* Packet metadata */
 struct qbuf_metadata {
   mac_callback_t sent;
@@ -98,6 +117,10 @@ struct neighbor_queue {
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions, deferrals;
+#if CSMA_FAIR_SCHEDULER
+  uint8_t ready; /* The transmit timer expired, waiting for the scheduler */
+  int16_t deficit; /* Deficit round-robin counter, in bytes */
+#endif /* CSMA_FAIR_SCHEDULER */
   LIST_STRUCT(queued_packet_list);
 };
 
@@ -116,11 +139,36 @@ struct neighbor_queue {
 #endif /* CSMA_CONF_MAX_PACKET_PER_NEIGHBOR */
 
 #define MAX_QUEUED_PACKETS QUEUEBUF_NUM
+
+/* When no more than this many packets are left in the pool, new packets
+ * are dropped for neighbors already holding their fair share of the pool */
+#ifdef CSMA_CONF_EARLY_DROP_THRESHOLD
+#define CSMA_EARLY_DROP_THRESHOLD CSMA_CONF_EARLY_DROP_THRESHOLD
+#else
+#define CSMA_EARLY_DROP_THRESHOLD (MAX_QUEUED_PACKETS / 4)
+#endif /* CSMA_CONF_EARLY_DROP_THRESHOLD */
+
 MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
 LIST(neighbor_list);
 
+#if CSMA_FAIR_SCHEDULER
+static struct ctimer scheduler_timer;
+static void neighbor_ready(void *ptr);
+#define TRANSMIT_CALLBACK neighbor_ready
+#else /* CSMA_FAIR_SCHEDULER */
+#define TRANSMIT_CALLBACK transmit_packet_list
+#endif /* CSMA_FAIR_SCHEDULER */
+
+#if CSMA_WITH_STATS
+struct csma_stats csma_stats;
+NBR_TABLE(struct csma_neighbor_stats, csma_neighbor_stats_table);
+#define STATS_ADD(field) csma_stats.field++
+#else /* CSMA_WITH_STATS */
+#define STATS_ADD(field)
+#endif /* CSMA_WITH_STATS */
+
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 
@@ -138,6 +186,59 @@ neighbor_queue_from_addr(const linkaddr_t *addr)
   return NULL;
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_WITH_STATS
+static struct csma_neighbor_stats *
+neighbor_stats_get(const linkaddr_t *addr, int create)
+{
+  struct csma_neighbor_stats *stats;
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    /* Broadcast is only accounted for in the global statistics */
+    return NULL;
+  }
+  stats = nbr_table_get_from_lladdr(csma_neighbor_stats_table, addr);
+  if(stats == NULL && create) {
+    stats = nbr_table_add_lladdr(csma_neighbor_stats_table, addr);
+  }
+  return stats;
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_stats_on_drop(const linkaddr_t *addr, int is_early)
+{
+  struct csma_neighbor_stats *stats = neighbor_stats_get(addr, 1);
+  if(is_early) {
+    STATS_ADD(dropped_early);
+    if(stats != NULL) {
+      stats->dropped_early++;
+    }
+  } else {
+    STATS_ADD(dropped_quota);
+    if(stats != NULL) {
+      stats->dropped_quota++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+const struct csma_neighbor_stats *
+csma_neighbor_stats(const linkaddr_t *addr)
+{
+  return neighbor_stats_get(addr, 0);
+}
+#endif /* CSMA_WITH_STATS */
+/*---------------------------------------------------------------------------*/
+/* The share of the packet pool each neighbor queue is entitled to */
+static int
+fair_share(void)
+{
+  int num_queues = list_length(neighbor_list);
+  int share;
+  if(num_queues == 0) {
+    return MAX_QUEUED_PACKETS;
+  }
+  share = MAX_QUEUED_PACKETS / num_queues;
+  return share > 0 ? share : 1;
+}
+/*---------------------------------------------------------------------------*/
 static clock_time_t
 default_timebase(void)
 {
@@ -170,6 +271,70 @@ transmit_packet_list(void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if CSMA_FAIR_SCHEDULER
+/* Deficit round-robin over the ready neighbor queues. The neighbor list is
+ * kept in round-robin order: a visited neighbor moves to the tail. Serves
+ * one neighbor per invocation, and reschedules itself if others are ready,
+ * so that packet_sent callbacks are processed in between. */
+static void
+schedule_next(void *ptr)
+{
+  struct neighbor_queue *n;
+  struct neighbor_queue *next;
+  struct neighbor_queue *last;
+  int num_ready;
+
+  ctimer_stop(&scheduler_timer);
+
+  do {
+    num_ready = 0;
+    /* Visit each neighbor of the current round once */
+    last = list_tail(neighbor_list);
+    for(n = list_head(neighbor_list); n != NULL; n = next) {
+      struct rdc_buf_list *q;
+      next = (n == last) ? NULL : list_item_next(n);
+      if(!n->ready) {
+        continue;
+      }
+      q = list_head(n->queued_packet_list);
+      if(q == NULL) {
+        n->ready = 0;
+        continue;
+      }
+      num_ready++;
+      n->deficit += CSMA_DRR_QUANTUM;
+      /* End of turn for this neighbor */
+      list_add(neighbor_list, n);
+      if(n->deficit >= queuebuf_datalen(q->buf)) {
+        /* Do not let unused credit build up */
+        if(n->deficit > queuebuf_datalen(q->buf) + CSMA_DRR_QUANTUM) {
+          n->deficit = queuebuf_datalen(q->buf) + CSMA_DRR_QUANTUM;
+        }
+        n->ready = 0;
+        /* Others may be ready, come back once this transmission is done */
+        ctimer_set(&scheduler_timer, 0, schedule_next, NULL);
+        /* Note: n may be freed during transmission */
+        transmit_packet_list(n);
+        return;
+      }
+    }
+    /* No ready neighbor had enough credit: start a new round */
+  } while(num_ready > 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_ready(void *ptr)
+{
+  struct neighbor_queue *n = ptr;
+  n->ready = 1;
+  if(!ctimer_expired(&scheduler_timer)) {
+    /* The scheduler is already pending */
+    return;
+  }
+  schedule_next(NULL);
+}
+#endif /* CSMA_FAIR_SCHEDULER */
+/*---------------------------------------------------------------------------*/
 static void
 free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
 {
@@ -184,6 +349,14 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
     memb_free(&packet_memb, p);
     PRINTF("csma: free_queued_packet, queue length %d, free packets %d\n",
            list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+#if CSMA_WITH_STATS
+    {
+      struct csma_neighbor_stats *stats = neighbor_stats_get(&n->addr, 0);
+      if(stats != NULL) {
+        stats->queue_len = list_length(n->queued_packet_list);
+      }
+    }
+#endif /* CSMA_WITH_STATS */
     if(list_head(n->queued_packet_list) != NULL) {
       /* There is a next packet. We reset current tx information */
       n->transmissions = 0;
@@ -191,7 +364,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p, int status)
       n->deferrals = 0;
       /* Set a timer for next transmissions */
       tx_delay = (status == MAC_TX_OK) ? 0 : default_timebase();
-      ctimer_set(&n->transmit_timer, tx_delay, transmit_packet_list, n);
+      ctimer_set(&n->transmit_timer, tx_delay, TRANSMIT_CALLBACK, n);
     } else {
       /* This was the last packet in the queue, we free the neighbor */
       ctimer_stop(&n->transmit_timer);
@@ -218,6 +391,14 @@ packet_sent(void *ptr, int status, int num_transmissions)
   if(n == NULL) {
     return;
   }
+#if CSMA_FAIR_SCHEDULER
+  /* Charge the neighbor for the air time it used. The debt is bounded
+   * so that a neighbor never waits more than a few rounds. */
+  n->deficit -= packetbuf_totlen() * (num_transmissions > 0 ? num_transmissions : 1);
+  if(n->deficit < -CSMA_MAX_MAC_TRANSMISSIONS * CSMA_DRR_QUANTUM) {
+    n->deficit = -CSMA_MAX_MAC_TRANSMISSIONS * CSMA_DRR_QUANTUM;
+  }
+#endif /* CSMA_FAIR_SCHEDULER */
   switch(status) {
   case MAC_TX_OK:
   case MAC_TX_NOACK:
@@ -288,13 +469,23 @@ packet_sent(void *ptr, int status, int num_transmissions)
         if(n->transmissions < metadata->max_transmissions) {
           PRINTF("csma: retransmitting with time %lu %p\n", time, q);
           ctimer_set(&n->transmit_timer, time,
-                     transmit_packet_list, n);
+                     TRANSMIT_CALLBACK, n);
           /* This is needed to correctly attribute energy that we spent
              transmitting this packet. */
           queuebuf_update_attr_from_packetbuf(q->buf);
         } else {
           PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
+#if CSMA_WITH_STATS
+          {
+            struct csma_neighbor_stats *stats = neighbor_stats_get(&n->addr, 0);
+            if(stats != NULL) {
+              stats->dropped_retries++;
+            }
+          }
+#endif /* CSMA_WITH_STATS */
+          STATS_ADD(dropped_retries);
+          link_stats_packet_sent(&n->addr, status, num_tx);
           free_packet(n, q, status);
           mac_call_sent_callback(sent, cptr, status, num_tx);
         }
@@ -304,6 +495,7 @@ packet_sent(void *ptr, int status, int num_transmissions)
         } else {
           PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
         }
+        link_stats_packet_sent(&n->addr, status, num_tx);
         free_packet(n, q, status);
         mac_call_sent_callback(sent, cptr, status, num_tx);
       }
@@ -348,6 +540,10 @@ send_packet(mac_callback_t sent, void *ptr)
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
+#if CSMA_FAIR_SCHEDULER
+      n->ready = 0;
+      n->deficit = 0;
+#endif /* CSMA_FAIR_SCHEDULER */
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
       /* Add neighbor to the list */
@@ -356,8 +552,21 @@ send_packet(mac_callback_t sent, void *ptr)
   }
 
   if(n != NULL) {
+    int queue_len = list_length(n->queued_packet_list);
+    int is_early_drop = 0;
+    /* Once the pool is nearly exhausted, only accept packets for neighbors
+     * below their fair share, so that a congested next hop can not starve
+     * the others. Link-layer ACKs are exempt. */
+    if(memb_numfree(&packet_memb) <= CSMA_EARLY_DROP_THRESHOLD
+       && queue_len >= fair_share()
+#if PACKETBUF_WITH_PACKET_TYPE
+       && packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) != PACKETBUF_ATTR_PACKET_TYPE_ACK
+#endif
+       ) {
+      is_early_drop = 1;
+    }
     /* Add packet to the neighbor's queue */
-    if(list_length(n->queued_packet_list) < CSMA_MAX_PACKET_PER_NEIGHBOR) {
+    if(queue_len < CSMA_MAX_PACKET_PER_NEIGHBOR && !is_early_drop) {
       q = memb_alloc(&packet_memb);
       if(q != NULL) {
         q->ptr = memb_alloc(&metadata_memb);
@@ -387,9 +596,26 @@ send_packet(mac_callback_t sent, void *ptr)
 
             PRINTF("csma: send_packet, queue length %d, free packets %d\n",
                    list_length(n->queued_packet_list), memb_numfree(&packet_memb));
+#if CSMA_WITH_STATS
+            {
+              struct csma_neighbor_stats *stats = neighbor_stats_get(addr, 1);
+              int num_queued = MAX_QUEUED_PACKETS - memb_numfree(&packet_memb);
+              STATS_ADD(enqueued);
+              if(num_queued > csma_stats.max_queued) {
+                csma_stats.max_queued = num_queued;
+              }
+              if(stats != NULL) {
+                stats->enqueued++;
+                stats->queue_len = queue_len + 1;
+                if(stats->queue_len > stats->max_queue_len) {
+                  stats->max_queue_len = stats->queue_len;
+                }
+              }
+            }
+#endif /* CSMA_WITH_STATS */
             /* If q is the first packet in the neighbor's queue, send asap */
             if(list_head(n->queued_packet_list) == q) {
-              ctimer_set(&n->transmit_timer, 0, transmit_packet_list, n);
+              ctimer_set(&n->transmit_timer, 0, TRANSMIT_CALLBACK, n);
             }
             return;
           }
@@ -399,16 +625,22 @@ send_packet(mac_callback_t sent, void *ptr)
         memb_free(&packet_memb, q);
         PRINTF("csma: could not allocate queuebuf, dropping packet\n");
       }
+      STATS_ADD(dropped_no_memory);
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
       if(list_length(n->queued_packet_list) == 0) {
         list_remove(neighbor_list, n);
         memb_free(&neighbor_memb, n);
       }
     } else {
-      PRINTF("csma: Neighbor queue full\n");
+      PRINTF("csma: Neighbor queue full (%d packets, early drop %d)\n",
+             queue_len, is_early_drop);
+#if CSMA_WITH_STATS
+      update_stats_on_drop(addr, is_early_drop);
+#endif /* CSMA_WITH_STATS */
     }
     PRINTF("csma: could not allocate packet, dropping packet\n");
   } else {
+    STATS_ADD(dropped_no_memory);
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
   }
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
@@ -417,6 +649,7 @@ send_packet(mac_callback_t sent, void *ptr)
 static void
 input_packet(void)
 {
+  link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
   NETSTACK_LLSEC.input();
 }
 /*---------------------------------------------------------------------------*/
@@ -447,6 +680,10 @@ init(void)
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+  link_stats_init();
+#if CSMA_WITH_STATS
+  nbr_table_register(csma_neighbor_stats_table, NULL);
+#endif /* CSMA_WITH_STATS */
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -42,8 +42,43 @@
 #define CSMA_H_
 
 #include "net/mac/mac.h"
+#include "net/linkaddr.h"
 #include "dev/radio.h"
 
+/* Keep statistics on queue occupancy and drops, globally and per neighbor? */
+#ifdef CSMA_CONF_WITH_STATS
+#define CSMA_WITH_STATS CSMA_CONF_WITH_STATS
+#else /* CSMA_CONF_WITH_STATS */
+#define CSMA_WITH_STATS 0
+#endif /* CSMA_CONF_WITH_STATS */
+
+#if CSMA_WITH_STATS
+/* Global CSMA statistics */
+struct csma_stats {
+  uint32_t enqueued;          /* Packets accepted in a neighbor queue */
+  uint32_t dropped_quota;     /* Dropped: neighbor queue full */
+  uint32_t dropped_early;     /* Dropped: pool nearly exhausted, neighbor above fair share */
+  uint32_t dropped_no_memory; /* Dropped: could not allocate neighbor or packet */
+  uint32_t dropped_retries;   /* Dropped: max transmissions reached */
+  uint16_t max_queued;        /* Highest number of packets queued at once */
+};
+
+/* Per-neighbor CSMA statistics, kept in a neighbor table */
+struct csma_neighbor_stats {
+  uint32_t enqueued;
+  uint16_t dropped_quota;
+  uint16_t dropped_early;
+  uint16_t dropped_retries;
+  uint8_t queue_len;          /* Current queue depth */
+  uint8_t max_queue_len;      /* Highest queue depth */
+};
+
+extern struct csma_stats csma_stats;
+
+/* Returns the statistics of a neighbor, or NULL if it has none */
+const struct csma_neighbor_stats *csma_neighbor_stats(const linkaddr_t *addr);
+#endif /* CSMA_WITH_STATS */
+
 extern const struct mac_driver csma_driver;
 
 const struct mac_driver *csma_init(const struct mac_driver *r);
@@ -43,6 +43,7 @@
 #include "net/ip/tcpip.h"
 #include "net/packetbuf.h"
 #include "net/netstack.h"
+#include "net/link-stats.h"
 
 /*---------------------------------------------------------------------------*/
 static void
@@ -54,6 +55,7 @@ send_packet(mac_callback_t sent, void *ptr)
 static void
 packet_input(void)
 {
+  link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
   NETSTACK_LLSEC.input();
 }
 /*---------------------------------------------------------------------------*/
@@ -78,6 +80,7 @@ channel_check_interval(void)
 static void
 init(void)
 {
+  link_stats_init();
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver nullmac_driver = {
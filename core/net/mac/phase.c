@@ -50,11 +50,68 @@
 #define PHASE_DRIFT_CORRECT 0
 #endif
 
+/* Track the jitter between the predicted and the observed wake-up of each
+   neighbor, and shrink the guard time accordingly (see phase_guard_time) */
+#ifdef PHASE_CONF_ADAPTIVE_GUARD_TIME
+#define PHASE_ADAPTIVE_GUARD_TIME PHASE_CONF_ADAPTIVE_GUARD_TIME
+#else
+#define PHASE_ADAPTIVE_GUARD_TIME 1
+#endif
+
+/* Number of jitter samples needed before the guard time is reduced */
+#ifdef PHASE_CONF_MIN_JITTER_SAMPLES
+#define PHASE_MIN_JITTER_SAMPLES PHASE_CONF_MIN_JITTER_SAMPLES
+#else
+#define PHASE_MIN_JITTER_SAMPLES 4
+#endif
+
+/* The guard time covers this many times the average jitter */
+#ifdef PHASE_CONF_JITTER_GUARD_FACTOR
+#define PHASE_JITTER_GUARD_FACTOR PHASE_CONF_JITTER_GUARD_FACTOR
+#else
+#define PHASE_JITTER_GUARD_FACTOR 4
+#endif
+
+/* Receivers running an adaptive channel check rate wake up 2^shift
+   times per cycle, aligned on their base cycle. We learn the shift of
+   each neighbor by probing the next faster rate after a number of
+   successful transmissions, and backing off when the receiver was not
+   awake at the predicted sub-cycle wake-up. */
+#ifdef PHASE_CONF_MAX_CYCLE_SHIFT
+#define PHASE_MAX_CYCLE_SHIFT PHASE_CONF_MAX_CYCLE_SHIFT
+#elif defined CONTIKIMAC_CONF_CHECK_RATE_MAX_SHIFT
+#define PHASE_MAX_CYCLE_SHIFT CONTIKIMAC_CONF_CHECK_RATE_MAX_SHIFT
+#else
+#define PHASE_MAX_CYCLE_SHIFT 0
+#endif
+
+/* Number of successful transmissions before probing a faster rate */
+#ifdef PHASE_CONF_CYCLE_PROBE_INTERVAL
+#define PHASE_CYCLE_PROBE_INTERVAL PHASE_CONF_CYCLE_PROBE_INTERVAL
+#else
+#define PHASE_CYCLE_PROBE_INTERVAL 8
+#endif
+
+#define PHASE_TRACK_EXPECTED (PHASE_ADAPTIVE_GUARD_TIME || PHASE_MAX_CYCLE_SHIFT > 0)
+
 struct phase {
   rtimer_clock_t time;
 #if PHASE_DRIFT_CORRECT
   rtimer_clock_t drift;
 #endif
+#if PHASE_TRACK_EXPECTED
+  rtimer_clock_t expected; /* Predicted wake-up for the ongoing transmission */
+  uint8_t has_expected;
+#endif /* PHASE_TRACK_EXPECTED */
+#if PHASE_ADAPTIVE_GUARD_TIME
+  rtimer_clock_t jitter;   /* Average deviation from the prediction (EWMA) */
+  uint8_t jitter_samples;
+#endif /* PHASE_ADAPTIVE_GUARD_TIME */
+#if PHASE_MAX_CYCLE_SHIFT > 0
+  rtimer_clock_t interval; /* Wake-up interval used for the prediction */
+  uint8_t shift;           /* Learned channel check rate shift */
+  uint8_t hits;            /* Successful predictions since the last probe */
+#endif /* PHASE_MAX_CYCLE_SHIFT > 0 */
   uint8_t noacks;
   struct timer noacks_timer;
 };
@@ -96,6 +153,60 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
   /* If we have an entry for this neighbor already, we renew it. */
   e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
   if(e != NULL) {
+#if PHASE_TRACK_EXPECTED
+    if(e->has_expected) {
+      e->has_expected = 0;
+      if(mac_status == MAC_TX_OK) {
+        rtimer_clock_t deviation;
+        if(RTIMER_CLOCK_LT(time, e->expected)) {
+          deviation = e->expected - time;
+        } else {
+          deviation = time - e->expected;
+        }
+#if PHASE_MAX_CYCLE_SHIFT > 0
+        if(deviation > e->interval / 2) {
+          /* The receiver was not awake at the predicted sub-cycle
+             wake-up: it runs at a slower rate than we assumed. This is
+             not jitter, so the average jitter is left unchanged. */
+          if(e->shift > 0) {
+            e->shift--;
+          }
+          e->hits = 0;
+#if PHASE_ADAPTIVE_GUARD_TIME
+          deviation = e->jitter;
+#endif /* PHASE_ADAPTIVE_GUARD_TIME */
+        } else if(e->shift < PHASE_MAX_CYCLE_SHIFT &&
+                  ++e->hits >= PHASE_CYCLE_PROBE_INTERVAL) {
+          /* Probe the next faster rate */
+          e->shift++;
+          e->hits = 0;
+        }
+#endif /* PHASE_MAX_CYCLE_SHIFT > 0 */
+#if PHASE_ADAPTIVE_GUARD_TIME
+        /* Compare the actual encounter with the prediction, and update
+           the average jitter: jitter = 3/4 jitter + 1/4 deviation */
+        if(e->jitter_samples == 0) {
+          e->jitter = deviation;
+        } else {
+          e->jitter = (rtimer_clock_t)(((uint32_t)e->jitter * 3 + deviation) / 4);
+        }
+        if(e->jitter_samples < PHASE_MIN_JITTER_SAMPLES) {
+          e->jitter_samples++;
+        }
+#endif /* PHASE_ADAPTIVE_GUARD_TIME */
+      } else if(mac_status == MAC_TX_NOACK) {
+#if PHASE_ADAPTIVE_GUARD_TIME
+        /* We probably missed the wake-up: fall back to the full guard
+           time until the jitter is learned again */
+        e->jitter_samples = 0;
+#endif /* PHASE_ADAPTIVE_GUARD_TIME */
+#if PHASE_MAX_CYCLE_SHIFT > 0
+        e->shift = 0;
+        e->hits = 0;
+#endif /* PHASE_MAX_CYCLE_SHIFT > 0 */
+      }
+    }
+#endif /* PHASE_TRACK_EXPECTED */
     if(mac_status == MAC_TX_OK) {
 #if PHASE_DRIFT_CORRECT
       e->drift = time-e->time;
@@ -128,6 +239,17 @@ phase_update(const linkaddr_t *neighbor, rtimer_clock_t time,
 #if PHASE_DRIFT_CORRECT
       e->drift = 0;
 #endif
+#if PHASE_TRACK_EXPECTED
+      e->has_expected = 0;
+#endif /* PHASE_TRACK_EXPECTED */
+#if PHASE_ADAPTIVE_GUARD_TIME
+      e->jitter = 0;
+      e->jitter_samples = 0;
+#endif /* PHASE_ADAPTIVE_GUARD_TIME */
+#if PHASE_MAX_CYCLE_SHIFT > 0
+      e->shift = 0;
+      e->hits = 0;
+#endif /* PHASE_MAX_CYCLE_SHIFT > 0 */
       e->noacks = 0;
       }
     }
@@ -185,6 +307,12 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
 
     sync = (e == NULL) ? now : e->time;
 
+#if PHASE_MAX_CYCLE_SHIFT > 0
+    /* The receiver also wakes up between its base cycles */
+    cycle_time >>= e->shift;
+    e->interval = cycle_time;
+#endif /* PHASE_MAX_CYCLE_SHIFT > 0 */
+
 #if PHASE_DRIFT_CORRECT
     {
       int32_t s;
@@ -205,7 +333,7 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
       wait = cycle_time - (rtimer_clock_t)((now - sync) % cycle_time);
     }
 
-    if(wait < guard_time) {
+    while(wait < guard_time) {
       wait += cycle_time;
     }
 
@@ -234,6 +362,12 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
     }
 
     expected = now + wait - guard_time;
+#if PHASE_TRACK_EXPECTED
+    /* Remember the predicted wake-up, to be compared with the actual
+       encounter in phase_update */
+    e->expected = now + wait;
+    e->has_expected = 1;
+#endif /* PHASE_TRACK_EXPECTED */
     if(!RTIMER_CLOCK_LT(expected, now)) {
       /* Wait until the receiver is expected to be awake */
       while(RTIMER_CLOCK_LT(RTIMER_NOW(), expected));
@@ -243,6 +377,23 @@ phase_wait(const linkaddr_t *neighbor, rtimer_clock_t cycle_time,
   return PHASE_UNKNOWN;
 }
 /*---------------------------------------------------------------------------*/
+rtimer_clock_t
+phase_guard_time(const linkaddr_t *neighbor, rtimer_clock_t min_guard_time,
+                 rtimer_clock_t max_guard_time)
+{
+#if PHASE_ADAPTIVE_GUARD_TIME
+  struct phase *e = nbr_table_get_from_lladdr(nbr_phase, neighbor);
+  if(e != NULL && e->jitter_samples >= PHASE_MIN_JITTER_SAMPLES) {
+    uint32_t guard_time = min_guard_time +
+      (uint32_t)PHASE_JITTER_GUARD_FACTOR * e->jitter;
+    if(guard_time < max_guard_time) {
+      return (rtimer_clock_t)guard_time;
+    }
+  }
+#endif /* PHASE_ADAPTIVE_GUARD_TIME */
+  return max_guard_time;
+}
+/*---------------------------------------------------------------------------*/
 void
 phase_init(void)
 {
@@ -61,6 +61,12 @@ phase_status_t phase_wait(const linkaddr_t *neighbor,
                           struct rdc_buf_list *buf_list);
 void phase_update(const linkaddr_t *neighbor,
                   rtimer_clock_t time, int mac_status);
+/* Returns the time to start transmitting before the expected wake-up of a
+   neighbor: max_guard_time until its phase jitter is known, then
+   min_guard_time plus a margin proportional to the jitter. */
+rtimer_clock_t phase_guard_time(const linkaddr_t *neighbor,
+                                rtimer_clock_t min_guard_time,
+                                rtimer_clock_t max_guard_time);
 void phase_remove(const linkaddr_t *neighbor);
 
 #endif /* PHASE_H */
@@ -168,6 +168,17 @@
 #define TSCH_WITH_LINK_SELECTOR 0
 #endif /* TSCH_CONF_WITH_LINK_SELECTOR */
 
+/* Maximum number of frames sent back-to-back to a neighbor in a burst.
+ * When more packets are queued for the neighbor, the frame pending bit is set
+ * and both sides use the timeslot immediately following for the next frame,
+ * until the queue is drained or the burst reaches this length.
+ * 0 or 1 disables bursts. */
+#ifdef TSCH_CONF_BURST_MAX_LEN
+#define TSCH_BURST_MAX_LEN TSCH_CONF_BURST_MAX_LEN
+#else
+#define TSCH_BURST_MAX_LEN 0
+#endif
+
 /* Estimate the drift of the time-source neighbor and compensate for it? */
 #ifdef TSCH_CONF_ADAPTIVE_TIMESYNC
 #define TSCH_ADAPTIVE_TIMESYNC TSCH_CONF_ADAPTIVE_TIMESYNC
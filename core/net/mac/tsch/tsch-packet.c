@@ -411,3 +411,28 @@ tsch_packet_parse_eb(const uint8_t *buf, int buf_size,
   return curr_len;
 }
 /*---------------------------------------------------------------------------*/
+/* Set frame pending bit in a packet (whose header was already built) */
+void
+tsch_packet_set_frame_pending(uint8_t *buf, int buf_size)
+{
+  if(buf != NULL && buf_size > 0) {
+    buf[0] |= (1 << 4);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Clear frame pending bit in a packet (whose header was already built) */
+void
+tsch_packet_clear_frame_pending(uint8_t *buf, int buf_size)
+{
+  if(buf != NULL && buf_size > 0) {
+    buf[0] &= ~(1 << 4);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Get frame pending bit from a packet */
+int
+tsch_packet_get_frame_pending(const uint8_t *buf, int buf_size)
+{
+  return buf != NULL && buf_size > 0 && (buf[0] >> 4) & 1;
+}
+/*---------------------------------------------------------------------------*/
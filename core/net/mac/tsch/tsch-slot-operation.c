@@ -151,6 +151,21 @@ static struct tsch_link *backup_link = NULL;
 static struct tsch_packet *current_packet = NULL;
 static struct tsch_neighbor *current_neighbor = NULL;
 
+#if TSCH_BURST_MAX_LEN > 1
+/* Set from slot operation when the frame just sent or received had the frame
+ * pending bit and was acknowledged: the next timeslot is then used as a burst
+ * slot with current_neighbor, preempting the schedule */
+static uint8_t burst_link_scheduled = 0;
+/* Are we the sender (or receiver) in the ongoing burst? */
+static uint8_t burst_link_tx = 0;
+/* Is the current slot a burst slot? */
+static uint8_t is_burst_slot = 0;
+/* Number of burst slots executed in the ongoing burst */
+static uint8_t burst_count = 0;
+/* Burst statistics */
+struct tsch_burst_stats tsch_burst_stats;
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+
 /* Protothread for association */
 PT_THREAD(tsch_scan(struct pt *pt));
 /* Protothread for slot operation, called from rtimer interrupt
@@ -415,6 +430,10 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
       /* is this a broadcast packet? (wait for ack?) */
       static uint8_t is_broadcast;
       static rtimer_clock_t tx_start_time;
+#if TSCH_BURST_MAX_LEN > 1
+      /* did we set the frame pending bit? */
+      static uint8_t burst_link_requested;
+#endif /* TSCH_BURST_MAX_LEN > 1 */
 
 #if CCA_ENABLED
       static uint8_t cca_status;
@@ -434,6 +453,23 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
         packet_ready = 1;
       }
 
+#if TSCH_BURST_MAX_LEN > 1
+      /* Unicast: announce a burst through the frame pending bit if more packets
+       * are queued for this neighbor. The bit is part of the header, so it must
+       * be set (or cleared, in case of retransmission) before securing the frame. */
+      if(!is_broadcast) {
+        burst_link_requested = burst_count + 1 < TSCH_BURST_MAX_LEN
+          && ringbufindex_elements(&current_neighbor->tx_ringbuf) > 1;
+        if(burst_link_requested) {
+          tsch_packet_set_frame_pending(packet, packet_len);
+        } else {
+          tsch_packet_clear_frame_pending(packet, packet_len);
+        }
+      } else {
+        burst_link_requested = 0;
+      }
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+
 #if TSCH_SECURITY_ENABLED
       if(tsch_is_pan_secured) {
         /* If we are going to encrypt, we need to generate the output in a separate buffer and keep
@@ -571,6 +607,14 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
                   tsch_schedule_keepalive();
                 }
                 mac_tx_status = MAC_TX_OK;
+#if TSCH_BURST_MAX_LEN > 1
+                /* The receiver acknowledged a frame with the pending bit:
+                 * it will listen in the next timeslot */
+                if(burst_link_requested) {
+                  burst_link_scheduled = 1;
+                  burst_link_tx = 1;
+                }
+#endif /* TSCH_BURST_MAX_LEN > 1 */
               } else {
                 mac_tx_status = MAC_TX_NOACK;
               }
@@ -587,6 +631,12 @@ PT_THREAD(tsch_tx_slot(struct pt *pt, struct rtimer *t))
     current_packet->transmissions++;
     current_packet->ret = mac_tx_status;
 
+#if TSCH_BURST_MAX_LEN > 1
+    if(is_burst_slot) {
+      tsch_burst_stats.tx++;
+    }
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+
     /* Post TX: Update neighbor state */
     in_queue = update_neighbor_state(current_neighbor, current_packet, current_link, mac_tx_status);
 
@@ -776,8 +826,22 @@ PT_THREAD(tsch_rx_slot(struct pt *pt, struct rtimer *t))
                   packet_duration + tsch_timing[tsch_ts_tx_ack_delay] - RADIO_DELAY_BEFORE_TX, "RxBeforeAck");
               TSCH_DEBUG_RX_EVENT();
               NETSTACK_RADIO.transmit(ack_len);
+
+#if TSCH_BURST_MAX_LEN > 1
+              /* The sender has more frames for us: listen in the next timeslot */
+              if(frame.fcf.frame_pending && burst_count + 1 < TSCH_BURST_MAX_LEN) {
+                burst_link_scheduled = 1;
+                burst_link_tx = 0;
+              }
+#endif /* TSCH_BURST_MAX_LEN > 1 */
             }
 
+#if TSCH_BURST_MAX_LEN > 1
+            if(is_burst_slot) {
+              tsch_burst_stats.rx++;
+            }
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+
             /* If the sender is a time source, proceed to clock drift compensation */
             n = tsch_queue_get_nbr(&source_address);
             if(n != NULL && n->is_time_source) {
@@ -859,13 +923,22 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       uint8_t current_channel;
       TSCH_DEBUG_SLOT_START();
       tsch_in_slot_operation = 1;
-      /* Get a packet ready to be sent */
-      current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
-      /* There is no packet to send, and this link does not have Rx flag. Instead of doing
-       * nothing, switch to the backup link (has Rx flag) if any. */
-      if(current_packet == NULL && !(current_link->link_options & LINK_OPTION_RX) && backup_link != NULL) {
-        current_link = backup_link;
+#if TSCH_BURST_MAX_LEN > 1
+      if(is_burst_slot) {
+        /* Burst slot: the sender keeps sending to the same neighbor,
+         * the receiver listens, regardless of the link options */
+        current_packet = burst_link_tx ? tsch_queue_get_packet_for_nbr(current_neighbor, current_link) : NULL;
+      } else
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+      {
+        /* Get a packet ready to be sent */
         current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
+        /* There is no packet to send, and this link does not have Rx flag. Instead of doing
+         * nothing, switch to the backup link (has Rx flag) if any. */
+        if(current_packet == NULL && !(current_link->link_options & LINK_OPTION_RX) && backup_link != NULL) {
+          current_link = backup_link;
+          current_packet = get_packet_and_neighbor_for_link(current_link, &current_neighbor);
+        }
       }
       /* Hop channel */
       current_channel = tsch_calculate_channel(&current_asn, current_link->channel_offset);
@@ -883,7 +956,11 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
          **/
         static struct pt slot_tx_pt;
         PT_SPAWN(&slot_operation_pt, &slot_tx_pt, tsch_tx_slot(&slot_tx_pt, t));
-      } else if((current_link->link_options & LINK_OPTION_RX)) {
+      } else if((current_link->link_options & LINK_OPTION_RX)
+#if TSCH_BURST_MAX_LEN > 1
+                || (is_burst_slot && !burst_link_tx)
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+                ) {
         /* Listen */
         static struct pt slot_rx_pt;
         PT_SPAWN(&slot_operation_pt, &slot_rx_pt, tsch_rx_slot(&slot_rx_pt, t));
@@ -914,18 +991,43 @@ PT_THREAD(tsch_slot_operation(struct rtimer *t, void *ptr))
       do {
         if(current_link != NULL
             && current_link->link_options & LINK_OPTION_TX
-            && current_link->link_options & LINK_OPTION_SHARED) {
+            && current_link->link_options & LINK_OPTION_SHARED
+#if TSCH_BURST_MAX_LEN > 1
+            && !is_burst_slot
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+            ) {
           /* Decrement the backoff window for all neighbors able to transmit over
            * this Tx, Shared link. */
           tsch_queue_update_all_backoff_windows(&current_link->addr);
         }
 
-        /* Get next active link */
-        current_link = tsch_schedule_get_next_active_link(&current_asn, &timeslot_diff, &backup_link);
-        if(current_link == NULL) {
-          /* There is no next link. Fall back to default
-           * behavior: wake up at the next slot. */
+#if TSCH_BURST_MAX_LEN > 1
+        if(burst_link_scheduled && current_link != NULL) {
+          /* Replay the current link at the next timeslot. The burst
+           * ends as soon as a deadline is missed. */
+          burst_link_scheduled = 0;
+          if(!is_burst_slot) {
+            tsch_burst_stats.bursts++;
+          }
+          is_burst_slot = 1;
+          burst_count++;
+          backup_link = NULL;
           timeslot_diff = 1;
+        } else
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+        {
+#if TSCH_BURST_MAX_LEN > 1
+          burst_link_scheduled = 0;
+          is_burst_slot = 0;
+          burst_count = 0;
+#endif /* TSCH_BURST_MAX_LEN > 1 */
+          /* Get next active link */
+          current_link = tsch_schedule_get_next_active_link(&current_asn, &timeslot_diff, &backup_link);
+          if(current_link == NULL) {
+            /* There is no next link. Fall back to default
+             * behavior: wake up at the next slot. */
+            timeslot_diff = 1;
+          }
         }
         /* Update ASN */
         ASN_INC(current_asn, timeslot_diff);
@@ -984,5 +1086,10 @@ tsch_slot_operation_sync(rtimer_clock_t next_slot_start,
   current_asn = *next_slot_asn;
   last_sync_asn = current_asn;
   current_link = NULL;
+#if TSCH_BURST_MAX_LEN > 1
+  burst_link_scheduled = 0;
+  is_burst_slot = 0;
+  burst_count = 0;
+#endif /* TSCH_BURST_MAX_LEN > 1 */
 }
 /*---------------------------------------------------------------------------*/
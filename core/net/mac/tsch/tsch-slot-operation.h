@@ -92,6 +92,13 @@ struct input_packet {
   uint16_t rssi; /* RSSI for this packet */
 };
 
+/* Burst statistics, see TSCH_BURST_MAX_LEN */
+struct tsch_burst_stats {
+  uint32_t bursts; /* Number of bursts started */
+  uint32_t tx; /* Frames transmitted in burst slots */
+  uint32_t rx; /* Frames received in burst slots */
+};
+
 /***** External Variables *****/
 
 /* A ringbuf storing outgoing packets after they were dequeued.
@@ -102,6 +109,10 @@ extern struct tsch_packet *dequeued_array[TSCH_DEQUEUED_ARRAY_SIZE];
  * Will be processed layer by tsch_rx_process_pending */
 extern struct ringbufindex input_ringbuf;
 extern struct input_packet input_array[TSCH_MAX_INCOMING_PACKETS];
+#if TSCH_BURST_MAX_LEN > 1
+/* Counters of frames sent and received in bursts */
+extern struct tsch_burst_stats tsch_burst_stats;
+#endif /* TSCH_BURST_MAX_LEN > 1 */
 
 /********** Functions *********/
 
@@ -45,6 +45,7 @@
 #include "net/netstack.h"
 #include "net/packetbuf.h"
 #include "net/queuebuf.h"
+#include "net/link-stats.h"
 #include "net/mac/framer-802154.h"
 #include "net/mac/tsch/tsch.h"
 #include "net/mac/tsch/tsch-slot-operation.h"
@@ -386,6 +387,9 @@ tsch_tx_process_pending()
     struct tsch_packet *p = dequeued_array[dequeued_index];
     /* Put packet into packetbuf for packet_sent callback */
     queuebuf_to_packetbuf(p->qb);
+    /* Update link statistics, also for keep-alives that have no
+     * upper layer */
+    link_stats_packet_sent(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), p->ret, p->transmissions);
     /* Call packet_sent callback */
     mac_call_sent_callback(p->sent, p->ptr, p->ret, p->transmissions);
     /* Free packet queuebuf */
@@ -852,6 +856,7 @@ tsch_init(void)
   }
 
   /* Init TSCH sub-modules */
+  link_stats_init();
   tsch_reset();
   tsch_queue_init();
   tsch_schedule_init();
@@ -986,6 +991,7 @@ packet_input(void)
       PRINTF("TSCH: received from %u with seqno %u\n",
              TSCH_LOG_ID_FROM_LINKADDR(packetbuf_addr(PACKETBUF_ADDR_SENDER)),
              packetbuf_attr(PACKETBUF_ATTR_MAC_SEQNO));
+      link_stats_input_callback(packetbuf_addr(PACKETBUF_ADDR_SENDER));
       NETSTACK_LLSEC.input();
     }
   }
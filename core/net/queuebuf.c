@@ -53,8 +53,10 @@
 /* Structure pointing to a buffer either stored
    in RAM or swapped in CFS */
 struct queuebuf {
-#if QUEUEBUF_DEBUG
+#if QUEUEBUF_DEBUG || WITH_SWAP
   struct queuebuf *next;
+#endif /* QUEUEBUF_DEBUG || WITH_SWAP */
+#if QUEUEBUF_DEBUG
   const char *file;
   int line;
   clock_time_t time;
@@ -109,12 +111,31 @@ static struct qbuf_file qbuf_files[NQBUF_FILES];
 /* The timer used to renew files during inactivity periods */
 static struct ctimer renew_timer;
 
+/*
+ * New queuebufs are stored in RAM whenever possible. In the background,
+ * the swap process writes the newest queuebufs to CFS while fewer than
+ * QUEUEBUF_SWAP_RAM_RESERVE RAM buffers are free, and reads the oldest
+ * swapped queuebufs back while more are free, so that they are in RAM
+ * when they are sent. Only when RAM runs out altogether are new
+ * queuebufs written to CFS directly.
+ */
+#ifdef QUEUEBUF_CONF_SWAP_RAM_RESERVE
+#define QUEUEBUF_SWAP_RAM_RESERVE QUEUEBUF_CONF_SWAP_RAM_RESERVE
+#else
+#define QUEUEBUF_SWAP_RAM_RESERVE 2
 #endif
 
-#if QUEUEBUF_DEBUG
+static struct queuebuf_swap_stats swap_stats;
+
+PROCESS(queuebuf_swap_process, "Queuebuf swap");
+
+#endif
+
+#if QUEUEBUF_DEBUG || WITH_SWAP
 #include "lib/list.h"
+/* All queuebufs, from the oldest to the newest */
 LIST(queuebuf_list);
-#endif /* QUEUEBUF_DEBUG */
+#endif /* QUEUEBUF_DEBUG || WITH_SWAP */
 
 #define DEBUG 0
 #if DEBUG
@@ -184,7 +205,7 @@ queuebuf_remove_from_file(int swap_id)
       ctimer_set(&renew_timer, 0, qbuf_renew_all, NULL);
     }
 
-    if(tmpdata_qbuf->swap_id == swap_id) {
+    if(tmpdata_qbuf != NULL && tmpdata_qbuf->swap_id == swap_id) {
       tmpdata_qbuf->swap_id = -1;
     }
   }
@@ -209,31 +230,66 @@ get_new_swap_id(void)
   return swap_id;
 }
 /*---------------------------------------------------------------------------*/
-/* Flush tmpdata to CFS */
+/* Write the data of a queuebuf to a new place in CFS */
 static int
-queuebuf_flush_tmpdata(void)
+queuebuf_write_to_file(struct queuebuf *b, struct queuebuf_data *data)
+{
+  int fileid, fd, ret;
+  cfs_offset_t offset;
+
+  queuebuf_remove_from_file(b->swap_id);
+  b->swap_id = get_new_swap_id();
+  if(b->swap_id == -1) {
+    return -1;
+  }
+  fileid = b->swap_id / NQBUF_PER_FILE;
+  offset = (b->swap_id % NQBUF_PER_FILE) * sizeof(struct queuebuf_data);
+  fd = qbuf_files[fileid].fd;
+  ret = cfs_seek(fd, offset, CFS_SEEK_SET);
+  if(ret == -1) {
+    PRINTF("queuebuf_write_to_file: cfs seek error\n");
+    goto error;
+  }
+  ret = cfs_write(fd, data, sizeof(struct queuebuf_data));
+  if(ret != sizeof(struct queuebuf_data)) {
+    PRINTF("queuebuf_write_to_file: cfs write error\n");
+    goto error;
+  }
+  return 0;
+
+error:
+  /* Give the slot back */
+  queuebuf_remove_from_file(b->swap_id);
+  b->swap_id = -1;
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+/* Read the data of a queuebuf from CFS */
+static void
+queuebuf_read_from_file(struct queuebuf *b, struct queuebuf_data *data)
 {
   int fileid, fd, ret;
   cfs_offset_t offset;
+
+  fileid = b->swap_id / NQBUF_PER_FILE;
+  offset = (b->swap_id % NQBUF_PER_FILE) * sizeof(struct queuebuf_data);
+  fd = qbuf_files[fileid].fd;
+  ret = cfs_seek(fd, offset, CFS_SEEK_SET);
+  if(ret == -1) {
+    PRINTF("queuebuf_read_from_file: cfs seek error\n");
+  }
+  ret = cfs_read(fd, data, sizeof(struct queuebuf_data));
+  if(ret == -1) {
+    PRINTF("queuebuf_read_from_file: cfs read error\n");
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Flush tmpdata to CFS */
+static int
+queuebuf_flush_tmpdata(void)
+{
   if(tmpdata_qbuf) {
-    queuebuf_remove_from_file(tmpdata_qbuf->swap_id);
-    tmpdata_qbuf->swap_id = get_new_swap_id();
-    if(tmpdata_qbuf->swap_id == -1) {
-      return -1;
-    }
-    fileid = tmpdata_qbuf->swap_id / NQBUF_PER_FILE;
-    offset = (tmpdata_qbuf->swap_id % NQBUF_PER_FILE) * sizeof(struct queuebuf_data);
-    fd = qbuf_files[fileid].fd;
-    ret = cfs_seek(fd, offset, CFS_SEEK_SET);
-    if(ret == -1) {
-      PRINTF("queuebuf_flush_tmpdata: cfs seek error\n");
-      return -1;
-    }
-    ret = cfs_write(fd, &tmpdata, sizeof(struct queuebuf_data));
-    if(ret == -1) {
-      PRINTF("queuebuf_flush_tmpdata: cfs write error\n");
-      return -1;
-    }
+    return queuebuf_write_to_file(tmpdata_qbuf, &tmpdata);
   }
   return 0;
 }
@@ -242,8 +298,6 @@ queuebuf_flush_tmpdata(void)
 static struct queuebuf_data *
 queuebuf_load_to_ram(struct queuebuf *b)
 {
-  int fileid, fd, ret;
-  cfs_offset_t offset;
   if(b->location == IN_RAM) { /* the qbuf is loacted in RAM */
     return b->ram_ptr;
   } else { /* the qbuf is located in CFS */
@@ -251,22 +305,133 @@ queuebuf_load_to_ram(struct queuebuf *b)
       return &tmpdata;
     } else { /* the qbuf needs to be loaded from CFS */
       tmpdata_qbuf = b;
-      /* read the qbuf from CFS */
-      fileid = b->swap_id / NQBUF_PER_FILE;
-      offset = (b->swap_id % NQBUF_PER_FILE) * sizeof(struct queuebuf_data);
-      fd = qbuf_files[fileid].fd;
-      ret = cfs_seek(fd, offset, CFS_SEEK_SET);
-      if(ret == -1) {
-        PRINTF("queuebuf_load_to_ram: cfs seek error\n");
-      }
-      ret = cfs_read(fd, &tmpdata, sizeof(struct queuebuf_data));
-      if(ret == -1) {
-        PRINTF("queuebuf_load_to_ram: cfs read error\n");
-      }
+      queuebuf_read_from_file(b, &tmpdata);
+      swap_stats.misses++;
       return &tmpdata;
     }
   }
 }
+/*---------------------------------------------------------------------------*/
+/* Move the newest queuebuf in RAM, except the oldest queuebuf, to CFS */
+static int
+queuebuf_spill(void)
+{
+  struct queuebuf *b, *newest;
+  struct queuebuf_data *data;
+
+  newest = NULL;
+  for(b = list_item_next(list_head(queuebuf_list)); b != NULL;
+      b = list_item_next(b)) {
+    if(b->location == IN_RAM) {
+      newest = b;
+    }
+  }
+  if(newest == NULL) {
+    return -1;
+  }
+
+  data = newest->ram_ptr;
+  newest->location = IN_CFS;
+  newest->swap_id = -1;
+  if(queuebuf_write_to_file(newest, data) == -1) {
+    newest->location = IN_RAM;
+    newest->ram_ptr = data;
+    return -1;
+  }
+  memb_free(&buframmem, data);
+
+  swap_stats.in_ram--;
+  swap_stats.in_swap++;
+  swap_stats.spills++;
+  if(swap_stats.in_swap > swap_stats.max_in_swap) {
+    swap_stats.max_in_swap = swap_stats.in_swap;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Move the oldest queuebuf in CFS to RAM */
+static int
+queuebuf_prefetch(void)
+{
+  struct queuebuf *b;
+  struct queuebuf_data *data;
+
+  for(b = list_head(queuebuf_list); b != NULL; b = list_item_next(b)) {
+    if(b->location == IN_CFS) {
+      break;
+    }
+  }
+  if(b == NULL) {
+    return -1;
+  }
+
+  data = memb_alloc(&buframmem);
+  if(data == NULL) {
+    return -1;
+  }
+  if(tmpdata_qbuf == b) {
+    memcpy(data, &tmpdata, sizeof(struct queuebuf_data));
+    tmpdata_qbuf = NULL;
+  } else {
+    queuebuf_read_from_file(b, data);
+  }
+  queuebuf_remove_from_file(b->swap_id);
+  b->location = IN_RAM;
+  b->ram_ptr = data;
+
+  swap_stats.in_swap--;
+  swap_stats.in_ram++;
+  swap_stats.prefetches++;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Whether the swap process has something to do */
+static int
+queuebuf_swap_pending(void)
+{
+  int numfree;
+
+  numfree = memb_numfree(&buframmem);
+  return (numfree < QUEUEBUF_SWAP_RAM_RESERVE && swap_stats.in_ram > 1) ||
+    (numfree > QUEUEBUF_SWAP_RAM_RESERVE && swap_stats.in_swap > 0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+queuebuf_poll_swap(void)
+{
+  if(queuebuf_swap_pending()) {
+    process_poll(&queuebuf_swap_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(queuebuf_swap_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    /* Move one queuebuf at a time, letting other processes run between. */
+    while(queuebuf_swap_pending()) {
+      if(memb_numfree(&buframmem) < QUEUEBUF_SWAP_RAM_RESERVE) {
+        if(queuebuf_spill() == -1) {
+          break;
+        }
+      } else if(queuebuf_prefetch() == -1) {
+        break;
+      }
+      PROCESS_PAUSE();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+queuebuf_swap_get_stats(struct queuebuf_swap_stats *stats)
+{
+  *stats = swap_stats;
+}
 #else /* WITH_SWAP */
 /*---------------------------------------------------------------------------*/
 static struct queuebuf_data *
@@ -285,6 +450,8 @@ queuebuf_init(void)
     qbuf_files[i].renewable = 1;
     qbuf_renew_file(i);
   }
+  memset(&swap_stats, 0, sizeof(swap_stats));
+  process_start(&queuebuf_swap_process, NULL);
 #endif
   memb_init(&buframmem);
   memb_init(&bufmem);
@@ -313,7 +480,6 @@ queuebuf_new_from_packetbuf(void)
   buf = memb_alloc(&bufmem);
   if(buf != NULL) {
 #if QUEUEBUF_DEBUG
-    list_add(queuebuf_list, buf);
     buf->file = file;
     buf->line = line;
     buf->time = clock_time();
@@ -346,12 +512,28 @@ queuebuf_new_from_packetbuf(void)
     if(buf->location == IN_CFS) {
       if(queuebuf_flush_tmpdata() == -1) {
         /* We were unable to write the data in the swap */
+        tmpdata_qbuf = NULL;
         memb_free(&bufmem, buf);
+        swap_stats.failures++;
         return NULL;
       }
+      swap_stats.in_swap++;
+      swap_stats.sync_spills++;
+      if(swap_stats.in_swap > swap_stats.max_in_swap) {
+        swap_stats.max_in_swap = swap_stats.in_swap;
+      }
+    } else {
+      swap_stats.in_ram++;
     }
 #endif
 
+#if QUEUEBUF_DEBUG || WITH_SWAP
+    list_add(queuebuf_list, buf);
+#endif /* QUEUEBUF_DEBUG || WITH_SWAP */
+#if WITH_SWAP
+    queuebuf_poll_swap();
+#endif
+
 #if QUEUEBUF_STATS
     ++queuebuf_len;
     PRINTF("#A q=%d\n", queuebuf_len);
@@ -398,8 +580,13 @@ queuebuf_free(struct queuebuf *buf)
 #if WITH_SWAP
     if(buf->location == IN_RAM) {
       memb_free(&buframmem, buf->ram_ptr);
+      swap_stats.in_ram--;
     } else {
       queuebuf_remove_from_file(buf->swap_id);
+      if(tmpdata_qbuf == buf) {
+        tmpdata_qbuf = NULL;
+      }
+      swap_stats.in_swap--;
     }
 #else
     memb_free(&buframmem, buf->ram_ptr);
@@ -409,9 +596,12 @@ queuebuf_free(struct queuebuf *buf)
     --queuebuf_len;
     PRINTF("#A q=%d\n", queuebuf_len);
 #endif /* QUEUEBUF_STATS */
-#if QUEUEBUF_DEBUG
+#if QUEUEBUF_DEBUG || WITH_SWAP
     list_remove(queuebuf_list, buf);
-#endif /* QUEUEBUF_DEBUG */
+#endif /* QUEUEBUF_DEBUG || WITH_SWAP */
+#if WITH_SWAP
+    queuebuf_poll_swap();
+#endif
   }
 }
 /*---------------------------------------------------------------------------*/
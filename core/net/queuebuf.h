@@ -111,6 +111,28 @@ void queuebuf_debug_print(void);
 
 int queuebuf_numfree(void);
 
+#if WITH_SWAP
+/* Occupancy and traffic of the two tiers of queuebuf storage */
+struct queuebuf_swap_stats {
+  /* Queuebufs currently in RAM and in CFS */
+  uint16_t in_ram;
+  uint16_t in_swap;
+  uint16_t max_in_swap;
+  /* Queuebufs moved to CFS in the background */
+  uint32_t spills;
+  /* Queuebufs written to CFS on allocation, because RAM was full */
+  uint32_t sync_spills;
+  /* Queuebufs moved back to RAM in the background */
+  uint32_t prefetches;
+  /* Accesses to queuebufs that had to be read from CFS */
+  uint32_t misses;
+  /* Allocations that failed because CFS was full */
+  uint32_t failures;
+};
+
+void queuebuf_swap_get_stats(struct queuebuf_swap_stats *stats);
+#endif /* WITH_SWAP */
+
 #endif /* __QUEUEBUF_H__ */
 
 /** @} */
@@ -70,6 +70,35 @@
 #define RPL_OF rpl_mrhof
 #endif /* RPL_CONF_OF */
 
+/*
+ * The objective functions that this node can join instances with, as an
+ * array initializer, e.g., { &rpl_mrhof, &rpl_of0 }. Instances rooted at
+ * this node use RPL_OF unless changed with rpl_set_of().
+ */
+#ifdef RPL_CONF_SUPPORTED_OFS
+#define RPL_SUPPORTED_OFS RPL_CONF_SUPPORTED_OFS
+#else
+#define RPL_SUPPORTED_OFS { &RPL_OF }
+#endif /* RPL_CONF_SUPPORTED_OFS */
+
+/* DAG Mode of Operation */
+#define RPL_MOP_NO_DOWNWARD_ROUTES      0
+#define RPL_MOP_NON_STORING             1
+#define RPL_MOP_STORING_NO_MULTICAST    2
+#define RPL_MOP_STORING_MULTICAST       3
+
+/*
+ * Non-storing mode is selected with RPL_CONF_MOP = RPL_MOP_NON_STORING.
+ * The root then keeps the topology of the DODAG and inserts source
+ * routing headers (RFC 6554) in downward packets, while the other nodes
+ * store no downward route at all.
+ */
+#if defined(RPL_CONF_MOP) && RPL_CONF_MOP == RPL_MOP_NON_STORING
+#define RPL_WITH_NON_STORING 1
+#else
+#define RPL_WITH_NON_STORING 0
+#endif /* RPL_CONF_MOP */
+
 /* This value decides which DAG instance we should participate in by default. */
 #ifdef RPL_CONF_DEFAULT_INSTANCE
 #define RPL_DEFAULT_INSTANCE RPL_CONF_DEFAULT_INSTANCE
@@ -296,6 +325,33 @@
     + random_rand() % (RPL_PROBING_INTERVAL))
 #endif
 
+/*
+ * Fast parent failover. The best backup parent is probed, with
+ * RPL_PROBING_SEND_FUNC, every RPL_FAILOVER_PROBING_INTERVAL on average
+ * so that its link statistics stay fresh. After
+ * RPL_FAILOVER_NOACK_THRESHOLD unacknowledged transmissions in a row,
+ * the preferred parent is dropped at once if a backup parent with fresh
+ * link statistics is available, instead of waiting for its ETX to
+ * degrade.
+ */
+#ifdef RPL_CONF_WITH_FAST_FAILOVER
+#define RPL_WITH_FAST_FAILOVER RPL_CONF_WITH_FAST_FAILOVER
+#else
+#define RPL_WITH_FAST_FAILOVER 0
+#endif
+
+#ifdef RPL_CONF_FAILOVER_PROBING_INTERVAL
+#define RPL_FAILOVER_PROBING_INTERVAL RPL_CONF_FAILOVER_PROBING_INTERVAL
+#else
+#define RPL_FAILOVER_PROBING_INTERVAL (30 * CLOCK_SECOND)
+#endif
+
+#ifdef RPL_CONF_FAILOVER_NOACK_THRESHOLD
+#define RPL_FAILOVER_NOACK_THRESHOLD RPL_CONF_FAILOVER_NOACK_THRESHOLD
+#else
+#define RPL_FAILOVER_NOACK_THRESHOLD 2
+#endif
+
 /*
  * Interval of DIS transmission
  */
@@ -209,8 +209,7 @@ rpl_dag_root_init_dag_immediately(void)
       rpl_remove_routes(dag);
       if(dag->instance != NULL &&
          dag->instance->def_route != NULL) {
-	uip_ds6_defrt_rm(dag->instance->def_route);
-        dag->instance->def_route = NULL;
+        rpl_remove_default_route(dag->instance);
       }
 
       uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
@@ -49,6 +49,7 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6-nbr.h"
 #include "net/nbr-table.h"
+#include "net/mac/mac.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 #include "lib/list.h"
 #include "lib/memb.h"
@@ -67,7 +68,7 @@ void RPL_CALLBACK_PARENT_SWITCH(rpl_parent_t *old, rpl_parent_t *new);
 
 /*---------------------------------------------------------------------------*/
 extern rpl_of_t RPL_OF;
-static rpl_of_t * const objective_functions[] = {&RPL_OF};
+static rpl_of_t * const objective_functions[] = RPL_SUPPORTED_OFS;
 
 /*---------------------------------------------------------------------------*/
 /* RPL definitions. */
@@ -81,6 +82,15 @@ static rpl_of_t * const objective_functions[] = {&RPL_OF};
 /*---------------------------------------------------------------------------*/
 /* Per-parent RPL information */
 NBR_TABLE_GLOBAL(rpl_parent_t, rpl_parents);
+/*
+ * Candidate parents of all DAGs, ordered by the path cost reported by
+ * the objective function. A parent is only repositioned when an event
+ * concerning it is processed, so the first eligible entry is the lowest
+ * cost parent of a DAG without scanning the neighbor table.
+ */
+LIST(candidates);
+/* Number of parents flagged with RPL_PARENT_FLAG_UPDATED. */
+static uint8_t num_updated_parents;
 /*---------------------------------------------------------------------------*/
 /* Allocate instance table. */
 rpl_instance_t instance_table[RPL_MAX_INSTANCES];
@@ -99,10 +109,9 @@ rpl_print_neighbor_list(void)
 
     printf("RPL: rank %u dioint %u, %u nbr(s)\n", curr_rank, curr_dio_interval, uip_ds6_nbr_num());
     while(p != NULL) {
-      uip_ds6_nbr_t *nbr = rpl_get_nbr(p);
       printf("RPL: nbr %3u %5u, %5u => %5u %c%c (last tx %u min ago)\n",
           nbr_table_get_lladdr(rpl_parents, p)->u8[7],
-          p->rank, nbr ? nbr->link_metric : 0,
+          p->rank, rpl_get_parent_link_metric(p),
           default_instance->of->calculate_rank(p, 0),
           default_instance->current_dag == p->dag ? 'd' : ' ',
           p == default_instance->current_dag->preferred_parent ? '*' : ' ',
@@ -125,6 +134,38 @@ rpl_get_nbr(rpl_parent_t *parent)
   }
 }
 /*---------------------------------------------------------------------------*/
+static uint16_t
+candidate_cost(rpl_parent_t *p)
+{
+  rpl_of_t *of;
+
+  if(p->dag == NULL || p->rank == INFINITE_RANK) {
+    return 0xffff;
+  }
+  of = p->dag->instance->of;
+  if(of == NULL || of->parent_path_cost == NULL) {
+    return 0xffff;
+  }
+  return of->parent_path_cost(p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+update_candidate(rpl_parent_t *p)
+{
+  rpl_parent_t *q, *prev;
+
+  list_remove(candidates, p);
+  p->path_cost = candidate_cost(p);
+
+  prev = NULL;
+  for(q = list_head(candidates);
+      q != NULL && q->path_cost <= p->path_cost;
+      q = list_item_next(q)) {
+    prev = q;
+  }
+  list_insert(candidates, prev, p);
+}
+/*---------------------------------------------------------------------------*/
 static void
 nbr_callback(void *ptr)
 {
@@ -134,9 +175,22 @@ nbr_callback(void *ptr)
 void
 rpl_dag_init(void)
 {
+  list_init(candidates);
+  num_updated_parents = 0;
   nbr_table_register(rpl_parents, (nbr_table_callback *)nbr_callback);
 }
 /*---------------------------------------------------------------------------*/
+void
+rpl_parent_updated(rpl_parent_t *p)
+{
+  if(!(p->flags & RPL_PARENT_FLAG_UPDATED)) {
+    p->flags |= RPL_PARENT_FLAG_UPDATED;
+    if(num_updated_parents < 0xff) {
+      num_updated_parents++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 rpl_parent_t *
 rpl_get_parent(uip_lladdr_t *addr)
 {
@@ -155,16 +209,24 @@ rpl_get_parent_rank(uip_lladdr_t *addr)
   }
 }
 /*---------------------------------------------------------------------------*/
+const struct link_stats *
+rpl_get_parent_link_stats(rpl_parent_t *p)
+{
+  const linkaddr_t *lladdr = nbr_table_get_lladdr(rpl_parents, p);
+  return lladdr != NULL ? link_stats_from_lladdr(lladdr) : NULL;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
-rpl_get_parent_link_metric(const uip_lladdr_t *addr)
+rpl_get_parent_link_metric(rpl_parent_t *p)
 {
-  uip_ds6_nbr_t *nbr;
-  nbr = nbr_table_get_from_lladdr(ds6_neighbors, (const linkaddr_t *)addr);
+  const struct link_stats *stats = rpl_get_parent_link_stats(p);
 
-  if(nbr != NULL) {
-    return nbr->link_metric;
+  if(stats != NULL && stats->tx_count > 0) {
+    /* ETX as measured by the link layer */
+    return (uint32_t)stats->etx * RPL_DAG_MC_ETX_DIVISOR / LINK_STATS_ETX_DIVISOR;
   } else {
-    return 0;
+    /* We have not transmitted to this parent yet */
+    return RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -402,6 +464,31 @@ rpl_repair_root(uint8_t instance_id)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+/* Select the objective function of an instance rooted at this node. This
+   should be done right after rpl_set_root(), as nodes that have already
+   joined treat DIOs with a different OCP as incompatible. */
+int
+rpl_set_of(rpl_dag_t *dag, rpl_of_t *of)
+{
+  rpl_instance_t *instance;
+
+  if(dag == NULL || of == NULL) {
+    return 0;
+  }
+
+  instance = dag->instance;
+  if(dag->rank != ROOT_RANK(instance)) {
+    PRINTF("RPL: rpl_set_of triggered but not root\n");
+    return 0;
+  }
+
+  instance->of = of;
+  of->reset(dag);
+  of->update_metric_container(instance);
+  PRINTF("RPL: Instance %u uses OCP %u\n", instance->instance_id, of->ocp);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 static void
 set_ip_from_prefix(uip_ipaddr_t *ipaddr, rpl_prefix_t *prefix)
 {
@@ -475,6 +562,28 @@ rpl_set_prefix(rpl_dag_t *dag, uip_ipaddr_t *prefix, unsigned len)
   return 1;
 }
 /*---------------------------------------------------------------------------*/
+void
+rpl_remove_default_route(rpl_instance_t *instance)
+{
+  rpl_instance_t *i, *end;
+
+  if(instance->def_route == NULL) {
+    return;
+  }
+
+  /* Instances with the same preferred parent share its default router
+     entry; only the last one of them removes it. */
+  for(i = &instance_table[0], end = i + RPL_MAX_INSTANCES; i < end; ++i) {
+    if(i != instance && i->used && i->def_route == instance->def_route) {
+      instance->def_route = NULL;
+      return;
+    }
+  }
+
+  uip_ds6_defrt_rm(instance->def_route);
+  instance->def_route = NULL;
+}
+/*---------------------------------------------------------------------------*/
 int
 rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from)
 {
@@ -482,8 +591,7 @@ rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from)
     PRINTF("RPL: Removing default route through ");
     PRINT6ADDR(&instance->def_route->ipaddr);
     PRINTF("\n");
-    uip_ds6_defrt_rm(instance->def_route);
-    instance->def_route = NULL;
+    rpl_remove_default_route(instance);
   }
 
   if(from != NULL) {
@@ -521,6 +629,9 @@ rpl_alloc_instance(uint8_t instance_id)
 #if RPL_WITH_PROBING
       rpl_schedule_probing(instance);
 #endif /* RPL_WITH_PROBING */
+#if RPL_WITH_FAST_FAILOVER
+      rpl_schedule_failover_probing(instance);
+#endif /* RPL_WITH_FAST_FAILOVER */
       return instance;
     }
   }
@@ -589,6 +700,9 @@ rpl_free_instance(rpl_instance_t *instance)
 #if RPL_WITH_PROBING
   ctimer_stop(&instance->probing_timer);
 #endif /* RPL_WITH_PROBING */
+#if RPL_WITH_FAST_FAILOVER
+  ctimer_stop(&instance->failover_timer);
+#endif /* RPL_WITH_FAST_FAILOVER */
   ctimer_stop(&instance->dio_timer);
   ctimer_stop(&instance->dao_timer);
   ctimer_stop(&instance->dao_lifetime_timer);
@@ -634,25 +748,23 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
   PRINT6ADDR(addr);
   PRINTF("\n");
   if(lladdr != NULL) {
+    /* An existing entry is cleared by nbr_table_add_lladdr() below. */
+    p = nbr_table_get_from_lladdr(rpl_parents, (linkaddr_t *)lladdr);
+    if(p != NULL) {
+      list_remove(candidates, p);
+    }
     /* Add parent in rpl_parents */
     p = nbr_table_add_lladdr(rpl_parents, (linkaddr_t *)lladdr);
     if(p == NULL) {
       PRINTF("RPL: rpl_add_parent p NULL\n");
     } else {
-      uip_ds6_nbr_t *nbr;
-      nbr = rpl_get_nbr(p);
-
       p->dag = dag;
       p->rank = dio->rank;
       p->dtsn = dio->dtsn;
-
-      /* Check whether we have a neighbor that has not gotten a link metric yet */
-      if(nbr != NULL && nbr->link_metric == 0) {
-	nbr->link_metric = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
-      }
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
+      update_candidate(p);
     }
   }
 
@@ -798,8 +910,27 @@ static rpl_parent_t *
 best_parent(rpl_dag_t *dag)
 {
   rpl_parent_t *p, *best;
+  rpl_of_t *of;
 
   best = NULL;
+  of = dag->instance->of;
+
+  if(of->parent_path_cost != NULL) {
+    /* The first eligible candidate has the lowest path cost. */
+    for(best = list_head(candidates); best != NULL;
+        best = list_item_next(best)) {
+      if(best->dag == dag && best->rank != INFINITE_RANK) {
+        break;
+      }
+    }
+    p = dag->preferred_parent;
+    if(best != NULL && p != NULL && p != best &&
+       p->dag == dag && p->rank != INFINITE_RANK) {
+      /* Let the OF apply its hysteresis against the preferred parent. */
+      best = of->best_parent(p, best);
+    }
+    return best;
+  }
 
   p = nbr_table_head(rpl_parents);
   while(p != NULL) {
@@ -808,7 +939,7 @@ best_parent(rpl_dag_t *dag)
     } else if(best == NULL) {
       best = p;
     } else {
-      best = dag->instance->of->best_parent(best, p);
+      best = of->best_parent(best, p);
     }
     p = nbr_table_next(rpl_parents, p);
   }
@@ -831,6 +962,68 @@ rpl_select_parent(rpl_dag_t *dag)
   return best;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_FAST_FAILOVER
+/* The candidate that would replace the preferred parent of a DAG. With
+   "validated" set, only a candidate with fresh link statistics, i.e.,
+   one that has recently acknowledged our probes or traffic, qualifies. */
+rpl_parent_t *
+rpl_get_backup_parent(rpl_dag_t *dag, int validated)
+{
+  rpl_parent_t *p;
+
+  if(dag == NULL) {
+    return NULL;
+  }
+
+  for(p = list_head(candidates); p != NULL; p = list_item_next(p)) {
+    if(p->dag == dag && p != dag->preferred_parent &&
+       p->rank != INFINITE_RANK &&
+       acceptable_rank(dag, dag->instance->of->calculate_rank(p, 0)) &&
+       (!validated || link_stats_is_fresh(rpl_get_parent_link_stats(p)))) {
+      return p;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_failover_link_callback(rpl_parent_t *p, int status)
+{
+  rpl_dag_t *dag;
+
+  if(status == MAC_TX_OK) {
+    p->noack_count = 0;
+    return;
+  }
+
+  dag = p->dag;
+  if(status != MAC_TX_NOACK || dag == NULL || p != dag->preferred_parent) {
+    return;
+  }
+
+  if(++p->noack_count < RPL_FAILOVER_NOACK_THRESHOLD) {
+    return;
+  }
+  p->noack_count = 0;
+
+  if(rpl_get_backup_parent(dag, 1) == NULL) {
+    PRINTF("RPL: Preferred parent is failing, but there is no validated backup\n");
+    return;
+  }
+
+  PRINTF("RPL: Failing over from preferred parent ");
+  PRINT6ADDR(rpl_get_parent_ipaddr(p));
+  PRINTF("\n");
+
+  /* Ignore the parent until its next DIO, and let the parent event be
+     processed outside of the MAC callback. */
+  p->rank = INFINITE_RANK;
+  rpl_parent_updated(p);
+  RPL_STAT(rpl_stats.failovers++);
+  rpl_schedule_failover_immediately(dag->instance);
+}
+#endif /* RPL_WITH_FAST_FAILOVER */
+/*---------------------------------------------------------------------------*/
 void
 rpl_remove_parent(rpl_parent_t *parent)
 {
@@ -840,6 +1033,10 @@ rpl_remove_parent(rpl_parent_t *parent)
 
   rpl_nullify_parent(parent);
 
+  list_remove(candidates, parent);
+  if((parent->flags & RPL_PARENT_FLAG_UPDATED) && num_updated_parents > 0) {
+    num_updated_parents--;
+  }
   nbr_table_remove(rpl_parents, parent);
 }
 /*---------------------------------------------------------------------------*/
@@ -856,8 +1053,7 @@ rpl_nullify_parent(rpl_parent_t *parent)
         PRINTF("RPL: Removing default route ");
         PRINT6ADDR(rpl_get_parent_ipaddr(parent));
         PRINTF("\n");
-        uip_ds6_defrt_rm(dag->instance->def_route);
-        dag->instance->def_route = NULL;
+        rpl_remove_default_route(dag->instance);
       }
       /* Send No-Path DAO only to preferred parent, if any */
       if(parent == dag->preferred_parent) {
@@ -883,8 +1079,7 @@ rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent)
       PRINT6ADDR(rpl_get_parent_ipaddr(parent));
       PRINTF("\n");
       PRINTF("rpl_move_parent\n");
-      uip_ds6_defrt_rm(dag_src->instance->def_route);
-      dag_src->instance->def_route = NULL;
+      rpl_remove_default_route(dag_src->instance);
     }
   } else if(dag_src->joined) {
     /* Remove uIPv6 routes that have this parent as the next hop. */
@@ -896,6 +1091,7 @@ rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent)
   PRINTF("\n");
 
   parent->dag = dag_dst;
+  update_candidate(parent);
 }
 /*---------------------------------------------------------------------------*/
 rpl_dag_t *
@@ -1182,19 +1378,40 @@ void
 rpl_recalculate_ranks(void)
 {
   rpl_parent_t *p;
+  int updated;
 
   /*
    * We recalculate ranks when we receive feedback from the system rather
    * than RPL protocol messages. This periodical recalculation is called
    * from a timer in order to keep the stack depth reasonably low.
    */
+  if(num_updated_parents == 0) {
+    return;
+  }
+
+  /* Reorder all updated parents first, so that each parent event below
+     selects among up-to-date path costs. */
+  updated = 0;
   p = nbr_table_head(rpl_parents);
   while(p != NULL) {
-    if(p->dag != NULL && p->dag->instance && (p->flags & RPL_PARENT_FLAG_UPDATED)) {
+    if(p->flags & RPL_PARENT_FLAG_UPDATED) {
+      update_candidate(p);
+      updated++;
+    }
+    p = nbr_table_next(rpl_parents, p);
+  }
+  num_updated_parents = 0;
+
+  p = nbr_table_head(rpl_parents);
+  while(p != NULL && updated > 0) {
+    if(p->flags & RPL_PARENT_FLAG_UPDATED) {
       p->flags &= ~RPL_PARENT_FLAG_UPDATED;
-      PRINTF("RPL: rpl_process_parent_event recalculate_ranks\n");
-      if(!rpl_process_parent_event(p->dag->instance, p)) {
-        PRINTF("RPL: A parent was dropped\n");
+      updated--;
+      if(p->dag != NULL && p->dag->instance) {
+        PRINTF("RPL: rpl_process_parent_event recalculate_ranks\n");
+        if(!rpl_process_parent_event(p->dag->instance, p)) {
+          PRINTF("RPL: A parent was dropped\n");
+        }
       }
     }
     p = nbr_table_next(rpl_parents, p);
@@ -1213,6 +1430,8 @@ rpl_process_parent_event(rpl_instance_t *instance, rpl_parent_t *p)
 
   return_value = 1;
 
+  update_candidate(p);
+
   if(!acceptable_rank(p->dag, p->rank)) {
     /* The candidate parent is no longer valid: the rank increase resulting
        from the choice of it as a parent would be too high. */
@@ -1395,14 +1614,14 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
   p->rank = dio->rank;
 
   /* Parent info has been updated, trigger rank recalculation */
-  p->flags |= RPL_PARENT_FLAG_UPDATED;
+  rpl_parent_updated(p);
 
   PRINTF("RPL: preferred DAG ");
   PRINT6ADDR(&instance->current_dag->dag_id);
   PRINTF(", rank %u, min_rank %u, ",
 	 instance->current_dag->rank, instance->current_dag->min_rank);
   PRINTF("parent rank %u, parent etx %u, link metric %u, instance etx %u\n",
-	 p->rank, -1/*p->mc.obj.etx*/, rpl_get_nbr(p)->link_metric, instance->mc.obj.etx);
+	 p->rank, -1/*p->mc.obj.etx*/, rpl_get_parent_link_metric(p), instance->mc.obj.etx);
 
   /* We have allocated a candidate parent; process the DIO further. */
 
@@ -64,6 +64,51 @@
 #define UIP_EXT_HDR_OPT_BUF       ((struct uip_ext_hdr_opt *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_PADN_BUF  ((struct uip_ext_hdr_opt_padn *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_RPL_BUF   ((struct uip_ext_hdr_opt_rpl *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
+#define UIP_RH_BUF                ((struct uip_routing_hdr *)&uip_buf[uip_l2_l3_hdr_len])
+#define UIP_RPL_SRH_BUF           ((struct uip_rpl_srh_hdr *)&uip_buf[uip_l2_l3_hdr_len + RPL_RH_LEN])
+
+/* A configurable function that returns the RPLInstanceID to use for a
+   packet originated by this node, e.g., based on its traffic class. */
+#ifdef RPL_CALLBACK_SELECT_INSTANCE
+uint8_t RPL_CALLBACK_SELECT_INSTANCE(void);
+#endif /* RPL_CALLBACK_SELECT_INSTANCE */
+/*---------------------------------------------------------------------------*/
+static rpl_instance_t *
+output_instance(void)
+{
+#ifdef RPL_CALLBACK_SELECT_INSTANCE
+  rpl_instance_t *instance;
+
+  instance = rpl_get_instance(RPL_CALLBACK_SELECT_INSTANCE());
+  if(instance != NULL && instance->current_dag != NULL &&
+     instance->current_dag->joined) {
+    return instance;
+  }
+#endif /* RPL_CALLBACK_SELECT_INSTANCE */
+  return default_instance;
+}
+/*---------------------------------------------------------------------------*/
+rpl_instance_t *
+rpl_get_packet_instance(void)
+{
+  rpl_instance_t *instance;
+  int uip_ext_opt_offset;
+  int last_uip_ext_len;
+
+  last_uip_ext_len = uip_ext_len;
+  uip_ext_len = 0;
+  uip_ext_opt_offset = 2;
+
+  instance = NULL;
+  if(UIP_IP_BUF->proto == UIP_PROTO_HBHO &&
+     UIP_HBHO_BUF->len == RPL_HOP_BY_HOP_LEN - 8 &&
+     UIP_EXT_HDR_OPT_RPL_BUF->opt_type == UIP_EXT_HDR_OPT_RPL) {
+    instance = rpl_get_instance(UIP_EXT_HDR_OPT_RPL_BUF->instance);
+  }
+
+  uip_ext_len = last_uip_ext_len;
+  return instance;
+}
 /*---------------------------------------------------------------------------*/
 int
 rpl_verify_header(int uip_ext_opt_offset)
@@ -103,7 +148,7 @@ rpl_verify_header(int uip_ext_opt_offset)
        the packet to be forwareded in the first place. We drop any
        routes that go through the neighbor that sent the packet to
        us. */
-    route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+    route = rpl_route_lookup(instance, &UIP_IP_BUF->destipaddr);
     if(route != NULL) {
       uip_ds6_route_rm(route);
     }
@@ -173,8 +218,11 @@ rpl_verify_header(int uip_ext_opt_offset)
 static void
 set_rpl_opt(unsigned uip_ext_opt_offset)
 {
+  rpl_instance_t *instance;
   uint8_t temp_len;
 
+  instance = output_instance();
+
   memmove(UIP_HBHO_NEXT_BUF, UIP_EXT_BUF, uip_len - UIP_IPH_LEN);
   memset(UIP_HBHO_BUF, 0, RPL_HOP_BY_HOP_LEN);
   UIP_HBHO_BUF->next = UIP_IP_BUF->proto;
@@ -183,7 +231,8 @@ set_rpl_opt(unsigned uip_ext_opt_offset)
   UIP_EXT_HDR_OPT_RPL_BUF->opt_type = UIP_EXT_HDR_OPT_RPL;
   UIP_EXT_HDR_OPT_RPL_BUF->opt_len = RPL_HDR_OPT_LEN;
   UIP_EXT_HDR_OPT_RPL_BUF->flags = 0;
-  UIP_EXT_HDR_OPT_RPL_BUF->instance = 0;
+  /* The sender rank is filled in by rpl_update_header_final() */
+  UIP_EXT_HDR_OPT_RPL_BUF->instance = instance != NULL ? instance->instance_id : 0;
   UIP_EXT_HDR_OPT_RPL_BUF->senderrank = 0;
   uip_len += RPL_HOP_BY_HOP_LEN;
   temp_len = UIP_IP_BUF->len[1];
@@ -254,7 +303,7 @@ rpl_update_header_empty(void)
        general not go back up again. If this happens, a
        RPL_HDR_OPT_FWD_ERR should be flagged. */
     if((UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
-      if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
+      if(rpl_route_lookup(instance, &UIP_IP_BUF->destipaddr) == NULL) {
         UIP_EXT_HDR_OPT_RPL_BUF->flags |= RPL_HDR_OPT_FWD_ERR;
         PRINTF("RPL forwarding error\n");
         /* We should send back the packet to the originating parent,
@@ -271,7 +320,7 @@ rpl_update_header_empty(void)
       /* Set the down extension flag correctly as described in Section
          11.2 of RFC6550. If the packet progresses along a DAO route,
          the down flag should be set. */
-      if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
+      if(rpl_route_lookup(instance, &UIP_IP_BUF->destipaddr) == NULL) {
         /* No route was found, so this packet will go towards the RPL
            root. If so, we should not set the down flag. */
         UIP_EXT_HDR_OPT_RPL_BUF->flags &= ~RPL_HDR_OPT_DOWN;
@@ -295,6 +344,7 @@ rpl_update_header_empty(void)
 int
 rpl_update_header_final(uip_ipaddr_t *addr)
 {
+  rpl_instance_t *instance;
   rpl_parent_t *parent;
   int uip_ext_opt_offset;
   int last_uip_ext_len;
@@ -313,16 +363,16 @@ rpl_update_header_final(uip_ipaddr_t *addr)
     if(UIP_EXT_HDR_OPT_BUF->type == UIP_EXT_HDR_OPT_RPL) {
       if(UIP_EXT_HDR_OPT_RPL_BUF->senderrank == 0) {
         PRINTF("RPL: Updating RPL option\n");
-        if(default_instance == NULL || !default_instance->used || !default_instance->current_dag->joined) {
-          PRINTF("RPL: Unable to add hop-by-hop extension header: incorrect default instance\n");
+        instance = rpl_get_instance(UIP_EXT_HDR_OPT_RPL_BUF->instance);
+        if(instance == NULL || !instance->used || !instance->current_dag->joined) {
+          PRINTF("RPL: Unable to add hop-by-hop extension header: incorrect instance\n");
           return 1;
         }
-        parent = rpl_find_parent(default_instance->current_dag, addr);
+        parent = rpl_find_parent(instance->current_dag, addr);
         if(parent == NULL || parent != parent->dag->preferred_parent) {
           UIP_EXT_HDR_OPT_RPL_BUF->flags = RPL_HDR_OPT_DOWN;
         }
-        UIP_EXT_HDR_OPT_RPL_BUF->instance = default_instance->instance_id;
-        UIP_EXT_HDR_OPT_RPL_BUF->senderrank = UIP_HTONS(default_instance->current_dag->rank);
+        UIP_EXT_HDR_OPT_RPL_BUF->senderrank = UIP_HTONS(instance->current_dag->rank);
       }
     }
   }
@@ -393,7 +443,7 @@ void
 rpl_insert_header(void)
 {
 #if RPL_INSERT_HBH_OPTION
-  if(default_instance != NULL && !uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+  if(output_instance() != NULL && !uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
     rpl_update_header_empty();
   }
 #endif
@@ -401,3 +451,237 @@ rpl_insert_header(void)
 /*---------------------------------------------------------------------------*/
 
 /** @}*/
+/*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+static uint8_t
+common_prefix_len(const uip_ipaddr_t *a, const uip_ipaddr_t *b)
+{
+  uint8_t len;
+
+  /* CmprI and CmprE are 4-bit fields: at most 15 octets can be elided */
+  for(len = 0; len < 15 && a->u8[len] == b->u8[len]; len++);
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* The instance of the packet in uip_buf, or the default instance for
+   packets without a hop-by-hop option */
+static rpl_instance_t *
+srh_instance(void)
+{
+  rpl_instance_t *instance;
+
+  instance = rpl_get_packet_instance();
+  return instance != NULL ? instance : default_instance;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_root_of_non_storing(rpl_instance_t *instance)
+{
+  return RPL_IS_NON_STORING(instance)
+    && instance->current_dag != NULL
+    && instance->current_dag->joined
+    && instance->current_dag->rank == ROOT_RANK(instance);
+}
+/*---------------------------------------------------------------------------*/
+static const struct uip_routing_hdr *
+find_srh(void)
+{
+  const uint8_t *next_hdr;
+  const uint8_t *hdr;
+
+  /* The SRH follows the IPv6 header, or a hop-by-hop header */
+  next_hdr = &UIP_IP_BUF->proto;
+  hdr = (const uint8_t *)UIP_IP_BUF + UIP_IPH_LEN;
+  if(*next_hdr == UIP_PROTO_HBHO) {
+    next_hdr = hdr;
+    hdr += (hdr[1] << 3) + 8;
+  }
+  if(*next_hdr == UIP_PROTO_ROUTING &&
+     ((const struct uip_routing_hdr *)hdr)->routing_type == RPL_RH_TYPE_SRH) {
+    return (const struct uip_routing_hdr *)hdr;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr)
+{
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  rpl_ns_node_t *dest_node;
+  int direct_child;
+
+  direct_child = 0;
+  instance = srh_instance();
+  if(is_root_of_non_storing(instance)) {
+    dag = instance->current_dag;
+    dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+    direct_child = dest_node != NULL && dest_node->parent != NULL &&
+      dest_node->parent == rpl_ns_get_node(dag, &dag->dag_id);
+  }
+
+  if(find_srh() != NULL || direct_child) {
+    /* The next hop is the destination, either because the root sends
+       to one of its children or because the SRH was processed already.
+       Send to its link-local address. */
+    uip_ipaddr_copy(ipaddr, &UIP_IP_BUF->destipaddr);
+    uip_create_linklocal_prefix(ipaddr);
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_process_srh_header(void)
+{
+  uint8_t cmpri, cmpre, cmpr;
+  uint8_t pad;
+  uint8_t n;
+  uint8_t segments_left;
+  uint8_t *addr_ptr;
+  uip_ipaddr_t current_dest;
+
+  /* Called from uip6.c with uip_ext_len pointing at the routing header */
+  if(UIP_RH_BUF->routing_type != RPL_RH_TYPE_SRH) {
+    PRINTF("RPL: unsupported routing header type %u\n",
+           UIP_RH_BUF->routing_type);
+    return 0;
+  }
+
+  segments_left = UIP_RH_BUF->seg_left;
+  cmpri = UIP_RPL_SRH_BUF->cmpr >> 4;
+  cmpre = UIP_RPL_SRH_BUF->cmpr & 0x0f;
+  pad = UIP_RPL_SRH_BUF->pad >> 4;
+  n = (((UIP_RH_BUF->len << 3) - pad - (16 - cmpre)) / (16 - cmpri)) + 1;
+
+  if(segments_left == 0 || segments_left > n) {
+    PRINTF("RPL: bad SRH, %u segments left of %u\n", segments_left, n);
+    return 0;
+  }
+
+  /* Swap the destination with the next address, Address[n - segments
+     left + 1] (RFC 6554, Section 4.2). Both share the elided prefix. */
+  segments_left--;
+  cmpr = segments_left == 0 ? cmpre : cmpri;
+  addr_ptr = ((uint8_t *)UIP_RH_BUF) + RPL_RH_LEN + RPL_SRH_LEN +
+    (n - segments_left - 1) * (16 - cmpri);
+  uip_ipaddr_copy(&current_dest, &UIP_IP_BUF->destipaddr);
+  memcpy(((uint8_t *)&UIP_IP_BUF->destipaddr) + cmpr, addr_ptr, 16 - cmpr);
+  memcpy(addr_ptr, ((uint8_t *)&current_dest) + cmpr, 16 - cmpr);
+  UIP_RH_BUF->seg_left = segments_left;
+
+  if(uip_is_addr_mcast(&UIP_IP_BUF->destipaddr) ||
+     uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("RPL: bad SRH, next hop is multicast or ourself\n");
+    return 0;
+  }
+
+  PRINTF("RPL: SRH next hop ");
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF(", %u segments left\n", segments_left);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_srh_insert(void)
+{
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  rpl_ns_node_t *dest_node;
+  rpl_ns_node_t *root_node;
+  rpl_ns_node_t *node;
+  uip_ipaddr_t node_addr;
+  uip_ipaddr_t parent_addr;
+  uint8_t cmpri, cmpre;
+  uint8_t n;
+  uint8_t pad;
+  uint16_t ext_len;
+  uint8_t *hop_ptr;
+
+  instance = srh_instance();
+  if(!is_root_of_non_storing(instance) ||
+     uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+    return 1;
+  }
+
+  dag = instance->current_dag;
+  dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+  root_node = rpl_ns_get_node(dag, &dag->dag_id);
+  if(dest_node == NULL || root_node == NULL ||
+     !rpl_ns_is_node_reachable(dag, &UIP_IP_BUF->destipaddr)) {
+    /* Not in the DODAG: regular forwarding */
+    PRINTF("RPL: SRH destination not in the DODAG\n");
+    return 1;
+  }
+
+  /* Walk up from the destination to find the number of addresses in the
+     SRH, all hops but the first one, and how much of them is elided. An
+     address is expanded with the prefix of the hop that processes it,
+     i.e. its parent. */
+  cmpri = 15;
+  cmpre = 15;
+  n = 0;
+  for(node = dest_node; node->parent != root_node; node = node->parent) {
+    rpl_ns_get_node_global_addr(&node_addr, node);
+    rpl_ns_get_node_global_addr(&parent_addr, node->parent);
+    if(node == dest_node) {
+      cmpre = common_prefix_len(&node_addr, &parent_addr);
+    } else {
+      cmpri = MIN(cmpri, common_prefix_len(&node_addr, &parent_addr));
+    }
+    n++;
+  }
+
+  if(n == 0) {
+    /* Direct child of the root, no SRH needed */
+    return 1;
+  }
+
+  ext_len = RPL_RH_LEN + RPL_SRH_LEN + (n - 1) * (16 - cmpri) + (16 - cmpre);
+  pad = (8 - (ext_len & 0x07)) & 0x07;
+  ext_len += pad;
+
+  /* The SRH replaces the RPL hop-by-hop option, if any */
+  rpl_remove_header();
+  if(uip_len + ext_len > UIP_BUFSIZE) {
+    PRINTF("RPL: Packet too long: impossible to add source routing header\n");
+    return 0;
+  }
+
+  uip_ext_len = 0;
+  memmove(((uint8_t *)UIP_EXT_BUF) + ext_len, UIP_EXT_BUF,
+          uip_len - UIP_IPH_LEN);
+  memset(UIP_EXT_BUF, 0, ext_len);
+
+  UIP_RH_BUF->next = UIP_IP_BUF->proto;
+  UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+  UIP_RH_BUF->len = (ext_len - 8) / 8;
+  UIP_RH_BUF->routing_type = RPL_RH_TYPE_SRH;
+  UIP_RH_BUF->seg_left = n;
+  UIP_RPL_SRH_BUF->cmpr = (cmpri << 4) + cmpre;
+  UIP_RPL_SRH_BUF->pad = pad << 4;
+
+  /* Fill in the addresses from the last one, Address[n] being the final
+     destination, and put the first hop in the IPv6 header */
+  hop_ptr = ((uint8_t *)UIP_RH_BUF) + ext_len - pad - (16 - cmpre);
+  for(node = dest_node; node->parent != root_node; node = node->parent) {
+    rpl_ns_get_node_global_addr(&node_addr, node);
+    if(node == dest_node) {
+      memcpy(hop_ptr, ((uint8_t *)&node_addr) + cmpre, 16 - cmpre);
+    } else {
+      hop_ptr -= 16 - cmpri;
+      memcpy(hop_ptr, ((uint8_t *)&node_addr) + cmpri, 16 - cmpri);
+    }
+  }
+  rpl_ns_get_node_global_addr(&UIP_IP_BUF->destipaddr, node);
+
+  uip_len += ext_len;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+
+  PRINTF("RPL: SRH inserted, %u segments, first hop ", n);
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF("\n");
+  return 1;
+}
+#endif /* RPL_WITH_NON_STORING */
@@ -53,6 +53,8 @@
 #include "net/rpl/rpl-private.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "lib/list.h"
+#include "lib/memb.h"
 
 #include <limits.h>
 #include <string.h>
@@ -577,6 +579,478 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Outgoing DAOs. In storing mode, the targets are queued per parent and
+ * sent together once the aggregation window is over, paced by a token
+ * bucket. With DAO-ACKs, a target stays in the queue until its DAO is
+ * acknowledged, and retransmissions are sent before new DAOs.
+ */
+struct dao_target {
+  struct dao_target *next;
+  rpl_instance_t *instance;
+  /* Aggregation window, then acknowledgement timeout */
+  struct timer timer;
+  uip_ipaddr_t parent;
+  uip_ipaddr_t prefix;
+  uint8_t prefixlen;
+  uint8_t lifetime;
+  uint8_t sequence;
+  uint8_t transmissions;
+};
+
+#if RPL_DAO_AGGREGATION_DELAY > 0
+#define DAO_TARGETS_PER_MSG RPL_DAO_MAX_TARGETS
+#else
+#define DAO_TARGETS_PER_MSG 1
+#endif
+
+MEMB(dao_target_memb, struct dao_target, RPL_DAO_QUEUE_SIZE);
+LIST(dao_target_list);
+static struct ctimer dao_send_timer;
+static struct timer dao_token_timer;
+static uint8_t dao_tokens = RPL_DAO_RATE_BURST;
+
+static void dao_send_pending(void *ptr);
+static void dao_send_targets(struct dao_target *lead);
+/*---------------------------------------------------------------------------*/
+static int
+dao_header(unsigned char *buffer, rpl_instance_t *instance, rpl_dag_t *dag)
+{
+  int pos;
+
+  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  pos = 0;
+
+  buffer[pos++] = instance->instance_id;
+  buffer[pos] = 0;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+#if RPL_CONF_DAO_ACK
+  buffer[pos] |= RPL_DAO_K_FLAG;
+#endif /* RPL_CONF_DAO_ACK */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_sequence;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+  pos+=sizeof(dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_target_option(unsigned char *buffer, int pos,
+                  const uip_ipaddr_t *prefix, uint8_t prefixlen)
+{
+  buffer[pos++] = RPL_OPTION_TARGET;
+  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = prefixlen;
+  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
+  return pos + ((prefixlen + 7) / CHAR_BIT);
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_transit_option(unsigned char *buffer, int pos, uint8_t lifetime,
+                   const uip_ipaddr_t *parent_prefix,
+                   const uip_ipaddr_t *parent_ipaddr)
+{
+  buffer[pos++] = RPL_OPTION_TRANSIT;
+  buffer[pos++] = parent_ipaddr != NULL ? 4 + 16 : 4;
+  buffer[pos++] = 0; /* flags - ignored */
+  buffer[pos++] = 0; /* path control - ignored */
+  buffer[pos++] = 0; /* path seq - ignored */
+  buffer[pos++] = lifetime;
+  if(parent_ipaddr != NULL) {
+    /* The global address of the parent: the prefix of the DAG ID and the
+       interface identifier of the link-local address */
+    memcpy(buffer + pos, parent_prefix, 8);
+    memcpy(buffer + pos + 8, ((const unsigned char *)parent_ipaddr) + 8, 8);
+    pos += 16;
+  }
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_schedule(void)
+{
+  struct dao_target *t;
+  clock_time_t delay;
+  clock_time_t remaining;
+
+  t = list_head(dao_target_list);
+  if(t == NULL) {
+    ctimer_stop(&dao_send_timer);
+    return;
+  }
+
+  delay = timer_remaining(&t->timer);
+  for(; t != NULL; t = list_item_next(t)) {
+    remaining = timer_expired(&t->timer) ? 0 : timer_remaining(&t->timer);
+    if(remaining < delay) {
+      delay = remaining;
+    }
+  }
+  if(dao_tokens == 0) {
+    remaining = timer_expired(&dao_token_timer) ?
+      0 : timer_remaining(&dao_token_timer);
+    if(remaining > delay) {
+      delay = remaining;
+    }
+  }
+  ctimer_set(&dao_send_timer, delay, dao_send_pending, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_instance_gone(struct dao_target *t)
+{
+  return !t->instance->used || t->instance->current_dag == NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Takes a token from the bucket, returns 0 if the bucket is empty */
+static int
+dao_take_token(void)
+{
+  /* Refill the token bucket */
+  while(dao_tokens < RPL_DAO_RATE_BURST && timer_expired(&dao_token_timer)) {
+    dao_tokens++;
+    timer_reset(&dao_token_timer);
+  }
+
+  if(dao_tokens == 0) {
+    return 0;
+  }
+  if(dao_tokens == RPL_DAO_RATE_BURST) {
+    timer_set(&dao_token_timer, RPL_DAO_RATE_INTERVAL);
+  }
+  dao_tokens--;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Send the targets that are still in their aggregation window right away,
+   as far as the token bucket allows */
+static void
+dao_flush(void)
+{
+  struct dao_target *t;
+
+  t = list_head(dao_target_list);
+  while(t != NULL) {
+    if(t->transmissions == 0 && !dao_instance_gone(t)) {
+      if(!dao_take_token()) {
+        return;
+      }
+      /* Sending may free targets: start over */
+      dao_send_targets(t);
+      t = list_head(dao_target_list);
+    } else {
+      t = list_item_next(t);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_queue_target(rpl_instance_t *instance, const uip_ipaddr_t *parent,
+                 const uip_ipaddr_t *prefix, uint8_t prefixlen,
+                 uint8_t lifetime)
+{
+  struct dao_target *t;
+
+  RPL_STAT(rpl_stats.dao_route_changes++);
+
+  for(t = list_head(dao_target_list); t != NULL; t = list_item_next(t)) {
+    if(t->instance == instance && t->prefixlen == prefixlen &&
+       uip_ipaddr_cmp(&t->prefix, prefix) &&
+       uip_ipaddr_cmp(&t->parent, parent)) {
+      break;
+    }
+  }
+
+  if(t == NULL) {
+    t = memb_alloc(&dao_target_memb);
+    if(t == NULL) {
+      /* The queue is full: send what is pending without waiting for the
+         end of the aggregation window */
+      PRINTF("RPL: DAO queue full, flushing\n");
+      dao_flush();
+      t = memb_alloc(&dao_target_memb);
+    }
+    if(t == NULL) {
+      /* Make room by giving up on the oldest target still waiting for an
+         ACK or, if the token bucket is empty, on the oldest one waiting
+         to be sent */
+      for(t = list_head(dao_target_list); t != NULL; t = list_item_next(t)) {
+        if(t->transmissions > 0 || dao_instance_gone(t)) {
+          break;
+        }
+      }
+      if(t == NULL) {
+        t = list_head(dao_target_list);
+      }
+      list_remove(dao_target_list, t);
+      RPL_STAT(rpl_stats.dao_drops++);
+    }
+    t->instance = instance;
+    uip_ipaddr_copy(&t->parent, parent);
+    uip_ipaddr_copy(&t->prefix, prefix);
+    t->prefixlen = prefixlen;
+    timer_set(&t->timer, RPL_DAO_AGGREGATION_DELAY);
+    list_add(dao_target_list, t);
+  } else if(t->transmissions > 0) {
+    /* The target was updated while its DAO was in flight: the new
+       content will be sent in a new DAO */
+    timer_set(&t->timer, RPL_DAO_AGGREGATION_DELAY);
+  }
+  t->lifetime = lifetime;
+  t->transmissions = 0;
+
+  dao_schedule();
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_free_target(struct dao_target *t)
+{
+  list_remove(dao_target_list, t);
+  memb_free(&dao_target_memb, t);
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_is_due(struct dao_target *t, struct dao_target *lead)
+{
+  if(t->instance != lead->instance || !uip_ipaddr_cmp(&t->parent, &lead->parent)) {
+    return 0;
+  }
+  /* New targets ride along before the end of their aggregation window,
+     targets in flight only once their acknowledgement timed out */
+  return t->transmissions == 0 || timer_expired(&t->timer);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_send_targets(struct dao_target *lead)
+{
+  struct dao_target *sel[DAO_TARGETS_PER_MSG];
+  uint8_t done[DAO_TARGETS_PER_MSG];
+  struct dao_target *t;
+  rpl_instance_t *instance;
+  unsigned char *buffer;
+  uip_ipaddr_t dest;
+  uint8_t lifetime;
+  int n, i, j;
+  int pos;
+
+  instance = lead->instance;
+  uip_ipaddr_copy(&dest, &lead->parent);
+
+  n = 0;
+  sel[n++] = lead;
+  for(t = list_head(dao_target_list);
+      t != NULL && n < DAO_TARGETS_PER_MSG; t = list_item_next(t)) {
+    if(t != lead && dao_is_due(t, lead)) {
+      sel[n++] = t;
+    }
+  }
+
+  buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_header(buffer, instance, instance->current_dag);
+
+  /* A transit option applies to all targets before it: group the
+     targets by lifetime */
+  memset(done, 0, sizeof(done));
+  for(i = 0; i < n; i++) {
+    if(done[i]) {
+      continue;
+    }
+    lifetime = sel[i]->lifetime;
+    for(j = i; j < n; j++) {
+      if(!done[j] && sel[j]->lifetime == lifetime) {
+        pos = dao_target_option(buffer, pos, &sel[j]->prefix, sel[j]->prefixlen);
+        done[j] = 1;
+      }
+    }
+    pos = dao_transit_option(buffer, pos, lifetime, NULL, NULL);
+  }
+
+  if(lead->transmissions == 0) {
+    RPL_STAT(rpl_stats.dao_sent++);
+  } else {
+    RPL_STAT(rpl_stats.dao_retransmissions++);
+  }
+  RPL_STAT(rpl_stats.dao_targets_sent += n);
+
+  for(i = 0; i < n; i++) {
+#if RPL_CONF_DAO_ACK
+    sel[i]->sequence = dao_sequence;
+    sel[i]->transmissions++;
+    timer_set(&sel[i]->timer, RPL_DAO_ACK_TIMEOUT);
+#else /* RPL_CONF_DAO_ACK */
+    dao_free_target(sel[i]);
+#endif /* RPL_CONF_DAO_ACK */
+  }
+
+  PRINTF("RPL: Sending a DAO with %d targets to ", n);
+  PRINT6ADDR(&dest);
+  PRINTF("\n");
+
+  uip_icmp6_send(&dest, ICMP6_RPL, RPL_CODE_DAO, pos);
+}
+/*---------------------------------------------------------------------------*/
+static void
+dao_send_pending(void *ptr)
+{
+  struct dao_target *t;
+  struct dao_target *next;
+  struct dao_target *lead;
+
+  /* Give up on targets that were never acknowledged, and on those of
+     instances that went away */
+  for(t = list_head(dao_target_list); t != NULL; t = next) {
+    next = list_item_next(t);
+    if(dao_instance_gone(t) ||
+       (t->transmissions > RPL_DAO_MAX_RETRANSMISSIONS &&
+        timer_expired(&t->timer))) {
+      PRINTF("RPL: Giving up on a DAO target\n");
+      RPL_STAT(rpl_stats.dao_drops++);
+      dao_free_target(t);
+    }
+  }
+
+  for(;;) {
+    /* Retransmissions first, then targets at the end of their window */
+    lead = NULL;
+    for(t = list_head(dao_target_list); t != NULL; t = list_item_next(t)) {
+      if(t->transmissions > 0 && timer_expired(&t->timer)) {
+        lead = t;
+        break;
+      }
+    }
+    if(lead == NULL) {
+      for(t = list_head(dao_target_list); t != NULL; t = list_item_next(t)) {
+        if(t->transmissions == 0 && timer_expired(&t->timer)) {
+          lead = t;
+          break;
+        }
+      }
+    }
+    if(lead == NULL || !dao_take_token()) {
+      break;
+    }
+    dao_send_targets(lead);
+  }
+
+  dao_schedule();
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the DAO-ACK status for the target, or -1 if it could not be
+   stored for lack of memory, in which case the sender should retry */
+static int
+dao_input_target(rpl_instance_t *instance, rpl_dag_t *dag,
+                 uip_ipaddr_t *dao_sender_addr, int learned_from,
+                 uip_ipaddr_t *prefix, uint8_t prefixlen, uint8_t lifetime)
+{
+  uip_ds6_route_t *rep;
+  uip_ds6_nbr_t *nbr;
+  int forward;
+  int status;
+
+  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+          (unsigned)lifetime, (unsigned)prefixlen);
+  PRINT6ADDR(prefix);
+  PRINTF("\n");
+
+  forward = 0;
+  status = RPL_DAO_ACK_UNCONDITIONAL_ACCEPT;
+
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(prefix)) {
+    mcast_group = uip_mcast6_route_add(prefix);
+    if(mcast_group) {
+      mcast_group->dag = dag;
+      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
+    } else {
+      status = -1;
+    }
+    forward = 1;
+    goto fwd_dao;
+  }
+#endif
+
+  rep = rpl_route_lookup(instance, prefix);
+
+  if(lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n");
+    /* No-Path DAO received; invoke the route purging routine. */
+    if(rep != NULL &&
+       rep->state.nopath_received == 0 &&
+       rep->length == prefixlen &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), dao_sender_addr)) {
+      PRINTF("RPL: Setting expiration timer for prefix ");
+      PRINT6ADDR(prefix);
+      PRINTF("\n");
+      rep->state.nopath_received = 1;
+      rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
+
+      /* We forward the incoming No-Path DAO to our parent, if we have
+         one. */
+      forward = 1;
+    } else {
+      /* No route to remove through the sender */
+      status = RPL_DAO_ACK_UNABLE_TO_ACCEPT;
+    }
+    goto fwd_dao;
+  }
+
+  PRINTF("RPL: adding DAO route\n");
+
+  if((nbr = uip_ds6_nbr_lookup(dao_sender_addr)) == NULL) {
+    if((nbr = uip_ds6_nbr_add(dao_sender_addr,
+                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                              0, NBR_REACHABLE)) != NULL) {
+      /* set reachable timer */
+      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      PRINTF("RPL: Neighbor added to neighbor cache ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+    } else {
+      PRINTF("RPL: Out of Memory, dropping DAO from ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+      return -1;
+    }
+  } else {
+    PRINTF("RPL: Neighbor already in neighbor cache\n");
+  }
+
+  rep = rpl_add_route(dag, prefix, prefixlen, dao_sender_addr);
+  if(rep == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+    return -1;
+  }
+
+  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
+  rep->state.learned_from = learned_from;
+  rep->state.nopath_received = 0;
+  forward = 1;
+
+fwd_dao:
+  if(forward && learned_from == RPL_ROUTE_FROM_UNICAST_DAO &&
+     dag->preferred_parent != NULL &&
+     rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
+    PRINTF("RPL: Forwarding DAO target to parent ");
+    PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
+    PRINTF("\n");
+    dao_queue_target(instance, rpl_get_parent_ipaddr(dag->preferred_parent),
+                     prefix, prefixlen, lifetime);
+  }
+  return status;
+}
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
@@ -587,24 +1061,33 @@ dao_input(void)
   uint16_t sequence;
   uint8_t instance_id;
   uint8_t lifetime;
-  uint8_t prefixlen;
   uint8_t flags;
   uint8_t subopt_type;
   /*
   uint8_t pathcontrol;
   uint8_t pathsequence;
   */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
+  uip_ipaddr_t prefixes[RPL_DAO_MAX_TARGETS];
+  uint8_t prefixlens[RPL_DAO_MAX_TARGETS];
+  uint8_t lifetimes[RPL_DAO_MAX_TARGETS];
+  uint8_t num_targets;
+  uint8_t transit_targets;
   uint8_t buffer_length;
   int pos;
   int len;
   int i;
+  int t;
   int learned_from;
+  int status;
+  int ack_status;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
+#if RPL_WITH_NON_STORING
+  uip_ipaddr_t transit_parent;
+  uint8_t has_transit_parent;
+#endif /* RPL_WITH_NON_STORING */
 
-  prefixlen = 0;
+  num_targets = transit_targets = 0;
+  ack_status = RPL_DAO_ACK_UNCONDITIONAL_ACCEPT;
   parent = NULL;
 
   uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
@@ -627,8 +1110,6 @@ dao_input(void)
     goto discard;
   }
 
-  lifetime = instance->default_lifetime;
-
   flags = buffer[pos++];
   /* reserved */
   pos++;
@@ -659,7 +1140,7 @@ dao_input(void)
       PRINTF("RPL: Loop detected when receiving a unicast DAO from a node with a lower rank! (%u < %u)\n",
           DAG_RANK(parent->rank, instance), DAG_RANK(dag->rank, instance));
       parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_parent_updated(parent);
       goto discard;
     }
 
@@ -667,12 +1148,23 @@ dao_input(void)
     if(parent != NULL && parent == dag->preferred_parent) {
       PRINTF("RPL: Loop detected when receiving a unicast DAO from our parent\n");
       parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_parent_updated(parent);
       goto discard;
     }
   }
 
-  /* Check if there are any RPL options present. */
+#if RPL_WITH_NON_STORING
+  if(RPL_IS_NON_STORING(instance) && dag->rank != ROOT_RANK(instance)) {
+    /* In non-storing mode, DAOs are sent to the root */
+    PRINTF("RPL: Ignoring a non-storing DAO, we are not the root\n");
+    goto discard;
+  }
+#endif /* RPL_WITH_NON_STORING */
+
+  /* Process the RPL options. A transit information option applies to
+     the target options that precede it. In storing mode, the targets
+     are processed once the whole message has been read, as queueing
+     them may send a DAO from uip_buf. */
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -685,121 +1177,81 @@ dao_input(void)
     switch(subopt_type) {
     case RPL_OPTION_TARGET:
       /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      if(num_targets == RPL_DAO_MAX_TARGETS) {
+        PRINTF("RPL: Too many targets in DAO, ignoring one\n");
+        RPL_STAT(rpl_stats.malformed_msgs++);
+        break;
+      }
+      prefixlens[num_targets] = buffer[i + 3];
+      memset(&prefixes[num_targets], 0, sizeof(prefixes[num_targets]));
+      memcpy(&prefixes[num_targets], buffer + i + 4,
+             (prefixlens[num_targets] + 7) / CHAR_BIT);
+      num_targets++;
       break;
     case RPL_OPTION_TRANSIT:
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
       lifetime = buffer[i + 5];
-      /* The parent address is also ignored. */
-      break;
-    }
-  }
-
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
-
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
-    }
-    goto fwd_dao;
-  }
-#endif
-
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = RPL_NOPATH_REMOVAL_DELAY;
-
-      /* We forward the incoming No-Path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        PRINTF("RPL: Forwarding No-Path DAO to parent ");
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+#if RPL_WITH_NON_STORING
+      /* The parent address is only used in non-storing mode. */
+      has_transit_parent = len >= 6 + 16;
+      if(has_transit_parent) {
+        memcpy(&transit_parent, buffer + i + 6, sizeof(transit_parent));
+      }
+      if(RPL_IS_NON_STORING(instance)) {
+        if(!has_transit_parent) {
+          PRINTF("RPL: Non-storing DAO without parent address\n");
+          if(ack_status == RPL_DAO_ACK_UNCONDITIONAL_ACCEPT) {
+            ack_status = RPL_DAO_ACK_UNABLE_TO_ACCEPT;
+          }
+          num_targets = transit_targets;
+          break;
+        }
+        /* The root records the link from each target to its parent
+           instead of a route */
+        for(t = transit_targets; t < num_targets; t++) {
+          if(lifetime == RPL_ZERO_LIFETIME) {
+            PRINTF("RPL: No-Path DAO received\n");
+            rpl_ns_expire_parent(dag, &prefixes[t], &transit_parent);
+          } else if(rpl_ns_update_node(dag, &prefixes[t], &transit_parent,
+                                       RPL_LIFETIME(instance, lifetime)) == NULL) {
+            RPL_STAT(rpl_stats.mem_overflows++);
+            PRINTF("RPL: Could not add a link after receiving a DAO\n");
+            ack_status = -1;
+          }
+        }
+        num_targets = transit_targets;
+        break;
       }
-      if(flags & RPL_DAO_K_FLAG) {
-        dao_ack_output(instance, &dao_sender_addr, sequence);
+#endif /* RPL_WITH_NON_STORING */
+      for(; transit_targets < num_targets; transit_targets++) {
+        lifetimes[transit_targets] = lifetime;
       }
+      break;
     }
-    goto discard;
   }
 
-  PRINTF("RPL: adding DAO route\n");
-
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
-    if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
-                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                              0, NBR_REACHABLE)) != NULL) {
-      /* set reachable timer */
-      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
-      PRINTF("RPL: Neighbor added to neighbor cache ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-    } else {
-      PRINTF("RPL: Out of Memory, dropping DAO from ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-      goto discard;
+  /* Targets without transit information get the default lifetime */
+  if(!RPL_IS_NON_STORING(instance)) {
+    for(t = 0; t < num_targets; t++) {
+      status = dao_input_target(instance, dag, &dao_sender_addr, learned_from,
+                                &prefixes[t], prefixlens[t],
+                                t < transit_targets ? lifetimes[t] :
+                                instance->default_lifetime);
+      if(status < 0 ||
+         (status != RPL_DAO_ACK_UNCONDITIONAL_ACCEPT && ack_status >= 0)) {
+        ack_status = status;
+      }
     }
-  } else {
-    PRINTF("RPL: Neighbor already in neighbor cache\n");
   }
 
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
-    goto discard;
-  }
-
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
-  rep->state.nopath_received = 0;
-
-#if RPL_CONF_MULTICAST
-fwd_dao:
-#endif
-
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-      PRINTF("RPL: Forwarding DAO to parent ");
-      PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-      PRINTF("\n");
-      uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                     ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-    }
-    if(flags & RPL_DAO_K_FLAG) {
-      dao_ack_output(instance, &dao_sender_addr, sequence);
-    }
+  /* Only acknowledge the DAO if every target was accepted or refused for
+     good: without an ACK, the sender retries the targets that could not
+     be stored */
+  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO && (flags & RPL_DAO_K_FLAG) &&
+     ack_status >= 0) {
+    dao_ack_output(instance, &dao_sender_addr, sequence, ack_status);
   }
 
  discard:
@@ -827,8 +1279,8 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   rpl_dag_t *dag;
   rpl_instance_t *instance;
   unsigned char *buffer;
-  uint8_t prefixlen;
   int pos;
+  uip_ipaddr_t *parent_ipaddr;
 
   /* Destination Advertisement Object */
 
@@ -862,62 +1314,44 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   RPL_DEBUG_DAO_OUTPUT(parent);
 #endif
 
-  buffer = UIP_ICMP_PAYLOAD;
-
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
-
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
-#if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
-#endif /* RPL_DAO_SPECIFY_DAG */
-#if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
-#endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
-#if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
-#endif /* RPL_DAO_SPECIFY_DAG */
-
-  /* create target subopt */
-  prefixlen = sizeof(*prefix) * CHAR_BIT;
-  buffer[pos++] = RPL_OPTION_TARGET;
-  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = prefixlen;
-  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
-  pos += ((prefixlen + 7) / CHAR_BIT);
-
-  /* Create a transit information sub-option. */
-  buffer[pos++] = RPL_OPTION_TRANSIT;
-  buffer[pos++] = 4;
-  buffer[pos++] = 0; /* flags - ignored */
-  buffer[pos++] = 0; /* path control - ignored */
-  buffer[pos++] = 0; /* path seq - ignored */
-  buffer[pos++] = lifetime;
+  parent_ipaddr = rpl_get_parent_ipaddr(parent);
+  if(parent_ipaddr == NULL) {
+    PRINTF("RPL dao_output_target error parent address NULL\n");
+    return;
+  }
 
   PRINTF("RPL: Sending %sDAO with prefix ", lifetime == RPL_ZERO_LIFETIME ? "No-Path " : "");
   PRINT6ADDR(prefix);
-  PRINTF(" to ");
-  PRINT6ADDR(rpl_get_parent_ipaddr(parent));
+  PRINTF(" via ");
+  PRINT6ADDR(parent_ipaddr);
   PRINTF("\n");
 
-  if(rpl_get_parent_ipaddr(parent) != NULL) {
-    uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
+  if(!RPL_IS_NON_STORING(instance)) {
+    dao_queue_target(instance, parent_ipaddr, prefix,
+                     sizeof(*prefix) * CHAR_BIT, lifetime);
+    return;
   }
+
+  /* In non-storing mode, the DAO goes straight to the root, with the
+     address of our parent */
+  buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_header(buffer, instance, dag);
+  pos = dao_target_option(buffer, pos, prefix, sizeof(*prefix) * CHAR_BIT);
+  pos = dao_transit_option(buffer, pos, lifetime, &dag->dag_id, parent_ipaddr);
+  RPL_STAT(rpl_stats.dao_route_changes++);
+  RPL_STAT(rpl_stats.dao_sent++);
+  RPL_STAT(rpl_stats.dao_targets_sent++);
+  uip_icmp6_send(&dag->dag_id, ICMP6_RPL, RPL_CODE_DAO, pos);
 }
 /*---------------------------------------------------------------------------*/
 static void
 dao_ack_input(void)
 {
-#if DEBUG
   unsigned char *buffer;
   uint8_t sequence;
   uint8_t status;
+  struct dao_target *t;
+  struct dao_target *next;
 
   buffer = UIP_ICMP_PAYLOAD;
 
@@ -928,16 +1362,34 @@ dao_ack_input(void)
     sequence, status);
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
   PRINTF("\n");
-#endif /* DEBUG */
+
+  /* The targets of the DAO are delivered, or were refused by the parent
+     (status >= 128): stop retransmitting them either way */
+  for(t = list_head(dao_target_list); t != NULL; t = next) {
+    next = list_item_next(t);
+    if(t->transmissions > 0 && t->sequence == sequence &&
+       uip_ipaddr_cmp(&t->parent, &UIP_IP_BUF->srcipaddr)) {
+      if(status >= RPL_DAO_ACK_UNABLE_TO_ACCEPT) {
+        RPL_STAT(rpl_stats.dao_drops++);
+      } else {
+        RPL_STAT(rpl_stats.dao_acks++);
+      }
+      dao_free_target(t);
+    }
+  }
+  dao_schedule();
+
   uip_clear_buf();
 }
 /*---------------------------------------------------------------------------*/
 void
-dao_ack_output(rpl_instance_t *instance, uip_ipaddr_t *dest, uint8_t sequence)
+dao_ack_output(rpl_instance_t *instance, uip_ipaddr_t *dest, uint8_t sequence,
+               uint8_t status)
 {
   unsigned char *buffer;
 
-  PRINTF("RPL: Sending a DAO ACK with sequence number %d to ", sequence);
+  PRINTF("RPL: Sending a DAO ACK with sequence number %d and status %d to ",
+         sequence, status);
   PRINT6ADDR(dest);
   PRINTF("\n");
 
@@ -946,7 +1398,7 @@ dao_ack_output(rpl_instance_t *instance, uip_ipaddr_t *dest, uint8_t sequence)
   buffer[0] = instance->instance_id;
   buffer[1] = 0;
   buffer[2] = sequence;
-  buffer[3] = 0;
+  buffer[3] = status;
 
   uip_icmp6_send(dest, ICMP6_RPL, RPL_CODE_DAO_ACK, 4);
 }
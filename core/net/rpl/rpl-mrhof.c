@@ -53,29 +53,23 @@
 #include "net/ip/uip-debug.h"
 
 static void reset(rpl_dag_t *);
-static void neighbor_link_callback(rpl_parent_t *, int, int);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 
 rpl_of_t rpl_mrhof = {
   reset,
-  neighbor_link_callback,
+  NULL, /* The ETX is maintained by link-stats */
   best_parent,
   best_dag,
   calculate_rank,
   update_metric_container,
-  1
+  1,
+  parent_path_cost
 };
 
-/* Constants for the ETX moving average */
-#define ETX_SCALE   100
-#define ETX_ALPHA   90
-
-/* Reject parents that have a higher link metric than the following. */
-#define MAX_LINK_METRIC			10
-
 /* Reject parents that have a higher path cost than the following. */
 #define MAX_PATH_COST			100
 
@@ -100,63 +94,27 @@ calculate_path_metric(rpl_parent_t *p)
   }
 #if RPL_DAG_MC == RPL_DAG_MC_NONE
   {
-    return p->rank + (uint16_t)nbr->link_metric;
+    return p->rank + rpl_get_parent_link_metric(p);
   }
 #elif RPL_DAG_MC == RPL_DAG_MC_ETX
-  return p->mc.obj.etx + (uint16_t)nbr->link_metric;
+  return p->mc.obj.etx + rpl_get_parent_link_metric(p);
 #elif RPL_DAG_MC == RPL_DAG_MC_ENERGY
-  return p->mc.obj.energy.energy_est + (uint16_t)nbr->link_metric;
+  return p->mc.obj.energy.energy_est + rpl_get_parent_link_metric(p);
 #else
 #error "Unsupported RPL_DAG_MC configured. See rpl.h."
 #endif /* RPL_DAG_MC */
 }
 
-static void
-reset(rpl_dag_t *dag)
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
 {
-  PRINTF("RPL: Reset MRHOF\n");
+  return calculate_path_metric(p);
 }
 
 static void
-neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
+reset(rpl_dag_t *dag)
 {
-  uint16_t recorded_etx = 0;
-  uint16_t packet_etx = numtx * RPL_DAG_MC_ETX_DIVISOR;
-  uint16_t new_etx;
-  uip_ds6_nbr_t *nbr = NULL;
-
-  nbr = rpl_get_nbr(p);
-  if(nbr == NULL) {
-    /* No neighbor for this parent - something bad has occurred */
-    return;
-  }
-
-  recorded_etx = nbr->link_metric;
-
-  /* Do not penalize the ETX when collisions or transmission errors occur. */
-  if(status == MAC_TX_OK || status == MAC_TX_NOACK) {
-    if(status == MAC_TX_NOACK) {
-      packet_etx = MAX_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
-    }
-
-    if(p->flags & RPL_PARENT_FLAG_LINK_METRIC_VALID) {
-      /* We already have a valid link metric, use weighted moving average to update it */
-      new_etx = ((uint32_t)recorded_etx * ETX_ALPHA +
-                 (uint32_t)packet_etx * (ETX_SCALE - ETX_ALPHA)) / ETX_SCALE;
-    } else {
-      /* We don't have a valid link metric, set it to the current packet's ETX */
-      new_etx = packet_etx;
-      /* Set link metric as valid */
-      p->flags |= RPL_PARENT_FLAG_LINK_METRIC_VALID;
-    }
-
-    PRINTF("RPL: ETX changed from %u to %u (packet ETX = %u)\n",
-        (unsigned)(recorded_etx / RPL_DAG_MC_ETX_DIVISOR),
-        (unsigned)(new_etx  / RPL_DAG_MC_ETX_DIVISOR),
-        (unsigned)(packet_etx / RPL_DAG_MC_ETX_DIVISOR));
-    /* update the link metric for this nbr */
-    nbr->link_metric = new_etx;
-  }
+  PRINTF("RPL: Reset MRHOF\n");
 }
 
 static rpl_rank_t
@@ -164,15 +122,14 @@ calculate_rank(rpl_parent_t *p, rpl_rank_t base_rank)
 {
   rpl_rank_t new_rank;
   rpl_rank_t rank_increase;
-  uip_ds6_nbr_t *nbr;
 
-  if(p == NULL || (nbr = rpl_get_nbr(p)) == NULL) {
+  if(p == NULL || rpl_get_nbr(p) == NULL) {
     if(base_rank == 0) {
       return INFINITE_RANK;
     }
     rank_increase = RPL_INIT_LINK_METRIC * RPL_DAG_MC_ETX_DIVISOR;
   } else {
-    rank_increase = nbr->link_metric;
+    rank_increase = rpl_get_parent_link_metric(p);
     if(base_rank == 0) {
       base_rank = p->rank;
     }
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         RPL non-storing mode: the DODAG topology kept at the root, one
+ *         child-to-parent link per node, used to build source routes.
+ */
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+#include "lib/memb.h"
+
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#if RPL_WITH_NON_STORING
+
+/* Expiration of nodes that are only known as parents */
+#define RPL_NS_INFINITE_LIFETIME 0xffffffff
+#define NOT_ON_WHEEL             0xff
+
+static int num_nodes;
+/* Seconds since init, advanced by rpl_ns_periodic() */
+static uint32_t current_time;
+
+MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
+static rpl_ns_node_t *buckets[RPL_NS_HASH_SIZE];
+static rpl_ns_node_t *wheel[RPL_NS_WHEEL_SLOTS];
+
+/*---------------------------------------------------------------------------*/
+static uint16_t
+hash(const unsigned char *link_identifier)
+{
+  uint16_t h;
+  uint8_t i;
+
+  h = 0;
+  for(i = 0; i < 8; i++) {
+    h = h * 33 + link_identifier[i];
+  }
+  return h % RPL_NS_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static int
+node_matches_address(const rpl_dag_t *dag, const rpl_ns_node_t *node,
+                     const uip_ipaddr_t *addr)
+{
+  return addr != NULL
+    && node != NULL
+    && dag != NULL
+    && dag == node->dag
+    && !memcmp(addr, &dag->dag_id, 8)
+    && !memcmp(((const unsigned char *)addr) + 8, node->link_identifier, 8);
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *l;
+
+  if(addr == NULL) {
+    return NULL;
+  }
+  for(l = buckets[hash(((const unsigned char *)addr) + 8)];
+      l != NULL; l = l->next) {
+    if(node_matches_address(dag, l, addr)) {
+      return l;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  int max_depth;
+  rpl_ns_node_t *node;
+  rpl_ns_node_t *root_node;
+
+  node = rpl_ns_get_node(dag, addr);
+  root_node = rpl_ns_get_node(dag, &dag->dag_id);
+
+  /* A path can not be longer than the number of nodes, unless it loops */
+  max_depth = RPL_NS_LINK_NUM;
+  while(node != NULL && node != root_node && max_depth > 0) {
+    node = node->parent;
+    max_depth--;
+  }
+  return node != NULL && node == root_node;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_parent(rpl_ns_node_t *node, rpl_ns_node_t *parent)
+{
+  if(node->parent != NULL) {
+    node->parent->children--;
+  }
+  node->parent = parent;
+  if(parent != NULL) {
+    parent->children++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(rpl_ns_node_t *node)
+{
+  node->wheel_slot = node->expiration % RPL_NS_WHEEL_SLOTS;
+  node->wheel_next = wheel[node->wheel_slot];
+  wheel[node->wheel_slot] = node;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_node(rpl_ns_node_t *node)
+{
+  rpl_ns_node_t **l;
+  rpl_ns_node_t *child;
+
+  for(l = &buckets[hash(node->link_identifier)]; *l != NULL; l = &(*l)->next) {
+    if(*l == node) {
+      *l = node->next;
+      break;
+    }
+  }
+  if(node->wheel_slot != NOT_ON_WHEEL) {
+    for(l = &wheel[node->wheel_slot]; *l != NULL; l = &(*l)->wheel_next) {
+      if(*l == node) {
+        *l = node->wheel_next;
+        break;
+      }
+    }
+  }
+
+  set_parent(node, NULL);
+  if(node->children > 0) {
+    /* Detach the children, they will be reattached by their next DAO */
+    for(child = rpl_ns_node_head(); child != NULL;
+        child = rpl_ns_node_next(child)) {
+      if(child->parent == node) {
+        set_parent(child, NULL);
+      }
+    }
+  }
+
+  memb_free(&nodememb, node);
+  num_nodes--;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                     const uip_ipaddr_t *parent)
+{
+  rpl_ns_node_t *l;
+
+  l = rpl_ns_get_node(dag, child);
+  /* Only remove the link if it is the current one: the No-Path DAO may
+     arrive after the DAO announcing the new parent */
+  if(l != NULL && node_matches_address(dag, l->parent, parent)) {
+    remove_node(l);
+  }
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                   const uip_ipaddr_t *parent, uint32_t lifetime)
+{
+  rpl_ns_node_t *child_node;
+  rpl_ns_node_t *parent_node;
+  rpl_ns_node_t *old_parent_node;
+  uint16_t h;
+
+  child_node = rpl_ns_get_node(dag, child);
+  parent_node = rpl_ns_get_node(dag, parent);
+
+  if(parent != NULL && parent_node == NULL) {
+    /* The parent has not sent its own DAO yet */
+    parent_node = rpl_ns_update_node(dag, parent, NULL,
+                                     RPL_NS_INFINITE_LIFETIME);
+    if(parent_node == NULL) {
+      return NULL;
+    }
+  }
+
+  if(child_node == NULL) {
+    child_node = memb_alloc(&nodememb);
+    if(child_node == NULL) {
+      PRINTF("RPL: NS: no room for a new node\n");
+      return NULL;
+    }
+    child_node->dag = dag;
+    child_node->parent = NULL;
+    child_node->children = 0;
+    child_node->wheel_slot = NOT_ON_WHEEL;
+    memcpy(child_node->link_identifier, ((const unsigned char *)child) + 8, 8);
+    h = hash(child_node->link_identifier);
+    child_node->next = buckets[h];
+    buckets[h] = child_node;
+    num_nodes++;
+  }
+
+  if(lifetime == RPL_NS_INFINITE_LIFETIME) {
+    child_node->expiration = RPL_NS_INFINITE_LIFETIME;
+  } else {
+    child_node->expiration = current_time + lifetime;
+    /* A node already on the wheel is moved lazily, when its slot is
+       visited */
+    if(child_node->wheel_slot == NOT_ON_WHEEL) {
+      wheel_add(child_node);
+    }
+  }
+
+  if(rpl_ns_is_node_reachable(dag, child)) {
+    old_parent_node = child_node->parent;
+    set_parent(child_node, parent_node);
+    if(!rpl_ns_is_node_reachable(dag, child)) {
+      /* The new link creates a loop, most likely because we have not
+         heard of another change yet. Keep the old parent for now. */
+      PRINTF("RPL: NS: update would create a loop, keeping old parent\n");
+      set_parent(child_node, old_parent_node);
+    }
+  } else {
+    set_parent(child_node, parent_node);
+  }
+
+  return child_node;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node)
+{
+  if(addr != NULL && node != NULL && node->dag != NULL) {
+    memcpy(addr, &node->dag->dag_id, 8);
+    memcpy(((unsigned char *)addr) + 8, node->link_identifier, 8);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+rpl_ns_node_lifetime(const rpl_ns_node_t *node)
+{
+  if(node->expiration == RPL_NS_INFINITE_LIFETIME) {
+    return RPL_NS_INFINITE_LIFETIME;
+  }
+  return node->expiration > current_time ?
+    node->expiration - current_time : 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_num_nodes(void)
+{
+  return num_nodes;
+}
+/*---------------------------------------------------------------------------*/
+static rpl_ns_node_t *
+first_in_buckets(uint16_t from)
+{
+  for(; from < RPL_NS_HASH_SIZE; from++) {
+    if(buckets[from] != NULL) {
+      return buckets[from];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_head(void)
+{
+  return first_in_buckets(0);
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_next(rpl_ns_node_t *item)
+{
+  if(item->next != NULL) {
+    return item->next;
+  }
+  return first_in_buckets(hash(item->link_identifier) + 1);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_periodic(void)
+{
+  rpl_ns_node_t **l;
+  rpl_ns_node_t *node;
+  uint8_t slot;
+
+  current_time++;
+
+  /* Only the nodes of the current slot are visited: those that expire
+     now, those that will expire in later rounds of the wheel, and those
+     whose lifetime was updated and have to move to another slot */
+  slot = current_time % RPL_NS_WHEEL_SLOTS;
+  l = &wheel[slot];
+  while(*l != NULL) {
+    node = *l;
+    if(node->expiration != RPL_NS_INFINITE_LIFETIME &&
+       node->expiration % RPL_NS_WHEEL_SLOTS == slot) {
+      if(node->expiration <= current_time) {
+        PRINTF("RPL: NS: link expired\n");
+        remove_node(node);
+      } else {
+        l = &node->wheel_next;
+      }
+      continue;
+    }
+    /* Unlink the node, then requeue it unless it became infinite */
+    *l = node->wheel_next;
+    node->wheel_slot = NOT_ON_WHEEL;
+    if(node->expiration != RPL_NS_INFINITE_LIFETIME) {
+      if(node->expiration <= current_time) {
+        remove_node(node);
+      } else {
+        wheel_add(node);
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_init(void)
+{
+  num_nodes = 0;
+  current_time = 0;
+  memb_init(&nodememb);
+  memset(buckets, 0, sizeof(buckets));
+  memset(wheel, 0, sizeof(wheel));
+}
+/*---------------------------------------------------------------------------*/
+#endif /* RPL_WITH_NON_STORING */
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         RPL non-storing mode: the DODAG topology kept at the root, one
+ *         child-to-parent link per node, used to build source routes.
+ */
+
+#ifndef RPL_NS_H
+#define RPL_NS_H
+
+#include "net/rpl/rpl.h"
+
+/* Number of nodes (i.e. links) the root can keep track of */
+#ifdef RPL_NS_CONF_LINK_NUM
+#define RPL_NS_LINK_NUM RPL_NS_CONF_LINK_NUM
+#else /* RPL_NS_CONF_LINK_NUM */
+#define RPL_NS_LINK_NUM UIP_DS6_ROUTE_NB
+#endif /* RPL_NS_CONF_LINK_NUM */
+
+/* Number of buckets of the hash table of nodes, indexed by the
+   interface identifier. A lookup visits RPL_NS_LINK_NUM / RPL_NS_HASH_SIZE
+   nodes on average. */
+#ifdef RPL_NS_CONF_HASH_SIZE
+#define RPL_NS_HASH_SIZE RPL_NS_CONF_HASH_SIZE
+#else /* RPL_NS_CONF_HASH_SIZE */
+#define RPL_NS_HASH_SIZE 16
+#endif /* RPL_NS_CONF_HASH_SIZE */
+
+/* Number of slots of the timer wheel used to expire the links, one slot
+   being visited per second. Expirations may be late by up to this many
+   seconds when a DAO shortens the lifetime of a link. */
+#ifdef RPL_NS_CONF_WHEEL_SLOTS
+#define RPL_NS_WHEEL_SLOTS RPL_NS_CONF_WHEEL_SLOTS
+#else /* RPL_NS_CONF_WHEEL_SLOTS */
+#define RPL_NS_WHEEL_SLOTS 32
+#endif /* RPL_NS_CONF_WHEEL_SLOTS */
+
+#if RPL_NS_WHEEL_SLOTS > 255
+#error "RPL_NS_WHEEL_SLOTS must be at most 255"
+#endif
+
+typedef struct rpl_ns_node {
+  struct rpl_ns_node *next;           /* Next node in the hash bucket */
+  struct rpl_ns_node *wheel_next;     /* Next node in the timer wheel slot */
+  struct rpl_ns_node *parent;
+  rpl_dag_t *dag;
+  uint32_t expiration;                /* In seconds of rpl_ns_periodic() */
+  uint16_t children;                  /* Number of nodes with us as parent */
+  uint8_t wheel_slot;
+  /* The prefix of the node address is the one of the DAG ID; only the
+     interface identifier is stored */
+  unsigned char link_identifier[8];
+} rpl_ns_node_t;
+
+/* Records or refreshes the link from child to parent. The parent is
+   added with an infinite lifetime if it is not known yet. */
+rpl_ns_node_t *rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                                  const uip_ipaddr_t *parent, uint32_t lifetime);
+/* Removes the link from child to parent, if it is the current one */
+void rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                          const uip_ipaddr_t *parent);
+rpl_ns_node_t *rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+/* Is there a loop-free path of links from addr up to the root? */
+int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node);
+/* Remaining lifetime of the link of a node, in seconds */
+uint32_t rpl_ns_node_lifetime(const rpl_ns_node_t *node);
+int rpl_ns_num_nodes(void);
+
+/* Iteration over the topology, e.g. to export it:
+   for(n = rpl_ns_node_head(); n != NULL; n = rpl_ns_node_next(n)) */
+rpl_ns_node_t *rpl_ns_node_head(void);
+rpl_ns_node_t *rpl_ns_node_next(rpl_ns_node_t *item);
+
+/* Expires the links, called once per second */
+void rpl_ns_periodic(void);
+void rpl_ns_init(void);
+
+#endif /* RPL_NS_H */
@@ -51,6 +51,7 @@ static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 
 rpl_of_t rpl_of0 = {
   reset,
@@ -59,7 +60,8 @@ rpl_of_t rpl_of0 = {
   best_dag,
   calculate_rank,
   update_metric_container,
-  0
+  0,
+  parent_path_cost
 };
 
 #define DEFAULT_RANK_INCREMENT  RPL_MIN_HOPRANKINC
@@ -122,34 +124,45 @@ best_dag(rpl_dag_t *d1, rpl_dag_t *d2)
   }
 }
 
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
+{
+  if(rpl_get_nbr(p) == NULL) {
+    return 0xffff;
+  }
+  return DAG_RANK(p->rank, p->dag->instance) * RPL_MIN_HOPRANKINC +
+    rpl_get_parent_link_metric(p);
+}
+
 static rpl_parent_t *
 best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
 {
   rpl_rank_t r1, r2;
   rpl_dag_t *dag;  
-  uip_ds6_nbr_t *nbr1, *nbr2;
-  nbr1 = rpl_get_nbr(p1);
-  nbr2 = rpl_get_nbr(p2);
+  uint16_t metric1, metric2;
 
   dag = (rpl_dag_t *)p1->dag; /* Both parents must be in the same DAG. */
 
-  if(nbr1 == NULL || nbr2 == NULL) {
+  if(rpl_get_nbr(p1) == NULL || rpl_get_nbr(p2) == NULL) {
     return dag->preferred_parent;
   }
 
+  metric1 = rpl_get_parent_link_metric(p1);
+  metric2 = rpl_get_parent_link_metric(p2);
+
   PRINTF("RPL: Comparing parent ");
   PRINT6ADDR(rpl_get_parent_ipaddr(p1));
   PRINTF(" (confidence %d, rank %d) with parent ",
-        nbr1->link_metric, p1->rank);
+        metric1, p1->rank);
   PRINT6ADDR(rpl_get_parent_ipaddr(p2));
   PRINTF(" (confidence %d, rank %d)\n",
-        nbr2->link_metric, p2->rank);
+        metric2, p2->rank);
 
 
   r1 = DAG_RANK(p1->rank, p1->dag->instance) * RPL_MIN_HOPRANKINC  +
-    nbr1->link_metric;
+    metric1;
   r2 = DAG_RANK(p2->rank, p1->dag->instance) * RPL_MIN_HOPRANKINC  +
-    nbr2->link_metric;
+    metric2;
   /* Compare two parents by looking both and their rank and at the ETX
      for that parent. We choose the parent that has the most
      favourable combination. */
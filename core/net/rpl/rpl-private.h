@@ -45,6 +45,7 @@
 #include "sys/ctimer.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#include "net/rpl/rpl-ns.h"
 
 /*---------------------------------------------------------------------------*/
 /** \brief Is IPv6 address addr the link-local, all-RPL-nodes
@@ -90,6 +91,10 @@
 
 #define RPL_DAO_K_FLAG                   0x80 /* DAO ACK requested */
 #define RPL_DAO_D_FLAG                   0x40 /* DODAG ID present */
+
+/* DAO-ACK status: values of 128 and above reject the DAO */
+#define RPL_DAO_ACK_UNCONDITIONAL_ACCEPT 0
+#define RPL_DAO_ACK_UNABLE_TO_ACCEPT     128
 /*---------------------------------------------------------------------------*/
 /* RPL IPv6 extension header option. */
 #define RPL_HDR_OPT_LEN			4
@@ -100,6 +105,16 @@
 #define RPL_HDR_OPT_RANK_ERR_SHIFT   	6
 #define RPL_HDR_OPT_FWD_ERR		0x20
 #define RPL_HDR_OPT_FWD_ERR_SHIFT   	5
+
+/* RPL Source Routing Header (RFC 6554), after the generic routing header */
+#define RPL_RH_TYPE_SRH                  3
+#define RPL_RH_LEN                       4
+#define RPL_SRH_LEN                      4
+struct uip_rpl_srh_hdr {
+  uint8_t cmpr;                 /* CmprI (4 bits), CmprE (4 bits) */
+  uint8_t pad;                  /* Pad (4 bits), reserved */
+  uint8_t reserved[2];
+};
 /*---------------------------------------------------------------------------*/
 /* Default values for RPL constants and variables. */
 
@@ -110,6 +125,57 @@
 #define RPL_DAO_DELAY                 (CLOCK_SECOND * 4)
 #endif /* RPL_CONF_DAO_DELAY */
 
+/* Targets that go to the same parent within RPL_DAO_AGGREGATION_DELAY
+   are sent in a single DAO (storing mode). 0 sends one DAO per target. */
+#ifdef RPL_CONF_DAO_AGGREGATION_DELAY
+#define RPL_DAO_AGGREGATION_DELAY     RPL_CONF_DAO_AGGREGATION_DELAY
+#else /* RPL_CONF_DAO_AGGREGATION_DELAY */
+#define RPL_DAO_AGGREGATION_DELAY     (CLOCK_SECOND / 2)
+#endif /* RPL_CONF_DAO_AGGREGATION_DELAY */
+
+/* Number of targets waiting to be sent or acknowledged */
+#ifdef RPL_CONF_DAO_QUEUE_SIZE
+#define RPL_DAO_QUEUE_SIZE            RPL_CONF_DAO_QUEUE_SIZE
+#else /* RPL_CONF_DAO_QUEUE_SIZE */
+#define RPL_DAO_QUEUE_SIZE            4
+#endif /* RPL_CONF_DAO_QUEUE_SIZE */
+
+/* Maximum number of targets in one DAO, sent or received */
+#ifdef RPL_CONF_DAO_MAX_TARGETS
+#define RPL_DAO_MAX_TARGETS           RPL_CONF_DAO_MAX_TARGETS
+#else /* RPL_CONF_DAO_MAX_TARGETS */
+#define RPL_DAO_MAX_TARGETS           4
+#endif /* RPL_CONF_DAO_MAX_TARGETS */
+
+/* DAO pacing: a token bucket of RPL_DAO_RATE_BURST DAOs, refilled with
+   one token every RPL_DAO_RATE_INTERVAL */
+#ifdef RPL_CONF_DAO_RATE_BURST
+#define RPL_DAO_RATE_BURST            RPL_CONF_DAO_RATE_BURST
+#else /* RPL_CONF_DAO_RATE_BURST */
+#define RPL_DAO_RATE_BURST            4
+#endif /* RPL_CONF_DAO_RATE_BURST */
+
+#ifdef RPL_CONF_DAO_RATE_INTERVAL
+#define RPL_DAO_RATE_INTERVAL         RPL_CONF_DAO_RATE_INTERVAL
+#else /* RPL_CONF_DAO_RATE_INTERVAL */
+#define RPL_DAO_RATE_INTERVAL         (CLOCK_SECOND / 2)
+#endif /* RPL_CONF_DAO_RATE_INTERVAL */
+
+/* With RPL_CONF_DAO_ACK, unacknowledged DAOs are retransmitted after
+   RPL_DAO_ACK_TIMEOUT, before any new DAO, up to
+   RPL_DAO_MAX_RETRANSMISSIONS times */
+#ifdef RPL_CONF_DAO_ACK_TIMEOUT
+#define RPL_DAO_ACK_TIMEOUT           RPL_CONF_DAO_ACK_TIMEOUT
+#else /* RPL_CONF_DAO_ACK_TIMEOUT */
+#define RPL_DAO_ACK_TIMEOUT           (CLOCK_SECOND * 4)
+#endif /* RPL_CONF_DAO_ACK_TIMEOUT */
+
+#ifdef RPL_CONF_DAO_MAX_RETRANSMISSIONS
+#define RPL_DAO_MAX_RETRANSMISSIONS   RPL_CONF_DAO_MAX_RETRANSMISSIONS
+#else /* RPL_CONF_DAO_MAX_RETRANSMISSIONS */
+#define RPL_DAO_MAX_RETRANSMISSIONS   3
+#endif /* RPL_CONF_DAO_MAX_RETRANSMISSIONS */
+
 /* Delay between reception of a no-path DAO and actual route removal */
 #ifdef RPL_CONF_NOPATH_REMOVAL_DELAY
 #define RPL_NOPATH_REMOVAL_DELAY          RPL_CONF_NOPATH_REMOVAL_DELAY
@@ -151,12 +217,7 @@
 #define RPL_ROUTE_FROM_MULTICAST_DAO    2
 #define RPL_ROUTE_FROM_DIO              3
 
-/* DAG Mode of Operation */
-#define RPL_MOP_NO_DOWNWARD_ROUTES      0
-#define RPL_MOP_NON_STORING             1
-#define RPL_MOP_STORING_NO_MULTICAST    2
-#define RPL_MOP_STORING_MULTICAST       3
-
+/* DAG Mode of Operation, the values are defined in rpl-conf.h */
 #ifdef  RPL_CONF_MOP
 #define RPL_MOP_DEFAULT                 RPL_CONF_MOP
 #else /* RPL_CONF_MOP */
@@ -167,6 +228,11 @@
 #endif /* UIP_IPV6_MULTICAST_RPL */
 #endif /* RPL_CONF_MOP */
 
+#define RPL_IS_STORING(instance) \
+  ((instance) != NULL && (instance)->mop > RPL_MOP_NON_STORING)
+#define RPL_IS_NON_STORING(instance) \
+  ((instance) != NULL && (instance)->mop == RPL_MOP_NON_STORING)
+
 /* Emit a pre-processor error if the user configured multicast with bad MOP */
 #if RPL_CONF_MULTICAST && (RPL_MOP_DEFAULT != RPL_MOP_STORING_MULTICAST)
 #error "RPL Multicast requires RPL_MOP_DEFAULT==3. Check contiki-conf.h"
@@ -245,6 +311,13 @@ struct rpl_stats {
   uint16_t loop_errors;
   uint16_t loop_warnings;
   uint16_t root_repairs;
+  uint16_t dao_route_changes;   /* Targets handed to the DAO engine */
+  uint16_t dao_sent;            /* DAO messages, first transmissions */
+  uint16_t dao_targets_sent;    /* Targets carried by these messages */
+  uint16_t dao_retransmissions;
+  uint16_t dao_acks;
+  uint16_t dao_drops;           /* Targets given up on */
+  uint16_t failovers;           /* Preferred parents dropped for a backup */
 };
 typedef struct rpl_stats rpl_stats_t;
 
@@ -268,7 +341,7 @@ void dis_output(uip_ipaddr_t *addr);
 void dio_output(rpl_instance_t *, uip_ipaddr_t *uc_addr);
 void dao_output(rpl_parent_t *, uint8_t lifetime);
 void dao_output_target(rpl_parent_t *, uip_ipaddr_t *, uint8_t lifetime);
-void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t);
+void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t, uint8_t);
 void rpl_icmp6_register_handlers(void);
 
 /* RPL logic functions. */
@@ -291,10 +364,14 @@ rpl_parent_t *rpl_find_parent(rpl_dag_t *, uip_ipaddr_t *);
 rpl_parent_t *rpl_find_parent_any_dag(rpl_instance_t *instance, uip_ipaddr_t *addr);
 void rpl_nullify_parent(rpl_parent_t *);
 void rpl_remove_parent(rpl_parent_t *);
+void rpl_parent_updated(rpl_parent_t *);
 void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent);
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
 void rpl_recalculate_ranks(void);
+void rpl_remove_default_route(rpl_instance_t *instance);
+rpl_parent_t *rpl_get_backup_parent(rpl_dag_t *dag, int validated);
+void rpl_failover_link_callback(rpl_parent_t *p, int status);
 
 /* RPL routing table functions. */
 void rpl_remove_routes(rpl_dag_t *dag);
@@ -312,6 +389,8 @@ void rpl_schedule_dao_immediately(rpl_instance_t *);
 void rpl_schedule_unicast_dio_immediately(rpl_instance_t *instance);
 void rpl_cancel_dao(rpl_instance_t *instance);
 void rpl_schedule_probing(rpl_instance_t *instance);
+void rpl_schedule_failover_probing(rpl_instance_t *instance);
+void rpl_schedule_failover_immediately(rpl_instance_t *instance);
 
 void rpl_reset_dio_timer(rpl_instance_t *);
 void rpl_reset_periodic_timer(void);
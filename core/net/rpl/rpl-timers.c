@@ -73,6 +73,9 @@ handle_periodic_timer(void *ptr)
 {
   rpl_purge_dags();
   rpl_purge_routes();
+#if RPL_WITH_NON_STORING
+  rpl_ns_periodic();
+#endif /* RPL_WITH_NON_STORING */
   rpl_recalculate_ranks();
 
   /* handle DIS */
@@ -450,4 +453,43 @@ rpl_schedule_probing(rpl_instance_t *instance)
                   handle_probing_timer, instance);
 }
 #endif /* RPL_WITH_PROBING */
+/*---------------------------------------------------------------------------*/
+#if RPL_WITH_FAST_FAILOVER
+static void
+handle_failover_timer(void *ptr)
+{
+  rpl_instance_t *instance = (rpl_instance_t *)ptr;
+  rpl_parent_t *backup;
+  uip_ipaddr_t *backup_ipaddr;
+
+  /* Process a pending failover before choosing the next backup */
+  rpl_recalculate_ranks();
+
+  backup = rpl_get_backup_parent(instance->current_dag, 0);
+  backup_ipaddr = rpl_get_parent_ipaddr(backup);
+  if(backup_ipaddr != NULL &&
+     (!link_stats_is_fresh(rpl_get_parent_link_stats(backup)) ||
+      clock_time() - backup->last_tx_time >= RPL_FAILOVER_PROBING_INTERVAL)) {
+    PRINTF("RPL: probing backup parent %u\n",
+        nbr_table_get_lladdr(rpl_parents, backup)->u8[7]);
+    RPL_PROBING_SEND_FUNC(instance, backup_ipaddr);
+  }
+
+  rpl_schedule_failover_probing(instance);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_schedule_failover_probing(rpl_instance_t *instance)
+{
+  ctimer_set(&instance->failover_timer, RPL_FAILOVER_PROBING_INTERVAL / 2
+             + random_rand() % RPL_FAILOVER_PROBING_INTERVAL,
+             handle_failover_timer, instance);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_schedule_failover_immediately(rpl_instance_t *instance)
+{
+  ctimer_set(&instance->failover_timer, 0, handle_failover_timer, instance);
+}
+#endif /* RPL_WITH_FAST_FAILOVER */
 /** @}*/
@@ -231,7 +231,8 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
 {
   uip_ds6_route_t *rep;
 
-  if((rep = uip_ds6_route_add(prefix, prefix_len, next_hop)) == NULL) {
+  if((rep = uip_ds6_route_add_table(dag->instance->instance_id,
+                                    prefix, prefix_len, next_hop)) == NULL) {
     PRINTF("RPL: No space for more route entries\n");
     return NULL;
   }
@@ -249,6 +250,29 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
   return rep;
 }
 /*---------------------------------------------------------------------------*/
+uip_ds6_route_t *
+rpl_route_lookup(rpl_instance_t *instance, uip_ipaddr_t *addr)
+{
+  if(instance == NULL) {
+    return uip_ds6_route_lookup(addr);
+  }
+  return uip_ds6_route_lookup_table(instance->instance_id, addr);
+}
+/*---------------------------------------------------------------------------*/
+uip_ipaddr_t *
+rpl_get_default_nexthop(rpl_instance_t *instance)
+{
+  if(instance != NULL && instance->def_route != NULL) {
+    return &instance->def_route->ipaddr;
+  }
+  /* Packets explicitly sent in an instance other than the default one
+     must not leave it through another instance or a non-RPL router. */
+  if(instance != NULL && instance != default_instance) {
+    return NULL;
+  }
+  return uip_ds6_defrt_choose();
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
 {
@@ -266,11 +290,14 @@ rpl_link_neighbor_callback(const linkaddr_t *addr, int status, int numtx)
       if(parent != NULL) {
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_link_neighbor_callback triggering update\n");
-        parent->flags |= RPL_PARENT_FLAG_UPDATED;
+        rpl_parent_updated(parent);
+        parent->last_tx_time = clock_time();
         if(instance->of->neighbor_link_callback != NULL) {
           instance->of->neighbor_link_callback(parent, status, numtx);
-          parent->last_tx_time = clock_time();
         }
+#if RPL_WITH_FAST_FAILOVER
+        rpl_failover_link_callback(parent, status);
+#endif /* RPL_WITH_FAST_FAILOVER */
       }
     }
   }
@@ -293,7 +320,7 @@ rpl_ipv6_neighbor_callback(uip_ds6_nbr_t *nbr)
         p->rank = INFINITE_RANK;
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_ipv6_neighbor_callback infinite rank\n");
-        p->flags |= RPL_PARENT_FLAG_UPDATED;
+        rpl_parent_updated(p);
       }
     }
   }
@@ -335,6 +362,9 @@ rpl_init(void)
   default_instance = NULL;
 
   rpl_dag_init();
+#if RPL_WITH_NON_STORING
+  rpl_ns_init();
+#endif /* RPL_WITH_NON_STORING */
   rpl_reset_periodic_timer();
   rpl_icmp6_register_handlers();
 
@@ -43,6 +43,7 @@
 #include "lib/list.h"
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/link-stats.h"
 #include "sys/ctimer.h"
 
 /*---------------------------------------------------------------------------*/
@@ -108,14 +109,19 @@ struct rpl_dag;
 #define RPL_PARENT_FLAG_LINK_METRIC_VALID 0x2
 
 struct rpl_parent {
+  struct rpl_parent *next; /* Must be first: the candidate list uses lib/list. */
   struct rpl_dag *dag;
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
   rpl_metric_container_t mc;
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
   rpl_rank_t rank;
+  uint16_t path_cost; /* Position in the candidate list, see rpl-dag.c */
   clock_time_t last_tx_time;
   uint8_t dtsn;
   uint8_t flags;
+#if RPL_WITH_FAST_FAILOVER
+  uint8_t noack_count; /* Unacknowledged transmissions in a row */
+#endif /* RPL_WITH_FAST_FAILOVER */
 };
 typedef struct rpl_parent rpl_parent_t;
 /*---------------------------------------------------------------------------*/
@@ -181,6 +187,14 @@ typedef struct rpl_instance rpl_instance_t;
  *  Updates the metric container for outgoing DIOs in a certain DAG.
  *  If the objective function of the DAG does not use metric containers,
  *  the function should set the object type to RPL_DAG_MC_NONE.
+ *
+ * parent_path_cost(parent)
+ *
+ *  Returns the path cost through "parent" on the same scale that
+ *  best_parent() compares parents on, without any hysteresis. It is used
+ *  to keep the candidate parents ordered so that parent selection does
+ *  not have to rescan the neighbor table. Optional; when NULL, every
+ *  parent event compares all candidates with best_parent().
  */
 struct rpl_of {
   void (*reset)(struct rpl_dag *);
@@ -190,11 +204,15 @@ struct rpl_of {
   rpl_rank_t (*calculate_rank)(rpl_parent_t *, rpl_rank_t);
   void (*update_metric_container)( rpl_instance_t *);
   rpl_ocp_t ocp;
+  uint16_t (*parent_path_cost)(rpl_parent_t *);
 };
 typedef struct rpl_of rpl_of_t;
 
 /* Declare the selected objective function. */
 extern rpl_of_t RPL_OF;
+/* Objective functions available for RPL_CONF_SUPPORTED_OFS. */
+extern rpl_of_t rpl_mrhof;
+extern rpl_of_t rpl_of0;
 /*---------------------------------------------------------------------------*/
 /* Instance */
 struct rpl_instance {
@@ -228,6 +246,9 @@ struct rpl_instance {
 #if RPL_WITH_PROBING
   struct ctimer probing_timer;
 #endif /* RPL_WITH_PROBING */
+#if RPL_WITH_FAST_FAILOVER
+  struct ctimer failover_timer;
+#endif /* RPL_WITH_FAST_FAILOVER */
   struct ctimer dio_timer;
   struct ctimer dao_timer;
   struct ctimer dao_lifetime_timer;
@@ -242,6 +263,7 @@ void uip_rpl_input(void);
 rpl_dag_t *rpl_set_root(uint8_t instance_id, uip_ipaddr_t *dag_id);
 int rpl_set_prefix(rpl_dag_t *dag, uip_ipaddr_t *prefix, unsigned len);
 int rpl_repair_root(uint8_t instance_id);
+int rpl_set_of(rpl_dag_t *dag, rpl_of_t *of);
 int rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from);
 rpl_dag_t *rpl_get_any_dag(void);
 rpl_instance_t *rpl_get_instance(uint8_t instance_id);
@@ -251,10 +273,17 @@ int rpl_verify_header(int);
 void rpl_insert_header(void);
 void rpl_remove_header(void);
 uint8_t rpl_invert_header(void);
+int rpl_srh_insert(void);
+int rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr);
+int rpl_process_srh_header(void);
+rpl_instance_t *rpl_get_packet_instance(void);
+uip_ds6_route_t *rpl_route_lookup(rpl_instance_t *instance, uip_ipaddr_t *addr);
+uip_ipaddr_t *rpl_get_default_nexthop(rpl_instance_t *instance);
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_parent_t *rpl_get_parent(uip_lladdr_t *addr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
-uint16_t rpl_get_parent_link_metric(const uip_lladdr_t *addr);
+uint16_t rpl_get_parent_link_metric(rpl_parent_t *p);
+const struct link_stats *rpl_get_parent_link_stats(rpl_parent_t *p);
 void rpl_dag_init(void);
 uip_ds6_nbr_t *rpl_get_nbr(rpl_parent_t *parent);
 void rpl_print_neighbor_list(void);
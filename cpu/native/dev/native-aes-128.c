@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         AES-128 driver for native builds
+ */
+
+#include "dev/native-aes-128.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NATIVE_AES_128_NI 1
+#include <wmmintrin.h>
+#else
+#define NATIVE_AES_128_NI 0
+#endif
+
+#if NATIVE_AES_128_NI
+static const uint8_t *round_keys;
+static int aesni = -1;
+/*---------------------------------------------------------------------------*/
+static int
+aesni_available(void)
+{
+  if(aesni < 0) {
+    __builtin_cpu_init();
+    aesni = __builtin_cpu_supports("aes");
+  }
+  return aesni;
+}
+/*---------------------------------------------------------------------------*/
+__attribute__((target("aes,sse2")))
+static void
+encrypt_ni(uint8_t *plaintext_and_result)
+{
+  const __m128i *rk;
+  __m128i state;
+  uint8_t round;
+
+  rk = (const __m128i *)round_keys;
+  state = _mm_loadu_si128((const __m128i *)plaintext_and_result);
+  state = _mm_xor_si128(state, _mm_loadu_si128(rk));
+  for(round = 1; round < AES_128_ROUNDS; round++) {
+    state = _mm_aesenc_si128(state, _mm_loadu_si128(rk + round));
+  }
+  state = _mm_aesenclast_si128(state, _mm_loadu_si128(rk + AES_128_ROUNDS));
+  _mm_storeu_si128((__m128i *)plaintext_and_result, state);
+}
+/*---------------------------------------------------------------------------*/
+__attribute__((target("aes,sse2")))
+static void
+encrypt_pair_ni(uint8_t *block1, uint8_t *block2)
+{
+  const __m128i *rk;
+  __m128i key;
+  __m128i state1;
+  __m128i state2;
+  uint8_t round;
+
+  /* interleaved so that both blocks are in the AES unit's pipeline */
+  rk = (const __m128i *)round_keys;
+  key = _mm_loadu_si128(rk);
+  state1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)block1), key);
+  state2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)block2), key);
+  for(round = 1; round < AES_128_ROUNDS; round++) {
+    key = _mm_loadu_si128(rk + round);
+    state1 = _mm_aesenc_si128(state1, key);
+    state2 = _mm_aesenc_si128(state2, key);
+  }
+  key = _mm_loadu_si128(rk + AES_128_ROUNDS);
+  _mm_storeu_si128((__m128i *)block1, _mm_aesenclast_si128(state1, key));
+  _mm_storeu_si128((__m128i *)block2, _mm_aesenclast_si128(state2, key));
+}
+#endif /* NATIVE_AES_128_NI */
+/*---------------------------------------------------------------------------*/
+static void
+set_key(const uint8_t *key)
+{
+#if NATIVE_AES_128_NI
+  if(aesni_available()) {
+    round_keys = aes_128_expand_key(key);
+    return;
+  }
+#endif /* NATIVE_AES_128_NI */
+  aes_128_ttable_driver.set_key(key);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt(uint8_t *plaintext_and_result)
+{
+#if NATIVE_AES_128_NI
+  if(aesni_available()) {
+    encrypt_ni(plaintext_and_result);
+    return;
+  }
+#endif /* NATIVE_AES_128_NI */
+  aes_128_ttable_driver.encrypt(plaintext_and_result);
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt_pair(uint8_t *block1, uint8_t *block2)
+{
+#if NATIVE_AES_128_NI
+  if(aesni_available()) {
+    encrypt_pair_ni(block1, block2);
+    return;
+  }
+#endif /* NATIVE_AES_128_NI */
+  aes_128_ttable_driver.encrypt(block1);
+  aes_128_ttable_driver.encrypt(block2);
+}
+/*---------------------------------------------------------------------------*/
+const struct aes_128_driver native_aes_128_driver = {
+  set_key,
+  encrypt,
+  encrypt_pair
+};
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Measures AQL query throughput on a relation of 100000 rows,
+ *         with and without indexes. The relation has an ascending
+ *         attribute "seq" and a random attribute "val". Range queries
+ *         over each attribute are timed with a full scan, with a
+ *         B+-tree index, and, for "seq", with an inline index. Each
+ *         indexed run must return as many rows as the full scan.
+ *         The rate of processed rows shows the cost of evaluating the
+ *         query predicate on each scanned row, and the buffer pool
+ *         statistics show how many page accesses reached the file system.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+
+#include "antelope.h"
+#include "index.h"
+#include "storage.h"
+
+#include <stdio.h>
+
+#define BENCHMARK_ROWS     100000UL
+#define SCAN_QUERIES       10
+#define INDEX_QUERIES      1000
+#define QUERY_RANGE        100
+#define VALUE_RANGE        65536UL
+
+PROCESS(antelope_benchmark, "Antelope benchmark");
+AUTOSTART_PROCESSES(&antelope_benchmark);
+
+static db_handle_t handle;
+static unsigned long processed_rows;
+static struct storage_stats last_stats;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+rate(unsigned long count, clock_time_t start)
+{
+  clock_time_t elapsed;
+
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  return count * CLOCK_SECOND / elapsed;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_buffer_stats(void)
+{
+  struct storage_stats stats;
+  unsigned long hits;
+  unsigned long accesses;
+
+  storage_get_stats(&stats);
+  hits = stats.hits - last_stats.hits;
+  accesses = hits + stats.misses - last_stats.misses;
+  printf("  buffer pool: %lu%% hits, %lu pages read ahead, %lu pages written\n",
+         accesses == 0 ? 0 : hits * 100 / accesses,
+         stats.read_ahead - last_stats.read_ahead,
+         stats.writes - last_stats.writes);
+  last_stats = stats;
+}
+/*---------------------------------------------------------------------------*/
+static db_result_t
+run(const char *query, unsigned long *rows)
+{
+  db_result_t result;
+
+  result = db_query(&handle, query);
+  if(DB_ERROR(result)) {
+    printf("Query \"%s\" failed: %s\n", query, db_get_result_message(result));
+    db_free(&handle);
+    return result;
+  }
+
+  while(db_processing(&handle)) {
+    result = db_process(&handle);
+    if(result == DB_GOT_ROW || result == DB_OK) {
+      processed_rows++;
+    }
+    if(result == DB_GOT_ROW && rows != NULL) {
+      (*rows)++;
+    } else if(result == DB_FINISHED) {
+      break;
+    } else if(DB_ERROR(result)) {
+      printf("Query \"%s\" failed: %s\n", query, db_get_result_message(result));
+      break;
+    }
+  }
+  db_free(&handle);
+
+  return DB_ERROR(result) ? result : DB_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+insert_rows(void)
+{
+  char query[AQL_MAX_QUERY_LENGTH];
+  clock_time_t start;
+  unsigned long i;
+
+  if(DB_ERROR(run("CREATE RELATION bench;", NULL)) ||
+     DB_ERROR(run("CREATE ATTRIBUTE seq DOMAIN LONG IN bench;", NULL)) ||
+     DB_ERROR(run("CREATE ATTRIBUTE val DOMAIN LONG IN bench;", NULL))) {
+    return 0;
+  }
+
+  start = clock_time();
+  for(i = 0; i < BENCHMARK_ROWS; i++) {
+    snprintf(query, sizeof(query), "INSERT (%lu, %lu) INTO bench;",
+             i, (unsigned long)random_rand() % VALUE_RANGE);
+    if(DB_ERROR(run(query, NULL))) {
+      return 0;
+    }
+  }
+  if(DB_ERROR(db_flush())) {
+    return 0;
+  }
+  printf("insert: %lu rows/s\n", rate(BENCHMARK_ROWS, start));
+  print_buffer_stats();
+
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+select_rows(const char *label, const char *attribute, unsigned long domain,
+            int queries)
+{
+  char query[AQL_MAX_QUERY_LENGTH];
+  clock_time_t start;
+  unsigned long rows;
+  unsigned long checked_rows;
+  unsigned long low;
+  int i;
+
+  /* Every run queries the same ranges. */
+  random_init(1);
+
+  rows = checked_rows = 0;
+  processed_rows = 0;
+  start = clock_time();
+  for(i = 0; i < queries; i++) {
+    low = random_rand() % (domain - QUERY_RANGE);
+    snprintf(query, sizeof(query),
+             "SELECT seq, val FROM bench WHERE %s >= %lu AND %s < %lu;",
+             attribute, low, attribute, low + QUERY_RANGE);
+    if(DB_ERROR(run(query, &rows))) {
+      return 0;
+    }
+    if(i == SCAN_QUERIES - 1) {
+      checked_rows = rows;
+    }
+  }
+  printf("%s: %lu queries/s, %lu rows/query, %lu rows/s processed\n",
+         label, rate(queries, start), rows / queries,
+         rate(processed_rows, start));
+  print_buffer_stats();
+
+  /* The row count of the first queries, which all runs have in common. */
+  return checked_rows;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(antelope_benchmark, ev, data)
+{
+  static char query[AQL_MAX_QUERY_LENGTH];
+  static clock_time_t start;
+  static relation_t *rel;
+  static attribute_t *attr;
+  static index_t *index;
+  static const char *attributes[] = {"seq", "val"};
+  static const char *types[] = {"btree", "inline"};
+  static unsigned long scan_rows[2];
+  static int i;
+  static int j;
+
+  PROCESS_BEGIN();
+
+  db_init();
+
+  if(!insert_rows()) {
+    printf("Failed to create the relation\n");
+    PROCESS_EXIT();
+  }
+
+  scan_rows[0] = select_rows("scan seq", "seq", BENCHMARK_ROWS, SCAN_QUERIES);
+  scan_rows[1] = select_rows("scan val", "val", VALUE_RANGE, SCAN_QUERIES);
+
+  for(i = 0; i < 2; i++) {
+    for(j = 0; j < 2; j++) {
+      /* The inline index requires ascending values. */
+      if(i == 1 && j == 1) {
+        break;
+      }
+
+      snprintf(query, sizeof(query), "CREATE INDEX bench.%s TYPE %s;",
+               attributes[i], types[j]);
+      start = clock_time();
+      if(DB_ERROR(run(query, NULL))) {
+        continue;
+      }
+
+      /* Indexes over existing rows are loaded in the background. */
+      rel = relation_load("bench");
+      attr = rel == NULL ? NULL : relation_attribute_get(rel, (char *)attributes[i]);
+      index = attr == NULL ? NULL : attr->index;
+      while(index != NULL && (index->flags & INDEX_LOAD_NEEDED)) {
+        PROCESS_PAUSE();
+      }
+      printf("%s %s index: loaded %lu rows/s\n", types[j], attributes[i],
+             rate(BENCHMARK_ROWS, start));
+      print_buffer_stats();
+      if(rel != NULL) {
+        relation_release(rel);
+      }
+
+      snprintf(query, sizeof(query), "%s %s", types[j], attributes[i]);
+      if(select_rows(query, attributes[i], i == 0 ? BENCHMARK_ROWS : VALUE_RANGE,
+                     INDEX_QUERIES) != scan_rows[i]) {
+        printf("%s: the index and the full scan returned different rows\n",
+               query);
+      }
+
+      snprintf(query, sizeof(query), "REMOVE INDEX bench.%s;", attributes[i]);
+      run(query, NULL);
+    }
+  }
+
+  run("REMOVE RELATION bench;", NULL);
+  printf("done\n");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,19 @@
+#ifndef PROJECT_CONF_H_
+#define PROJECT_CONF_H_
+
+/* The native platform stores files through cfs-posix. */
+#define DB_FEATURE_COFFEE		0
+
+/* Index both attributes of the benchmark relation with B+-trees. */
+#define DB_BTREE_INDEX_LIMIT		2
+#define DB_BTREE_CACHE_LIMIT		16
+
+/* Load indexes over existing rows in larger steps. */
+#define DB_INDEX_LOAD_BATCH		100
+
+/* Buffer 8 kB of relation and index pages. */
+#define DB_STORAGE_PAGE_SIZE		512
+#define DB_STORAGE_PAGE_LIMIT		16
+#define DB_STORAGE_READ_AHEAD		2
+
+#endif /* PROJECT_CONF_H_ */
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Coffee benchmarks on the native platform. Fills the file
+ *         system with BENCHMARK_FILES small files and then measures
+ *         how many files per second can be opened, either files that
+ *         exist, in random order so that few of them are in the file
+ *         cache, or files that do not exist. Then keeps replacing
+ *         files, yielding in between as an application would, and
+ *         shows how much garbage collection the allocations had to do
+ *         themselves. Finally, compares how fast a file that has
+ *         been modified many times through its micro log can be read
+ *         with how fast an unmodified file can be read.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/random.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCHMARK_DURATION  (CLOCK_SECOND * 2)
+#define BENCHMARK_FILES     300
+#define BENCHMARK_FILE_SIZE 128
+#define BENCHMARK_REPLACEMENTS 500
+#define BENCHMARK_LOG_FILE_SIZE 4096
+#define BENCHMARK_LOG_RECORD_SIZE 64
+#define BENCHMARK_LOG_RECORDS 250
+#define BENCHMARK_MODIFICATIONS 240
+
+static char name[16];
+/*---------------------------------------------------------------------------*/
+static void
+set_name(unsigned i)
+{
+  snprintf(name, sizeof(name), "file-%u", i);
+}
+/*---------------------------------------------------------------------------*/
+static void
+open_existing(void)
+{
+  int fd;
+
+  set_name(random_rand() % BENCHMARK_FILES);
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    printf("Failed to open %s\n", name);
+  }
+  cfs_close(fd);
+}
+/*---------------------------------------------------------------------------*/
+static void
+open_missing(void)
+{
+  set_name(BENCHMARK_FILES + random_rand() % BENCHMARK_FILES);
+  if(cfs_open(name, CFS_READ) >= 0) {
+    printf("Opened %s, which does not exist\n", name);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns how many times per second op completes */
+static unsigned long
+run(void (*op)(void))
+{
+  clock_time_t start;
+  unsigned long count;
+  uint8_t i;
+
+  count = 0;
+  start = clock_time();
+  do {
+    for(i = 0; i < 16; i++) {
+      op();
+    }
+    count += 16;
+  } while(clock_time() - start < BENCHMARK_DURATION);
+
+  return count / (BENCHMARK_DURATION / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+/* Returns how many replacements failed */
+static unsigned
+replace_file(unsigned i)
+{
+  int fd;
+
+  set_name(BENCHMARK_FILES + i % 2);
+  cfs_remove(name);
+  fd = cfs_open(name, CFS_WRITE);
+  if(fd < 0) {
+    return 1;
+  }
+  cfs_write(fd, name, sizeof(name));
+  cfs_close(fd);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+create_log_file(const char *filename, unsigned modifications)
+{
+  static char buf[BENCHMARK_LOG_RECORD_SIZE];
+  unsigned i;
+  int fd;
+
+  if(cfs_coffee_reserve(filename, BENCHMARK_LOG_FILE_SIZE) < 0 ||
+     cfs_coffee_configure_log(filename,
+                              BENCHMARK_LOG_RECORDS *
+                              BENCHMARK_LOG_RECORD_SIZE,
+                              BENCHMARK_LOG_RECORD_SIZE) < 0) {
+    return -1;
+  }
+
+  fd = cfs_open(filename, CFS_WRITE);
+  if(fd < 0) {
+    return -1;
+  }
+  /* Coffee finds the end of a file by its last non-zero byte. */
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < BENCHMARK_LOG_FILE_SIZE; i += sizeof(buf)) {
+    cfs_write(fd, buf, sizeof(buf));
+  }
+  cfs_close(fd);
+
+  fd = cfs_open(filename, CFS_READ | CFS_WRITE);
+  if(fd < 0) {
+    return -1;
+  }
+  for(i = 0; i < modifications; i++) {
+    cfs_seek(fd, random_rand() % (BENCHMARK_LOG_FILE_SIZE - 8), CFS_SEEK_SET);
+    cfs_write(fd, &i, sizeof(i));
+  }
+  cfs_close(fd);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_log_file(void)
+{
+  char buf[BENCHMARK_LOG_RECORD_SIZE];
+  int fd;
+
+  fd = cfs_open(name, CFS_READ);
+  while(cfs_read(fd, buf, sizeof(buf)) > 0);
+  cfs_close(fd);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+count_lost_files(void)
+{
+  unsigned i;
+  unsigned lost;
+  int fd;
+
+  lost = 0;
+  for(i = 0; i < BENCHMARK_FILES + 2; i++) {
+    set_name(i);
+    fd = cfs_open(name, CFS_READ);
+    if(fd < 0) {
+      lost++;
+    }
+    cfs_close(fd);
+  }
+  return lost;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coffee_benchmark_process, "Coffee benchmark process");
+AUTOSTART_PROCESSES(&coffee_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_benchmark_process, ev, data)
+{
+  static unsigned i;
+  static unsigned failures;
+  struct cfs_coffee_gc_stats stats;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  for(i = 0; i < BENCHMARK_FILES; i++) {
+    set_name(i);
+    if(cfs_coffee_reserve(name, BENCHMARK_FILE_SIZE) < 0) {
+      printf("Failed to reserve %s\n", name);
+      PROCESS_EXIT();
+    }
+  }
+
+  printf("%u files: %lu opens/s of existing files",
+         BENCHMARK_FILES, run(open_existing));
+  printf(", %lu opens/s of missing files\n", run(open_missing));
+
+  failures = 0;
+  for(i = 0; i < BENCHMARK_REPLACEMENTS; i++) {
+    failures += replace_file(i);
+    PROCESS_PAUSE();
+  }
+  if(count_lost_files() > 0) {
+    printf("Files were lost\n");
+  }
+  cfs_coffee_get_gc_stats(&stats);
+  printf("%u replacements, %u failed: %lu sectors erased in the background, "
+         "%lu by %lu allocations, at most %u by one\n",
+         BENCHMARK_REPLACEMENTS, failures, stats.background_erases,
+         stats.foreground_erases, stats.foreground_runs,
+         stats.max_foreground_erases);
+
+  if(create_log_file("plain", 0) < 0 ||
+     create_log_file("modified", BENCHMARK_MODIFICATIONS) < 0) {
+    printf("Failed to create the log files\n");
+    PROCESS_EXIT();
+  }
+  strcpy(name, "plain");
+  printf("%u-byte files: %lu reads/s unmodified",
+         BENCHMARK_LOG_FILE_SIZE, run(read_log_file));
+  strcpy(name, "modified");
+  printf(", %lu reads/s after %u modifications\n",
+         run(read_log_file), BENCHMARK_MODIFICATIONS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
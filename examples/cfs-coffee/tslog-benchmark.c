@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Compares appending sensor samples to a Coffee file with
+ *         appending them to a tslog, by how fast appending is and by
+ *         how many sectors have to be erased for it, since the native
+ *         flash is RAM and only the latter shows what appending costs
+ *         on real flash. Then measures how fast the tslog
+ *         can be read back and searched by timestamp, and checks that
+ *         it is found intact when opened again.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/random.h"
+#include "tslog.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCHMARK_DURATION (CLOCK_SECOND * 2)
+#define SAMPLES        8192
+#define SEGMENTS       8
+#define SEGMENT_SIZE   16384
+#define SEEKS          1000
+
+struct sample {
+  uint32_t time;
+  int16_t values[6];
+};
+
+static struct tslog log;
+static unsigned long appended;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+rate(unsigned long count, clock_time_t start)
+{
+  clock_time_t elapsed;
+
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  return count * CLOCK_SECOND / elapsed;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+erased_sectors(void)
+{
+  struct cfs_coffee_gc_stats stats;
+
+  cfs_coffee_get_gc_stats(&stats);
+  return stats.foreground_erases + stats.background_erases;
+}
+/*---------------------------------------------------------------------------*/
+/* Sectors erased per megabyte of samples since a count of erased sectors. */
+static unsigned long
+erases_per_mb(unsigned long count, unsigned long erased)
+{
+  return (erased_sectors() - erased) * 1048576UL /
+    (count * sizeof(struct sample));
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Appends SAMPLES samples to a new Coffee file, which Coffee extends by
+ * copying as it fills up, over and over for BENCHMARK_DURATION.
+ */
+static unsigned long
+coffee_append(void)
+{
+  struct sample sample;
+  clock_time_t start;
+  unsigned long count, erased;
+  unsigned i;
+  int fd;
+
+  memset(&sample, 0, sizeof(sample));
+  count = 0;
+  erased = erased_sectors();
+  start = clock_time();
+  do {
+    cfs_remove("samples");
+    fd = cfs_open("samples", CFS_WRITE | CFS_APPEND);
+    for(i = 0; i < SAMPLES; i++) {
+      sample.time = i;
+      if(cfs_write(fd, &sample, sizeof(sample)) != sizeof(sample)) {
+        printf("Coffee append failed after %u samples\n", i);
+        cfs_close(fd);
+        return 0;
+      }
+    }
+    cfs_close(fd);
+    count += SAMPLES;
+  } while(clock_time() - start < BENCHMARK_DURATION);
+  cfs_remove("samples");
+
+  printf("%lu appends/s to a Coffee file, %lu erases/MB\n",
+         rate(count, start), erases_per_mb(count, erased));
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+/* Appends samples to the tslog for BENCHMARK_DURATION. */
+static unsigned long
+tslog_append_samples(void)
+{
+  struct sample sample;
+  clock_time_t start;
+  unsigned long erased;
+
+  memset(&sample, 0, sizeof(sample));
+  erased = erased_sectors();
+  start = clock_time();
+  do {
+    sample.time = appended;
+    if(tslog_append(&log, appended, &sample, sizeof(sample)) < 0) {
+      printf("tslog append failed after %lu samples\n", appended);
+      return 0;
+    }
+    appended++;
+  } while((appended & 0xff) != 0 || clock_time() - start < BENCHMARK_DURATION);
+
+  printf("%lu appends/s to a tslog of %u %u-byte segments, %lu erases/MB\n",
+         rate(appended, start), SEGMENTS, SEGMENT_SIZE,
+         erases_per_mb(appended, erased));
+  return appended;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns how many records there are, or 0 if they are out of order. */
+static unsigned long
+read_all(void)
+{
+  struct tslog_cursor cursor;
+  struct sample sample;
+  uint32_t timestamp, last;
+  unsigned long count;
+
+  count = 0;
+  last = 0;
+  tslog_rewind(&log, &cursor);
+  while(tslog_read(&log, &cursor, &timestamp, &sample, sizeof(sample)) ==
+        sizeof(sample)) {
+    if((count > 0 && timestamp != last + 1) || sample.time != timestamp) {
+      return 0;
+    }
+    last = timestamp;
+    count++;
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns how many seeks per second there are, or 0 if one fails. */
+static unsigned long
+seek_samples(uint32_t oldest, unsigned long count)
+{
+  struct tslog_cursor cursor;
+  struct sample sample;
+  clock_time_t start;
+  uint32_t target, timestamp;
+  unsigned i;
+
+  start = clock_time();
+  for(i = 0; i < SEEKS; i++) {
+    target = oldest + random_rand() % count;
+    if(tslog_seek(&log, &cursor, target) < 0 ||
+       tslog_read(&log, &cursor, &timestamp, &sample, sizeof(sample)) < 0 ||
+       timestamp != target) {
+      return 0;
+    }
+  }
+  return rate(SEEKS, start);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(tslog_benchmark_process, "tslog benchmark process");
+AUTOSTART_PROCESSES(&tslog_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tslog_benchmark_process, ev, data)
+{
+  struct tslog_cursor cursor;
+  struct sample sample;
+  unsigned long count;
+  uint32_t oldest;
+  clock_time_t start;
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+
+  printf("%u-byte samples\n", (unsigned)sizeof(struct sample));
+  if(coffee_append() == 0) {
+    PROCESS_EXIT();
+  }
+
+  if(tslog_open(&log, "samples", SEGMENTS, SEGMENT_SIZE) < 0) {
+    printf("Failed to open the tslog\n");
+    PROCESS_EXIT();
+  }
+  if(tslog_append_samples() == 0) {
+    PROCESS_EXIT();
+  }
+
+  start = clock_time();
+  count = read_all();
+  if(count == 0) {
+    printf("The tslog records are out of order\n");
+    PROCESS_EXIT();
+  }
+  printf("%lu samples kept: %lu reads/s", count, rate(count, start));
+
+  tslog_rewind(&log, &cursor);
+  tslog_read(&log, &cursor, &oldest, &sample, sizeof(sample));
+  printf(", %lu seeks/s\n", seek_samples(oldest, count));
+
+  tslog_close(&log);
+  sample.time = appended;
+  if(tslog_open(&log, "samples", SEGMENTS, SEGMENT_SIZE) < 0 ||
+     tslog_append(&log, appended, &sample, sizeof(sample)) < 0 ||
+     read_all() != count + 1) {
+    printf("The tslog was not intact when opened again\n");
+  } else {
+    printf("The tslog was intact when opened again\n");
+  }
+  tslog_erase(&log);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Measures how many small reads and writes per second the CFS
+ *         backend of the native platform serves: appending records to
+ *         a file, reading them back in order, and reading them in
+ *         random order. Build with CFS_MMAP=0 to measure cfs-posix
+ *         instead of cfs-mmap.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#if WITH_CFS_MMAP
+#include "cfs/cfs-mmap.h"
+#endif
+#include "lib/random.h"
+#include <stdio.h>
+
+#define BENCHMARK_FILE     "cfs-benchmark.dat"
+#define BENCHMARK_RECORDS  1000000UL
+#define RANDOM_READS       1000000UL
+
+struct record {
+  uint32_t id;
+  uint32_t data[3];
+};
+/*---------------------------------------------------------------------------*/
+static unsigned long
+rate(unsigned long count, clock_time_t start)
+{
+  clock_time_t elapsed;
+
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+  return count * CLOCK_SECOND / elapsed;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+write_records(void)
+{
+  struct record record;
+  clock_time_t start;
+  unsigned long i;
+  int fd;
+
+  fd = cfs_open(BENCHMARK_FILE, CFS_WRITE);
+  if(fd < 0) {
+    return 0;
+  }
+
+  start = clock_time();
+  for(i = 0; i < BENCHMARK_RECORDS; i++) {
+    record.id = i;
+    record.data[0] = record.data[1] = record.data[2] = ~i;
+    if(cfs_write(fd, &record, sizeof(record)) != sizeof(record)) {
+      cfs_close(fd);
+      return 0;
+    }
+  }
+#if WITH_CFS_MMAP
+  cfs_mmap_sync(fd);
+#endif
+  cfs_close(fd);
+  return rate(BENCHMARK_RECORDS, start);
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+read_records(void)
+{
+  struct record record;
+  clock_time_t start;
+  unsigned long i;
+  int fd;
+
+  fd = cfs_open(BENCHMARK_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+
+  start = clock_time();
+  for(i = 0; cfs_read(fd, &record, sizeof(record)) == sizeof(record); i++) {
+    if(record.id != i) {
+      break;
+    }
+  }
+  cfs_close(fd);
+  return i == BENCHMARK_RECORDS ? rate(i, start) : 0;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+read_random_records(void)
+{
+  struct record record;
+  clock_time_t start;
+  unsigned long i, id;
+  int fd;
+
+  fd = cfs_open(BENCHMARK_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+
+  start = clock_time();
+  for(i = 0; i < RANDOM_READS; i++) {
+    id = ((unsigned long)random_rand() << 16 | random_rand()) %
+      BENCHMARK_RECORDS;
+    cfs_seek(fd, id * sizeof(record), CFS_SEEK_SET);
+    if(cfs_read(fd, &record, sizeof(record)) != sizeof(record) ||
+       record.id != id) {
+      cfs_close(fd);
+      return 0;
+    }
+  }
+  cfs_close(fd);
+  return rate(RANDOM_READS, start);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(cfs_benchmark_process, "CFS benchmark process");
+AUTOSTART_PROCESSES(&cfs_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(cfs_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("%u-byte records: %lu writes/s", (unsigned)sizeof(struct record),
+         write_records());
+  printf(", %lu sequential reads/s", read_records());
+  printf(", %lu random reads/s\n", read_random_records());
+  cfs_remove(BENCHMARK_FILE);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -41,6 +41,7 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl.h"
+#include "net/rpl/rpl-ns.h"
 
 #include "net/netstack.h"
 #include "dev/button-sensor.h"
@@ -145,6 +146,11 @@ PT_THREAD(generate_routes(struct httpd_state *s))
 {
   static uip_ds6_route_t *r;
   static uip_ds6_nbr_t *nbr;
+#if RPL_WITH_NON_STORING
+  static rpl_ns_node_t *link;
+  uip_ipaddr_t child_ipaddr;
+  uip_ipaddr_t parent_ipaddr;
+#endif /* RPL_WITH_NON_STORING */
 #if BUF_USES_STACK
   char buf[256];
 #endif
@@ -259,6 +265,36 @@ PT_THREAD(generate_routes(struct httpd_state *s))
   }
   ADD("</pre>");
 
+#if RPL_WITH_NON_STORING
+  /* In non-storing mode, the downward routes are the links of the
+     topology known to the root */
+  ADD("Links<pre>");
+  SEND_STRING(&s->sout, buf);
+#if BUF_USES_STACK
+  bufptr = buf; bufend = bufptr + sizeof(buf);
+#else
+  blen = 0;
+#endif
+  for(link = rpl_ns_node_head(); link != NULL; link = rpl_ns_node_next(link)) {
+    if(link->parent == NULL) {
+      continue;
+    }
+    rpl_ns_get_node_global_addr(&child_ipaddr, link);
+    rpl_ns_get_node_global_addr(&parent_ipaddr, link->parent);
+    ipaddr_add(&child_ipaddr);
+    ADD(" (parent: ");
+    ipaddr_add(&parent_ipaddr);
+    ADD(") %lus\n", (unsigned long)rpl_ns_node_lifetime(link));
+    SEND_STRING(&s->sout, buf);
+#if BUF_USES_STACK
+    bufptr = buf; bufend = bufptr + sizeof(buf);
+#else
+    blen = 0;
+#endif
+  }
+  ADD("</pre>");
+#endif /* RPL_WITH_NON_STORING */
+
 #if WEBSERVER_CONF_FILESTATS
   static uint16_t numtimes;
   ADD("<br><i>This page sent %u times</i>",++numtimes);
@@ -41,6 +41,7 @@
 #include "net/rpl/rpl.h"
 #include "net/ipv6/uip-ds6-route.h"
 #include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-slot-operation.h"
 #if WITH_ORCHESTRA
 #include "orchestra.h"
 #endif /* WITH_ORCHESTRA */
@@ -106,6 +107,14 @@ print_network_status(void)
     PRINTA(" (lifetime: %lu seconds)\n", (unsigned long)route->state.lifetime);
     route = uip_ds6_route_next(route); 
   }
+
+#if TSCH_BURST_MAX_LEN > 1
+  /* Our TSCH burst counters */
+  PRINTA("- TSCH bursts: %lu (frames tx %lu, rx %lu)\n",
+         (unsigned long)tsch_burst_stats.bursts,
+         (unsigned long)tsch_burst_stats.tx,
+         (unsigned long)tsch_burst_stats.rx);
+#endif /* TSCH_BURST_MAX_LEN > 1 */
   
   PRINTA("----------------------\n");
 }
@@ -45,6 +45,11 @@
 #define WITH_SECURITY 0
 #endif /* WITH_SECURITY */
 
+/* Set to enable TSCH bursts (frame pending) */
+#ifndef WITH_BURST
+#define WITH_BURST 0
+#endif /* WITH_BURST */
+
 /*******************************************************/
 /********************* Enable TSCH *********************/
 /*******************************************************/
@@ -111,6 +116,14 @@
 
 #endif /* WITH_SECURITY */
 
+#if WITH_BURST
+
+/* Send up to 4 queued frames back-to-back in consecutive timeslots */
+#undef TSCH_CONF_BURST_MAX_LEN
+#define TSCH_CONF_BURST_MAX_LEN 4
+
+#endif /* WITH_BURST */
+
 #if WITH_ORCHESTRA
 
 /* See apps/orchestra/README.md for more Orchestra configuration options */
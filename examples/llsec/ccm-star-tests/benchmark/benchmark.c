@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Throughput of the AES-128 drivers and of CCM*. For each driver,
+ *         counts the blocks encrypted within BENCHMARK_DURATION, first
+ *         under a single key and then switching between BENCHMARK_KEYS
+ *         keys before each block, as a node that talks to several
+ *         neighbors with pairwise keys would.
+ */
+
+#include "contiki.h"
+#include "dev/watchdog.h"
+#include "lib/aes-128.h"
+#include "lib/ccm-star.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCHMARK_DURATION  (CLOCK_SECOND * 2)
+#define BENCHMARK_KEYS      4
+#define BENCHMARK_FRAME_LEN 64
+#define BENCHMARK_MIC_LEN   8
+
+struct driver {
+  const char *name;
+  const struct aes_128_driver *driver;
+};
+
+static const struct driver drivers[] = {
+  { "default", &aes_128_driver },
+  { "ttable", &aes_128_ttable_driver },
+  { "AES_128", &AES_128 },
+};
+
+static uint8_t keys[BENCHMARK_KEYS][AES_128_KEY_LENGTH];
+static const struct aes_128_driver *current;
+static uint8_t block[AES_128_BLOCK_SIZE];
+static uint8_t frame[BENCHMARK_FRAME_LEN];
+static uint8_t nonce[CCM_STAR_NONCE_LENGTH];
+static uint8_t mic[BENCHMARK_MIC_LEN];
+static uint8_t next_key;
+/*---------------------------------------------------------------------------*/
+/* Test vector C.1 from FIPS Pub 197 */
+static int
+verify(const struct aes_128_driver *driver)
+{
+  static const uint8_t key[16] = { 0x00 , 0x01 , 0x02 , 0x03 ,
+                                   0x04 , 0x05 , 0x06 , 0x07 ,
+                                   0x08 , 0x09 , 0x0A , 0x0B ,
+                                   0x0C , 0x0D , 0x0E , 0x0F };
+  static const uint8_t oracle[16] = { 0x69 , 0xC4 , 0xE0 , 0xD8 ,
+                                      0x6A , 0x7B , 0x04 , 0x30 ,
+                                      0xD8 , 0xCD , 0xB7 , 0x80 ,
+                                      0x70 , 0xB4 , 0xC5 , 0x5A };
+  uint8_t data[16] = { 0x00 , 0x11 , 0x22 , 0x33 ,
+                       0x44 , 0x55 , 0x66 , 0x77 ,
+                       0x88 , 0x99 , 0xAA , 0xBB ,
+                       0xCC , 0xDD , 0xEE , 0xFF };
+
+  driver->set_key(key);
+  driver->encrypt(data);
+  return memcmp(data, oracle, 16) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+encrypt_block(void)
+{
+  current->encrypt(block);
+}
+/*---------------------------------------------------------------------------*/
+static void
+rekey_and_encrypt_block(void)
+{
+  current->set_key(keys[next_key]);
+  next_key = (next_key + 1) % BENCHMARK_KEYS;
+  current->encrypt(block);
+}
+/*---------------------------------------------------------------------------*/
+static void
+secure_frame(void)
+{
+  CCM_STAR.set_key(keys[next_key]);
+  next_key = (next_key + 1) % BENCHMARK_KEYS;
+  nonce[CCM_STAR_NONCE_LENGTH - 1]++;
+  CCM_STAR.aead(nonce, frame, BENCHMARK_FRAME_LEN, NULL, 0,
+      mic, BENCHMARK_MIC_LEN, 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Returns how many times per second op completes */
+static unsigned long
+run(void (*op)(void))
+{
+  clock_time_t start;
+  unsigned long count;
+  uint8_t i;
+
+  count = 0;
+  start = clock_time();
+  do {
+    for(i = 0; i < 16; i++) {
+      op();
+    }
+    count += 16;
+    watchdog_periodic();
+  } while(clock_time() - start < BENCHMARK_DURATION);
+
+  return count / (BENCHMARK_DURATION / CLOCK_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(ccm_star_benchmark_process, "CCM* benchmark process");
+AUTOSTART_PROCESSES(&ccm_star_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ccm_star_benchmark_process, ev, data)
+{
+  uint8_t i;
+  uint8_t j;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < BENCHMARK_KEYS; i++) {
+    for(j = 0; j < AES_128_KEY_LENGTH; j++) {
+      keys[i][j] = i * AES_128_KEY_LENGTH + j;
+    }
+  }
+
+  for(i = 0; i < sizeof(drivers) / sizeof(drivers[0]); i++) {
+    current = drivers[i].driver;
+    if(!verify(current)) {
+      printf("%s: Failure\n", drivers[i].name);
+      continue;
+    }
+    current->set_key(keys[0]);
+    printf("%s: %lu blocks/s", drivers[i].name, run(encrypt_block));
+    printf(", %lu blocks/s with %u keys\n",
+        run(rekey_and_encrypt_block), BENCHMARK_KEYS);
+  }
+
+  printf("CCM*: %lu frames/s of %u bytes with %u keys\n",
+      run(secure_frame), BENCHMARK_FRAME_LEN, BENCHMARK_KEYS);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Testing pairsec. Node 1 broadcasts a round number every
+ *         ROUND_INTERVAL, which exercises group keys, and every other node
+ *         replies by unicast, which exercises session keys. At the start of
+ *         each round, node 1 prints how many replies it got in the last one.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/ip/uip.h"
+#include "simple-udp.h"
+#include "sys/node-id.h"
+#include <stdio.h>
+#include <string.h>
+
+#define UDP_PORT 1234
+#define ROUND_INTERVAL (CLOCK_SECOND * 2)
+
+static struct simple_udp_connection connection;
+static uint16_t round;
+static uint16_t replies;
+static uip_ipaddr_t reply_addr;
+static uint16_t reply_round;
+/*---------------------------------------------------------------------------*/
+PROCESS(pairsec_tests_process, "pairsec tests process");
+AUTOSTART_PROCESSES(&pairsec_tests_process);
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  uint16_t received_round;
+
+  if(datalen != sizeof(received_round)) {
+    return;
+  }
+  memcpy(&received_round, data, sizeof(received_round));
+
+  if(node_id == 1) {
+    if(received_round == round) {
+      replies++;
+    }
+  } else {
+    /* Reply after a random delay to avoid collisions */
+    uip_ipaddr_copy(&reply_addr, sender_addr);
+    reply_round = received_round;
+    process_poll(&pairsec_tests_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(pairsec_tests_process, ev, data)
+{
+  static struct etimer timer;
+  uip_ipaddr_t addr;
+
+  PROCESS_BEGIN();
+
+  simple_udp_register(&connection, UDP_PORT, NULL, UDP_PORT, receiver);
+
+  if(node_id == 1) {
+    etimer_set(&timer, ROUND_INTERVAL);
+    while(1) {
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&timer));
+      etimer_reset(&timer);
+      if(round) {
+        printf("Round %u: %u replies\n", round, replies);
+      }
+      round++;
+      replies = 0;
+      uip_create_linklocal_allnodes_mcast(&addr);
+      simple_udp_sendto(&connection, &round, sizeof(round), &addr);
+    }
+  } else {
+    while(1) {
+      PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+      etimer_set(&timer, random_rand() % (ROUND_INTERVAL / 4));
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&timer));
+      simple_udp_sendto(&connection,
+          &reply_round, sizeof(reply_round), &reply_addr);
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
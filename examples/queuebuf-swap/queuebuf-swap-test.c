@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016, SICS Swedish ICT.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Tests swapping queuebufs between RAM and CFS. TEST_PACKETS
+ *         packets are queued in bursts, more than fit in RAM, and are
+ *         then drained in order while the swap process prefetches them.
+ *         Every packet must come back intact.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_PACKETS  60
+#define BURST_LENGTH  4
+
+static struct queuebuf *queued[TEST_PACKETS];
+/*---------------------------------------------------------------------------*/
+static void
+print_stats(const char *label)
+{
+  struct queuebuf_swap_stats stats;
+
+  queuebuf_swap_get_stats(&stats);
+  printf("%s: %u in RAM, %u in CFS (max %u), %lu spills (%lu synchronous), "
+         "%lu prefetches, %lu misses, %lu failures\n", label,
+         stats.in_ram, stats.in_swap, stats.max_in_swap,
+         (unsigned long)stats.spills, (unsigned long)stats.sync_spills,
+         (unsigned long)stats.prefetches, (unsigned long)stats.misses,
+         (unsigned long)stats.failures);
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_packet(int i)
+{
+  char payload[20];
+
+  snprintf(payload, sizeof(payload), "packet %d", i);
+  packetbuf_copyfrom(payload, strlen(payload) + 1);
+  packetbuf_set_attr(PACKETBUF_ATTR_CHANNEL, i);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(queuebuf_swap_test_process, "queuebuf swap test");
+AUTOSTART_PROCESSES(&queuebuf_swap_test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(queuebuf_swap_test_process, ev, data)
+{
+  static struct etimer et;
+  static int errors;
+  static int i;
+  char expected[20];
+
+  PROCESS_BEGIN();
+
+  /* Let the swap process start. */
+  etimer_set(&et, 1);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  errors = 0;
+  for(i = 0; i < TEST_PACKETS; i++) {
+    make_packet(i);
+    queued[i] = queuebuf_new_from_packetbuf();
+    if(queued[i] == NULL) {
+      printf("Failed to queue packet %d\n", i);
+      errors++;
+    }
+    if(i % BURST_LENGTH == BURST_LENGTH - 1) {
+      PROCESS_PAUSE();
+    }
+  }
+  print_stats("queued");
+
+  for(i = 0; i < TEST_PACKETS; i++) {
+    if(queued[i] == NULL) {
+      continue;
+    }
+    queuebuf_to_packetbuf(queued[i]);
+    snprintf(expected, sizeof(expected), "packet %d", i);
+    if(strcmp(packetbuf_dataptr(), expected) != 0 ||
+       packetbuf_attr(PACKETBUF_ATTR_CHANNEL) != i) {
+      printf("Packet %d came back corrupted\n", i);
+      errors++;
+    }
+    queuebuf_free(queued[i]);
+    /* Give the swap process time to prefetch the next packets. */
+    PROCESS_PAUSE();
+    PROCESS_PAUSE();
+  }
+  print_stats("drained");
+
+  printf("%s\n", errors == 0 ? "TEST OK" : "TEST FAILED");
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
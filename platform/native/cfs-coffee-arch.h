@@ -54,8 +54,32 @@
 #define COFFEE_LOG_DIVISOR		4
 #define COFFEE_LOG_SIZE			8192
 #define COFFEE_LOG_TABLE_LIMIT		256
+#ifdef COFFEE_CONF_MICRO_LOGS
+#define COFFEE_MICRO_LOGS		COFFEE_CONF_MICRO_LOGS
+#else
 #define COFFEE_MICRO_LOGS		0
+#endif
 #define COFFEE_IO_SEMANTICS		1
+#ifdef COFFEE_CONF_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE		COFFEE_CONF_NAME_INDEX_SIZE
+#else
+#define COFFEE_NAME_INDEX_SIZE		512
+#endif
+#ifdef COFFEE_CONF_BACKGROUND_GC
+#define COFFEE_BACKGROUND_GC		COFFEE_CONF_BACKGROUND_GC
+#else
+#define COFFEE_BACKGROUND_GC		1
+#endif
+#ifdef COFFEE_CONF_LOG_INDEX_SIZE
+#define COFFEE_LOG_INDEX_SIZE		COFFEE_CONF_LOG_INDEX_SIZE
+#else
+#define COFFEE_LOG_INDEX_SIZE		64
+#endif
+#ifdef COFFEE_CONF_READ_CACHE_SIZE
+#define COFFEE_READ_CACHE_SIZE		COFFEE_CONF_READ_CACHE_SIZE
+#else
+#define COFFEE_READ_CACHE_SIZE		0
+#endif
 
 #define COFFEE_WRITE(buf, size, offset)				\
 		xmem_pwrite((char *)(buf), (size), COFFEE_START + (offset))
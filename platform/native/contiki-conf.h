@@ -128,6 +128,13 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_MAX_ROUTES   30
 #endif /* UIP_CONF_MAX_ROUTES */
 
+#ifndef AES_128_CONF
+#define AES_128_CONF native_aes_128_driver
+#endif /* AES_128_CONF */
+#ifndef AES_128_CONF_KEY_CACHE_SIZE
+#define AES_128_CONF_KEY_CACHE_SIZE 8
+#endif /* AES_128_CONF_KEY_CACHE_SIZE */
+
 #define UIP_CONF_ND6_SEND_RA		0
 #define UIP_CONF_ND6_REACHABLE_TIME     600000
 #define UIP_CONF_ND6_RETRANS_TIMER      10000
@@ -28,3 +28,7 @@
  */
 #define TCPIP_CONF_ANNOTATE_TRANSMISSIONS 1
 
+#ifdef RPL_SECOND_INSTANCE
+/* Nodes join both the default and the second instance */
+#define RPL_CONF_MAX_INSTANCES 2
+#endif /* RPL_SECOND_INSTANCE */
@@ -104,9 +104,13 @@ create_rpl_dag(uip_ipaddr_t *ipaddr)
     rpl_dag_t *dag;
     uip_ipaddr_t prefix;
     
-    rpl_set_root(RPL_DEFAULT_INSTANCE, ipaddr);
-    dag = rpl_get_any_dag();
     uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+#ifdef RPL_SECOND_INSTANCE
+    /* The instance rooted last becomes the default one */
+    dag = rpl_set_root(RPL_SECOND_INSTANCE, ipaddr);
+    rpl_set_prefix(dag, &prefix, 64);
+#endif /* RPL_SECOND_INSTANCE */
+    dag = rpl_set_root(RPL_DEFAULT_INSTANCE, ipaddr);
     rpl_set_prefix(dag, &prefix, 64);
     PRINTF("created a new RPL dag\n");
   } else {
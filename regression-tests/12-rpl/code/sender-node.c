@@ -38,16 +38,33 @@
 
 #include "simple-udp.h"
 
+#ifdef RPL_SECOND_INSTANCE
+#include "net/rpl/rpl.h"
+#endif /* RPL_SECOND_INSTANCE */
+
 #include <stdio.h>
 #include <string.h>
 
 #define UDP_PORT 1234
 
-#define SEND_INTERVAL		(60 * CLOCK_SECOND)
+#ifndef SEND_INTERVAL_SECONDS
+#define SEND_INTERVAL_SECONDS	60
+#endif
+#define SEND_INTERVAL		(SEND_INTERVAL_SECONDS * CLOCK_SECOND)
 #define SEND_TIME		(random_rand() % (SEND_INTERVAL))
 
 static struct simple_udp_connection unicast_connection;
 
+#ifdef RPL_SECOND_INSTANCE
+/* Messages alternate between the default and the second RPL instance */
+static uint8_t instance_id = RPL_DEFAULT_INSTANCE;
+
+uint8_t
+sender_select_instance(void)
+{
+  return instance_id;
+}
+#endif /* RPL_SECOND_INSTANCE */
 /*---------------------------------------------------------------------------*/
 PROCESS(sender_node_process, "Sender node process");
 AUTOSTART_PROCESSES(&sender_node_process);
@@ -114,11 +131,27 @@ PROCESS_THREAD(sender_node_process, ev, data)
     {
       static unsigned int message_number;
       char buf[20];
+#ifdef RPL_SECOND_INSTANCE
+      rpl_instance_t *instance;
+
+      instance_id = instance_id == RPL_DEFAULT_INSTANCE ?
+        RPL_SECOND_INSTANCE : RPL_DEFAULT_INSTANCE;
+      instance = rpl_get_instance(instance_id);
+      if(instance == NULL || instance->current_dag == NULL ||
+         !instance->current_dag->joined) {
+        printf("Not in instance %u\n", instance_id);
+        continue;
+      }
+#endif /* RPL_SECOND_INSTANCE */
 
       printf("Sending unicast to ");
       uip_debug_ipaddr_print(&addr);
       printf("\n");
+#ifdef RPL_SECOND_INSTANCE
+      sprintf(buf, "Message %d %u", message_number, instance_id);
+#else /* RPL_SECOND_INSTANCE */
       sprintf(buf, "Message %d", message_number);
+#endif /* RPL_SECOND_INSTANCE */
       message_number++;
       simple_udp_sendto(&unicast_connection, buf, strlen(buf) + 1, &addr);
     }